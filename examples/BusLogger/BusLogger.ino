@@ -0,0 +1,85 @@
+// BusLogger
+
+// This demo runs on Teensy 3.5 and 3.6 (built-in SD card slot)
+// The FlexCAN module is configured in loop back mode: no external hardware required.
+// Every received frame is logged in binary format (see ACANBusLogFormat.h) into the
+// CANLOG.BIN file of the SD card.
+
+//-----------------------------------------------------------------
+
+#include <ACAN.h>
+#include <ACANBusLogger.h>
+#include <SD.h>
+
+//-----------------------------------------------------------------
+
+static ACANBusLogger gLogger (8) ; // Two buffers of 8 x 512 bytes
+static File gLogFile ;
+
+//-----------------------------------------------------------------
+
+void setup () {
+  Serial.begin (9600) ;
+  Serial.println ("Hello") ;
+  if (!SD.begin (BUILTIN_SDCARD)) {
+    Serial.println ("SD card error") ;
+  }
+  gLogFile = SD.open ("CANLOG.BIN", FILE_WRITE) ;
+  gLogger.begin () ;
+  ACAN::can0.setBusLogger (& gLogger) ;
+  ACANSettings settings (1000 * 1000) ; // 1 Mbit/s
+  settings.mLoopBackMode = true ;
+  settings.mSelfReceptionMode = true ;
+  const uint32_t errorCode = ACAN::can0.begin (settings) ;
+  if (0 == errorCode) {
+    Serial.println ("can0 ok") ;
+  }else{
+    Serial.print ("Error can0: 0x") ;
+    Serial.println (errorCode, HEX) ;
+  }
+}
+
+//-----------------------------------------------------------------
+
+static uint32_t gDisplayDate = 0 ;
+static uint32_t gSentCount = 0 ;
+static const uint32_t MESSAGE_COUNT = 100 * 1000 ;
+
+//-----------------------------------------------------------------
+
+void loop () {
+//--- Send frames as fast as possible
+  if (gSentCount < MESSAGE_COUNT) {
+    CANMessage message ;
+    message.id = gSentCount & 0x7FF ;
+    message.len = 8 ;
+    message.data32 [0] = gSentCount ;
+    if (ACAN::can0.tryToSend (message)) {
+      gSentCount += 1 ;
+    }
+  }else if (gLogFile) {
+    gLogger.sync (gLogFile) ;
+    gLogFile.close () ;
+  }
+//--- Frames are not handled by the sketch, only logged
+  CANMessage frame ;
+  while (ACAN::can0.receive (frame)) {}
+//--- Write full buffers
+  if (gLogFile) {
+    gLogger.flush (gLogFile) ;
+  }
+//--- Display statistics
+  if (gDisplayDate < millis ()) {
+    gDisplayDate += 1000 ;
+    Serial.print ("Sent: ") ;
+    Serial.print (gSentCount) ;
+    Serial.print (", logged: ") ;
+    Serial.print (gLogger.loggedFrameCount ()) ;
+    Serial.print (", dropped: ") ;
+    Serial.print (gLogger.droppedFrameCount ()) ;
+    Serial.print (", blocks: ") ;
+    Serial.println (gLogger.writtenBlockCount ()) ;
+  }
+}
+
+//-----------------------------------------------------------------
@@ -0,0 +1,29 @@
+// HostAdapter
+
+// This demo turns a Teensy into a SLCAN (Lawicel) / GVRET (SavvyCAN) bus adapter.
+// Connect a CAN transceiver to CAN0, and open the USB serial port with slcand, SavvyCAN,
+// or any SLCAN compatible application. The bus is configured by the host (S6 then O for
+// 500 kbit/s in SLCAN).
+
+//-----------------------------------------------------------------
+
+#include <ACAN.h>
+#include <ACANHostAdapter.h>
+
+//-----------------------------------------------------------------
+
+static ACANHostAdapter gAdapter (ACAN::can0, Serial) ;
+
+//-----------------------------------------------------------------
+
+void setup () {
+  Serial.begin (9600) ; // Baud rate is ignored by USB serial
+}
+
+//-----------------------------------------------------------------
+
+void loop () {
+  gAdapter.poll () ;
+}
+
+//-----------------------------------------------------------------
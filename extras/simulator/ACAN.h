@@ -0,0 +1,33 @@
+//----------------------------------------------------------------------------------------
+// ACAN driver API on the virtual CAN bus (host), for running sketches unchanged
+// by Pierre Molinaro
+// https://github.com/pierremolinaro/acan
+//
+// ACAN::can0 and ACAN::can1 are simulated nodes of the sketch bus (see ACANVirtualBus.h):
+// they are connected together, as the Teensy 3.6 CAN0 and CAN1 modules of the
+// Teensy36Test example. This file is found before src/ACAN.h (include path order).
+//
+//----------------------------------------------------------------------------------------
+
+#pragma once
+
+//----------------------------------------------------------------------------------------
+
+#include <ACANVirtualBus.h>
+
+//----------------------------------------------------------------------------------------
+
+ACANVirtualBus & acanSketchBus (void) ;
+
+//----------------------------------------------------------------------------------------
+
+class ACAN : public ACANSimulatedNode {
+  private: explicit ACAN (const char * inName) : ACANSimulatedNode (acanSketchBus (), inName) {}
+
+  public: inline uint8_t flexcanRxFIFOFlags (void) const { return 0 ; } // No RxFIFO warning or overflow
+
+  public: static ACAN can0 ;
+  public: static ACAN can1 ;
+} ;
+
+//----------------------------------------------------------------------------------------
@@ -0,0 +1,228 @@
+//----------------------------------------------------------------------------------------
+// Runs an ACAN sketch on the virtual CAN bus (host)
+// by Pierre Molinaro
+// https://github.com/pierremolinaro/acan
+//
+// Usage: sketch [simulated seconds (default 10)] [loop period in µs (default 10)]
+// setup is called once, then loop; simulated time advances by the loop period after each
+// loop call (and by delay). At the end, a report gives, for every started node, the
+// transmit latency distribution, lost arbitrations, buffer high-water marks and error
+// counters, and the bus load.
+//
+//----------------------------------------------------------------------------------------
+
+#include <Arduino.h>
+#include <ACAN.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+//----------------------------------------------------------------------------------------
+//    Sketch bus and nodes
+//----------------------------------------------------------------------------------------
+
+ACANVirtualBus & acanSketchBus (void) {
+  static ACANVirtualBus bus ; // Bit rate of the first started node
+  return bus ;
+}
+
+//----------------------------------------------------------------------------------------
+
+ACAN ACAN::can0 ("can0") ;
+ACAN ACAN::can1 ("can1") ;
+
+//----------------------------------------------------------------------------------------
+//    Time, pins, interrupts
+//----------------------------------------------------------------------------------------
+
+uint32_t millis (void) {
+  return (uint32_t) (acanSketchBus ().nowNanos () / (1000 * 1000)) ;
+}
+
+//----------------------------------------------------------------------------------------
+
+uint32_t micros (void) {
+  return acanSketchBus ().nowMicros () ;
+}
+
+//----------------------------------------------------------------------------------------
+
+void delay (const uint32_t inMillis) {
+  acanSketchBus ().runFor ((uint64_t) inMillis * 1000 * 1000) ;
+}
+
+//----------------------------------------------------------------------------------------
+
+void delayMicroseconds (const uint32_t inMicros) {
+  acanSketchBus ().runFor ((uint64_t) inMicros * 1000) ;
+}
+
+//----------------------------------------------------------------------------------------
+
+static uint8_t gPinValues [256] ;
+
+void pinMode (const uint8_t /* inPin */, const uint8_t /* inMode */) {
+}
+
+void digitalWrite (const uint8_t inPin, const uint8_t inValue) {
+  gPinValues [inPin] = (inValue != LOW) ? HIGH : LOW ;
+}
+
+uint8_t digitalRead (const uint8_t inPin) {
+  return gPinValues [inPin] ;
+}
+
+//----------------------------------------------------------------------------------------
+
+void noInterrupts (void) {
+}
+
+void interrupts (void) {
+}
+
+//----------------------------------------------------------------------------------------
+//    Serial
+//----------------------------------------------------------------------------------------
+
+HostSerial Serial ;
+
+//----------------------------------------------------------------------------------------
+
+void HostSerial::begin (const uint32_t /* inBaudRate */) {
+}
+
+int HostSerial::available (void) {
+  return 0 ;
+}
+
+int HostSerial::read (void) {
+  return -1 ;
+}
+
+size_t HostSerial::write (const uint8_t inByte) {
+  return (putchar (inByte) == EOF) ? 0 : 1 ;
+}
+
+void HostSerial::flush (void) {
+  fflush (stdout) ;
+}
+
+//----------------------------------------------------------------------------------------
+
+static size_t printNumber (unsigned long inValue, const int inBase) {
+  char buffer [8 * sizeof (unsigned long) + 1] ;
+  const unsigned long base = ((inBase >= 2) && (inBase <= 36)) ? (unsigned long) inBase : 10 ;
+  size_t length = 0 ;
+  do{
+    const unsigned long digit = inValue % base ;
+    buffer [length] = (char) ((digit < 10) ? ('0' + digit) : ('A' + digit - 10)) ;
+    length += 1 ;
+    inValue /= base ;
+  }while (inValue != 0) ;
+  for (size_t i=length ; i>0 ; i--) {
+    putchar (buffer [i-1]) ;
+  }
+  return length ;
+}
+
+//----------------------------------------------------------------------------------------
+
+size_t HostSerial::print (const char * inString) {
+  return (size_t) printf ("%s", inString) ;
+}
+
+size_t HostSerial::print (const char inChar) {
+  return write ((uint8_t) inChar) ;
+}
+
+size_t HostSerial::print (const int inValue, const int inBase) {
+  return print ((long) inValue, inBase) ;
+}
+
+size_t HostSerial::print (const unsigned inValue, const int inBase) {
+  return printNumber (inValue, inBase) ;
+}
+
+size_t HostSerial::print (const long inValue, const int inBase) {
+  size_t length = 0 ;
+  if ((inBase == DEC) && (inValue < 0)) {
+    length = print ('-') + printNumber (0UL - (unsigned long) inValue, DEC) ;
+  }else{
+    length = printNumber ((unsigned long) inValue, inBase) ;
+  }
+  return length ;
+}
+
+size_t HostSerial::print (const unsigned long inValue, const int inBase) {
+  return printNumber (inValue, inBase) ;
+}
+
+size_t HostSerial::print (const double inValue, const int inDigits) {
+  return (size_t) printf ("%.*f", inDigits, inValue) ;
+}
+
+//----------------------------------------------------------------------------------------
+
+size_t HostSerial::println (void) { return print ("\r\n") ; }
+size_t HostSerial::println (const char * inString) { return print (inString) + println () ; }
+size_t HostSerial::println (const char inChar) { return print (inChar) + println () ; }
+size_t HostSerial::println (const int inValue, const int inBase) { return print (inValue, inBase) + println () ; }
+size_t HostSerial::println (const unsigned inValue, const int inBase) { return print (inValue, inBase) + println () ; }
+size_t HostSerial::println (const long inValue, const int inBase) { return print (inValue, inBase) + println () ; }
+size_t HostSerial::println (const unsigned long inValue, const int inBase) { return print (inValue, inBase) + println () ; }
+size_t HostSerial::println (const double inValue, const int inDigits) { return print (inValue, inDigits) + println () ; }
+
+//----------------------------------------------------------------------------------------
+//    Report
+//----------------------------------------------------------------------------------------
+
+static void printNodeReport (const ACANSimulatedNode & inNode) {
+  static const char * kStateNames [3] = {"error active", "error passive", "bus off"} ;
+  const ACANLatencyHistogram & latency = inNode.transmitLatencyHistogram () ;
+  printf ("%s: sent %u, received %u, lost arbitrations %u, rejected by tryToSend %u, receive overflows %u\n",
+          inNode.name (), inNode.sentFrameCount (), inNode.receivedFrameCount (),
+          inNode.lostArbitrationCount (), inNode.rejectedFrameCount (), inNode.droppedFrameCount ()) ;
+  printf ("  transmit buffer peak %u / %u, receive buffer peak %u / %u\n",
+          inNode.transmitBufferPeakCount (), inNode.transmitBufferSize (),
+          inNode.receiveBufferPeakCount (), inNode.receiveBufferSize ()) ;
+  printf ("  transmit latency (us): min %u, mean %u, p50 <= %u, p90 <= %u, p99 <= %u, max %u\n",
+          latency.minCycles (), latency.meanCycles (), latency.percentileCycles (50),
+          latency.percentileCycles (90), latency.percentileCycles (99), latency.maxCycles ()) ;
+  printf ("  TEC %u, REC %u, %s, bus off %u times\n",
+          inNode.transmitErrorCounter (), inNode.receiveErrorCounter (),
+          kStateNames [inNode.controllerState ()], inNode.busOffCount ()) ;
+}
+
+//----------------------------------------------------------------------------------------
+//    Main
+//----------------------------------------------------------------------------------------
+
+void setup (void) ;
+void loop (void) ;
+
+//----------------------------------------------------------------------------------------
+
+int main (int argc, char * argv []) {
+  const double seconds = (argc > 1) ? atof (argv [1]) : 10.0 ;
+  const uint64_t loopNanos = ((argc > 2) ? strtoull (argv [2], nullptr, 10) : 10) * 1000 ;
+  const uint64_t endNanos = (uint64_t) (seconds * 1.0e9) ;
+  ACANVirtualBus & bus = acanSketchBus () ;
+  setup () ;
+  while (bus.nowNanos () < endNanos) {
+    loop () ;
+    bus.runFor ((loopNanos > 0) ? loopNanos : 1) ;
+  }
+  fflush (stdout) ;
+  printf ("\n---- Simulation report, %.3f s\n", (double) bus.nowNanos () / 1.0e9) ;
+  const ACANSimulatedNode * nodes [2] = {& ACAN::can0, & ACAN::can1} ;
+  for (uint32_t i=0 ; i<2 ; i++) {
+    if (nodes [i]->isStarted ()) {
+      printNodeReport (*nodes [i]) ;
+    }
+  }
+  printf ("bus: %u bit/s, %u frames, %u error frames, load %u.%u %%\n",
+          bus.bitRate (), bus.frameCount (), bus.errorFrameCount (),
+          bus.busLoadPerMille () / 10, bus.busLoadPerMille () % 10) ;
+  return 0 ;
+}
+
+//----------------------------------------------------------------------------------------
@@ -0,0 +1,93 @@
+//----------------------------------------------------------------------------------------
+// Minimal Arduino API for running sketches on the virtual CAN bus (host)
+// by Pierre Molinaro
+// https://github.com/pierremolinaro/acan
+//
+// Time is the simulated time of the sketch bus: millis and micros read it, delay advances
+// it. Serial (a Stream) writes to the standard output; pins are simulated as plain values.
+//
+//----------------------------------------------------------------------------------------
+
+#pragma once
+
+//----------------------------------------------------------------------------------------
+
+#include <stdint.h>
+#include <stddef.h>
+
+//----------------------------------------------------------------------------------------
+
+static const uint8_t LOW = 0 ;
+static const uint8_t HIGH = 1 ;
+static const uint8_t INPUT = 0 ;
+static const uint8_t OUTPUT = 1 ;
+static const uint8_t INPUT_PULLUP = 2 ;
+static const uint8_t LED_BUILTIN = 13 ;
+static const uint8_t DEC = 10 ;
+static const uint8_t HEX = 16 ;
+static const uint8_t OCT = 8 ;
+static const uint8_t BIN = 2 ;
+
+//----------------------------------------------------------------------------------------
+
+uint32_t millis (void) ;
+uint32_t micros (void) ;
+void delay (const uint32_t inMillis) ;
+void delayMicroseconds (const uint32_t inMicros) ;
+
+void pinMode (const uint8_t inPin, const uint8_t inMode) ;
+void digitalWrite (const uint8_t inPin, const uint8_t inValue) ;
+uint8_t digitalRead (const uint8_t inPin) ;
+
+void noInterrupts (void) ;
+void interrupts (void) ;
+
+//----------------------------------------------------------------------------------------
+// Byte stream (ACANHostAdapter takes a Stream): read returns -1 if no byte is available
+
+class Stream {
+  public: virtual ~ Stream (void) {}
+  public: virtual int available (void) = 0 ;
+  public: virtual int read (void) = 0 ;
+  public: virtual size_t write (const uint8_t inByte) = 0 ;
+  public: virtual size_t write (const uint8_t * inBuffer, const size_t inLength) {
+    size_t n = 0 ;
+    while ((n < inLength) && (write (inBuffer [n]) == 1)) {
+      n += 1 ;
+    }
+    return n ;
+  }
+} ;
+
+//----------------------------------------------------------------------------------------
+
+class HostSerial : public Stream {
+  public: void begin (const uint32_t inBaudRate) ;
+  public: inline operator bool (void) const { return true ; }
+  public: virtual int available (void) override ;
+  public: virtual int read (void) override ;
+  public: using Stream::write ;
+  public: virtual size_t write (const uint8_t inByte) override ;
+  public: void flush (void) ;
+
+  public: size_t print (const char * inString) ;
+  public: size_t print (const char inChar) ;
+  public: size_t print (const int inValue, const int inBase = DEC) ;
+  public: size_t print (const unsigned inValue, const int inBase = DEC) ;
+  public: size_t print (const long inValue, const int inBase = DEC) ;
+  public: size_t print (const unsigned long inValue, const int inBase = DEC) ;
+  public: size_t print (const double inValue, const int inDigits = 2) ;
+
+  public: size_t println (void) ;
+  public: size_t println (const char * inString) ;
+  public: size_t println (const char inChar) ;
+  public: size_t println (const int inValue, const int inBase = DEC) ;
+  public: size_t println (const unsigned inValue, const int inBase = DEC) ;
+  public: size_t println (const long inValue, const int inBase = DEC) ;
+  public: size_t println (const unsigned long inValue, const int inBase = DEC) ;
+  public: size_t println (const double inValue, const int inDigits = 2) ;
+} ;
+
+extern HostSerial Serial ;
+
+//----------------------------------------------------------------------------------------
@@ -0,0 +1,193 @@
+//----------------------------------------------------------------------------------------
+// Bus log format test (Linux / macOS host, no CAN hardware needed)
+// by Pierre Molinaro
+// https://github.com/pierremolinaro/acan
+//
+// Records are written through ACANBusLogWriter, and read back with ACANBusLogReader:
+//   - layout: 512-byte blocks, 16-byte header, 24 records of 20 bytes, little endian;
+//   - clean capture: every record is read back, in order, dropped frames are reported;
+//   - torn block: the capture ends in the middle of a block (power loss while writing),
+//     the records of the complete blocks are read back, the fragment is ignored;
+//   - resynchronization: a block with a bad sync marker, and junk bytes that shift the
+//     following blocks, are skipped; the lost block is reported by the sequence gap.
+//
+//   g++ -std=gnu++14 -O2 -Isrc extras/tests/ACANBusLogTest.cpp src/ACANBusLogFormat.cpp
+//       -o busLogTest && ./busLogTest
+//
+//----------------------------------------------------------------------------------------
+
+#include <ACANBusLogFormat.h>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+//----------------------------------------------------------------------------------------
+
+static const uint32_t kRecordCount = 1000 ; // 41 complete blocks, and a partial one
+static uint32_t gErrorCount = 0 ;
+
+//----------------------------------------------------------------------------------------
+
+static void check (const bool inCondition, const char * inMessage) {
+  if (!inCondition) {
+    gErrorCount += 1 ;
+    printf ("error: %s\n", inMessage) ;
+  }
+}
+
+//----------------------------------------------------------------------------------------
+
+static ACANBusLogRecord record (const uint32_t inIndex) {
+  ACANBusLogRecord result ;
+  result.mTimeStamp = 0xFFFF0000 + inIndex * 37 ; // Wraps around
+  result.mIdentifier = ((inIndex % 3) == 0)
+    ? ((inIndex * 0x10001) & kACANBusLogIdentifierMask) | kACANBusLogExtendedFlag
+    : (inIndex & 0x7FF) ;
+  if ((inIndex % 5) == 0) {
+    result.mIdentifier |= kACANBusLogRemoteFlag ;
+  }
+  result.mLength = (uint8_t) (inIndex % 9) ;
+  for (uint32_t i=0 ; i<8 ; i++) {
+    result.mData [i] = (i < result.mLength) ? (uint8_t) (inIndex + i) : 0 ;
+  }
+  result.mFlexcanTimeStamp = (uint16_t) (inIndex * 113) ;
+  result.mFilterIndex = (uint8_t) (inIndex % 7) ;
+  return result ;
+}
+
+//----------------------------------------------------------------------------------------
+
+static bool sameRecord (const ACANBusLogRecord & inLeft, const ACANBusLogRecord & inRight) {
+  return memcmp (& inLeft, & inRight, sizeof (ACANBusLogRecord)) == 0 ;
+}
+
+//----------------------------------------------------------------------------------------
+
+static bool appendBlock (const ACANBusLogBlock & inBlock, void * inUserData) {
+  std::vector <uint8_t> & bytes = * (std::vector <uint8_t> *) inUserData ;
+  const uint8_t * p = (const uint8_t *) & inBlock ;
+  bytes.insert (bytes.end (), p, p + sizeof (ACANBusLogBlock)) ;
+  return true ;
+}
+
+//----------------------------------------------------------------------------------------
+
+static uint32_t littleEndian (const uint8_t inBytes [], const uint32_t inByteCount) {
+  uint32_t result = 0 ;
+  for (uint32_t i=inByteCount ; i>0 ; i--) {
+    result = (result << 8) | inBytes [i-1] ;
+  }
+  return result ;
+}
+
+//----------------------------------------------------------------------------------------
+// Reads the records from inData (copied to a 4-byte aligned buffer); every read record
+// should be the next record of the written sequence, except the records of skipped blocks
+
+static uint32_t readBack (const std::vector <uint8_t> & inData,
+                          ACANBusLogReader * & outReader,
+                          std::vector <uint32_t> & outReadIndexes) {
+  static std::vector <uint32_t> aligned ;
+  aligned.assign ((inData.size () + 3) / 4, 0) ;
+  memcpy (aligned.data (), inData.data (), inData.size ()) ;
+  outReader = new ACANBusLogReader ((const uint8_t *) aligned.data (), inData.size ()) ;
+  outReadIndexes.clear () ;
+  uint32_t unknownCount = 0 ;
+  uint32_t nextIndex = 0 ;
+  const ACANBusLogRecord * r = outReader->next () ;
+  while (nullptr != r) {
+    while ((nextIndex < kRecordCount) && !sameRecord (*r, record (nextIndex))) {
+      nextIndex += 1 ;
+    }
+    if (nextIndex < kRecordCount) {
+      outReadIndexes.push_back (nextIndex) ;
+      nextIndex += 1 ;
+    }else{
+      unknownCount += 1 ;
+    }
+    r = outReader->next () ;
+  }
+  return unknownCount ;
+}
+
+//----------------------------------------------------------------------------------------
+
+int main (void) {
+//--- Write the capture; 3 frames dropped before record 100, 2 at the end
+  std::vector <uint8_t> capture ;
+  ACANBusLogWriter writer (appendBlock, & capture) ;
+  for (uint32_t i=0 ; i<kRecordCount ; i++) {
+    if (i == 100) {
+      writer.noteDroppedFrames (3) ;
+    }
+    check (writer.append (record (i)), "append") ;
+  }
+  writer.noteDroppedFrames (2) ;
+  check (writer.flush (), "flush") ;
+  const uint32_t blockCount = (kRecordCount + kACANBusLogRecordsPerBlock - 1) / kACANBusLogRecordsPerBlock ;
+  check (writer.writtenBlockCount () == blockCount, "written block count") ;
+  check (capture.size () == (blockCount * kACANBusLogBlockSize), "capture size") ;
+//--- Layout of block 1: header, record 24 at offset 16, record 25 at offset 36
+  { const uint8_t * block = & capture [kACANBusLogBlockSize] ;
+    check (memcmp (block, "ACAN", 4) == 0, "sync marker") ;
+    check (littleEndian (block + 4, 4) == 1, "block sequence") ;
+    check (littleEndian (block + 8, 2) == kACANBusLogRecordsPerBlock, "record count") ;
+    check (littleEndian (block + 10, 2) == kACANBusLogFormatVersion, "format version") ;
+    const ACANBusLogRecord r = record (25) ;
+    const uint8_t * bytes = block + 16 + 20 ;
+    check (littleEndian (bytes, 4) == r.mTimeStamp, "record time stamp") ;
+    check (littleEndian (bytes + 4, 4) == r.mIdentifier, "record identifier") ;
+    check (memcmp (bytes + 8, r.mData, 8) == 0, "record data") ;
+    check (littleEndian (bytes + 16, 2) == r.mFlexcanTimeStamp, "record FlexCAN time stamp") ;
+    check ((bytes [18] == r.mLength) && (bytes [19] == r.mFilterIndex), "record length and filter index") ;
+    bool zeroPadding = true ;
+    for (uint32_t i=kACANBusLogBlockSize - 16 ; i<kACANBusLogBlockSize ; i++) {
+      zeroPadding &= block [i] == 0 ;
+    }
+    check (zeroPadding, "padding") ;
+  }
+//--- Clean capture
+  ACANBusLogReader * reader = nullptr ;
+  std::vector <uint32_t> indexes ;
+  uint32_t unknownCount = readBack (capture, reader, indexes) ;
+  check ((unknownCount == 0) && (indexes.size () == kRecordCount) && (indexes.back () == (kRecordCount - 1)), "clean capture: records") ;
+  check (reader->blockCount () == blockCount, "clean capture: block count") ;
+  check ((reader->lostBlockCount () == 0) && (reader->skippedByteCount () == 0), "clean capture: no loss") ;
+  check (reader->droppedFrameCount () == 5, "clean capture: dropped frames") ;
+  reader->rewind () ;
+  uint32_t iteratedBlockCount = 0 ;
+  while (nullptr != reader->nextBlock ()) {
+    iteratedBlockCount += 1 ;
+  }
+  check (iteratedBlockCount == blockCount, "clean capture: block iteration") ;
+  delete reader ;
+//--- Torn block: the capture ends 300 bytes into block 10
+  std::vector <uint8_t> torn (capture.begin (), capture.begin () + 10 * kACANBusLogBlockSize + 300) ;
+  unknownCount = readBack (torn, reader, indexes) ;
+  check ((unknownCount == 0) && (indexes.size () == (10 * kACANBusLogRecordsPerBlock)), "torn block: records of complete blocks") ;
+  check ((reader->blockCount () == 10) && (reader->lostBlockCount () == 0), "torn block: block count") ;
+  check ((reader->skippedByteCount () == 0) && (nullptr == reader->next ()), "torn block: fragment ignored") ;
+  delete reader ;
+//--- Resynchronization: bad sync marker in block 5, 12 junk bytes (one of them a fake sync
+//    marker) inserted before block 20
+  std::vector <uint8_t> corrupted (capture) ;
+  corrupted [5 * kACANBusLogBlockSize] ^= 0xFF ;
+  const uint8_t junk [12] = {'A', 'C', 'A', 'N', 0x55, 0x55, 0x55, 0x55, 0x55, 0x55, 0x55, 0x55} ;
+  corrupted.insert (corrupted.begin () + 20 * kACANBusLogBlockSize, junk, junk + sizeof (junk)) ;
+  unknownCount = readBack (corrupted, reader, indexes) ;
+  bool expectedRecords = (unknownCount == 0) && (indexes.size () == (kRecordCount - kACANBusLogRecordsPerBlock)) ;
+  for (uint32_t i=0 ; (i<indexes.size ()) && expectedRecords ; i++) {
+    const uint32_t expected = (i < (5 * kACANBusLogRecordsPerBlock)) ? i : (i + kACANBusLogRecordsPerBlock) ;
+    expectedRecords = indexes [i] == expected ;
+  }
+  check (expectedRecords, "resynchronization: every record, except those of block 5") ;
+  check ((reader->blockCount () == (blockCount - 1)) && (reader->lostBlockCount () == 1), "resynchronization: lost block") ;
+  check (reader->skippedByteCount () == (kACANBusLogBlockSize + sizeof (junk)), "resynchronization: skipped bytes") ;
+  delete reader ;
+//---
+  printf ("%u records, %u blocks\n", kRecordCount, blockCount) ;
+  printf ("%s\n", (gErrorCount == 0) ? "OK" : "FAILED") ;
+  return (gErrorCount == 0) ? 0 : 1 ;
+}
+
+//----------------------------------------------------------------------------------------
@@ -0,0 +1,184 @@
+//----------------------------------------------------------------------------------------
+// ACANCoroutines test (Linux / macOS host, C++20, no CAN hardware needed)
+// by Pierre Molinaro
+// https://github.com/pierremolinaro/acan
+//
+// ACANAsync runs over a fake driver that behaves as ACAN seen from loop: a receive buffer,
+// a 2 frame transmit buffer, and an event call back called by the simulated interrupt
+// service routine with ACAN::kReceiveEvent (frame stored) and ACAN::kTransmitSpaceEvent
+// (a frame left the transmit buffer). Checks that:
+//   - an operation that can complete at once does not suspend the coroutine;
+//   - a waiting coroutine is only resumed by ACANEventLoop::run after an event;
+//   - waiting coroutines are served in arrival order;
+//   - send waits for transmit buffer space, frames are sent in order;
+//   - a coroutine in a loop waits again after being resumed, and returns after the last frame;
+//   - notify can be called from another thread (as from an interrupt).
+//
+//   g++ -std=gnu++20 -O2 -Isrc extras/tests/ACANCoroutinesTest.cpp -lpthread
+//       -o coroutinesTest && ./coroutinesTest
+//
+//----------------------------------------------------------------------------------------
+
+#include <ACANCoroutines.h>
+#include <stdio.h>
+#include <deque>
+#include <thread>
+
+//----------------------------------------------------------------------------------------
+
+#ifndef ACAN_COROUTINES
+  #error "compile with -std=gnu++20 (or c++20)"
+#endif
+
+//----------------------------------------------------------------------------------------
+
+static uint32_t gErrorCount = 0 ;
+
+static void check (const bool inCondition, const char * inMessage) {
+  if (!inCondition) {
+    gErrorCount += 1 ;
+    printf ("error: %s\n", inMessage) ;
+  }
+}
+
+//----------------------------------------------------------------------------------------
+//    Fake driver (event bits are the ACAN ones)
+//----------------------------------------------------------------------------------------
+
+class FakeDriver {
+  public: static const uint32_t kReceiveEvent       = 1 << 0 ;
+  public: static const uint32_t kTransmitSpaceEvent = 1 << 1 ;
+  public: typedef void (*tEventCallBack) (const uint32_t inEvents, void * inUserData) ;
+
+  public: void setEventCallBack (const tEventCallBack inCallBack, void * inUserData) {
+    mEventCallBack = inCallBack ;
+    mEventUserData = inUserData ;
+  }
+
+  public: bool receive (CANMessage & outMessage) {
+    const bool ok = !mReceiveBuffer.empty () ;
+    if (ok) {
+      outMessage = mReceiveBuffer.front () ;
+      mReceiveBuffer.pop_front () ;
+    }
+    return ok ;
+  }
+
+  public: bool tryToSend (const CANMessage & inMessage) {
+    const bool ok = mTransmitBuffer.size () < kTransmitBufferSize ;
+    if (ok) {
+      mTransmitBuffer.push_back (inMessage) ;
+    }
+    return ok ;
+  }
+
+//--- Simulated interrupt service routine
+  public: void isrReceive (const uint32_t inIdentifier) {
+    CANMessage message ;
+    message.id = inIdentifier ;
+    mReceiveBuffer.push_back (message) ;
+    mEventCallBack (kReceiveEvent, mEventUserData) ;
+  }
+
+  public: uint32_t isrTransmit (void) { // Returns the sent identifier
+    const uint32_t identifier = mTransmitBuffer.front ().id ;
+    mTransmitBuffer.pop_front () ;
+    mEventCallBack (kTransmitSpaceEvent, mEventUserData) ;
+    return identifier ;
+  }
+
+  public: static const size_t kTransmitBufferSize = 2 ;
+  public: std::deque <CANMessage> mReceiveBuffer ;
+  public: std::deque <CANMessage> mTransmitBuffer ;
+  private: tEventCallBack mEventCallBack = nullptr ;
+  private: void * mEventUserData = nullptr ;
+} ;
+
+//----------------------------------------------------------------------------------------
+//    Coroutines
+//----------------------------------------------------------------------------------------
+
+static uint32_t gEchoReceivedCount = 0 ;
+static bool gEchoReturned = false ;
+
+static ACANTask echo (ACANAsync <FakeDriver> & inAsync, const uint32_t inCount) {
+  for (uint32_t i=0 ; i<inCount ; i++) {
+    CANMessage frame = co_await inAsync.receive () ;
+    gEchoReceivedCount += 1 ;
+    frame.id += 0x100 ;
+    co_await inAsync.send (frame) ;
+  }
+  gEchoReturned = true ;
+}
+
+//----------------------------------------------------------------------------------------
+
+static ACANTask receiveOne (ACANAsync <FakeDriver> & inAsync, uint32_t & outIdentifier) {
+  const CANMessage frame = co_await inAsync.receive () ;
+  outIdentifier = frame.id ;
+}
+
+//----------------------------------------------------------------------------------------
+
+int main (void) {
+  FakeDriver driver ;
+  ACANEventLoop eventLoop ;
+  ACANAsync <FakeDriver> async (driver, eventLoop) ;
+//--- Ready at once: no suspension
+  driver.mReceiveBuffer.push_back (CANMessage ()) ;
+  uint32_t identifier = 0xFFFFFFFF ;
+  receiveOne (async, identifier) ;
+  check ((identifier == 0) && !eventLoop.hasWaiters (), "ready frame: no suspension") ;
+//--- Waiting coroutines, served in arrival order
+  uint32_t first = 0 ;
+  uint32_t second = 0 ;
+  receiveOne (async, first) ;
+  receiveOne (async, second) ;
+  check (eventLoop.hasWaiters () && (eventLoop.run () == 0), "no event: no resume") ;
+  driver.mReceiveBuffer.push_back (CANMessage ()) ; // Stored without event
+  check (eventLoop.run () == 0, "frame without event: no resume") ;
+  driver.mReceiveBuffer.clear () ;
+  driver.isrReceive (0x11) ;
+  check ((eventLoop.run () == 1) && (first == 0x11) && (second == 0), "first waiter resumed first") ;
+  driver.isrReceive (0x22) ;
+  check ((eventLoop.run () == 1) && (second == 0x22) && !eventLoop.hasWaiters (), "second waiter resumed") ;
+//--- Echo: send waits for transmit buffer space
+  echo (async, 5) ;
+  check (eventLoop.hasWaiters () && (gEchoReceivedCount == 0), "echo waits") ;
+  driver.isrReceive (1) ;
+  eventLoop.run () ;
+  check ((gEchoReceivedCount == 1) && (driver.mTransmitBuffer.size () == 1), "echo: first frame sent") ;
+  driver.isrReceive (2) ;
+  driver.isrReceive (3) ;
+  driver.isrReceive (4) ;
+  eventLoop.run () ;
+  check ((gEchoReceivedCount == 3) && (driver.mTransmitBuffer.size () == 2), "echo: waits for space") ;
+  uint32_t sentIdentifiers [5] = {} ;
+  uint32_t sentCount = 0 ;
+  while (sentCount < 4) {
+    sentIdentifiers [sentCount] = driver.isrTransmit () ;
+    sentCount += 1 ;
+    eventLoop.run () ;
+  }
+  check ((gEchoReceivedCount == 4) && driver.mReceiveBuffer.empty (), "echo: fourth frame") ;
+//--- Last frame, notified from another thread
+  driver.mReceiveBuffer.push_back (CANMessage ()) ;
+  driver.mReceiveBuffer.back ().id = 5 ;
+  std::thread isr ([&eventLoop] () { eventLoop.notify (FakeDriver::kReceiveEvent) ; }) ;
+  isr.join () ;
+  eventLoop.run () ;
+  sentIdentifiers [sentCount] = driver.isrTransmit () ;
+  sentCount += 1 ;
+  eventLoop.run () ;
+  bool inOrder = driver.mTransmitBuffer.empty () ;
+  for (uint32_t i=0 ; i<5 ; i++) {
+    inOrder &= sentIdentifiers [i] == (0x101 + i) ;
+  }
+  check (inOrder, "echo: frames sent in order") ;
+  check ((gEchoReceivedCount == 5) && gEchoReturned && !eventLoop.hasWaiters (), "echo returned") ;
+//---
+  printf ("%s\n", (gErrorCount == 0) ? "OK" : "FAILED") ;
+  return (gErrorCount == 0) ? 0 : 1 ;
+}
+
+//----------------------------------------------------------------------------------------
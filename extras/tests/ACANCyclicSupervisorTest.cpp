@@ -0,0 +1,165 @@
+//----------------------------------------------------------------------------------------
+// ACANCyclicSupervisor test (Linux / macOS host, no CAN hardware needed)
+// by Pierre Molinaro
+// https://github.com/pierremolinaro/acan
+//
+// Simulates 2 s of traffic, in 100 µs steps, on a 64 slot wheel of 1 ms: 500 identifiers
+// with 10 ms to 16 ms periods, and one with a 200 ms period (farther than a wheel turn).
+// The time origin is 64 ms before the micros () wrap around. Checks that:
+//   - supervise reports its errors (too many entries, already supervised, null period);
+//   - entries refreshed in time never time out;
+//   - a silent identifier times out once, within a wheel slot and a poll step after its
+//     deadline, and recovers when its frames come back; the 200 ms one times out too;
+//   - interval and jitter statistics are exact;
+//   - poll visits a few entries per call, not the 501 entries;
+//   - a poll more than a wheel turn late times out every entry once.
+//
+//   g++ -std=gnu++14 -O2 -Isrc extras/tests/ACANCyclicSupervisorTest.cpp
+//       src/ACANCyclicSupervisor.cpp -o cyclicSupervisorTest && ./cyclicSupervisorTest
+//
+//----------------------------------------------------------------------------------------
+
+#include <ACANCyclicSupervisor.h>
+#include <stdio.h>
+#include <vector>
+
+//----------------------------------------------------------------------------------------
+
+static const uint32_t kEntryCount = 500 ;
+static const uint32_t kSlowEntry = kEntryCount ; // 200 ms period
+static const uint32_t kSilentEntry = 5 ; // 15 ms period, silent from 500 ms to 1200 ms
+static const uint32_t kJitterEntry = 7 ; // 10 ms period, jitter
+static const uint32_t kTolerance = 2000 ;
+static const uint32_t kTick = 1000 ;
+static const uint32_t kStep = 100 ;
+static const uint32_t kOrigin = 0xFFFF0000 ;
+
+//----------------------------------------------------------------------------------------
+
+static uint32_t gErrorCount = 0 ;
+
+static void check (const bool inCondition, const char * inMessage) {
+  if (!inCondition) {
+    gErrorCount += 1 ;
+    printf ("error: %s\n", inMessage) ;
+  }
+}
+
+//----------------------------------------------------------------------------------------
+
+class Event {
+  public: char mKind ; // 'T': timeout, 'R': recovery
+  public: uint32_t mEntryIndex ;
+  public: uint32_t mTime ; // From origin
+} ;
+
+static std::vector <Event> gEvents ;
+static uint32_t gNow ;
+
+static void timeout (const uint32_t inEntryIndex) {
+  gEvents.push_back ({'T', inEntryIndex, gNow - kOrigin}) ;
+}
+
+static void recovery (const uint32_t inEntryIndex) {
+  gEvents.push_back ({'R', inEntryIndex, gNow - kOrigin}) ;
+}
+
+//----------------------------------------------------------------------------------------
+
+static uint32_t period (const uint32_t inEntryIndex) {
+  return (inEntryIndex == kSlowEntry) ? 200000 : (10000 + (inEntryIndex % 7) * 1000) ;
+}
+
+//----------------------------------------------------------------------------------------
+
+int main (void) {
+  ACANCyclicSupervisor supervisor (kTick, 64) ;
+  check (!supervisor.allocate (0), "allocate (0)") ;
+  check (supervisor.allocate (kEntryCount + 1), "allocate") ;
+  supervisor.setTimeoutCallBack (timeout) ;
+  supervisor.setRecoveryCallBack (recovery) ;
+//--- Entry i: identifier 3 * i + 1, extended if i is odd
+  bool superviseOk = true ;
+  for (uint32_t i=0 ; i<=kEntryCount ; i++) {
+    if (i == kSlowEntry) {
+      check ((supervisor.supervise (kExtended, 16, 0, 0, kOrigin)
+             == (ACANCyclicSupervisor::kAlreadySupervised | ACANCyclicSupervisor::kNullPeriod)),
+             "already supervised, null period") ;
+    }
+    superviseOk &= supervisor.supervise ((i % 2) ? kExtended : kStandard, 3 * i + 1, period (i), kTolerance, kOrigin) == 0 ;
+  }
+  check (superviseOk, "supervise") ;
+  check (supervisor.supervise (kStandard, 0x7FF, 10000, 0, kOrigin) == ACANCyclicSupervisor::kTooManyEntries, "too many entries") ;
+  check ((supervisor.entryCount () == (kEntryCount + 1)) && (supervisor.entryIndex (kExtended, 16) == (int32_t) kSilentEntry), "entry index") ;
+  check ((supervisor.entryIndex (kStandard, 16) == -1) && (supervisor.identifier (kSilentEntry) == 16) && supervisor.isExtended (kSilentEntry), "entry identifier") ;
+//--- 2 s of traffic
+  CANMessage message ;
+  uint32_t pollCount = 0 ;
+  bool refreshOk = true ;
+  for (uint32_t t=kStep ; t<2000000 ; t+=kStep) {
+    gNow = kOrigin + t ;
+    for (uint32_t i=0 ; i<=kEntryCount ; i++) {
+      const bool silent = ((i == kSilentEntry) && (t >= 500000) && (t < 1200000))
+                       || ((i == kSlowEntry) && (t > 800000)) ;
+      if (((t % period (i)) == 0) && !silent) {
+        message.ext = (i % 2) != 0 ;
+        message.id = 3 * i + 1 ;
+        const uint32_t jitter = (i == kJitterEntry) ? ((t / period (i)) % 3) * 300 : 0 ;
+        refreshOk &= supervisor.refresh (message, gNow + jitter) ;
+      }
+    }
+    supervisor.poll (gNow) ;
+    pollCount += 1 ;
+  }
+  check (refreshOk, "refresh") ;
+  message.ext = false ;
+  message.id = 2 ;
+  check (!supervisor.refresh (message, gNow), "refresh of an identifier not supervised") ;
+//--- Silent entry: last frame at 495 ms, deadline at 512 ms; frames back at 1200 ms.
+//    Slow entry: last frame at 800 ms, deadline at 1002 ms.
+  check (gEvents.size () == 3, "event count") ;
+  if (gEvents.size () == 3) {
+    check ((gEvents [0].mKind == 'T') && (gEvents [0].mEntryIndex == kSilentEntry), "silent entry timeout") ;
+    check ((gEvents [0].mTime >= 512000) && (gEvents [0].mTime <= (512000 + kTick + kStep)), "silent entry timeout latency") ;
+    check ((gEvents [1].mKind == 'T') && (gEvents [1].mEntryIndex == kSlowEntry), "slow entry timeout") ;
+    check ((gEvents [1].mTime >= 1002000) && (gEvents [1].mTime <= (1002000 + kTick + kStep)), "slow entry timeout latency") ;
+    check ((gEvents [2].mKind == 'R') && (gEvents [2].mEntryIndex == kSilentEntry), "silent entry recovery") ;
+    check ((gEvents [2].mTime >= 1200000) && (gEvents [2].mTime <= (1200000 + period (kSilentEntry) + kTick + kStep)), "silent entry recovery latency") ;
+  }
+  check ((supervisor.timeoutCount (kSilentEntry) == 1) && !supervisor.isTimedOut (kSilentEntry), "silent entry state") ;
+  check ((supervisor.timeoutCount (kSlowEntry) == 1) && supervisor.isTimedOut (kSlowEntry), "slow entry state") ;
+  check (supervisor.frameCount (kSilentEntry) == ((495000 / 15000) + (1995000 - 1200000) / 15000 + 1), "silent entry frame count") ;
+  check (supervisor.lastSeenMicros (kSlowEntry) == (kOrigin + 800000), "slow entry last seen") ;
+//--- Intervals of the jitter entry: 10300, 10300, 9400 µs
+  check ((supervisor.minIntervalMicros (kJitterEntry) == 9400) && (supervisor.maxIntervalMicros (kJitterEntry) == 10300), "intervals") ;
+  check ((supervisor.meanJitterMicros (kJitterEntry) == 400) && (supervisor.maxJitterMicros (kJitterEntry) == 600), "jitter") ;
+  check ((supervisor.minIntervalMicros (0) == 10000) && (supervisor.maxJitterMicros (0) == 0), "no jitter") ;
+//--- Supervision cost
+  const double visitedPerPoll = (double) supervisor.visitedEntryCount () / pollCount ;
+  check (visitedPerPoll < 8.0, "visited entries per poll") ;
+//--- Statistics reset
+  const uint32_t frameCount = supervisor.frameCount (kJitterEntry) ;
+  supervisor.resetStatistics () ;
+  check ((supervisor.maxJitterMicros (kJitterEntry) == 0) && (supervisor.minIntervalMicros (kJitterEntry) == 0xFFFFFFFF), "reset statistics") ;
+  check ((supervisor.frameCount (kJitterEntry) == frameCount) && (supervisor.timeoutCount (kSilentEntry) == 0), "reset statistics: frame count kept") ;
+  check (supervisor.visitedEntryCount () == 0, "reset statistics: visited entry count") ;
+//--- Poll 10 s late: every entry still alive times out once
+  gEvents.clear () ;
+  gNow += 10000000 ;
+  supervisor.poll (gNow) ;
+  std::vector <uint32_t> timeoutCount (kEntryCount + 1, 0) ;
+  for (const Event & event : gEvents) {
+    timeoutCount [event.mEntryIndex] += event.mKind == 'T' ;
+  }
+  bool everyEntryOnce = gEvents.size () == kEntryCount ;
+  for (uint32_t i=0 ; i<kEntryCount ; i++) {
+    everyEntryOnce &= timeoutCount [i] == 1 ;
+  }
+  check (everyEntryOnce && (timeoutCount [kSlowEntry] == 0), "late poll") ;
+//---
+  printf ("%u polls, %.2f entries visited per poll\n", pollCount, visitedPerPoll) ;
+  printf ("%s\n", (gErrorCount == 0) ? "OK" : "FAILED") ;
+  return (gErrorCount == 0) ? 0 : 1 ;
+}
+
+//----------------------------------------------------------------------------------------
@@ -0,0 +1,170 @@
+//----------------------------------------------------------------------------------------
+// ACANDriverInterface test (Linux / macOS host, no CAN hardware needed)
+// by Pierre Molinaro
+// https://github.com/pierremolinaro/acan
+//
+// Compile time: ACANMockDriver and ACANSimulatedNode satisfy ACANIsDriver (and, in C++20,
+// the ACANDriver concept); a class with missing members, a class with a wrong result
+// type, and a non class type do not.
+// Run time: a generic forwarding template, written once against the interface, runs on
+// mock drivers and on simulated nodes; checks ACANMockDriver (injected and sent frames,
+// buffer overflow, bus off state, error counters, statistics) and the batch variants
+// and derived state given by the CRTP base.
+//
+//   g++ -std=gnu++14 -O2 -Iextras/simulator -Isrc -include Arduino.h
+//       extras/tests/ACANDriverInterfaceTest.cpp src/ACANMockDriver.cpp
+//       src/ACANVirtualBus.cpp src/ACANSettings.cpp src/ACANFilters.cpp
+//       src/ACANInstrumentation.cpp -o driverInterfaceTest && ./driverInterfaceTest
+//
+// Also build it with -std=gnu++20 (concept checks).
+//
+//----------------------------------------------------------------------------------------
+
+#include <ACANMockDriver.h>
+#include <ACANVirtualBus.h>
+#include <ACANSettings.h>
+#include <stdio.h>
+
+//----------------------------------------------------------------------------------------
+
+static uint32_t gErrorCount = 0 ;
+
+static void check (const bool inCondition, const char * inMessage) {
+  if (!inCondition) {
+    gErrorCount += 1 ;
+    printf ("error: %s\n", inMessage) ;
+  }
+}
+
+//----------------------------------------------------------------------------------------
+//   Compile time checks
+//----------------------------------------------------------------------------------------
+
+class MissingMembers {
+  public: bool tryToSend (const CANMessage & inMessage) ;
+  public: bool receive (CANMessage & outMessage) ;
+} ;
+
+class WrongResultType : public ACANMockDriver {
+  public: uint8_t controllerState (void) const ; // Hides the tControllerState one
+} ;
+
+static_assert (ACANIsDriver <ACANMockDriver>::value, "ACANMockDriver") ;
+static_assert (ACANIsDriver <ACANSimulatedNode>::value, "ACANSimulatedNode") ;
+static_assert (!ACANIsDriver <MissingMembers>::value, "missing members") ;
+static_assert (!ACANIsDriver <WrongResultType>::value, "wrong result type") ;
+static_assert (!ACANIsDriver <int>::value, "not a class") ;
+
+#ifdef __cpp_concepts
+  static_assert (ACANDriver <ACANMockDriver> && ACANDriver <ACANSimulatedNode>, "concept") ;
+  static_assert (!ACANDriver <MissingMembers> && !ACANDriver <WrongResultType>, "concept") ;
+#endif
+
+//----------------------------------------------------------------------------------------
+//   Generic layer: forwards received frames, identifier + 1, in batches of 4; returns
+//   the number of accepted frames
+//----------------------------------------------------------------------------------------
+
+template <typename DRIVER> uint32_t forward (DRIVER & ioSource, DRIVER & ioDestination) {
+  static_assert (ACANIsDriver <DRIVER>::value, "DRIVER does not provide the ACAN driver interface") ;
+  CANMessage frames [4] ;
+  uint32_t acceptedCount = 0 ;
+  uint32_t n = ioSource.receiveBatch (frames, 4) ;
+  while (n > 0) {
+    for (uint32_t i=0 ; i<n ; i++) {
+      frames [i].id += 1 ;
+    }
+    acceptedCount += ioDestination.tryToSendBatch (frames, n) ;
+    n = ioSource.receiveBatch (frames, 4) ;
+  }
+  return acceptedCount ;
+}
+
+//----------------------------------------------------------------------------------------
+
+#ifdef __cpp_concepts
+  template <ACANDriver DRIVER> bool sendIfActive (DRIVER & ioDriver, const CANMessage & inMessage) {
+    return !ioDriver.isBusOff () && ioDriver.tryToSend (inMessage) ;
+  }
+#endif
+
+//----------------------------------------------------------------------------------------
+
+int main (void) {
+//--- Mock: receive buffer overflow
+  ACANMockDriver source (8, 16) ;
+  ACANMockDriver destination (8, 16) ;
+  CANMessage message ;
+  for (uint32_t i=0 ; i<10 ; i++) {
+    message.id = i ;
+    check (source.injectReceivedMessage (message) == (i < 8), "inject") ;
+  }
+  check ((source.receivedFrameCount () == 8) && (source.droppedFrameCount () == 2), "receive overflow") ;
+  check ((source.receiveBufferCount () == 8) && (source.receiveBufferPeakCount () == 9), "receive buffer peak") ;
+  check (source.available (), "available") ;
+//--- Forward through mocks
+  check (forward (source, destination) == 8, "mock forward") ;
+  check (!source.available () && (source.receiveBufferCount () == 0), "source drained") ;
+  bool inOrder = true ;
+  for (uint32_t i=0 ; i<8 ; i++) {
+    inOrder &= destination.takeSentMessage (message) && (message.id == (i + 1)) ;
+  }
+  check (inOrder && !destination.takeSentMessage (message), "mock forward order") ;
+  check ((destination.sentFrameCount () == 8) && (destination.transmitBufferPeakCount () == 8), "mock sent frames") ;
+  check (destination.transmitBufferFreeCount () == 16, "transmit buffer free count") ;
+//--- Batch send stops at the first rejected frame
+  ACANMockDriver small (4, 3) ;
+  CANMessage frames [5] ;
+  check (small.tryToSendBatch (frames, 5) == 3, "batch send") ;
+  check ((small.rejectedFrameCount () == 1) && (small.transmitBufferFreeCount () == 0), "batch send: rejected frame") ;
+  check ((small.receiveBatch (frames, 5) == 0), "batch receive, no frame") ;
+//--- Bus off state, error counters
+  check (!small.isBusOff () && (small.controllerState () == kActive), "active") ;
+  small.takeSentMessage (message) ;
+  small.setControllerState (kBusOff) ;
+  small.setErrorCounters (12, 255) ;
+  check (small.isBusOff () && !small.tryToSend (message), "bus off") ;
+  check ((small.receiveErrorCounter () == 12) && (small.transmitErrorCounter () == 255), "error counters") ;
+  small.setControllerState (kPassive) ;
+  check (!small.isBusOff () && small.tryToSend (message), "passive") ;
+//--- Forward through simulated nodes: can0 --> gateway0 ... gateway1 --> can1
+  ACANVirtualBus bus0 ;
+  ACANVirtualBus bus1 ;
+  ACANSimulatedNode can0 (bus0, "can0") ;
+  ACANSimulatedNode gateway0 (bus0, "gateway0") ;
+  ACANSimulatedNode gateway1 (bus1, "gateway1") ;
+  ACANSimulatedNode can1 (bus1, "can1") ;
+  check ((can0.begin (ACANSettings (500 * 1000)) == 0) && (gateway0.begin (ACANSettings (500 * 1000)) == 0), "bus 0 begin") ;
+  check ((gateway1.begin (ACANSettings (500 * 1000)) == 0) && (can1.begin (ACANSettings (500 * 1000)) == 0), "bus 1 begin") ;
+  for (uint32_t i=0 ; i<5 ; i++) {
+    frames [i].id = 0x100 + i ;
+    frames [i].len = 1 ;
+    frames [i].data [0] = (uint8_t) i ;
+  }
+  check (can0.tryToSendBatch (frames, 5) == 5, "simulated batch send") ;
+  bus0.runFor (10 * 1000 * 1000) ; // 10 ms
+  check ((can0.transmitBufferFreeCount () == can0.transmitBufferSize ()) && (gateway0.receiveBufferCount () == 5), "bus 0 transfer") ;
+  check (forward (gateway0, gateway1) == 5, "simulated forward") ;
+  bus1.runFor (10 * 1000 * 1000) ;
+  CANMessage received [8] ;
+  const uint32_t receivedCount = can1.receiveBatch (received, 8) ;
+  inOrder = receivedCount == 5 ;
+  for (uint32_t i=0 ; (i<receivedCount) && inOrder ; i++) {
+    inOrder = (received [i].id == (0x101 + i)) && (received [i].len == 1) && (received [i].data [0] == i) ;
+  }
+  check (inOrder, "simulated forward order") ;
+  check (!can1.isBusOff () && (can1.receivedFrameCount () == 5), "simulated node state") ;
+//--- Concept constrained template
+  #ifdef __cpp_concepts
+    ACANMockDriver conceptDriver ;
+    check (sendIfActive (conceptDriver, message) && sendIfActive (can0, message), "concept constrained template") ;
+    conceptDriver.setControllerState (kBusOff) ;
+    check (!sendIfActive (conceptDriver, message), "concept constrained template, bus off") ;
+    printf ("C++20 concepts checked\n") ;
+  #endif
+//---
+  printf ("%s\n", (gErrorCount == 0) ? "OK" : "FAILED") ;
+  return (gErrorCount == 0) ? 0 : 1 ;
+}
+
+//----------------------------------------------------------------------------------------
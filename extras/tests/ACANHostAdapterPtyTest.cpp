@@ -0,0 +1,349 @@
+//----------------------------------------------------------------------------------------
+// ACANHostAdapter pseudo-terminal test (Linux / macOS host, no CAN hardware needed)
+// by Pierre Molinaro
+// https://github.com/pierremolinaro/acan
+//
+// The adapter runs on the simulated driver (extras/simulator): ACAN::can0 is the adapter
+// CAN module, ACAN::can1 a node that keeps its transmit buffer full at 1 Mbit/s (full bus
+// load). The adapter stream is the slave side of a pseudo-terminal; a host thread, on the
+// master side, plays the PC application: it opens the channel in SLCAN (S8, Z1, O), checks
+// that every frame sent by can1 is streamed once, in order, with its data and a time
+// stamp, and sends a frame to the bus ('t' command) every 200 received frames.
+// The adapter receive buffer must never overflow.
+//
+//   g++ -std=gnu++14 -O2 -Iextras/simulator -Isrc -include Arduino.h
+//       extras/tests/ACANHostAdapterPtyTest.cpp src/ACANHostAdapter.cpp
+//       src/ACANVirtualBus.cpp src/ACANSettings.cpp src/ACANFilters.cpp
+//       src/ACANInstrumentation.cpp -lpthread -o hostAdapterTest
+//   ./hostAdapterTest [loop period in µs (default 100)]
+//
+//----------------------------------------------------------------------------------------
+
+#include <Arduino.h>
+#include <ACAN.h>
+#include <ACANHostAdapter.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <termios.h>
+#include <unistd.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+//----------------------------------------------------------------------------------------
+
+static const uint32_t kFrameCount = 20000 ; // Sent by can1, streamed by the adapter
+static const uint32_t kStreamedIdentifier = 0x100 ;
+static const uint32_t kHostIdentifier = 0x050 ; // Sent by the host thread
+static const uint32_t kHostFramePeriod = 200 ; // One host frame every 200 streamed frames
+
+//----------------------------------------------------------------------------------------
+//    Sketch bus, time (as ACANSketchRunner.cpp)
+//----------------------------------------------------------------------------------------
+
+ACANVirtualBus & acanSketchBus (void) {
+  static ACANVirtualBus bus ; // Bit rate of the first started node
+  return bus ;
+}
+
+//----------------------------------------------------------------------------------------
+
+ACAN ACAN::can0 ("can0") ;
+ACAN ACAN::can1 ("can1") ;
+
+//----------------------------------------------------------------------------------------
+
+uint32_t millis (void) {
+  return (uint32_t) (acanSketchBus ().nowNanos () / (1000 * 1000)) ;
+}
+
+//----------------------------------------------------------------------------------------
+
+uint32_t micros (void) {
+  return acanSketchBus ().nowMicros () ;
+}
+
+//----------------------------------------------------------------------------------------
+//    Adapter side of the pseudo-terminal
+//----------------------------------------------------------------------------------------
+
+class PtyStream : public Stream {
+  public: explicit PtyStream (const int inFileDescriptor) : mFileDescriptor (inFileDescriptor) {}
+
+  public: virtual int available (void) override {
+    if (mReadIndex == mReadLength) {
+      struct pollfd p = {mFileDescriptor, POLLIN, 0} ;
+      if ((::poll (& p, 1, 0) > 0) && ((p.revents & POLLIN) != 0)) {
+        const ssize_t n = ::read (mFileDescriptor, mReadBuffer, sizeof (mReadBuffer)) ;
+        mReadLength = (n > 0) ? (uint32_t) n : 0 ;
+        mReadIndex = 0 ;
+      }
+    }
+    return (int) (mReadLength - mReadIndex) ;
+  }
+
+  public: virtual int read (void) override {
+    int result = -1 ;
+    if (available () > 0) {
+      result = mReadBuffer [mReadIndex] ;
+      mReadIndex += 1 ;
+    }
+    return result ;
+  }
+
+  public: virtual size_t write (const uint8_t inByte) override {
+    return write (& inByte, 1) ;
+  }
+
+//--- Blocking: the host thread reads the master side
+  public: virtual size_t write (const uint8_t * inBuffer, const size_t inLength) override {
+    size_t n = 0 ;
+    bool ok = true ;
+    while ((n < inLength) && ok) {
+      const ssize_t written = ::write (mFileDescriptor, inBuffer + n, inLength - n) ;
+      if (written > 0) {
+        n += (size_t) written ;
+      }else{
+        ok = (written < 0) && (errno == EINTR) ;
+      }
+    }
+    mWriteCallCount += 1 ;
+    mWrittenByteCount += n ;
+    return n ;
+  }
+
+  public: inline uint32_t writeCallCount (void) const { return mWriteCallCount ; }
+  public: inline uint64_t writtenByteCount (void) const { return mWrittenByteCount ; }
+
+  private: const int mFileDescriptor ;
+  private: uint8_t mReadBuffer [256] ;
+  private: uint32_t mReadIndex = 0 ;
+  private: uint32_t mReadLength = 0 ;
+  private: uint32_t mWriteCallCount = 0 ;
+  private: uint64_t mWrittenByteCount = 0 ;
+} ;
+
+//----------------------------------------------------------------------------------------
+//    Host side (PC application)
+//----------------------------------------------------------------------------------------
+
+static std::atomic <bool> gStop (false) ;
+static std::atomic <bool> gHostDone (false) ;
+
+static uint32_t gStreamedFrameCount = 0 ; // Host thread results, read after join
+static uint32_t gHostFrameCount = 0 ;
+static uint32_t gHostFrameAckCount = 0 ;
+static uint32_t gOkCount = 0 ;
+static uint32_t gBellCount = 0 ;
+static uint32_t gHostErrorCount = 0 ;
+
+//----------------------------------------------------------------------------------------
+
+static void writeAll (const int inFileDescriptor, const char * inText, const size_t inLength) {
+  size_t n = 0 ;
+  while (n < inLength) {
+    const ssize_t written = ::write (inFileDescriptor, inText + n, inLength - n) ;
+    if (written > 0) {
+      n += (size_t) written ;
+    }else if ((written < 0) && (errno != EINTR)) {
+      n = inLength ;
+      gHostErrorCount += 1 ;
+    }
+  }
+}
+
+//----------------------------------------------------------------------------------------
+
+static uint32_t hexValue (const char inText [], const uint32_t inDigitCount) {
+  char digits [9] = {} ;
+  for (uint32_t i=0 ; i<inDigitCount ; i++) {
+    digits [i] = inText [i] ;
+  }
+  return (uint32_t) strtoul (digits, nullptr, 16) ;
+}
+
+//----------------------------------------------------------------------------------------
+// tiiiLdddddddddddddddduuuu: identifier, length, data (sequence number and its complement,
+// little endian), time stamp (ms, modulo 60000)
+
+static void handleLine (const char inLine [], const uint32_t inLength, uint32_t & ioPreviousTimeStamp) {
+  if (inLength == 0) {
+    gOkCount += 1 ;
+  }else if ((inLength == 1) && (inLine [0] == 'z')) {
+    gHostFrameAckCount += 1 ;
+  }else if ((inLength == 25) && (inLine [0] == 't')) {
+    const uint32_t identifier = hexValue (& inLine [1], 3) ;
+    const uint32_t length = hexValue (& inLine [4], 1) ;
+    uint8_t data [8] ;
+    for (uint32_t i=0 ; i<8 ; i++) {
+      data [i] = (uint8_t) hexValue (& inLine [5 + 2 * i], 2) ;
+    }
+    const uint32_t sequence = data [0] | (data [1] << 8) | (data [2] << 16) | ((uint32_t) data [3] << 24) ;
+    const uint32_t complement = data [4] | (data [5] << 8) | (data [6] << 16) | ((uint32_t) data [7] << 24) ;
+    const uint32_t timeStamp = hexValue (& inLine [21], 4) ;
+    if ((identifier != kStreamedIdentifier) || (length != 8) || (complement != ~ sequence)) {
+      gHostErrorCount += 1 ;
+      printf ("corrupted frame: %.*s\n", (int) inLength, inLine) ;
+    }else if (sequence != gStreamedFrameCount) {
+      gHostErrorCount += 1 ;
+      printf ("frame %u received, %u expected\n", sequence, gStreamedFrameCount) ;
+    }else if ((timeStamp < ioPreviousTimeStamp) || (timeStamp >= 60000)) {
+      gHostErrorCount += 1 ;
+      printf ("frame %u: time stamp %u after %u\n", sequence, timeStamp, ioPreviousTimeStamp) ;
+    }
+    gStreamedFrameCount = sequence + 1 ;
+    ioPreviousTimeStamp = timeStamp ;
+  }else{
+    gHostErrorCount += 1 ;
+    printf ("unexpected line: %.*s\n", (int) inLength, inLine) ;
+  }
+}
+
+//----------------------------------------------------------------------------------------
+
+static void hostThread (const int inMasterFileDescriptor) {
+  const char openCommands [] = "S8\rZ1\rO\r" ; // 1 Mbit/s, time stamps, open
+  writeAll (inMasterFileDescriptor, openCommands, sizeof (openCommands) - 1) ;
+  char line [64] ;
+  uint32_t lineLength = 0 ;
+  uint32_t previousTimeStamp = 0 ;
+  while (!gStop.load ()) {
+    struct pollfd p = {inMasterFileDescriptor, POLLIN, 0} ;
+    if ((poll (& p, 1, 100) > 0) && ((p.revents & POLLIN) != 0)) {
+      char buffer [4096] ;
+      const ssize_t n = ::read (inMasterFileDescriptor, buffer, sizeof (buffer)) ;
+      for (ssize_t i=0 ; i<n ; i++) {
+        const char c = buffer [i] ;
+        if (c == 0x07) { // BEL: command rejected
+          gBellCount += 1 ;
+        }else if (c == '\r') {
+          handleLine (line, lineLength, previousTimeStamp) ;
+          lineLength = 0 ;
+        }else if (lineLength < sizeof (line)) {
+          line [lineLength] = c ;
+          lineLength += 1 ;
+        }
+      //--- Host frame: sequence number in data [0]
+        if ((c == '\r') && (gStreamedFrameCount >= ((gHostFrameCount + 1) * kHostFramePeriod))) {
+          char command [32] ;
+          const int length = snprintf (command, sizeof (command), "t%03X1%02X\r",
+                                       kHostIdentifier, gHostFrameCount & 0xFF) ;
+          writeAll (inMasterFileDescriptor, command, (size_t) length) ;
+          gHostFrameCount += 1 ;
+        }
+      }
+    }
+  //--- Every frame, a reply to every command ("\r" for open commands, "z\r" for frames)
+    const bool done = (gStreamedFrameCount == kFrameCount)
+      && ((gOkCount + gHostFrameAckCount + gBellCount) == (3 + gHostFrameCount)) ;
+    gHostDone.store (done) ;
+  }
+}
+
+//----------------------------------------------------------------------------------------
+//    can1 receives the host frames
+//----------------------------------------------------------------------------------------
+
+static void receiveHostFrames (uint32_t & ioHostFrameCount, uint32_t & ioErrorCount) {
+  CANMessage message ;
+  while (ACAN::can1.receive (message)) {
+    if ((message.id != kHostIdentifier) || (message.len != 1) || (message.data [0] != (ioHostFrameCount & 0xFF))) {
+      ioErrorCount += 1 ;
+      printf ("can1: unexpected frame 0x%X, length %u\n", message.id, message.len) ;
+    }
+    ioHostFrameCount += 1 ;
+  }
+}
+
+//----------------------------------------------------------------------------------------
+//    Main
+//----------------------------------------------------------------------------------------
+
+int main (int argc, char * argv []) {
+  const uint64_t loopNanos = ((argc > 1) ? strtoull (argv [1], nullptr, 10) : 100) * 1000 ;
+  uint32_t errorCount = 0 ;
+//--- Pseudo-terminal, raw mode (no echo, no CR / LF translation)
+  const int master = posix_openpt (O_RDWR | O_NOCTTY) ;
+  if ((master < 0) || (grantpt (master) != 0) || (unlockpt (master) != 0)) {
+    printf ("cannot open a pseudo-terminal\n") ;
+    return 2 ;
+  }
+  const int slave = open (ptsname (master), O_RDWR | O_NOCTTY) ;
+  struct termios settings ;
+  if ((slave < 0) || (tcgetattr (slave, & settings) != 0)) {
+    printf ("cannot open %s\n", ptsname (master)) ;
+    return 2 ;
+  }
+  cfmakeraw (& settings) ;
+  tcsetattr (slave, TCSANOW, & settings) ;
+//--- can1 sends, once the adapter channel is open
+  ACANVirtualBus & bus = acanSketchBus () ;
+  errorCount += ACAN::can1.begin (ACANSettings (1000 * 1000)) != 0 ;
+  PtyStream stream (slave) ;
+  ACANHostAdapter adapter (ACAN::can0, stream) ;
+  std::thread host (hostThread, master) ;
+  uint32_t sentCount = 0 ;
+  uint32_t hostFrameCount = 0 ;
+  uint64_t startNanos = 0 ;
+  uint64_t endNanos = 0 ;
+  uint64_t streamedBitCount = 0 ; // Frames sent by can1, with intermission
+  const auto timeOut = std::chrono::steady_clock::now () + std::chrono::seconds (30) ;
+  while (!gHostDone.load () && (std::chrono::steady_clock::now () < timeOut)) {
+    adapter.poll () ;
+    if (ACAN::can0.isStarted ()) {
+      if (sentCount == 0) {
+        startNanos = bus.nowNanos () ;
+      }
+      CANMessage message ;
+      message.id = kStreamedIdentifier ;
+      message.len = 8 ;
+      message.data32 [0] = sentCount ;
+      message.data32 [1] = ~ sentCount ;
+      while ((sentCount < kFrameCount) && ACAN::can1.tryToSend (message)) {
+        streamedBitCount += ACANVirtualBus::frameBitCount (message) + 3 ;
+        sentCount += 1 ;
+        message.data32 [0] = sentCount ;
+        message.data32 [1] = ~ sentCount ;
+      }
+      if ((sentCount == kFrameCount) && (endNanos == 0) && (ACAN::can1.transmitBufferCount () == 0)) {
+        endNanos = bus.nowNanos () ;
+      }
+    }
+    receiveHostFrames (hostFrameCount, errorCount) ;
+    bus.runFor (loopNanos) ;
+  }
+  gStop.store (true) ;
+  host.join () ;
+//--- Last host frame may still be in the can0 transmit buffer
+  bus.runFor (10 * 1000 * 1000) ;
+  receiveHostFrames (hostFrameCount, errorCount) ;
+//--- Report
+  const double seconds = (double) (endNanos - startNanos) / 1.0e9 ;
+  const double load = (seconds > 0.0) ? ((double) streamedBitCount / (seconds * 1.0e6)) : 0.0 ; // 1 bit = 1 µs
+  printf ("%u frames sent by can1 in %.3f s (%.0f frames/s, bus load %.1f %%), %u streamed by the adapter, %u received by the host\n",
+          sentCount, seconds, (seconds > 0.0) ? (sentCount / seconds) : 0.0, load * 100.0,
+          adapter.streamedFrameCount (), gStreamedFrameCount) ;
+  printf ("adapter: %u writes (%u by the stream), %.1f bytes per write; receive buffer peak %u / %u, %u dropped\n",
+          adapter.writeCount (), stream.writeCallCount (),
+          (double) stream.writtenByteCount () / ((stream.writeCallCount () > 0) ? stream.writeCallCount () : 1),
+          ACAN::can0.receiveBufferPeakCount (), ACAN::can0.receiveBufferSize (), ACAN::can0.droppedFrameCount ()) ;
+  printf ("host frames: %u sent, %u acknowledged, %u received by can1, %u rejected commands\n",
+          gHostFrameCount, gHostFrameAckCount, hostFrameCount, gBellCount) ;
+  printf ("bus: %u frames, %u error frames\n", bus.frameCount (), bus.errorFrameCount ()) ;
+  errorCount += gHostErrorCount ;
+  errorCount += !gHostDone.load () ;
+  errorCount += gStreamedFrameCount != kFrameCount ;
+  errorCount += ACAN::can0.droppedFrameCount () != 0 ;
+  errorCount += load < 0.95 ; // Full load: frames are sent back to back
+  errorCount += bus.errorFrameCount () != 0 ;
+  errorCount += (gBellCount != 0) || (hostFrameCount != gHostFrameCount) ;
+  printf ("%s\n", (errorCount == 0) ? "OK" : "FAILED") ;
+  close (slave) ;
+  close (master) ;
+  return (errorCount == 0) ? 0 : 1 ;
+}
+
+//----------------------------------------------------------------------------------------
@@ -0,0 +1,273 @@
+//----------------------------------------------------------------------------------------
+// ACANSignalColumns test (Linux / macOS host, no CAN hardware needed)
+// by Pierre Molinaro
+// https://github.com/pierremolinaro/acan
+//
+// A 200,000 record capture (300 identifiers, standard and extended, some remote frames,
+// time stamps wrapping around, a block with a corrupted header) is written through
+// ACANBusLogWriter. Checks that:
+//   - ACANCaptureColumns::build gives the same columns with 1 and 4 threads, and the same
+//     rows as a sequential read with ACANBusLogReader (time stamps, payloads, lengths);
+//   - every available kernel (scalar, SSSE3, AVX2) extracts the values given by a bit by
+//     bit reference, for Intel and Motorola signals, signed or not, 1 to 64 bits;
+//   - an invalid signal gives NaN;
+//   - extractSignals, with 1 and 4 threads, gives the values of extractSignal, and
+//     returns false for an absent identifier.
+//
+//   g++ -std=gnu++14 -O2 -Isrc extras/tests/ACANSignalColumnsTest.cpp
+//       src/ACANSignalColumns.cpp src/ACANBusLogFormat.cpp -lpthread
+//       -o signalColumnsTest && ./signalColumnsTest
+//
+// Also run it with -fsanitize=thread.
+//
+//----------------------------------------------------------------------------------------
+
+#include <ACANSignalColumns.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+//----------------------------------------------------------------------------------------
+
+static const uint32_t kRecordCount = 200000 ;
+static const uint32_t kCorruptedBlock = 50 ;
+
+//----------------------------------------------------------------------------------------
+
+static uint32_t gErrorCount = 0 ;
+
+static void check (const bool inCondition, const char * inMessage) {
+  if (!inCondition) {
+    gErrorCount += 1 ;
+    printf ("error: %s\n", inMessage) ;
+  }
+}
+
+//----------------------------------------------------------------------------------------
+
+static bool appendBlock (const ACANBusLogBlock & inBlock, void * inUserData) {
+  std::vector <uint32_t> & words = * (std::vector <uint32_t> *) inUserData ; // 4-byte aligned
+  const uint32_t * p = (const uint32_t *) & inBlock ;
+  words.insert (words.end (), p, p + sizeof (ACANBusLogBlock) / 4) ;
+  return true ;
+}
+
+//----------------------------------------------------------------------------------------
+
+static uint64_t payload (const uint8_t inData []) {
+  uint64_t result = 0 ;
+  for (uint32_t i=8 ; i>0 ; i--) {
+    result = (result << 8) | inData [i-1] ;
+  }
+  return result ;
+}
+
+//----------------------------------------------------------------------------------------
+// Bit by bit reference (DBC conventions, see ACANSignalColumns.h)
+
+static double referenceValue (const ACANSignal & inSignal, const uint64_t inPayload) {
+  uint64_t raw = 0 ;
+  uint32_t bit = inSignal.mStartBit ;
+  for (uint32_t i=0 ; i<inSignal.mBitLength ; i++) {
+    const uint64_t b = (inPayload >> bit) & 1 ;
+    if (inSignal.mByteOrder == ACANSignal::kLittleEndian) {
+      raw |= b << i ;
+      bit += 1 ;
+    }else{
+      raw = (raw << 1) | b ;
+      bit = ((bit % 8) == 0) ? (bit + 15) : (bit - 1) ;
+    }
+  }
+  double value ;
+  if (!inSignal.mSigned) {
+    value = (double) raw ;
+  }else if ((inSignal.mBitLength < 64) && (((raw >> (inSignal.mBitLength - 1)) & 1) != 0)) {
+    value = (double) (int64_t) (raw | (~ UINT64_C (0) << inSignal.mBitLength)) ;
+  }else{
+    value = (double) (int64_t) raw ;
+  }
+  return value * inSignal.mFactor + inSignal.mOffset ;
+}
+
+//----------------------------------------------------------------------------------------
+
+int main (void) {
+//--- Capture
+  std::vector <uint32_t> capture ;
+  ACANBusLogWriter writer (appendBlock, & capture) ;
+  uint64_t random = 12345 ;
+  uint32_t timeStamp = 0xFFF00000 ; // Wraps around after about 1 s
+  for (uint32_t i=0 ; i<kRecordCount ; i++) {
+    random = random * UINT64_C (6364136223846793005) + UINT64_C (1442695040888963407) ;
+    ACANBusLogRecord record ;
+    memset (& record, 0, sizeof (record)) ;
+    timeStamp += (uint32_t) ((random >> 40) % 3000) ;
+    record.mTimeStamp = timeStamp ;
+    const uint32_t identifier = (uint32_t) ((random >> 20) % 300) ;
+    record.mIdentifier = identifier
+      | (((identifier % 7) == 0) ? kACANBusLogExtendedFlag : 0)
+      | (((i % 1000) == 0) ? kACANBusLogRemoteFlag : 0) ;
+    const uint64_t data = random ^ (random << 17) ;
+    for (uint32_t k=0 ; k<8 ; k++) {
+      record.mData [k] = (uint8_t) (data >> (8 * k)) ;
+    }
+    record.mLength = (uint8_t) ((random >> 33) % 9) ;
+    writer.append (record) ;
+  }
+  writer.flush () ;
+  memset ((uint8_t *) capture.data () + kCorruptedBlock * kACANBusLogBlockSize + 3, 0xAA, 10) ;
+  const uint8_t * data = (const uint8_t *) capture.data () ;
+  const size_t size = capture.size () * 4 ;
+//--- Build, with 1 and 4 threads
+  ACANCaptureColumns columns ;
+  ACANCaptureColumns parallelColumns ;
+  const uint64_t storedCount = columns.build (data, size, 1) ;
+  check (parallelColumns.build (data, size, 4) == storedCount, "stored record count") ;
+  bool same = (columns.columnCount () == parallelColumns.columnCount ())
+           && (columns.recordCount () == parallelColumns.recordCount ())
+           && (columns.remoteFrameCount () == parallelColumns.remoteFrameCount ()) ;
+  for (uint32_t c=0 ; (c<columns.columnCount ()) && same ; c++) {
+    const uint64_t n = columns.rowCount (c) ;
+    same = (columns.keyAtIndex (c) == parallelColumns.keyAtIndex (c))
+        && (n == parallelColumns.rowCount (c))
+        && (memcmp (columns.timeStamps (c), parallelColumns.timeStamps (c), n * 8) == 0)
+        && (memcmp (columns.payloads (c), parallelColumns.payloads (c), n * 8) == 0)
+        && (memcmp (columns.lengths (c), parallelColumns.lengths (c), n) == 0) ;
+  }
+  check (same, "1 and 4 thread builds") ;
+//--- Sequential reference
+  ACANBusLogReader reader (data, size) ;
+  std::vector <std::vector <uint64_t> > referenceTimeStamps (columns.columnCount ()) ;
+  std::vector <std::vector <uint64_t> > referencePayloads (columns.columnCount ()) ;
+  std::vector <std::vector <uint8_t> > referenceLengths (columns.columnCount ()) ;
+  uint64_t readCount = 0 ;
+  uint64_t remoteCount = 0 ;
+  uint64_t time = 0 ;
+  uint32_t previousTimeStamp = 0 ;
+  bool knownColumns = true ;
+  const ACANBusLogRecord * record = reader.next () ;
+  while (nullptr != record) {
+    if (readCount > 0) {
+      time += (uint32_t) (record->mTimeStamp - previousTimeStamp) ;
+    }
+    previousTimeStamp = record->mTimeStamp ;
+    readCount += 1 ;
+    if (record->isRemote ()) {
+      remoteCount += 1 ;
+    }else{
+      const int32_t c = columns.columnIndex (record->identifier (), record->isExtended ()) ;
+      if (c < 0) {
+        knownColumns = false ;
+      }else{
+        referenceTimeStamps [c].push_back (time) ;
+        referencePayloads [c].push_back (payload (record->mData)) ;
+        referenceLengths [c].push_back (record->mLength) ;
+      }
+    }
+    record = reader.next () ;
+  }
+  check (reader.lostBlockCount () == 1, "corrupted block skipped") ;
+  check (readCount == (kRecordCount - kACANBusLogRecordsPerBlock), "read record count") ;
+  check ((columns.remoteFrameCount () == remoteCount) && (remoteCount > 0), "remote frame count") ;
+  check ((columns.recordCount () == storedCount) && (storedCount == (readCount - remoteCount)), "stored record count") ;
+  check (knownColumns && (columns.columnCount () == 300), "column count") ;
+  same = true ;
+  for (uint32_t c=0 ; (c<columns.columnCount ()) && same ; c++) {
+    const uint64_t n = referencePayloads [c].size () ;
+    same = (columns.rowCount (c) == n)
+        && ((c == 0) || (columns.keyAtIndex (c - 1) < columns.keyAtIndex (c)))
+        && (memcmp (columns.timeStamps (c), referenceTimeStamps [c].data (), n * 8) == 0)
+        && (memcmp (columns.payloads (c), referencePayloads [c].data (), n * 8) == 0)
+        && (memcmp (columns.lengths (c), referenceLengths [c].data (), n) == 0) ;
+  }
+  check (same, "columns and sequential read") ;
+//--- Kernels
+  const ACANSignal signals [] = {
+    ACANSignal (0, 8),
+    ACANSignal (3, 13, ACANSignal::kLittleEndian, true, 0.1, -40.0),
+    ACANSignal (7, 16, ACANSignal::kBigEndian, false, 0.25),
+    ACANSignal (21, 12, ACANSignal::kBigEndian, true, 0.5, 1.0),
+    ACANSignal (62, 1),
+    ACANSignal (0, 51, ACANSignal::kLittleEndian, true),
+    ACANSignal (13, 51, ACANSignal::kLittleEndian, false, 2.0, 3.0),
+    ACANSignal (0, 64),
+    ACANSignal (0, 64, ACANSignal::kLittleEndian, true),
+    ACANSignal (7, 64, ACANSignal::kBigEndian, true)
+  } ;
+  const uint32_t signalCount = sizeof (signals) / sizeof (signals [0]) ;
+  const tACANSignalKernel kernels [3] = {kACANSignalKernelScalar, kACANSignalKernelSSSE3, kACANSignalKernelAVX2} ;
+  const char * kernelNames [3] = {"scalar", "SSSE3", "AVX2"} ;
+  std::vector <double> values ;
+  for (uint32_t k=0 ; k<3 ; k++) {
+    if (!setACANSignalKernel (kernels [k])) {
+      printf ("%s kernel not supported\n", kernelNames [k]) ;
+    }else{
+      bool exact = true ;
+      for (uint32_t s=0 ; s<signalCount ; s++) {
+        check (signals [s].isValid (), "valid signal") ;
+        for (uint32_t c=0 ; c<columns.columnCount () ; c++) {
+          const uint64_t n = columns.rowCount (c) ;
+          values.assign (n, 0.0) ;
+          acanExtractSignal (signals [s], columns.payloads (c), n, values.data ()) ;
+          for (uint64_t i=0 ; (i<n) && exact ; i++) {
+            exact = values [i] == referenceValue (signals [s], columns.payloads (c) [i]) ;
+            if (!exact) {
+              printf ("%s kernel, signal %u, column %u, row %llu: %.17g, %.17g expected\n",
+                      kernelNames [k], s, c, (unsigned long long) i, values [i],
+                      referenceValue (signals [s], columns.payloads (c) [i])) ;
+            }
+          }
+        }
+      }
+      check (exact, "kernel values") ;
+    //--- Invalid signal: NaN
+      const ACANSignal invalidSignal (60, 8) ;
+      values.assign (columns.rowCount (0), 0.0) ;
+      acanExtractSignal (invalidSignal, columns.payloads (0), values.size (), values.data ()) ;
+      check (!invalidSignal.isValid () && isnan (values [0]) && isnan (values.back ()), "invalid signal") ;
+    }
+  }
+//--- Requests: 4 signals per identifier, with 1 and 4 threads
+  std::vector <ACANSignalRequest> requests ;
+  std::vector <std::vector <double> > requestValues ;
+  for (uint32_t c=0 ; c<columns.columnCount () ; c++) {
+    for (uint32_t s=0 ; s<4 ; s++) {
+      requestValues.push_back (std::vector <double> (columns.rowCount (c), 0.0)) ;
+    }
+  }
+  for (uint32_t c=0 ; c<columns.columnCount () ; c++) {
+    const uint32_t key = columns.keyAtIndex (c) ;
+    for (uint32_t s=0 ; s<4 ; s++) {
+      requests.push_back (ACANSignalRequest (key & kACANBusLogIdentifierMask,
+                                             (key & kACANBusLogExtendedFlag) != 0,
+                                             signals [s],
+                                             requestValues [requests.size ()].data ())) ;
+    }
+  }
+  for (uint32_t threadCount = 1 ; threadCount <= 4 ; threadCount += 3) {
+    for (std::vector <double> & v : requestValues) {
+      v.assign (v.size (), 0.0) ;
+    }
+    check (parallelColumns.extractSignals (requests.data (), (uint32_t) requests.size (), threadCount), "extractSignals") ;
+    same = true ;
+    for (uint32_t r=0 ; (r<requests.size ()) && same ; r++) {
+      values.assign (requestValues [r].size (), 0.0) ;
+      same = parallelColumns.extractSignal (requests [r].mIdentifier, requests [r].mExtended, requests [r].mSignal, values.data ())
+          && (values == requestValues [r]) ;
+    }
+    check (same, "extractSignals and extractSignal") ;
+  }
+  const ACANSignalRequest absentRequest (0x7FF, true, signals [0], nullptr) ;
+  check (!columns.extractSignals (& absentRequest, 1), "absent identifier") ;
+//--- Empty capture
+  ACANCaptureColumns empty ;
+  check ((empty.build (nullptr, 0) == 0) && (empty.columnCount () == 0) && (empty.columnIndex (1, false) == -1), "empty capture") ;
+//---
+  printf ("%llu records, %llu stored, %u columns\n", (unsigned long long) readCount,
+          (unsigned long long) storedCount, columns.columnCount ()) ;
+  printf ("%s\n", (gErrorCount == 0) ? "OK" : "FAILED") ;
+  return (gErrorCount == 0) ? 0 : 1 ;
+}
+
+//----------------------------------------------------------------------------------------
@@ -0,0 +1,109 @@
+//----------------------------------------------------------------------------------------
+// ACANSocketCAN filter translation test (Linux host, no CAN interface needed)
+// by Pierre Molinaro
+// https://github.com/pierremolinaro/acan
+//
+// Primary and secondary filters are translated into kernel can_filter entries. For random
+// frames (standard, extended, data, remote), checks that the kernel matching rule
+// ((can_id ^ filter.can_id) & filter.can_mask) == 0 accepts exactly the frames the
+// FlexCAN ID table matching accepts, and that frames convert to can_frame and back.
+// ACANSocketCAN.cpp is included, for its file scope conversion routines.
+//
+//   g++ -std=gnu++14 -O2 -Isrc extras/tests/ACANSocketCANFilterTest.cpp src/ACANFilters.cpp
+//       src/ACANSettings.cpp -o filterTest && ./filterTest
+//
+//----------------------------------------------------------------------------------------
+
+#include "../../src/ACANSocketCAN.cpp"
+#include <stdio.h>
+
+//----------------------------------------------------------------------------------------
+
+static uint32_t gRandomState = 1 ;
+
+static uint32_t randomValue (void) {
+  gRandomState = gRandomState * 1664525 + 1013904223 ;
+  return gRandomState >> 1 ;
+}
+
+//----------------------------------------------------------------------------------------
+
+static bool kernelAccepts (const struct can_filter & inFilter, const struct can_frame & inFrame) {
+  return ((inFrame.can_id ^ inFilter.can_id) & inFilter.can_mask) == 0 ;
+}
+
+//----------------------------------------------------------------------------------------
+
+int main (void) {
+  const ACANPrimaryFilter primaryFilters [] = {
+    ACANPrimaryFilter (kData, kStandard, 0x7F8, 0x100),
+    ACANPrimaryFilter (kRemote, kExtended, 0x1FFF0000, 0x12340000),
+    ACANPrimaryFilter (kData, kExtended),
+    ACANPrimaryFilter (kRemote, kStandard, 0x123),
+    ACANPrimaryFilter ()
+  } ;
+  const ACANSecondaryFilter secondaryFilters [] = {
+    ACANSecondaryFilter (kData, kStandard, 0x555),
+    ACANSecondaryFilter (kRemote, kExtended, 0x1ABCDEF)
+  } ;
+  uint32_t errorCount = 0 ;
+  uint32_t acceptCount = 0 ;
+  const uint32_t frameCount = 2000000 ;
+  for (uint32_t n=0 ; n<frameCount ; n++) {
+  //--- Random frame, biased towards the filter identifiers
+    CANMessage message ;
+    message.ext = (randomValue () & 1) != 0 ;
+    message.rtr = (randomValue () & 1) != 0 ;
+    if (!message.ext) {
+      message.id = ((n % 7) == 0) ? (0x100 | (randomValue () & 7)) : (randomValue () & 0x7FF) ;
+    }else if ((randomValue () % 4) == 0) {
+      message.id = 0x12340000 | (randomValue () & 0xFFFF) ;
+    }else{
+      message.id = randomValue () & 0x1FFFFFFF ;
+    }
+    if ((n % 1000) == 0) { // Exact secondary identifiers
+      message = CANMessage () ;
+      message.ext = (n % 2000) == 0 ;
+      message.rtr = message.ext ;
+      message.id = message.ext ? 0x1ABCDEF : 0x555 ;
+    }
+  //--- Conversion
+    struct can_frame frame ;
+    frameFromMessage (message, frame) ;
+    CANMessage back ;
+    messageFromFrame (frame, back) ;
+    if ((back.id != message.id) || (back.ext != message.ext) || (back.rtr != message.rtr)) {
+      errorCount += 1 ;
+      printf ("conversion error: id 0x%X, ext %d, rtr %d\n", message.id, message.ext, message.rtr) ;
+    }
+  //--- Matching
+    const uint32_t image = acanFilterImage (message) ;
+    for (const ACANPrimaryFilter & filter : primaryFilters) {
+      const bool accepted = ((image ^ filter.mAcceptanceFilter) & filter.mFilterMask) == 0 ;
+      if (accepted != kernelAccepts (kernelFilter (filter.mFilterMask, filter.mAcceptanceFilter), frame)) {
+        errorCount += 1 ;
+        printf ("primary filter mismatch: id 0x%X, ext %d, rtr %d\n", message.id, message.ext, message.rtr) ;
+      }
+      acceptCount += accepted ;
+    }
+    for (const ACANSecondaryFilter & filter : secondaryFilters) {
+      const bool accepted = ((image ^ filter.mSingleAcceptanceFilter) & ~ 1U) == 0 ;
+      if (accepted != kernelAccepts (kernelFilter (~ 1U, filter.mSingleAcceptanceFilter), frame)) {
+        errorCount += 1 ;
+        printf ("secondary filter mismatch: id 0x%X, ext %d, rtr %d\n", message.id, message.ext, message.rtr) ;
+      }
+      acceptCount += accepted ;
+    }
+  }
+//--- A filter that does not conform is rejected by begin, before opening the socket
+  ACANSocketCAN driver ("vcan0") ;
+  const ACANPrimaryFilter badFilters [] = {ACANPrimaryFilter (kData, kStandard, 0x800)} ;
+  if (driver.begin (ACANSettings (500 * 1000), badFilters, 1) != ACANSocketCAN::kNotConformPrimaryFilter) {
+    errorCount += 1 ;
+    printf ("non conform filter accepted\n") ;
+  }
+  printf ("%u frames, %u acceptances, %u errors\n%s\n", frameCount, acceptCount, errorCount, (errorCount == 0) ? "OK" : "FAILED") ;
+  return (errorCount == 0) ? 0 : 1 ;
+}
+
+//----------------------------------------------------------------------------------------
@@ -0,0 +1,210 @@
+//----------------------------------------------------------------------------------------
+// ACANSocketCAN test on a local vcan interface (Linux host)
+// by Pierre Molinaro
+// https://github.com/pierremolinaro/acan
+//
+// Four threads send 1000 frames through a sender driver in polling mode; a receiver
+// driver on the same interface has a primary and a secondary filter. Checks that the
+// kernel filters deliver exactly the matching frames to the right call back, in order for
+// every sending thread, with their data and increasing kernel time stamps. Then 64
+// frames queued at once should be written by a single poll, with 2 sendmmsg calls.
+//
+//   sudo modprobe vcan
+//   sudo ip link add dev vcan0 type vcan && sudo ip link set up vcan0
+//   g++ -std=gnu++14 -O2 -Isrc extras/tests/ACANSocketCANvcanTest.cpp src/ACANSocketCAN.cpp
+//       src/ACANFilters.cpp src/ACANSettings.cpp -lpthread -o vcanTest
+//   ./vcanTest [interface (default vcan0)]
+//
+// Exit status: 0 success, 1 failure, 2 interface not available.
+//
+//----------------------------------------------------------------------------------------
+
+#include <ACANSocketCAN.h>
+#include <stdio.h>
+#include <string.h>
+#include <thread>
+#include <time.h>
+
+//----------------------------------------------------------------------------------------
+
+static const uint32_t kThreadCount = 4 ;
+static const uint32_t kFramesPerThread = 250 ;
+
+//----------------------------------------------------------------------------------------
+// Frame i of thread t: every fifth frame matches no filter (standard 0x700), the others
+// alternate between the primary filter (standard 0x100 ... 0x10F) and the secondary
+// filter (extended 0x12345). data32 [0] is the thread, data32 [1] the frame index.
+
+static CANMessage testFrame (const uint32_t inThread, const uint32_t inIndex) {
+  CANMessage frame ;
+  if ((inIndex % 5) == 0) {
+    frame.id = 0x700 ;
+  }else if ((inIndex & 1) != 0) {
+    frame.ext = true ;
+    frame.id = 0x12345 ;
+  }else{
+    frame.id = 0x100 + (inIndex % 16) ;
+  }
+  frame.len = 8 ;
+  frame.data32 [0] = inThread ;
+  frame.data32 [1] = inIndex ;
+  return frame ;
+}
+
+//----------------------------------------------------------------------------------------
+
+static uint32_t gPrimaryCount = 0 ;
+static uint32_t gSecondaryCount = 0 ;
+static uint32_t gErrorCount = 0 ;
+static int64_t gLastIndex [kThreadCount] = {-1, -1, -1, -1} ;
+
+//----------------------------------------------------------------------------------------
+
+static const uint32_t kBatchFrameCount = 64 ;
+static uint32_t gBatchFrameCount = 0 ;
+
+//----------------------------------------------------------------------------------------
+
+static void checkFrame (const CANMessage & inFrame) {
+  const uint32_t thread = inFrame.data32 [0] ;
+  const uint32_t index = inFrame.data32 [1] ;
+  bool ok = (thread <= kThreadCount) && (index < kFramesPerThread) && (inFrame.len == 8) ;
+  if (ok && (thread == kThreadCount)) { // Batch frame
+    ok = (index == gBatchFrameCount) && (inFrame.id == 0x10F) && !inFrame.ext ;
+    gBatchFrameCount += 1 ;
+  }else if (ok) {
+    const CANMessage expected = testFrame (thread, index) ;
+    ok = (expected.id == inFrame.id) && (expected.ext == inFrame.ext) && ((int64_t) index > gLastIndex [thread]) ;
+    gLastIndex [thread] = index ;
+  }
+  if (!ok) {
+    gErrorCount += 1 ;
+    printf ("unexpected frame 0x%X (ext %d), thread %u, index %u\n", inFrame.id, inFrame.ext, thread, index) ;
+  }
+}
+
+//----------------------------------------------------------------------------------------
+
+static void primaryFilterMatch (const CANMessage & inFrame) {
+  gPrimaryCount += 1 ;
+  if (inFrame.ext) {
+    gErrorCount += 1 ;
+  }
+  checkFrame (inFrame) ;
+}
+
+//----------------------------------------------------------------------------------------
+
+static void secondaryFilterMatch (const CANMessage & inFrame) {
+  gSecondaryCount += 1 ;
+  if (!inFrame.ext) {
+    gErrorCount += 1 ;
+  }
+  checkFrame (inFrame) ;
+}
+
+//----------------------------------------------------------------------------------------
+
+static uint64_t monotonicMillis (void) {
+  struct timespec t ;
+  clock_gettime (CLOCK_MONOTONIC, & t) ;
+  return (uint64_t) t.tv_sec * 1000 + (uint64_t) t.tv_nsec / 1000000 ;
+}
+
+//----------------------------------------------------------------------------------------
+
+int main (int argc, char * argv []) {
+  const char * interfaceName = (argc > 1) ? argv [1] : "vcan0" ;
+  ACANSocketCAN sender (interfaceName) ;
+  ACANSocketCAN receiver (interfaceName) ;
+  ACANSettings settings (500 * 1000) ; // Bit rate is not used
+  settings.mPollingMode = true ; // Only poll performs I/O: frames are written in batches
+  settings.mTransmitBufferSize = 1024 ;
+  settings.mReceiveBufferSize = 256 ;
+  const ACANPrimaryFilter primaryFilters [] = {
+    ACANPrimaryFilter (kData, kStandard, 0x7F0, 0x100, primaryFilterMatch)
+  } ;
+  const ACANSecondaryFilter secondaryFilters [] = {
+    ACANSecondaryFilter (kData, kExtended, 0x12345, secondaryFilterMatch)
+  } ;
+  uint32_t errorCode = sender.begin (settings) ;
+  if (0 == errorCode) {
+    errorCode = receiver.begin (settings, primaryFilters, 1, secondaryFilters, 1) ;
+  }
+  if ((errorCode & ACANSocketCAN::kSocketError) != 0) {
+    perror (interfaceName) ;
+    printf ("%s is not available (see the setup commands at the top of this file)\n", interfaceName) ;
+    return 2 ;
+  }else if (errorCode != 0) {
+    printf ("begin error 0x%X\n", errorCode) ;
+    return 1 ;
+  }
+//--- Senders
+  std::thread threads [kThreadCount] ;
+  for (uint32_t t=0 ; t<kThreadCount ; t++) {
+    threads [t] = std::thread ([&sender, t] () {
+      for (uint32_t i=0 ; i<kFramesPerThread ; i++) {
+        while (!sender.tryToSend (testFrame (t, i))) {
+          std::this_thread::yield () ;
+        }
+      }
+    }) ;
+  }
+//--- Reception, while senders are running
+  const uint32_t expectedCount = kThreadCount * kFramesPerThread * 4 / 5 ;
+  uint32_t receivedCount = 0 ;
+  uint64_t lastTimeStamp = 0 ;
+  const uint64_t deadline = monotonicMillis () + 5000 ;
+  while ((receivedCount < expectedCount) && (monotonicMillis () < deadline)) {
+    sender.poll () ;
+    receiver.poll () ;
+    while (receiver.dispatchReceivedMessage ()) {
+      receivedCount += 1 ;
+      if (receiver.lastReceivedTimeStampNanos () < lastTimeStamp) {
+        gErrorCount += 1 ;
+        printf ("time stamp goes backwards\n") ;
+      }
+      lastTimeStamp = receiver.lastReceivedTimeStampNanos () ;
+    }
+  }
+  for (uint32_t t=0 ; t<kThreadCount ; t++) {
+    threads [t].join () ;
+  }
+  printf ("received %u / %u frames (primary %u, secondary %u), kernel drops %u, transmit errors %u\n",
+          receivedCount, expectedCount, gPrimaryCount, gSecondaryCount,
+          receiver.kernelDroppedFrameCount (), sender.transmitErrorCount ()) ;
+//--- Batching: frames queued by tryToSend are written by the next poll
+  for (uint32_t i=0 ; i<kBatchFrameCount ; i++) {
+    CANMessage frame = testFrame (kThreadCount, i) ;
+    frame.ext = false ;
+    frame.id = 0x10F ;
+    sender.tryToSend (frame) ;
+  }
+  const uint32_t senderCallCount = sender.systemCallCount () ;
+  sender.poll () ; // One recvmmsg, then sendmmsg calls of 32 frames
+  const uint32_t senderBatchCallCount = sender.systemCallCount () - senderCallCount ;
+  const uint32_t receiverCallCount = receiver.systemCallCount () ;
+  const uint64_t batchDeadline = monotonicMillis () + 1000 ;
+  while ((gBatchFrameCount < kBatchFrameCount) && (monotonicMillis () < batchDeadline)) {
+    sender.poll () ; // In case the interface queue was full
+    receiver.poll () ;
+    while (receiver.dispatchReceivedMessage ()) {}
+  }
+  const uint32_t receiverBatchCallCount = receiver.systemCallCount () - receiverCallCount ;
+  printf ("batch: %u frames written with %u system calls, %u / %u read with %u system calls\n",
+          kBatchFrameCount, senderBatchCallCount, gBatchFrameCount, kBatchFrameCount, receiverBatchCallCount) ;
+//--- Report
+  const bool ok = (gErrorCount == 0)
+    && (receivedCount == expectedCount)
+    && (gPrimaryCount == ((expectedCount / 2) + kBatchFrameCount))
+    && (gSecondaryCount == (expectedCount / 2))
+    && (lastTimeStamp != 0)
+    && (senderBatchCallCount <= 3)
+    && (gBatchFrameCount == kBatchFrameCount)
+    && (receiverBatchCallCount < kBatchFrameCount)
+  ;
+  printf ("%s\n", ok ? "OK" : "FAILED") ;
+  return ok ? 0 : 1 ;
+}
+
+//----------------------------------------------------------------------------------------
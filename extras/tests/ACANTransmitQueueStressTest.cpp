@@ -0,0 +1,129 @@
+//----------------------------------------------------------------------------------------
+// ACANMPSCQueue stress test (Linux / macOS host, no CAN hardware needed)
+// by Pierre Molinaro
+// https://github.com/pierremolinaro/acan
+//
+// Four producer threads push 50,000 frames each (200,000 frames) into a 16 cell queue,
+// retrying when it is full; the message identifier is the producer index, data32 [0] the
+// producer sequence number. A single consumer pops them, alternately one at a time and
+// in batches (front (offset) / pop (count)), and checks that every frame is received
+// exactly once, in order for each producer: no loss, no duplication.
+//
+//   g++ -std=gnu++14 -O2 -Isrc extras/tests/ACANTransmitQueueStressTest.cpp -lpthread
+//       -o queueStressTest && ./queueStressTest
+//
+// Also run it with -fsanitize=thread.
+//
+//----------------------------------------------------------------------------------------
+
+#include <ACANTransmitQueue.h>
+#include <ACAN_CANMessage.h>
+#include <stdio.h>
+#include <atomic>
+#include <thread>
+
+//----------------------------------------------------------------------------------------
+
+static const uint32_t kProducerCount = 4 ;
+static const uint32_t kFramesPerProducer = 50000 ;
+static const uint32_t kQueueSize = 16 ;
+
+//----------------------------------------------------------------------------------------
+
+static ACANMPSCQueue <CANMessage> gQueue ;
+static std::atomic <bool> gGo (false) ;
+static uint32_t gFullCount [kProducerCount] ;
+static std::atomic <uint32_t> gFinishedProducerCount (0) ;
+
+//----------------------------------------------------------------------------------------
+
+static void producer (const uint32_t inProducer) {
+  while (!gGo.load ()) {
+    std::this_thread::yield () ;
+  }
+  uint32_t fullCount = 0 ;
+  for (uint32_t seq=0 ; seq<kFramesPerProducer ; seq++) {
+    CANMessage message ;
+    message.id = inProducer ;
+    message.len = 8 ;
+    message.data32 [0] = seq ;
+    message.data32 [1] = ~ seq ;
+    while (!gQueue.push (message)) {
+      fullCount += 1 ;
+      std::this_thread::yield () ;
+    }
+  }
+  gFullCount [inProducer] = fullCount ;
+  gFinishedProducerCount += 1 ;
+}
+
+//----------------------------------------------------------------------------------------
+
+int main (void) {
+  gQueue.allocate (kQueueSize) ;
+  uint32_t errorCount = 0 ;
+  uint32_t nextSequence [kProducerCount] = {} ;
+  uint32_t receivedCount = 0 ;
+  uint32_t batchCount = 0 ;
+  std::thread threads [kProducerCount] ;
+  for (uint32_t p=0 ; p<kProducerCount ; p++) {
+    threads [p] = std::thread (producer, p) ;
+  }
+  gGo.store (true) ;
+  const uint32_t total = kProducerCount * kFramesPerProducer ;
+  bool finished = false ;
+  while (!finished && (receivedCount < total)) {
+    const bool producersFinished = gFinishedProducerCount.load () == kProducerCount ; // Read before front
+  //--- Take every published frame at once, or a single one
+    uint32_t n = 0 ;
+    if ((receivedCount & 1) != 0) {
+      while (gQueue.front (n) != nullptr) {
+        n += 1 ;
+      }
+      batchCount += n > 1 ;
+    }else if (gQueue.front () != nullptr) {
+      n = 1 ;
+    }
+    for (uint32_t i=0 ; i<n ; i++) {
+      const CANMessage & message = * gQueue.front (i) ;
+      if ((message.id >= kProducerCount) || (message.data32 [1] != ~ message.data32 [0])) {
+        errorCount += 1 ;
+        printf ("corrupted frame: id %u, data 0x%08X 0x%08X\n", message.id, message.data32 [0], message.data32 [1]) ;
+      }else if (message.data32 [0] != nextSequence [message.id]) {
+        errorCount += 1 ;
+        printf ("producer %u: frame %u received, %u expected\n", message.id, message.data32 [0], nextSequence [message.id]) ;
+        nextSequence [message.id] = message.data32 [0] + 1 ;
+      }else{
+        nextSequence [message.id] += 1 ;
+      }
+    }
+    gQueue.pop (n) ;
+    receivedCount += n ;
+    if (n == 0) {
+      finished = producersFinished ; // Frames lost: do not wait forever
+      std::this_thread::yield () ;
+    }
+  }
+  for (uint32_t p=0 ; p<kProducerCount ; p++) {
+    threads [p].join () ;
+  }
+//--- Nothing left, every sequence complete
+  if (gQueue.front () != nullptr) {
+    errorCount += 1 ;
+    printf ("queue not empty: %u frames\n", gQueue.count ()) ;
+  }
+  uint32_t fullCount = 0 ;
+  for (uint32_t p=0 ; p<kProducerCount ; p++) {
+    fullCount += gFullCount [p] ;
+    if (nextSequence [p] != kFramesPerProducer) {
+      errorCount += 1 ;
+      printf ("producer %u: %u frames received, %u sent\n", p, nextSequence [p], kFramesPerProducer) ;
+    }
+  }
+  printf ("%u frames, %u batches, %u full queue retries, peak count %u\n",
+          receivedCount, batchCount, fullCount, gQueue.peakCount ()) ;
+  printf ("%s\n", (errorCount == 0) ? "OK" : "FAILED") ;
+  return (errorCount == 0) ? 0 : 1 ;
+}
+
+//----------------------------------------------------------------------------------------
@@ -24,6 +24,8 @@
 //----------------------------------------------------------------------------------------
 
 #include <ACAN.h>
+#include <ACANBusLogger.h>
+#include <ACANCyclicSupervisor.h>
 
 //----------------------------------------------------------------------------------------
 //    FlexCAN Register access
@@ -40,6 +42,7 @@ typedef volatile uint32_t vuint32_t ;
 
 #define FLEXCANb_MCR(b)                   (*((vuint32_t *) (b)))
 #define FLEXCANb_CTRL1(b)                 (*((vuint32_t *) ((b)+0x04)))
+#define FLEXCANb_TIMER(b)                 (*((vuint32_t *) ((b)+0x08)))
 #define FLEXCANb_ECR(b)                   (*((vuint32_t *) ((b)+0x1C)))
 #define FLEXCANb_ESR1(b)                  (*((vuint32_t *) ((b)+0x20)))
 #define FLEXCANb_IMASK1(b)                (*((vuint32_t *) ((b)+0x28)))
@@ -79,9 +82,9 @@ typedef volatile uint32_t vuint32_t ;
 #define FLEXCAN_MB_CODE_TX_EMPTY    (0x04)
 #define FLEXCAN_MB_CODE_TX_OVERRUN  (0x06)
 #define FLEXCAN_MB_CODE_TX_INACTIVE  (0x08)
-// #define FLEXCAN_MB_CODE_TX_ABORT    (0x09)
+#define FLEXCAN_MB_CODE_TX_ABORT    (0x09)
 #define FLEXCAN_MB_CODE_TX_ONCE      (0x0C)
-// #define FLEXCAN_MB_CODE_TX_RESPONSE  (0x0A)
+#define FLEXCAN_MB_CODE_TX_RESPONSE  (0x0A)
 // #define FLEXCAN_MB_CODE_TX_RESPONSE_TEMPO  (0x0E)
 
 #define FLEXCAN_get_code(cs)        (((cs) & FLEXCAN_MB_CS_CODE_MASK)>>24)
@@ -141,7 +144,7 @@ typedef volatile uint32_t vuint32_t ;
 #define FLEXCAN_MB_ID_EXT_BIT_NO      (0)
 
 //----------------------------------------------------------------------------------------
-//    imin template function
+//    imin, imax template functions
 //----------------------------------------------------------------------------------------
 
 template <typename T> static inline T imin (const T inA, const T inB) {
@@ -149,98 +152,94 @@ template <typename T> static inline T imin (const T inA, const T inB) {
 }
 
 //----------------------------------------------------------------------------------------
-//    CAN Filter
+
+template <typename T> static inline T imax (const T inA, const T inB) {
+  return (inA >= inB) ? inA : inB ;
+}
+
+//----------------------------------------------------------------------------------------
+//    Identifier mask
 //----------------------------------------------------------------------------------------
 
 static uint32_t defaultMask (const tFrameFormat inFormat) {
   return (inFormat == kExtended) ? 0x1FFFFFFF : 0x7FF ;
 }
 
+//----------------------------------------------------------------------------------------
+//    Gateway route
 //----------------------------------------------------------------------------------------
 
-static uint32_t computeFilterMask (const tFrameFormat inFormat,
-                                   const uint32_t inMask) {
-  return
-    (1 << 31) | // Test RTR bit
-    (1 << 30) | // Test IDE bit
-    ((inFormat == kStandard) ? (inMask << 19) : (inMask << 1)) // Test identifier
-  ;
+ACANGatewayRoute::ACANGatewayRoute (const tFrameFormat inFormat,
+                                    const uint32_t inRemapMask,
+                                    const uint32_t inRemapValue) :
+mExtended (inFormat == kExtended),
+mMask (0),
+mAcceptance (0),
+mRemapMask (inRemapMask & defaultMask (inFormat)),
+mRemapValue (inRemapValue & inRemapMask & defaultMask (inFormat)) {
 }
 
 //----------------------------------------------------------------------------------------
 
-static uint32_t computeAcceptanceFilter (const tFrameKind inKind,
-                                         const tFrameFormat inFormat,
-                                         const uint32_t inMask,
-                                         const uint32_t inAcceptance) {
-  const uint32_t acceptanceConformanceError = (inFormat == kStandard)
-    ? (inAcceptance > 0x7FF)
-    : (inAcceptance > 0x1FFFFFFF)
-  ;
-  const uint32_t maskConformanceError = (inFormat == kStandard)
-    ? (inMask > 0x7FF)
-    : (inMask > 0x1FFFFFFF)
-  ;
-//--- inMask & inAcceptance sould be equal to inAcceptance
-  const uint32_t maskAndAcceptanceCompabilityError = (inMask & inAcceptance) != inAcceptance ;
-//---
-  return
-    ((inKind == kRemote) ? (1 << 31) : 0) | // Accepts remote or data frames ?
-    ((inFormat == kExtended) ? (1 << 30) : 0) | // Accepts standard or extended frames ?
-    ((inFormat == kStandard) ? (inAcceptance << 19) : (inAcceptance << 1)) |
-    acceptanceConformanceError | // Bit 0 is not used by hardware --> we use it for sting conformance error
-    maskConformanceError | maskAndAcceptanceCompabilityError
-  ;
+ACANGatewayRoute::ACANGatewayRoute (const tFrameFormat inFormat,
+                                    const uint32_t inMask,
+                                    const uint32_t inAcceptance,
+                                    const uint32_t inRemapMask,
+                                    const uint32_t inRemapValue) :
+mExtended (inFormat == kExtended),
+mMask (inMask & defaultMask (inFormat)),
+mAcceptance (inAcceptance & inMask & defaultMask (inFormat)),
+mRemapMask (inRemapMask & defaultMask (inFormat)),
+mRemapValue (inRemapValue & inRemapMask & defaultMask (inFormat)) {
 }
 
+//----------------------------------------------------------------------------------------
+//    Transmit rate limit
 //----------------------------------------------------------------------------------------
 
-ACANPrimaryFilter::ACANPrimaryFilter (const tFrameKind inKind,
-                                      const tFrameFormat inFormat,
-                                      const ACANCallBackRoutine inCallBackRoutine) :
-mFilterMask (computeFilterMask (inFormat, 0)),
-mAcceptanceFilter (computeAcceptanceFilter (inKind, inFormat, defaultMask (inFormat), 0)),
-mCallBackRoutine (inCallBackRoutine) {
+ACANTransmitRateLimit::ACANTransmitRateLimit (const tFrameFormat inFormat,
+                                              const uint32_t inMask,
+                                              const uint32_t inAcceptance,
+                                              const uint32_t inFramesPerSecond,
+                                              const uint32_t inBurstFrameCount) :
+mExtended (inFormat == kExtended),
+mMask (inMask & defaultMask (inFormat)),
+mAcceptance (inAcceptance & inMask & defaultMask (inFormat)),
+mFramesPerSecond (inFramesPerSecond),
+mBurstFrameCount (inBurstFrameCount) {
 }
 
+//----------------------------------------------------------------------------------------
+//    Interrupt masking from any context (PRIMASK is restored on exit)
 //----------------------------------------------------------------------------------------
 
-ACANPrimaryFilter::ACANPrimaryFilter (const tFrameKind inKind,
-                                      const tFrameFormat inFormat,
-                                      const uint32_t inIdentifier,
-                                      const ACANCallBackRoutine inCallBackRoutine) :
-mFilterMask (computeFilterMask (inFormat, (inFormat == kExtended) ? 0x1FFFFFFF : 0x7FF)),
-mAcceptanceFilter (computeAcceptanceFilter (inKind, inFormat, defaultMask (inFormat), inIdentifier)),
-mCallBackRoutine (inCallBackRoutine) {
+static inline uint32_t saveAndDisableInterrupts (void) {
+  uint32_t primask ;
+  __asm__ volatile ("mrs %0, primask\n\tcpsid i" : "=r" (primask) : : "memory") ;
+  return primask ;
 }
 
 //----------------------------------------------------------------------------------------
 
-ACANPrimaryFilter::ACANPrimaryFilter (const tFrameKind inKind,
-                                      const tFrameFormat inFormat,
-                                      const uint32_t inMask,
-                                      const uint32_t inAcceptance,
-                                      const ACANCallBackRoutine inCallBackRoutine) :
-mFilterMask (computeFilterMask (inFormat, inMask)),
-mAcceptanceFilter (computeAcceptanceFilter (inKind, inFormat, inMask, inAcceptance)),
-mCallBackRoutine (inCallBackRoutine) {
+static inline void restoreInterrupts (const uint32_t inPrimask) {
+  __asm__ volatile ("msr primask, %0" : : "r" (inPrimask) : "memory") ;
 }
 
+//----------------------------------------------------------------------------------------
+//    Time synchronization frames (data byte 0 is the frame type)
+//      SYNC: type, sequence number (2 bytes)
+//      Follow up: type, sequence number, 0, 0, master micros () of SYNC (little endian)
 //----------------------------------------------------------------------------------------
 
-ACANSecondaryFilter::ACANSecondaryFilter (const tFrameKind inKind,
-                                          const tFrameFormat inFormat,
-                                          const uint32_t inIdentifier,
-                                          const ACANCallBackRoutine inCallBackRoutine) :
-mSingleAcceptanceFilter (computeAcceptanceFilter (inKind, inFormat, defaultMask (inFormat), inIdentifier)),
-mCallBackRoutine (inCallBackRoutine) {
-}
+static const uint8_t kTimeSyncFrameType = 0x10 ;
+static const uint8_t kTimeSyncFollowUpFrameType = 0x18 ;
 
 //----------------------------------------------------------------------------------------
 //    FlexCAN Mailboxes configuration
 //----------------------------------------------------------------------------------------
 
 static const int MB_COUNT = 16 ; // MB count is fixed by hardware
+static const uint32_t RX_FIFO_DEPTH = 6 ; // RxFIFO frame count is fixed by hardware
 
 //----------------------------------------------------------------------------------------
 // FlexCAN is configured for FIFO reception (MCR.FEN bit is set)
@@ -277,6 +276,134 @@ static inline size_t totalFilterCountForConfiguration (const ACANSettings::tConf
   return 8 + 8 * (size_t) inConfiguration ;
 }
 
+//----------------------------------------------------------------------------------------
+//    FlexCAN modules
+//----------------------------------------------------------------------------------------
+// Everything that depends on the FlexCAN module (IRQ number, clock gate, pins) is a
+// compile time constant of FlexcanModule <FLEXCAN_BASE>. The message interrupt service
+// routine and the register access routines are specialized for each module.
+
+static inline uint32_t txPinConfiguration (const ACANSettings & inSettings) {
+  return
+    PORT_PCR_MUX(2) | // Select function #2
+    (inSettings.mTxPinIsOpenCollector ? PORT_PCR_ODE : 0) // Open collector ?
+  ;
+}
+
+//······················································································································
+
+static inline uint32_t rxPinConfiguration (const ACANSettings & inSettings) {
+  return
+    PORT_PCR_MUX(2) | // Select function #2
+    (inSettings.mRxPinHasInternalPullUp ? (PORT_PCR_PE | PORT_PCR_PS) : 0) // Internal pullup ?
+  ;
+}
+
+//······················································································································
+
+template <uint32_t FLEXCAN_BASE> class FlexcanModule ;
+
+//······················································································································
+
+template <> class FlexcanModule <FLEXCAN0_BASE> {
+  #if defined(__MK20DX256__)
+    public: static const uint32_t kMessageIRQ = IRQ_CAN_MESSAGE ; // Teensy 3.1 / 3.2
+  #else
+    public: static const uint32_t kMessageIRQ = IRQ_CAN0_MESSAGE ; // Teensy 3.5, 3.6
+  #endif
+
+  public: static inline void enableClock (void) {
+    SIM_SCGC6 |= SIM_SCGC6_FLEXCAN0 ;
+  }
+
+  public: static inline uint32_t configurePins (const ACANSettings & inSettings) {
+    #if defined(__MK20DX256__) // Teensy 3.1 / 3.2
+    //  3=PTA12=CAN0_TX,  4=PTA13=CAN0_RX (default)
+    // 32=PTB18=CAN0_TX, 25=PTB19=CAN0_RX (alternative)
+      if (inSettings.mUseAlternateTxPin) {
+        CORE_PIN32_CONFIG = txPinConfiguration (inSettings) ;
+      }else{
+        CORE_PIN3_CONFIG = txPinConfiguration (inSettings) ;
+      }
+      if (inSettings.mUseAlternateRxPin) {
+        CORE_PIN25_CONFIG = rxPinConfiguration (inSettings) ;
+      }else{
+        CORE_PIN4_CONFIG = rxPinConfiguration (inSettings) ;
+      }
+    #else // Teensy 3.5, 3.6
+    //  3=PTA12=CAN0_TX,  4=PTA13=CAN0_RX (default)
+    // 29=PTB18=CAN0_TX, 30=PTB19=CAN0_RX (alternative)
+      if (inSettings.mUseAlternateTxPin) {
+        CORE_PIN29_CONFIG = txPinConfiguration (inSettings) ;
+      }else{
+        CORE_PIN3_CONFIG = txPinConfiguration (inSettings) ;
+      }
+      if (inSettings.mUseAlternateRxPin) {
+        CORE_PIN30_CONFIG = rxPinConfiguration (inSettings) ;
+      }else{
+        CORE_PIN4_CONFIG = rxPinConfiguration (inSettings) ;
+      }
+    #endif
+    return 0 ; // No error
+  }
+} ;
+
+//······················································································································
+
+#ifdef __MK66FX1M0__
+  template <> class FlexcanModule <FLEXCAN1_BASE> {
+    public: static const uint32_t kMessageIRQ = IRQ_CAN1_MESSAGE ;
+
+    public: static inline void enableClock (void) {
+      SIM_SCGC3 |= SIM_SCGC3_FLEXCAN1 ;
+    }
+
+    public: static inline uint32_t configurePins (const ACANSettings & inSettings) {
+    // 33=PTE24=CAN1_TX, 34=PTE25=CAN1_RX (default)
+      CORE_PIN33_CONFIG = txPinConfiguration (inSettings) ;
+      CORE_PIN34_CONFIG = rxPinConfiguration (inSettings) ;
+      uint32_t errorCode = 0 ;
+      if (inSettings.mUseAlternateTxPin) {
+        errorCode |= ACAN::kNoAlternateTxPinForCan1 ; // Error
+      }
+      if (inSettings.mUseAlternateRxPin) {
+        errorCode |= ACAN::kNoAlternateRxPinForCan1 ; // Error
+      }
+      return errorCode ;
+    }
+  } ;
+#endif
+
+//······················································································································
+// Runtime selection of the module, for non time critical code. Teensy 3.1, 3.2 and 3.5
+// have a single module: the base address is a constant.
+
+#ifdef __MK66FX1M0__
+  #define FLEXCAN_MODULE(b, call) (((b) == FLEXCAN0_BASE) ? FlexcanModule <FLEXCAN0_BASE>::call : FlexcanModule <FLEXCAN1_BASE>::call)
+#else
+  #define FLEXCAN_MODULE(b, call) (FlexcanModule <FLEXCAN0_BASE>::call)
+#endif
+
+//······················································································································
+// Interrupt coalescing backstop timer: triggers the message interrupt if frames are waiting
+// in the RxFIFO (the frame available interrupt is disabled)
+
+template <uint32_t FLEXCAN_BASE> static void coalescingTimerISR (void) {
+  if ((FLEXCANb_IFLAG1 (FLEXCAN_BASE) & (1 << 5)) != 0) {
+    NVIC_SET_PENDING (FlexcanModule <FLEXCAN_BASE>::kMessageIRQ) ;
+  }
+}
+
+//······················································································································
+
+static inline uint32_t flexcanBase (const uint32_t inFlexcanBaseAddress) {
+  #ifdef __MK66FX1M0__
+    return inFlexcanBaseAddress ;
+  #else
+    return FLEXCAN0_BASE ;
+  #endif
+}
+
 //----------------------------------------------------------------------------------------
 //    Constructor
 //----------------------------------------------------------------------------------------
@@ -290,37 +417,210 @@ mFlexcanBaseAddress (inFlexcanBaseAddress) {
 //----------------------------------------------------------------------------------------
 
 void ACAN::end (void) {
-//--- Disable interrupts
-  #if defined(__MK20DX256__)
-    NVIC_DISABLE_IRQ (IRQ_CAN_MESSAGE);  // Teensy 3.1 / 3.2
-  #elif defined(__MK64FX512__)
-    NVIC_DISABLE_IRQ (IRQ_CAN0_MESSAGE);  // Teensy 3.5
-  #elif defined(__MK66FX1M0__)
-    if(mFlexcanBaseAddress == FLEXCAN0_BASE) {
-      NVIC_DISABLE_IRQ (IRQ_CAN0_MESSAGE);  // Teensy 3.6, Can 0
-    }else{
-      NVIC_DISABLE_IRQ (IRQ_CAN1_MESSAGE); // Teensy 3.6, Can 1
-    }
+//--- Stop gateway
+  #ifdef __MK66FX1M0__
+    setGatewayRoutes (nullptr, nullptr, 0) ;
   #endif
+//--- Stop interrupt coalescing timer
+  if (nullptr != mCoalescingTimer) {
+    mCoalescingTimer->end () ;
+    delete mCoalescingTimer ; mCoalescingTimer = nullptr ;
+  }
+//--- Stop time triggered transmission, time synchronization
+  endTimeTriggeredTransmit () ;
+  mTimeSyncRole = kTimeSyncOff ;
+  mTimeSynchronized = false ;
+  mGlobalTimeOffsetMicros = 0 ;
+//--- Disable interrupts
+  const uint32_t base = flexcanBase (mFlexcanBaseAddress) ;
+  NVIC_DISABLE_IRQ (FLEXCAN_MODULE (base, kMessageIRQ)) ;
 //--- Enter freeze mode
-  FLEXCANb_MCR (mFlexcanBaseAddress) |= (FLEXCAN_MCR_HALT);
-  while (!(FLEXCANb_MCR (mFlexcanBaseAddress) & FLEXCAN_MCR_FRZ_ACK)) ;
-//--- Free receive buffer
-  delete [] mReceiveBuffer ; mReceiveBuffer = nullptr ;
+  FLEXCANb_MCR (base) |= (FLEXCAN_MCR_HALT);
+  while (!(FLEXCANb_MCR (base) & FLEXCAN_MCR_FRZ_ACK)) ;
+//--- Free receive buffers
+  for (uint32_t i=0 ; i<ACANSettings::kReceiveClassCount ; i++) {
+    delete [] mReceiveQueue [i].mBuffer ;
+    #if ACAN_INSTRUMENTATION
+      delete [] mReceiveQueue [i].mEntryCycles ;
+    #endif
+    mReceiveQueue [i] = ReceiveQueue () ;
+  }
   mReceiveBufferSize = 0 ;
-  mReceiveBufferReadIndex = 0 ;
   mReceiveBufferCount = 0 ;
   mReceiveBufferPeakCount = 0 ;
   mFlexcanRxFIFOFlags = 0 ;
+  mReceiveBufferAboveHighWatermark = false ;
+  mReceiveBufferDroppedCount = 0 ;
 //--- Free transmit buffer
-  delete [] mTransmitBuffer ; mTransmitBuffer = nullptr ;
-  mTransmitBufferSize = 0 ;
-  mTransmitBufferReadIndex = 0 ;
-  mTransmitBufferCount = 0 ;
-  mTransmitBufferPeakCount = 0 ;
+  mTransmitQueue.deallocate () ;
+  #if ACAN_INSTRUMENTATION
+    resetHistograms () ;
+  #endif
+  mTransmitTimeoutCount = 0 ;
+  mTransmitFlushedCount = 0 ;
+  setTransmitRateLimits (nullptr, 0) ;
+  mBusShareBucket = TokenBucket () ;
+  mTransmitRateLimitedCount = 0 ;
+  mTransmitBusShareLimitedCount = 0 ;
+  mRemoteResponderCount = 0 ;
+  mFalseAcceptCount = 0 ;
+  mMessageInterruptCount = 0 ;
+  mPollCount = 0 ;
+  mReceivedFrameCount = 0 ;
 //--- Free callback function array
- delete [] mCallBackFunctionArray ; mCallBackFunctionArray = nullptr ;
- mCallBackFunctionArraySize = 0 ;
+ freeFilterTables () ;
+ mSuppressedFrameCount = 0 ;
+}
+
+//----------------------------------------------------------------------------------------
+//    Filter tables
+//----------------------------------------------------------------------------------------
+
+void ACAN::freeFilterTables (void) {
+  delete [] mCallBackFunctionArray ; mCallBackFunctionArray = nullptr ;
+  if (nullptr != mFilterStatisticsArray) {
+    for (uint32_t i=0 ; i<mCallBackFunctionArraySize ; i++) {
+      delete [] mFilterStatisticsArray [i].mIntendedIdentifiers ;
+    }
+  }
+  delete [] mFilterStatisticsArray ; mFilterStatisticsArray = nullptr ;
+  delete [] mFilterReceiveClassArray ; mFilterReceiveClassArray = nullptr ;
+  delete [] mChangeDetectorArray ; mChangeDetectorArray = nullptr ;
+  mCallBackFunctionArraySize = 0 ;
+}
+
+//----------------------------------------------------------------------------------------
+// Filter counts are valid (at most the maximum count of the configuration)
+
+void ACAN::installFilterTables (const ACANPrimaryFilter inPrimaryFilters [],
+                                const uint32_t primaryFilterCount,
+                                const ACANSecondaryFilter inSecondaryFilters [],
+                                const uint32_t secondaryFilterCount) {
+  mCallBackFunctionArraySize = primaryFilterCount + secondaryFilterCount ;
+  if (mCallBackFunctionArraySize > 0) {
+    mCallBackFunctionArray = new ACANCallBackRoutine [mCallBackFunctionArraySize] ;
+    for (uint32_t i=0 ; i<primaryFilterCount ; i++) {
+      mCallBackFunctionArray [i] = inPrimaryFilters [i].mCallBackRoutine ;
+    }
+    for (uint32_t i=0 ; i<secondaryFilterCount ; i++) {
+      mCallBackFunctionArray [i + primaryFilterCount] = inSecondaryFilters [i].mCallBackRoutine ;
+    }
+  //--- Statistics; intended identifiers are sorted for binary search
+    mFilterStatisticsArray = new FilterStatistics [mCallBackFunctionArraySize] ;
+    for (uint32_t i=0 ; i<primaryFilterCount ; i++) {
+      const uint32_t count = inPrimaryFilters [i].mIntendedIdentifierCount ;
+      if (count > 0) {
+        uint32_t * identifiers = new uint32_t [count] ;
+        for (uint32_t j=0 ; j<count ; j++) {
+          const uint32_t identifier = inPrimaryFilters [i].mIntendedIdentifiers [j] ;
+          uint32_t k = j ;
+          while ((k > 0) && (identifiers [k-1] > identifier)) {
+            identifiers [k] = identifiers [k-1] ;
+            k -= 1 ;
+          }
+          identifiers [k] = identifier ;
+        }
+        mFilterStatisticsArray [i].mIntendedIdentifiers = identifiers ;
+        mFilterStatisticsArray [i].mIntendedIdentifierCount = count ;
+      }
+    }
+  //--- Receive class of each filter; a class without buffer is replaced by the normal class
+    mFilterReceiveClassArray = new uint8_t [mCallBackFunctionArraySize] ;
+    for (uint32_t i=0 ; i<mCallBackFunctionArraySize ; i++) {
+      const ACANSettings::tReceiveClass receiveClass = (i < primaryFilterCount)
+        ? inPrimaryFilters [i].mReceiveClass
+        : inSecondaryFilters [i - primaryFilterCount].mReceiveClass
+      ;
+      mFilterReceiveClassArray [i] = (mReceiveQueue [receiveClass].mSize > 0)
+        ? receiveClass
+        : ACANSettings::kReceiveClassNormal
+      ;
+    }
+  //--- On change only filters
+    bool hasOnChangeOnlyFilter = false ;
+    for (uint32_t i=0 ; i<primaryFilterCount ; i++) {
+      hasOnChangeOnlyFilter |= inPrimaryFilters [i].mOnChangeOnly ;
+    }
+    for (uint32_t i=0 ; i<secondaryFilterCount ; i++) {
+      hasOnChangeOnlyFilter |= inSecondaryFilters [i].mOnChangeOnly ;
+    }
+    if (hasOnChangeOnlyFilter) {
+      mChangeDetectorArray = new ChangeDetector [mCallBackFunctionArraySize] ;
+      for (uint32_t i=0 ; i<primaryFilterCount ; i++) {
+        mChangeDetectorArray [i].mEnabled = inPrimaryFilters [i].mOnChangeOnly ;
+        mChangeDetectorArray [i].mHeartbeatMillis = inPrimaryFilters [i].mHeartbeatMillis ;
+      }
+      for (uint32_t i=0 ; i<secondaryFilterCount ; i++) {
+        mChangeDetectorArray [i + primaryFilterCount].mEnabled = inSecondaryFilters [i].mOnChangeOnly ;
+        mChangeDetectorArray [i + primaryFilterCount].mHeartbeatMillis = inSecondaryFilters [i].mHeartbeatMillis ;
+      }
+    }
+  }
+}
+
+//----------------------------------------------------------------------------------------
+// Called in freeze mode; returns an error code
+
+uint32_t ACAN::writeFilterRegisters (const uint32_t inFlexcanBase,
+                                     const ACANSettings::tConfiguration inConfiguration,
+                                     const ACANPrimaryFilter inPrimaryFilters [],
+                                     const uint32_t inPrimaryFilterCount,
+                                     const ACANSecondaryFilter inSecondaryFilters [],
+                                     const uint32_t inSecondaryFilterCount) {
+  uint32_t errorCode = 0 ;
+  const uint32_t MAX_PRIMARY_FILTER_COUNT = primaryFilterCountForConfiguration (inConfiguration) ;
+  const uint32_t MAX_SECONDARY_FILTER_COUNT = secondaryFilterCountForConfiguration (inConfiguration) ;
+  const uint32_t TOTAL_FILTER_COUNT = totalFilterCountForConfiguration (inConfiguration) ;
+  const uint32_t primaryFilterCount = imin (inPrimaryFilterCount, MAX_PRIMARY_FILTER_COUNT) ;
+  const uint32_t secondaryFilterCount = imin (inSecondaryFilterCount, MAX_SECONDARY_FILTER_COUNT) ;
+//--- Default mask
+  uint32_t defaultFilterMask = 0 ; // By default, accept any frame
+  uint32_t defaultAcceptanceFilter = 0 ;
+  if (inPrimaryFilterCount > 0) {
+    defaultFilterMask = inPrimaryFilters [0].mFilterMask ;
+    defaultAcceptanceFilter = inPrimaryFilters [0].mAcceptanceFilter ;
+  }else if (inSecondaryFilterCount > 0) {
+    defaultFilterMask = ~1 ;
+    defaultAcceptanceFilter = inSecondaryFilters [0].mSingleAcceptanceFilter ;
+  }
+//--- Setup primary filters (individual filters in FlexCAN vocabulary)
+  if (inPrimaryFilterCount > MAX_PRIMARY_FILTER_COUNT) {
+    errorCode |= kTooMuchPrimaryFilters ; // Error, too much primary filters
+  }
+  mActualPrimaryFilterCount = (uint8_t) primaryFilterCount ;
+  mMaxPrimaryFilterCount = (uint8_t) MAX_PRIMARY_FILTER_COUNT ;
+  for (uint32_t i=0 ; i<primaryFilterCount ; i++) {
+    const uint32_t mask = inPrimaryFilters [i].mFilterMask ;
+    const uint32_t acceptance = inPrimaryFilters [i].mAcceptanceFilter ;
+    FLEXCANb_MB_MASK (inFlexcanBase, i) = mask ;
+    FLEXCANb_IDAF (inFlexcanBase, i) = acceptance ;
+    if ((acceptance & 1) != 0) {
+      errorCode |= kNotConformPrimaryFilter ;
+    }
+  }
+  for (uint32_t i = primaryFilterCount ; i<MAX_PRIMARY_FILTER_COUNT ; i++) {
+    FLEXCANb_MB_MASK (inFlexcanBase, i) = defaultFilterMask ;
+    FLEXCANb_IDAF (inFlexcanBase, i) = defaultAcceptanceFilter ;
+  }
+//--- Setup secondary filters (filter mask for Rx individual acceptance filter)
+  FLEXCANb_RXFGMASK (inFlexcanBase) = (inSecondaryFilterCount > 0) ? (~1) : defaultFilterMask ;
+  if (inSecondaryFilterCount > MAX_SECONDARY_FILTER_COUNT) {
+    errorCode |= kTooMuchSecondaryFilters ;
+  }
+  for (uint32_t i=0 ; i<secondaryFilterCount ; i++) {
+    const uint32_t acceptance = inSecondaryFilters [i].mSingleAcceptanceFilter ;
+    FLEXCANb_IDAF (inFlexcanBase, i + MAX_PRIMARY_FILTER_COUNT) = acceptance ;
+    if ((acceptance & 1) != 0) { // Bit 0 is the error flag
+      errorCode |= kNotConformSecondaryFilter ;
+    }
+  }
+  for (uint32_t i=MAX_PRIMARY_FILTER_COUNT + secondaryFilterCount ; i<TOTAL_FILTER_COUNT ; i++) {
+    FLEXCANb_IDAF (inFlexcanBase, i) = (inSecondaryFilterCount > 0)
+      ? inSecondaryFilters [0].mSingleAcceptanceFilter
+      : defaultAcceptanceFilter
+    ;
+  }
+  return errorCode ;
 }
 
 //----------------------------------------------------------------------------------------
@@ -338,123 +638,70 @@ uint32_t ACAN::begin (const ACANSettings & inSettings,
     errorCode |= kCANBitConfiguration ;
   }
   if (0 == errorCode) {
-  //---------- Allocate receive buffer
-    mReceiveBufferSize = inSettings.mReceiveBufferSize ;
-    mReceiveBuffer = new CANMessage [inSettings.mReceiveBufferSize] ;
+  //---------- Allocate receive buffers
+    const uint32_t receiveBufferSizes [ACANSettings::kReceiveClassCount] = {
+      inSettings.mHighReceiveBufferSize,
+      inSettings.mReceiveBufferSize,
+      inSettings.mBulkReceiveBufferSize
+    } ;
+    for (uint32_t i=0 ; i<ACANSettings::kReceiveClassCount ; i++) {
+      mReceiveQueue [i].mSize = receiveBufferSizes [i] ;
+      mReceiveQueue [i].mBuffer = new CANMessage [receiveBufferSizes [i]] ;
+      #if ACAN_INSTRUMENTATION
+        mReceiveQueue [i].mEntryCycles = new uint32_t [receiveBufferSizes [i]] ;
+      #endif
+    }
+    mReceiveBufferSize = inSettings.mHighReceiveBufferSize + inSettings.mReceiveBufferSize + inSettings.mBulkReceiveBufferSize ;
+    mReceiveBufferHighWatermark = imin ((uint32_t) inSettings.mReceiveBufferHighWatermark, (uint32_t) mReceiveBufferSize) ;
+    mReceiveBufferLowWatermark = imin (inSettings.mReceiveBufferLowWatermark, inSettings.mReceiveBufferHighWatermark) ;
+    mReceiveOverflowPolicy = inSettings.mReceiveOverflowPolicy ;
   //---------- Allocate transmit buffer
-    mTransmitBufferSize = inSettings.mTransmitBufferSize ;
-    mTransmitBuffer = new CANMessage [inSettings.mTransmitBufferSize] ;
+    mTransmitQueue.allocate (inSettings.mTransmitBufferSize) ;
+    #if ACAN_INSTRUMENTATION
+    //--- Enable the cycle counter
+      ARM_DEMCR |= ARM_DEMCR_TRCENA ;
+      ARM_DWT_CTRL |= ARM_DWT_CTRL_CYCCNTENA ;
+    #endif
+    mActualBitRate = inSettings.actualBitRate () ;
+    mMicrosPerBitQ8 = (256U * 1000U * 1000U + mActualBitRate / 2) / mActualBitRate ;
+    mMessageIRQPriority = inSettings.mMessageIRQPriority ;
+    mTransmitTimeoutMillis = inSettings.mTransmitTimeoutMillis ;
+    mFlushTransmitBufferOnTimeout = inSettings.mFlushTransmitBufferOnTimeout ;
   //---------- Filter count
     const uint32_t MAX_PRIMARY_FILTER_COUNT = primaryFilterCountForConfiguration (inSettings.mConfiguration) ;
     const uint32_t MAX_SECONDARY_FILTER_COUNT = secondaryFilterCountForConfiguration (inSettings.mConfiguration) ;
     const uint32_t primaryFilterCount = imin (inPrimaryFilterCount, MAX_PRIMARY_FILTER_COUNT) ;
     const uint32_t secondaryFilterCount = imin (inSecondaryFilterCount, MAX_SECONDARY_FILTER_COUNT) ;
-  //---------- Allocate call back function array
-    mCallBackFunctionArraySize = primaryFilterCount + secondaryFilterCount ;
-    if (mCallBackFunctionArraySize > 0) {
-      mCallBackFunctionArray = new ACANCallBackRoutine [mCallBackFunctionArraySize] ;
-      for (uint32_t i=0 ; i<primaryFilterCount ; i++) {
-        mCallBackFunctionArray [i] = inPrimaryFilters [i].mCallBackRoutine ;
-      }
-      for (uint32_t i=0 ; i<secondaryFilterCount ; i++) {
-        mCallBackFunctionArray [i + primaryFilterCount] = inSecondaryFilters [i].mCallBackRoutine ;
-      }
-    }
+  //---------- Filter tables
+    installFilterTables (inPrimaryFilters, primaryFilterCount, inSecondaryFilters, secondaryFilterCount) ;
   //---------- Set up the pins
-    const uint32_t TxPinConfiguration =
-      PORT_PCR_MUX(2) | // Select function #2
-      (inSettings.mTxPinIsOpenCollector ? PORT_PCR_ODE : 0) // Open collector ?
-    ;
-    const uint32_t RxPinConfiguration =
-      PORT_PCR_MUX(2) | // Select function #2
-      (inSettings.mRxPinHasInternalPullUp ? (PORT_PCR_PE | PORT_PCR_PS) : 0) // Internal pullup ?
-    ;
-    #if defined(__MK20DX256__) // Teensy 3.1 / 3.2
-    //  3=PTA12=CAN0_TX,  4=PTA13=CAN0_RX (default)
-    // 32=PTB18=CAN0_TX, 25=PTB19=CAN0_RX (alternative)
-      if (inSettings.mUseAlternateTxPin) {
-        CORE_PIN32_CONFIG = TxPinConfiguration ;
-      }else{
-        CORE_PIN3_CONFIG = TxPinConfiguration ;
-      }
-      if (inSettings.mUseAlternateRxPin) {
-        CORE_PIN25_CONFIG = RxPinConfiguration ;
-      }else{
-        CORE_PIN4_CONFIG = RxPinConfiguration ;
-      }
-    #elif defined(__MK64FX512__) // Teensy 3.5
-    //  3=PTA12=CAN0_TX,  4=PTA13=CAN0_RX (default)
-    // 29=PTB18=CAN0_TX, 30=PTB19=CAN0_RX (alternative)
-      if (inSettings.mUseAlternateTxPin) {
-        CORE_PIN29_CONFIG = TxPinConfiguration ;
-      }else{
-        CORE_PIN3_CONFIG = TxPinConfiguration ;
-      }
-      if (inSettings.mUseAlternateRxPin) {
-        CORE_PIN30_CONFIG = RxPinConfiguration ;
-      }else{
-        CORE_PIN4_CONFIG = RxPinConfiguration ;
-      }
-    #elif defined(__MK66FX1M0__) // Teensy 3.6
-      if (mFlexcanBaseAddress == FLEXCAN0_BASE) { // aCan0
-      //  3=PTA12=CAN0_TX,  4=PTA13=CAN0_RX (default)
-      // 29=PTB18=CAN0_TX, 30=PTB19=CAN0_RX (alternative)
-        if (inSettings.mUseAlternateTxPin) {
-          CORE_PIN29_CONFIG = TxPinConfiguration ;
-        }else{
-          CORE_PIN3_CONFIG = TxPinConfiguration ;
-        }
-        if (inSettings.mUseAlternateRxPin) {
-          CORE_PIN30_CONFIG = RxPinConfiguration ;
-        }else{
-          CORE_PIN4_CONFIG = RxPinConfiguration ;
-        }
-      }else{ // Can1
-      // 33=PTE24=CAN1_TX, 34=PTE25=CAN1_RX (default)
-        CORE_PIN33_CONFIG = TxPinConfiguration ;
-        CORE_PIN34_CONFIG = RxPinConfiguration ;
-        if (inSettings.mUseAlternateTxPin) {
-          errorCode |= kNoAlternateTxPinForCan1 ; // Error
-        }
-        if (inSettings.mUseAlternateRxPin) {
-          errorCode |= kNoAlternateRxPinForCan1 ; // Error
-        }
-      }
-    #endif
+    const uint32_t base = flexcanBase (mFlexcanBaseAddress) ;
+    errorCode |= FLEXCAN_MODULE (base, configurePins (inSettings)) ;
   //---------- Power on FlexCAN module, select clock source 16MHz xtal
     OSC0_CR |= OSC_ERCLKEN ; // Enables external reference clock (§28.8.1.1)
-    #if defined(__MK20DX256__)
-      SIM_SCGC6 |= SIM_SCGC6_FLEXCAN0 ; // Teensy 3.1 / 3.2
-    #elif defined(__MK64FX512__)
-      SIM_SCGC6 |= SIM_SCGC6_FLEXCAN0 ; // Teensy 3.5
-    #elif defined(__MK66FX1M0__)
-      if (mFlexcanBaseAddress == FLEXCAN0_BASE) { // Teensy 3.6, Can 0
-        SIM_SCGC6 |= SIM_SCGC6_FLEXCAN0 ;
-      }else{  // Teensy 3.6, Can 1
-        SIM_SCGC3 |= SIM_SCGC3_FLEXCAN1 ;
-      }
-    #endif
-    FLEXCANb_CTRL1 (mFlexcanBaseAddress) &= ~FLEXCAN_CTRL_CLK_SRC; // Use oscillator clock (16 MHz)
+    FLEXCAN_MODULE (base, enableClock ()) ;
+    FLEXCANb_CTRL1 (base) &= ~FLEXCAN_CTRL_CLK_SRC; // Use oscillator clock (16 MHz)
   //---------- Enable CAN
-    FLEXCANb_MCR (mFlexcanBaseAddress) =
+    FLEXCANb_MCR (base) =
       (1 << 30) | // Enable to enter to freeze mode
       (1 << 23) | // FlexCAN is in supervisor mode
       (15 << 0)   // 16 MB
     ;
-    while (FLEXCANb_MCR(mFlexcanBaseAddress) & FLEXCAN_MCR_LPM_ACK) {}
+    while (FLEXCANb_MCR (base) & FLEXCAN_MCR_LPM_ACK) {}
   //---------- Soft reset
-    FLEXCANb_MCR(mFlexcanBaseAddress) |= FLEXCAN_MCR_SOFT_RST;
-    while (FLEXCANb_MCR(mFlexcanBaseAddress) & FLEXCAN_MCR_SOFT_RST) {}
+    FLEXCANb_MCR (base) |= FLEXCAN_MCR_SOFT_RST;
+    while (FLEXCANb_MCR (base) & FLEXCAN_MCR_SOFT_RST) {}
   //---------- Wait for freeze ack
-    while (!(FLEXCANb_MCR(mFlexcanBaseAddress) & FLEXCAN_MCR_FRZ_ACK)) {}
+    while (!(FLEXCANb_MCR (base) & FLEXCAN_MCR_FRZ_ACK)) {}
   //---------- Can settings
-    FLEXCANb_MCR (mFlexcanBaseAddress) |=
+    FLEXCANb_MCR (base) |=
       (inSettings.mSelfReceptionMode ? 0 : FLEXCAN_MCR_SRX_DIS) | // Disable self-reception ?
       FLEXCAN_MCR_FEN  | // Set RxFIFO mode
-      FLEXCAN_MCR_IRMQ   // Enable per-mailbox filtering (§56.4.2)
+      FLEXCAN_MCR_IRMQ | // Enable per-mailbox filtering (§56.4.2)
+      FLEXCAN_MCR_AEN    // Enable transmission abort (transmit watchdog)
     ;
   //---------- Can bit timing (CTRL1)
-    FLEXCANb_CTRL1 (mFlexcanBaseAddress) =
+    FLEXCANb_CTRL1 (base) =
       FLEXCAN_CTRL_PROPSEG (inSettings.mPropagationSegment - 1) |
       FLEXCAN_CTRL_RJW (inSettings.mRJW - 1) |
       FLEXCAN_CTRL_PSEG1 (inSettings.mPhaseSegment1 - 1) |
@@ -466,9 +713,8 @@ uint32_t ACAN::begin (const ACANSettings & inSettings,
     ;
   //---------- FIFO configuration
     const uint32_t RFFN = RFFNForConfiguration (inSettings.mConfiguration) ;
-    const uint32_t TOTAL_FILTER_COUNT = totalFilterCountForConfiguration (inSettings.mConfiguration) ;
   //---------- CTRL2
-    FLEXCANb_CTRL2 (mFlexcanBaseAddress) =
+    FLEXCANb_CTRL2 (base) =
       (RFFN << 24) | // Number of RxFIFO
       (0x16 << 19) | // TASD: 0x16 is the default value
       (   0 << 18) | // MRP: Matching starts from RxFIFO and continues on mailboxes
@@ -476,87 +722,54 @@ uint32_t ACAN::begin (const ACANSettings & inSettings,
       (   1 << 16)   // EACEN: RTR bit in mask is always compared
     ;
   //---------- Setup RxFIFO filters
-  //--- Default mask
-    uint32_t defaultFilterMask = 0 ; // By default, accept any frame
-    uint32_t defaultAcceptanceFilter = 0 ;
-    if (inPrimaryFilterCount > 0) {
-      defaultFilterMask = inPrimaryFilters [0].mFilterMask ;
-      defaultAcceptanceFilter = inPrimaryFilters [0].mAcceptanceFilter ;
-    }else if (inSecondaryFilterCount > 0) {
-      defaultFilterMask = ~1 ;
-      defaultAcceptanceFilter = inSecondaryFilters [0].mSingleAcceptanceFilter ;
-    }
-  //--- Setup primary filters (individual filters in FlexCAN vocabulary)
-    if (inPrimaryFilterCount > MAX_PRIMARY_FILTER_COUNT) {
-      errorCode |= kTooMuchPrimaryFilters ; // Error, too much primary filters
-    }
-    mActualPrimaryFilterCount = (uint8_t) primaryFilterCount ;
-    mMaxPrimaryFilterCount = (uint8_t) MAX_PRIMARY_FILTER_COUNT ;
-    for (uint32_t i=0 ; i<primaryFilterCount ; i++) {
-      const uint32_t mask = inPrimaryFilters [i].mFilterMask ;
-      const uint32_t acceptance = inPrimaryFilters [i].mAcceptanceFilter ;
-      FLEXCANb_MB_MASK (mFlexcanBaseAddress, i) = mask ;
-      FLEXCANb_IDAF (mFlexcanBaseAddress, i) = acceptance ;
-      if ((acceptance & 1) != 0) {
-        errorCode |= kNotConformPrimaryFilter ;
-      }
-    }
-    for (uint32_t i = primaryFilterCount ; i<MAX_PRIMARY_FILTER_COUNT ; i++) {
-      FLEXCANb_MB_MASK (mFlexcanBaseAddress, i) = defaultFilterMask ;
-      FLEXCANb_IDAF (mFlexcanBaseAddress, i) = defaultAcceptanceFilter ;
-    }
-  //--- Setup secondary filters (filter mask for Rx individual acceptance filter)
-    FLEXCANb_RXFGMASK (mFlexcanBaseAddress) = (inSecondaryFilterCount > 0) ? (~1) : defaultFilterMask ;
-    if (inSecondaryFilterCount > MAX_SECONDARY_FILTER_COUNT) {
-      errorCode |= kTooMuchSecondaryFilters ;
-    }
-    for (uint32_t i=0 ; i<secondaryFilterCount ; i++) {
-      const uint32_t acceptance = inSecondaryFilters [i].mSingleAcceptanceFilter ;
-      FLEXCANb_IDAF (mFlexcanBaseAddress, i + MAX_PRIMARY_FILTER_COUNT) = acceptance ;
-      if ((acceptance & 1) != 0) { // Bit 0 is the error flag
-        errorCode |= kNotConformSecondaryFilter ;
-      }
-    }
-    for (uint32_t i=MAX_PRIMARY_FILTER_COUNT + secondaryFilterCount ; i<TOTAL_FILTER_COUNT ; i++) {
-      FLEXCANb_IDAF (mFlexcanBaseAddress, i) = (inSecondaryFilterCount > 0)
-        ? inSecondaryFilters [0].mSingleAcceptanceFilter
-        : defaultAcceptanceFilter
-      ;
-    }
-  //---------- Make all other MB inactive
+    errorCode |= writeFilterRegisters (base, inSettings.mConfiguration,
+                                       inPrimaryFilters, inPrimaryFilterCount,
+                                       inSecondaryFilters, inSecondaryFilterCount) ;
+    mConfiguration = inSettings.mConfiguration ;
+  //---------- Make all other MB inactive (no remote frame responder)
+    mRemoteResponderCount = 0 ;
     for (uint32_t i = MAX_PRIMARY_FILTER_COUNT ; i < MB_COUNT ; i++) {
-      FLEXCANb_MB_MASK (mFlexcanBaseAddress, i) = 0 ;
-      FLEXCANb_MBn_CS (mFlexcanBaseAddress, i) = FLEXCAN_MB_CS_CODE (FLEXCAN_MB_CODE_TX_INACTIVE) ;
+      FLEXCANb_MB_MASK (base, i) = 0 ;
+      FLEXCANb_MBn_CS (base, i) = FLEXCAN_MB_CS_CODE (FLEXCAN_MB_CODE_TX_INACTIVE) ;
     }
   //---------- Start CAN
-    FLEXCANb_MCR (mFlexcanBaseAddress) &= ~FLEXCAN_MCR_HALT ;
+    FLEXCANb_MCR (base) &= ~FLEXCAN_MCR_HALT ;
   //---------- Wait till exit of freeze mode
-    while (FLEXCANb_MCR (mFlexcanBaseAddress) & FLEXCAN_MCR_FRZ_ACK) {}
+    while (FLEXCANb_MCR (base) & FLEXCAN_MCR_FRZ_ACK) {}
   //----------  Wait till ready
-    while (FLEXCANb_MCR (mFlexcanBaseAddress) & FLEXCAN_MCR_NOT_RDY) {}
-  //---------- Enable NVIC interrupts
-    #if defined(__MK20DX256__)
-      NVIC_SET_PRIORITY (IRQ_CAN_MESSAGE, inSettings.mMessageIRQPriority) ; // Teensy 3.1 / 3.2
-      NVIC_ENABLE_IRQ (IRQ_CAN_MESSAGE);
-    #elif defined(__MK64FX512__)
-      NVIC_SET_PRIORITY (IRQ_CAN0_MESSAGE, inSettings.mMessageIRQPriority) ; // Teensy 3.5
-      NVIC_ENABLE_IRQ (IRQ_CAN0_MESSAGE);
-    #elif defined(__MK66FX1M0__)
-      if (mFlexcanBaseAddress == FLEXCAN0_BASE) { // Teensy 3.6, Can 0
-        NVIC_SET_PRIORITY (IRQ_CAN0_MESSAGE, inSettings.mMessageIRQPriority) ;
-        NVIC_ENABLE_IRQ (IRQ_CAN0_MESSAGE);
-      }else{  // Teensy 3.6, Can 1
-        NVIC_SET_PRIORITY (IRQ_CAN1_MESSAGE, inSettings.mMessageIRQPriority) ;
-        NVIC_ENABLE_IRQ (IRQ_CAN1_MESSAGE) ;
+    while (FLEXCANb_MCR (base) & FLEXCAN_MCR_NOT_RDY) {}
+  //---------- Interrupt coalescing: backstop timer, at the message interrupt priority
+    mPollingMode = inSettings.mPollingMode ;
+    mInterruptCoalescing = inSettings.mInterruptCoalescing && !mPollingMode ;
+    if (mInterruptCoalescing) {
+      #ifdef __MK66FX1M0__
+        void (* timerISR) (void) = (base == FLEXCAN0_BASE)
+          ? coalescingTimerISR <FLEXCAN0_BASE>
+          : coalescingTimerISR <FLEXCAN1_BASE>
+        ;
+      #else
+        void (* timerISR) (void) = coalescingTimerISR <FLEXCAN0_BASE> ;
+      #endif
+      mCoalescingTimer = new IntervalTimer () ;
+      mCoalescingTimer->priority (inSettings.mMessageIRQPriority) ;
+      mInterruptCoalescing = mCoalescingTimer->begin (timerISR, imax (inSettings.mCoalescingMaxLatencyMicros, (uint32_t) 10)) ;
+      if (!mInterruptCoalescing) {
+        errorCode |= kNoCoalescingTimer ;
+        delete mCoalescingTimer ; mCoalescingTimer = nullptr ;
       }
-    #endif
+    }
+  //---------- Enable NVIC interrupts (not in polling mode)
+    if (!mPollingMode) {
+      NVIC_SET_PRIORITY (FLEXCAN_MODULE (base, kMessageIRQ), inSettings.mMessageIRQPriority) ;
+      NVIC_ENABLE_IRQ (FLEXCAN_MODULE (base, kMessageIRQ)) ;
+    }
   //---------- Enable CAN interrupts (§56.4.10)
-    FLEXCANb_IMASK1 (mFlexcanBaseAddress) =
+    FLEXCANb_IMASK1 (base) = mPollingMode ? 0 : (
       (1 << 15) | // MB15 (data frame sending)
       (1 << 7) | // RxFIFO Overflow
       (1 << 6) | // RxFIFO Warning: number of messages in FIFO goes from 4 to 5
-      (1 << 5)   // Data available in RxFIFO
-    ;
+      (mInterruptCoalescing ? 0 : (1 << 5)) // Data available in RxFIFO
+    ) ;
   }
 //--- Return error code (0 --> no error)
   return errorCode ;
@@ -566,174 +779,935 @@ uint32_t ACAN::begin (const ACANSettings & inSettings,
 //   RECEPTION
 //----------------------------------------------------------------------------------------
 
+// Called with interrupts disabled
+
+void ACAN::releaseReceivedFrames (ReceiveQueue & ioQueue, const uint32_t inCount) {
+  ioQueue.mReadIndex = (ioQueue.mReadIndex + inCount) % ioQueue.mSize ;
+  ioQueue.mCount -= inCount ;
+  ioQueue.mPeekedCount = (ioQueue.mPeekedCount > inCount) ? (ioQueue.mPeekedCount - inCount) : 0 ;
+  mReceiveBufferCount -= inCount ;
+}
+
+//----------------------------------------------------------------------------------------
+
 bool ACAN::receive (CANMessage & outMessage) {
+  bool lowWatermarkReached = false ;
   noInterrupts () ;
     const bool hasMessage = mReceiveBufferCount > 0 ;
     if (hasMessage) {
-      outMessage = mReceiveBuffer [mReceiveBufferReadIndex] ;
-      mReceiveBufferReadIndex = (mReceiveBufferReadIndex + 1) % mReceiveBufferSize ;
-      mReceiveBufferCount -= 1 ;
+    //--- Highest non empty class first
+      uint32_t receiveClass = 0 ;
+      while (mReceiveQueue [receiveClass].mCount == 0) {
+        receiveClass += 1 ;
+      }
+      ReceiveQueue & queue = mReceiveQueue [receiveClass] ;
+      outMessage = queue.mBuffer [queue.mReadIndex] ;
+      #if ACAN_INSTRUMENTATION
+        mReceiveResidencyHistogram.record (acanCycleCount () - queue.mEntryCycles [queue.mReadIndex]) ;
+      #endif
+      releaseReceivedFrames (queue, 1) ;
+      lowWatermarkReached = mReceiveBufferAboveHighWatermark && (mReceiveBufferCount <= mReceiveBufferLowWatermark) ;
+      if (lowWatermarkReached) {
+        mReceiveBufferAboveHighWatermark = false ;
+      }
     }
   interrupts ()
+  if (lowWatermarkReached && (nullptr != mReceiveWatermarkCallBack)) {
+    mReceiveWatermarkCallBack (false) ;
+  }
   return hasMessage ;
 }
 
 //----------------------------------------------------------------------------------------
 
-bool ACAN::dispatchReceivedMessage (const tFilterMatchCallBack inFilterMatchCallBack) {
-  CANMessage receivedMessage ;
-  const bool hasReceived = receive (receivedMessage) ;
-  if (hasReceived) {
-    const uint32_t filterIndex = receivedMessage.idx ;
-    if (nullptr != inFilterMatchCallBack) {
-      inFilterMatchCallBack (filterIndex) ;
-    }
-    if (filterIndex < mCallBackFunctionArraySize) {
-      ACANCallBackRoutine callBackFunction = mCallBackFunctionArray [filterIndex] ;
-      if (nullptr != callBackFunction) {
-        callBackFunction (receivedMessage) ;
+uint32_t ACAN::peek (const CANMessage * & outMessages) {
+  uint32_t count = 0 ;
+  outMessages = nullptr ;
+  noInterrupts () ;
+    mReceiveQueue [mPeekedClass].mPeekedCount = 0 ; // Previous peek is cancelled
+    if (mReceiveBufferCount > 0) {
+    //--- Highest non empty class first
+      uint32_t receiveClass = 0 ;
+      while (mReceiveQueue [receiveClass].mCount == 0) {
+        receiveClass += 1 ;
       }
+      ReceiveQueue & queue = mReceiveQueue [receiveClass] ;
+    //--- Contiguous frames: up to the end of the ring
+      count = imin (queue.mCount, queue.mSize - queue.mReadIndex) ;
+      outMessages = & queue.mBuffer [queue.mReadIndex] ;
+      queue.mPeekedCount = count ;
+      mPeekedClass = receiveClass ;
     }
-  }
-  return hasReceived ;
+  interrupts ()
+  return count ;
 }
 
-//----------------------------------------------------------------------------------------
-//   EMISSION
 //----------------------------------------------------------------------------------------
 
-bool ACAN::tryToSend (const CANMessage & inMessage) {
-  const uint32_t firstTxMailBoxIndex = 15 ;
-  bool sent = false ;
-  if (inMessage.rtr) { // Remote
-    for (uint32_t index = mMaxPrimaryFilterCount ; (index < firstTxMailBoxIndex) && !sent ; index++) {
-      const uint32_t status = FLEXCAN_get_code (FLEXCANb_MBn_CS (mFlexcanBaseAddress, index)) ;
-      switch (status) {
-      case FLEXCAN_MB_CODE_TX_INACTIVE : // MB has never sent remote frame
-      case FLEXCAN_MB_CODE_TX_EMPTY : // MB has sent a remote frame
-      case FLEXCAN_MB_CODE_TX_FULL : // MB has sent a remote frame, and received a frame that did not pass any filter
-      case FLEXCAN_MB_CODE_TX_OVERRUN : // MB has sent a remote frame, and received several frames that did not pass any filter
-        writeTxRegisters (inMessage, index) ;
-        sent = true ;
-        break ;
-      default:
-        break ;
-      }
-    }
-  }else{ // Data
-    noInterrupts () ;
-    //--- Find an available mailbox
-    // Don't compete with the transmit buffer for an inactive mailbox (race condition)
-    // Bug fixed in 2.0.1, thanks to wangnick
-      if (mTransmitBufferCount == 0) {
-        for (uint32_t index = firstTxMailBoxIndex ; (index < MB_COUNT) && !sent ; index++) {
-          const uint32_t code = FLEXCAN_get_code (FLEXCANb_MBn_CS (mFlexcanBaseAddress, index)) ;
-          if (code == FLEXCAN_MB_CODE_TX_INACTIVE) {
-            writeTxRegisters (inMessage, index);
-            sent = true ;
-          }
-        }
-      }
-    //--- If no mailboxes available, try to buffer it
-      if (!sent) {
-        sent = mTransmitBufferCount < mTransmitBufferSize ;
-        if (sent) {
-          uint32_t transmitBufferWriteIndex = mTransmitBufferReadIndex + mTransmitBufferCount ;
-          if (transmitBufferWriteIndex >= mTransmitBufferSize) {
-            transmitBufferWriteIndex -= mTransmitBufferSize ;
-          }
-          mTransmitBuffer [transmitBufferWriteIndex] = inMessage ;
-          mTransmitBufferCount += 1 ;
-        //--- Update max count
-          if (mTransmitBufferPeakCount < mTransmitBufferCount) {
-            mTransmitBufferPeakCount = mTransmitBufferCount ;
-          }
-        }else{
-          mTransmitBufferPeakCount = mTransmitBufferSize + 1 ;
+void ACAN::consume (const uint32_t inCount) {
+  bool lowWatermarkReached = false ;
+  noInterrupts () ;
+    ReceiveQueue & queue = mReceiveQueue [mPeekedClass] ;
+    const uint32_t count = imin (inCount, (uint32_t) queue.mPeekedCount) ;
+    if (count > 0) {
+      #if ACAN_INSTRUMENTATION
+        const uint32_t now = acanCycleCount () ;
+        for (uint32_t i=0 ; i<count ; i++) {
+          mReceiveResidencyHistogram.record (now - queue.mEntryCycles [(queue.mReadIndex + i) % queue.mSize]) ;
         }
+      #endif
+      releaseReceivedFrames (queue, count) ;
+      lowWatermarkReached = mReceiveBufferAboveHighWatermark && (mReceiveBufferCount <= mReceiveBufferLowWatermark) ;
+      if (lowWatermarkReached) {
+        mReceiveBufferAboveHighWatermark = false ;
       }
-    interrupts () ;
+    }
+    queue.mPeekedCount = 0 ;
+  interrupts ()
+  if (lowWatermarkReached && (nullptr != mReceiveWatermarkCallBack)) {
+    mReceiveWatermarkCallBack (false) ;
   }
-//---
-  return sent ;
 }
 
 //----------------------------------------------------------------------------------------
 
-void ACAN::writeTxRegisters (const CANMessage & inMessage, const uint32_t inMBIndex) {
-//--- Make Tx box inactive
-  FLEXCANb_MBn_CS (mFlexcanBaseAddress, inMBIndex) = FLEXCAN_MB_CS_CODE (FLEXCAN_MB_CODE_TX_INACTIVE) ;
-//--- Write identifier
-  FLEXCANb_MBn_ID (mFlexcanBaseAddress, inMBIndex) = inMessage.ext
-    ? (inMessage.id & FLEXCAN_MB_ID_EXT_MASK)
-    : FLEXCAN_MB_ID_IDSTD (inMessage.id)
-  ;
-//--- Write data (registers are big endian, values should be swapped)
-  FLEXCANb_MBn_WORD0 (mFlexcanBaseAddress, inMBIndex) = __builtin_bswap32 (inMessage.data32 [0]) ;
-  FLEXCANb_MBn_WORD1 (mFlexcanBaseAddress, inMBIndex) = __builtin_bswap32 (inMessage.data32 [1]) ;
-//--- Send message
-  const uint8_t length = (inMessage.len <= 8) ? inMessage.len : 8 ;
-  uint32_t command = FLEXCAN_MB_CS_CODE (FLEXCAN_MB_CODE_TX_ONCE) | FLEXCAN_MB_CS_LENGTH (length) ;
-  if (inMessage.rtr) {
-    command |= FLEXCAN_MB_CS_RTR ;
-  }
-  if (inMessage.ext) {
-    command |= FLEXCAN_MB_CS_SRR | FLEXCAN_MB_CS_IDE ;
+uint32_t ACAN::receiveBatch (CANMessage outMessages [], const uint32_t inMaxCount) {
+  uint32_t count = 0 ;
+  const CANMessage * messages = nullptr ;
+  uint32_t runLength = (inMaxCount > 0) ? peek (messages) : 0 ;
+  while (runLength > 0) {
+    const uint32_t n = imin (runLength, inMaxCount - count) ;
+    for (uint32_t i=0 ; i<n ; i++) {
+      outMessages [count + i] = messages [i] ;
+    }
+    consume (n) ;
+    count += n ;
+    runLength = (count < inMaxCount) ? peek (messages) : 0 ;
   }
-  FLEXCANb_MBn_CS (mFlexcanBaseAddress, inMBIndex) = command ;
+  return count ;
 }
 
 //----------------------------------------------------------------------------------------
-//   MESSAGE INTERRUPT SERVICE ROUTINES
+// Called from message_isr
+
+static inline uint32_t arbitrationKey (const CANMessage & inMessage) {
+//--- Lower key wins arbitration: base identifier, then standard before extended
+//    (IDE bit), then extended identifier bits, then data before remote (RTR bit)
+  return inMessage.ext
+    ? (((inMessage.id >> 18) & 0x7FF) << 21) | (1 << 20) | ((inMessage.id & 0x3FFFF) << 1) | inMessage.rtr
+    : ((inMessage.id & 0x7FF) << 21) | inMessage.rtr
+  ;
+}
+
 //----------------------------------------------------------------------------------------
 
-void ACAN::readRxRegisters (CANMessage & outMessage) {
-//--- Get identifier, ext, rtr and len
-  const uint32_t dlc = FLEXCANb_MBn_CS (mFlexcanBaseAddress, 0) ;
-  outMessage.len = FLEXCAN_get_length (dlc) ;
+void ACAN::countDroppedFrame (ReceiveQueue & ioQueue, const CANMessage & inMessage) {
+  ioQueue.mDroppedCount += 1 ;
+  mReceiveBufferDroppedCount += 1 ;
+  if (inMessage.idx < mCallBackFunctionArraySize) {
+    mFilterStatisticsArray [inMessage.idx].mDroppedCount += 1 ;
+  }
+}
+
+//----------------------------------------------------------------------------------------
+// Receive class buffer is full: remove the buffered frame with the lowest priority, if its
+// priority is lower than inMessage's one. Returns true if a frame has been removed.
+
+bool ACAN::evictLowestPriorityFrame (ReceiveQueue & ioQueue, const CANMessage & inMessage) {
+  uint32_t lowestPriorityOffset = 0 ;
+  uint32_t lowestPriorityKey = 0 ;
+  for (uint32_t offset = ioQueue.mPeekedCount ; offset < ioQueue.mCount ; offset++) { // Peeked frames are read in place
+    const uint32_t key = arbitrationKey (ioQueue.mBuffer [(ioQueue.mReadIndex + offset) % ioQueue.mSize]) ;
+    if (key >= lowestPriorityKey) { // >= : evict the most recent one
+      lowestPriorityKey = key ;
+      lowestPriorityOffset = offset ;
+    }
+  }
+  const bool evict = (ioQueue.mCount > ioQueue.mPeekedCount) && (lowestPriorityKey > arbitrationKey (inMessage)) ;
+  if (evict) {
+    countDroppedFrame (ioQueue, ioQueue.mBuffer [(ioQueue.mReadIndex + lowestPriorityOffset) % ioQueue.mSize]) ;
+    for (uint32_t offset = lowestPriorityOffset ; (offset + 1) < ioQueue.mCount ; offset++) {
+      ioQueue.mBuffer [(ioQueue.mReadIndex + offset) % ioQueue.mSize] =
+        ioQueue.mBuffer [(ioQueue.mReadIndex + offset + 1) % ioQueue.mSize] ;
+      #if ACAN_INSTRUMENTATION
+        ioQueue.mEntryCycles [(ioQueue.mReadIndex + offset) % ioQueue.mSize] =
+          ioQueue.mEntryCycles [(ioQueue.mReadIndex + offset + 1) % ioQueue.mSize] ;
+      #endif
+    }
+    ioQueue.mCount -= 1 ;
+    mReceiveBufferCount -= 1 ;
+  }
+  return evict ;
+}
+
+//----------------------------------------------------------------------------------------
+// Called from message_isr: returns the slot the next frame accepted by inFilterIndex will be
+// written to, so that the frame can be read in place; nullptr if the receive class buffer
+// is full.
+
+CANMessage * ACAN::freeReceiveSlot (const uint32_t inFilterIndex) {
+  const uint32_t receiveClass = (inFilterIndex < mCallBackFunctionArraySize)
+    ? mFilterReceiveClassArray [inFilterIndex]
+    : (uint32_t) ACANSettings::kReceiveClassNormal
+  ;
+  ReceiveQueue & queue = mReceiveQueue [receiveClass] ;
+  CANMessage * result = nullptr ;
+  if (queue.mCount < queue.mSize) {
+    uint32_t receiveBufferWriteIndex = queue.mReadIndex + queue.mCount ;
+    if (receiveBufferWriteIndex >= queue.mSize) {
+      receiveBufferWriteIndex -= queue.mSize ;
+    }
+    result = & queue.mBuffer [receiveBufferWriteIndex] ;
+  }
+  return result ;
+}
+
+//----------------------------------------------------------------------------------------
+
+bool ACAN::enterReceiveBuffer (const CANMessage & inMessage) {
+  const uint32_t receiveClass = (inMessage.idx < mCallBackFunctionArraySize)
+    ? mFilterReceiveClassArray [inMessage.idx]
+    : (uint32_t) ACANSettings::kReceiveClassNormal
+  ;
+  ReceiveQueue & queue = mReceiveQueue [receiveClass] ;
+  bool store = true ;
+  if (queue.mCount == queue.mSize) { // Overflow! Receive class buffer is full
+    queue.mPeakCount = queue.mSize + 1 ; // Mark overflow
+    mReceiveBufferPeakCount = mReceiveBufferSize + 1 ;
+    switch (mReceiveOverflowPolicy) {
+    case ACANSettings::kDropNewest :
+      store = false ;
+      break ;
+    case ACANSettings::kDropOldest :
+      store = (queue.mCount > 0) && (queue.mPeekedCount == 0) ; // Oldest frame is not read in place
+      if (store) {
+        countDroppedFrame (queue, queue.mBuffer [queue.mReadIndex]) ;
+        releaseReceivedFrames (queue, 1) ;
+      }
+      break ;
+    case ACANSettings::kEvictLowestPriority :
+      store = evictLowestPriorityFrame (queue, inMessage) ;
+      break ;
+    }
+    if (!store) {
+      countDroppedFrame (queue, inMessage) ;
+    }
+  }
+  if (store) {
+    uint32_t receiveBufferWriteIndex = queue.mReadIndex + queue.mCount ;
+    if (receiveBufferWriteIndex >= queue.mSize) {
+      receiveBufferWriteIndex -= queue.mSize ;
+    }
+    if (& queue.mBuffer [receiveBufferWriteIndex] != & inMessage) { // Not read in place
+      queue.mBuffer [receiveBufferWriteIndex] = inMessage ;
+    }
+    #if ACAN_INSTRUMENTATION
+      queue.mEntryCycles [receiveBufferWriteIndex] = acanCycleCount () ;
+    #endif
+    queue.mCount += 1 ;
+    if (queue.mCount > queue.mPeakCount) {
+      queue.mPeakCount = queue.mCount ;
+    }
+    mReceiveBufferCount += 1 ;
+    if (mReceiveBufferCount > mReceiveBufferPeakCount) {
+      mReceiveBufferPeakCount = mReceiveBufferCount ;
+    }
+  //--- High watermark ?
+    const bool highWatermarkReached =
+      (mReceiveBufferHighWatermark > 0) &&
+      !mReceiveBufferAboveHighWatermark &&
+      (mReceiveBufferCount >= mReceiveBufferHighWatermark)
+    ;
+    if (highWatermarkReached) {
+      mReceiveBufferAboveHighWatermark = true ;
+      if (nullptr != mReceiveWatermarkCallBack) {
+        mReceiveWatermarkCallBack (true) ;
+      }
+    }
+  }
+  return store ;
+}
+
+//----------------------------------------------------------------------------------------
+// Called from message_isr: returns true if inMessage should be discarded (on change only
+// filter, same frame as the last accepted one, heartbeat not elapsed)
+
+bool ACAN::isUnchangedFrame (const CANMessage & inMessage) {
+  bool unchanged = false ;
+  if ((nullptr != mChangeDetectorArray) && (inMessage.idx < mCallBackFunctionArraySize)) {
+    ChangeDetector & detector = mChangeDetectorArray [inMessage.idx] ;
+    if (detector.mEnabled) {
+      const uint32_t identifier = inMessage.id | (inMessage.ext ? (1 << 30) : 0) | (inMessage.rtr ? (1U << 31) : 0) ;
+      const uint64_t data = inMessage.rtr ? 0 : inMessage.data64 ;
+      const uint32_t now = millis () ;
+      unchanged =
+        detector.mHasLastFrame &&
+        (data == detector.mLastData) &&
+        (inMessage.len == detector.mLastLength) &&
+        (identifier == detector.mLastIdentifier) &&
+        ((detector.mHeartbeatMillis == 0) || ((now - detector.mLastAcceptDate) < detector.mHeartbeatMillis))
+      ;
+      if (unchanged) {
+        detector.mSuppressedCount += 1 ;
+        mSuppressedFrameCount += 1 ;
+      }else{
+        detector.mLastData = data ;
+        detector.mLastIdentifier = identifier ;
+        detector.mLastLength = inMessage.len ;
+        detector.mLastAcceptDate = now ;
+        detector.mHasLastFrame = true ;
+      }
+    }
+  }
+  return unchanged ;
+}
+
+//----------------------------------------------------------------------------------------
+
+uint32_t ACAN::filterSuppressedCount (const uint32_t inFilterIndex) const {
+  return ((nullptr != mChangeDetectorArray) && (inFilterIndex < mCallBackFunctionArraySize))
+    ? mChangeDetectorArray [inFilterIndex].mSuppressedCount
+    : 0
+  ;
+}
+
+//----------------------------------------------------------------------------------------
+
+uint32_t ACAN::filterDroppedCount (const uint32_t inFilterIndex) const {
+  return (inFilterIndex < mCallBackFunctionArraySize) ? mFilterStatisticsArray [inFilterIndex].mDroppedCount : 0 ;
+}
+
+//----------------------------------------------------------------------------------------
+//   FILTER STATISTICS
+//----------------------------------------------------------------------------------------
+// Called from message_isr
+
+void ACAN::updateFilterStatistics (const CANMessage & inMessage) {
+  if (inMessage.idx < mCallBackFunctionArraySize) {
+    FilterStatistics & statistics = mFilterStatisticsArray [inMessage.idx] ;
+    statistics.mMatchedCount += 1 ;
+    statistics.mLastSeenMicros = micros () ;
+    if (statistics.mIntendedIdentifierCount > 0) {
+      uint32_t low = 0 ;
+      uint32_t high = statistics.mIntendedIdentifierCount ;
+      while (low < high) {
+        const uint32_t middle = low + (high - low) / 2 ;
+        if (statistics.mIntendedIdentifiers [middle] < inMessage.id) {
+          low = middle + 1 ;
+        }else{
+          high = middle ;
+        }
+      }
+      const bool intended = (low < statistics.mIntendedIdentifierCount) && (statistics.mIntendedIdentifiers [low] == inMessage.id) ;
+      if (!intended) {
+        statistics.mFalseAcceptCount += 1 ;
+        mFalseAcceptCount += 1 ;
+      }
+    }
+  }
+}
+
+//----------------------------------------------------------------------------------------
+
+uint32_t ACAN::filterMatchedCount (const uint32_t inFilterIndex) const {
+  return (inFilterIndex < mCallBackFunctionArraySize) ? mFilterStatisticsArray [inFilterIndex].mMatchedCount : 0 ;
+}
+
+//----------------------------------------------------------------------------------------
+
+uint32_t ACAN::filterLastSeenMicros (const uint32_t inFilterIndex) const {
+  return (inFilterIndex < mCallBackFunctionArraySize) ? mFilterStatisticsArray [inFilterIndex].mLastSeenMicros : 0 ;
+}
+
+//----------------------------------------------------------------------------------------
+
+uint32_t ACAN::filterFalseAcceptCount (const uint32_t inFilterIndex) const {
+  return (inFilterIndex < mCallBackFunctionArraySize) ? mFilterStatisticsArray [inFilterIndex].mFalseAcceptCount : 0 ;
+}
+
+//----------------------------------------------------------------------------------------
+
+void ACAN::resetFilterStatistics (void) {
+  noInterrupts () ;
+    for (uint32_t i=0 ; i<mCallBackFunctionArraySize ; i++) {
+      mFilterStatisticsArray [i].mMatchedCount = 0 ;
+      mFilterStatisticsArray [i].mDroppedCount = 0 ;
+      mFilterStatisticsArray [i].mFalseAcceptCount = 0 ;
+      mFilterStatisticsArray [i].mLastSeenMicros = 0 ;
+    }
+    mFalseAcceptCount = 0 ;
+  interrupts () ;
+}
+
+//----------------------------------------------------------------------------------------
+
+// The frame is copied and released before the call backs are called: they can call
+// receive, peek or dispatchReceivedMessage
+
+bool ACAN::dispatchReceivedMessage (const tFilterMatchCallBack inFilterMatchCallBack) {
+  CANMessage receivedMessage ;
+  const bool hasReceived = receive (receivedMessage) ;
+  if (hasReceived) {
+    const uint32_t filterIndex = receivedMessage.idx ;
+    if (nullptr != inFilterMatchCallBack) {
+      inFilterMatchCallBack (filterIndex) ;
+    }
+    if (filterIndex < mCallBackFunctionArraySize) {
+      ACANCallBackRoutine callBackFunction = mCallBackFunctionArray [filterIndex] ;
+      if (nullptr != callBackFunction) {
+        callBackFunction (receivedMessage) ;
+      }
+    }
+  }
+  return hasReceived ;
+}
+
+//----------------------------------------------------------------------------------------
+//   EMISSION
+//----------------------------------------------------------------------------------------
+
+// Called with a constant inFlexcanBase from the interrupt service routine
+
+static inline void writeTxRegisters (const uint32_t inFlexcanBase,
+                                     const CANMessage & inMessage,
+                                     const uint32_t inMBIndex,
+                                     const uint32_t inCode = FLEXCAN_MB_CODE_TX_ONCE) {
+//--- Make Tx box inactive
+  FLEXCANb_MBn_CS (inFlexcanBase, inMBIndex) = FLEXCAN_MB_CS_CODE (FLEXCAN_MB_CODE_TX_INACTIVE) ;
+//--- Write identifier
+  FLEXCANb_MBn_ID (inFlexcanBase, inMBIndex) = inMessage.ext
+    ? (inMessage.id & FLEXCAN_MB_ID_EXT_MASK)
+    : FLEXCAN_MB_ID_IDSTD (inMessage.id)
+  ;
+//--- Write data (registers are big endian, values should be swapped)
+  FLEXCANb_MBn_WORD0 (inFlexcanBase, inMBIndex) = __builtin_bswap32 (inMessage.data32 [0]) ;
+  FLEXCANb_MBn_WORD1 (inFlexcanBase, inMBIndex) = __builtin_bswap32 (inMessage.data32 [1]) ;
+//--- Send message
+  const uint8_t length = (inMessage.len <= 8) ? inMessage.len : 8 ;
+  uint32_t command = FLEXCAN_MB_CS_CODE (inCode) | FLEXCAN_MB_CS_LENGTH (length) ;
+  if (inMessage.rtr) {
+    command |= FLEXCAN_MB_CS_RTR ;
+  }
+  if (inMessage.ext) {
+    command |= FLEXCAN_MB_CS_SRR | FLEXCAN_MB_CS_IDE ;
+  }
+  FLEXCANb_MBn_CS (inFlexcanBase, inMBIndex) = command ;
+}
+
+//----------------------------------------------------------------------------------------
+// Interrupts should be disabled
+
+void ACAN::loadDataMailbox (const uint32_t inFlexcanBase,
+                            const CANMessage & inMessage,
+                            const uint32_t inMBIndex) {
+  if (mTransmitTimeoutMillis > 0) {
+    mTxMailboxFrame = inMessage ;
+    mTxMailboxLoadDate = millis () ;
+  }
+  mTimeSyncInMailbox = (kTimeSyncMaster == mTimeSyncRole) && isTimeSyncFrame (inMessage) && (inMessage.data [0] == kTimeSyncFrameType) ;
+  if (mTimeSyncInMailbox) {
+    mTimeSyncSequence = inMessage.data [1] ;
+  }
+  writeTxRegisters (inFlexcanBase, inMessage, inMBIndex) ;
+}
+
+//----------------------------------------------------------------------------------------
+//    Transmit rate limits
+//----------------------------------------------------------------------------------------
+
+// Worst case bit length of a frame, including stuff bits and interframe space
+
+static uint32_t frameBitLength (const CANMessage & inMessage) {
+  const uint32_t dataBitCount = inMessage.rtr ? 0 : (8 * imin (inMessage.len, (uint8_t) 8)) ;
+//--- Stuffed fields: from SOF to CRC
+  const uint32_t stuffedBitCount = (inMessage.ext ? 54 : 34) + dataBitCount ;
+//--- CRC delimiter, ACK slot and delimiter, EOF, interframe space: 1 + 2 + 7 + 3 bits
+  return stuffedBitCount + (stuffedBitCount - 1) / 4 + 13 ;
+}
+
+//----------------------------------------------------------------------------------------
+
+void ACAN::TokenBucket::refill (const uint32_t inNow) {
+  const uint32_t elapsed = inNow - mRefillDate ;
+  mRefillDate = inNow ;
+  if (elapsed >= ((mCapacity - mTokens) / mRate)) {
+    mTokens = mCapacity ;
+  }else{
+    mTokens += elapsed * mRate ;
+  }
+}
+
+//----------------------------------------------------------------------------------------
+
+void ACAN::TokenBucket::refund (const uint32_t inTokens) {
+  mTokens = (inTokens < (mCapacity - mTokens)) ? (mTokens + inTokens) : mCapacity ;
+}
+
+//----------------------------------------------------------------------------------------
+// Bucket of the first identifier limit matching inMessage, nullptr if none (or no limit)
+
+ACAN::TokenBucket * ACAN::transmitRateBucket (const CANMessage & inMessage) {
+  TokenBucket * bucket = nullptr ;
+  for (uint32_t i=0 ; (i<mTransmitRateLimitCount) && (nullptr == bucket) ; i++) {
+    const ACANTransmitRateLimit & limit = mTransmitRateLimits [i] ;
+    if ((limit.mExtended == inMessage.ext) && ((inMessage.id & limit.mMask) == limit.mAcceptance)) {
+      bucket = & mTransmitRateBuckets [i] ;
+    }
+  }
+  return ((nullptr != bucket) && (bucket->mRate > 0)) ? bucket : nullptr ;
+}
+
+//----------------------------------------------------------------------------------------
+// Interrupts should be disabled. Tokens are taken only if the frame is accepted by both the
+// identifier limit and the bus share cap; refundTransmitRate gives them back if the frame
+// is not sent after all.
+
+bool ACAN::acceptTransmitRate (const CANMessage & inMessage) {
+  const uint32_t now = micros () ;
+//--- Identifier limit
+  TokenBucket * bucket = transmitRateBucket (inMessage) ;
+  bool accepted = true ;
+  if (nullptr != bucket) {
+    bucket->refill (now) ;
+    accepted = bucket->mTokens >= 1000000 ;
+    if (!accepted) {
+      mTransmitRateLimitedCount += 1 ;
+    }
+  }
+//--- Bus share
+  const uint32_t bitCost = frameBitLength (inMessage) * 1000000 ;
+  if (accepted && (mBusShareBucket.mRate > 0)) {
+    mBusShareBucket.refill (now) ;
+    accepted = mBusShareBucket.mTokens >= bitCost ;
+    if (!accepted) {
+      mTransmitBusShareLimitedCount += 1 ;
+    }
+  }
+//--- Take tokens
+  if (accepted) {
+    if (nullptr != bucket) {
+      bucket->mTokens -= 1000000 ;
+    }
+    if (mBusShareBucket.mRate > 0) {
+      mBusShareBucket.mTokens -= bitCost ;
+    }
+  }
+  return accepted ;
+}
+
+//----------------------------------------------------------------------------------------
+// Interrupts should be disabled. The frame has been accepted by acceptTransmitRate, but
+// it has not been sent (transmit buffer full, no free remote mailbox).
+
+void ACAN::refundTransmitRate (const CANMessage & inMessage) {
+  TokenBucket * bucket = transmitRateBucket (inMessage) ;
+  if (nullptr != bucket) {
+    bucket->refund (1000000) ;
+  }
+  if (mBusShareBucket.mRate > 0) {
+    mBusShareBucket.refund (frameBitLength (inMessage) * 1000000) ;
+  }
+}
+
+//----------------------------------------------------------------------------------------
+
+void ACAN::setTransmitRateLimits (const ACANTransmitRateLimit inLimits [], const uint32_t inLimitCount) {
+//--- Copy limits, create buckets
+  ACANTransmitRateLimit * limits = nullptr ;
+  TokenBucket * buckets = nullptr ;
+  if (inLimitCount > 0) {
+    limits = new ACANTransmitRateLimit [inLimitCount] ;
+    buckets = new TokenBucket [inLimitCount] ;
+    const uint32_t now = micros () ;
+    for (uint32_t i=0 ; i<inLimitCount ; i++) {
+      limits [i] = inLimits [i] ;
+      const uint32_t burstFrameCount = imin (imax (inLimits [i].mBurstFrameCount, (uint32_t) 1), (uint32_t) 4000) ;
+      buckets [i].mRate = inLimits [i].mFramesPerSecond ;
+      buckets [i].mCapacity = burstFrameCount * 1000000 ;
+      buckets [i].mTokens = buckets [i].mCapacity ;
+      buckets [i].mRefillDate = now ;
+    }
+  }
+//--- Install
+  noInterrupts () ;
+    ACANTransmitRateLimit * previousLimits = mTransmitRateLimits ;
+    TokenBucket * previousBuckets = mTransmitRateBuckets ;
+    mTransmitRateLimits = limits ;
+    mTransmitRateBuckets = buckets ;
+    mTransmitRateLimitCount = inLimitCount ;
+  interrupts () ;
+  delete [] previousLimits ;
+  delete [] previousBuckets ;
+}
+
+//----------------------------------------------------------------------------------------
+
+void ACAN::setTransmitBusShare (const uint32_t inPercent, const uint32_t inBurstFrameCount) {
+//--- Burst of longest frames (160 bits), at most 4000 bits so that capacity fits in 32 bits
+  const uint32_t burstBitCount = imin (imax (inBurstFrameCount, (uint32_t) 1) * 160, (uint32_t) 4000) ;
+  noInterrupts () ;
+    mBusShareBucket.mRate = (uint32_t) (((uint64_t) mActualBitRate * imin (inPercent, (uint32_t) 100)) / 100) ;
+    mBusShareBucket.mCapacity = burstBitCount * 1000000 ;
+    mBusShareBucket.mTokens = mBusShareBucket.mCapacity ;
+    mBusShareBucket.mRefillDate = micros () ;
+  interrupts () ;
+}
+
+//----------------------------------------------------------------------------------------
+//    Transmit watchdog
+//----------------------------------------------------------------------------------------
+
+void ACAN::checkTransmitTimeout (void) {
+  if (mTransmitTimeoutMillis > 0) {
+    const uint32_t base = flexcanBase (mFlexcanBaseAddress) ;
+    const uint32_t dataMailBoxIndex = 15 ;
+    const uint32_t primask = saveAndDisableInterrupts () ; // Called by tryToSend, from any context
+      const uint32_t cs = FLEXCANb_MBn_CS (base, dataMailBoxIndex) ;
+      const bool timeout =
+        (FLEXCAN_get_code (cs) == FLEXCAN_MB_CODE_TX_ONCE) &&
+        ((millis () - mTxMailboxLoadDate) >= mTransmitTimeoutMillis)
+      ;
+    //--- Request abort: the message interrupt occurs when the mailbox is aborted, or if the
+    //    frame is being sent, when it is completed
+      if (timeout) {
+        FLEXCANb_MBn_CS (base, dataMailBoxIndex) = (cs & ~FLEXCAN_MB_CS_CODE_MASK) | FLEXCAN_MB_CS_CODE (FLEXCAN_MB_CODE_TX_ABORT) ;
+      }
+    restoreInterrupts (primask) ;
+  }
+}
+
+//----------------------------------------------------------------------------------------
+// Called from message_isr, the data mailbox has been aborted
+
+void ACAN::handleTransmitTimeout (void) {
+  mTransmitTimeoutCount += 1 ;
+  if (nullptr != mTransmitTimeoutCallBack) {
+    mTransmitTimeoutCallBack (mTxMailboxFrame) ;
+  }
+  if (mFlushTransmitBufferOnTimeout) {
+    while (nullptr != mTransmitQueue.front ()) {
+      mTransmitQueue.pop () ;
+      mTransmitFlushedCount += 1 ;
+    }
+  }
+}
+
+//----------------------------------------------------------------------------------------
+
+bool ACAN::tryToSend (const CANMessage & inMessage) {
+  const uint32_t firstTxMailBoxIndex = 15 ;
+  const uint32_t base = flexcanBase (mFlexcanBaseAddress) ;
+  bool sent = false ;
+//--- Rate limits
+  const bool rateLimited = (mTransmitRateLimitCount > 0) || (mBusShareBucket.mRate > 0) ;
+  bool accepted = true ;
+  if (rateLimited) {
+    const uint32_t primask = saveAndDisableInterrupts () ; // tryToSend may be called from an ISR
+      accepted = acceptTransmitRate (inMessage) ;
+    restoreInterrupts (primask) ;
+  }
+  if (!accepted) {
+    // Over limit, frame is rejected
+  }else if (inMessage.rtr) { // Remote
+    const uint32_t firstResponderMailBoxIndex = firstTxMailBoxIndex - mRemoteResponderCount ;
+    for (uint32_t index = mMaxPrimaryFilterCount ; (index < firstResponderMailBoxIndex) && !sent ; index++) {
+    //--- Claim the mailbox, so that a concurrent sender does not write it
+      const uint32_t claim = 1U << index ;
+      if ((__atomic_fetch_or (& mRemoteMailboxClaims, claim, __ATOMIC_ACQUIRE) & claim) == 0) {
+        const uint32_t status = FLEXCAN_get_code (FLEXCANb_MBn_CS (base, index)) ;
+        switch (status) {
+        case FLEXCAN_MB_CODE_TX_INACTIVE : // MB has never sent remote frame
+        case FLEXCAN_MB_CODE_TX_EMPTY : // MB has sent a remote frame
+        case FLEXCAN_MB_CODE_TX_FULL : // MB has sent a remote frame, and received a frame that did not pass any filter
+        case FLEXCAN_MB_CODE_TX_OVERRUN : // MB has sent a remote frame, and received several frames that did not pass any filter
+          writeTxRegisters (base, inMessage, index) ;
+          sent = true ;
+          break ;
+        default:
+          break ;
+        }
+        __atomic_fetch_and (& mRemoteMailboxClaims, ~ claim, __ATOMIC_RELEASE) ;
+      }
+    }
+  }else{ // Data
+    checkTransmitTimeout () ;
+    #ifdef __MK66FX1M0__
+      if (base == FLEXCAN0_BASE) {
+        sent = sendDataFrame <FLEXCAN0_BASE> (inMessage) ;
+      }else{
+        sent = sendDataFrame <FLEXCAN1_BASE> (inMessage) ;
+      }
+    #else
+      sent = sendDataFrame <FLEXCAN0_BASE> (inMessage) ;
+    #endif
+  }
+//--- Tokens taken for a frame that has not been sent are given back
+  if (accepted && rateLimited && !sent) {
+    const uint32_t primask = saveAndDisableInterrupts () ;
+      refundTransmitRate (inMessage) ;
+    restoreInterrupts (primask) ;
+  }
+//---
+  return sent ;
+}
+
+//----------------------------------------------------------------------------------------
+// Any context. Fast path: if the transmit queue is empty (no frame is queued, or being
+// queued by a preempted sender) and mailbox 15 is inactive, the frame is written at once,
+// interrupts disabled. Otherwise, the frame is queued, and the message interrupt is
+// triggered, so that it is written to mailbox 15 when the mailbox is inactive (in polling
+// mode, poll does).
+
+template <uint32_t FLEXCAN_BASE> bool ACAN::sendDataFrame (const CANMessage & inMessage) {
+  const uint32_t dataMailBoxIndex = 15 ;
+  #if ACAN_INSTRUMENTATION
+    const uint32_t entryCycles = acanCycleCount () ;
+  #endif
+  bool sent = false ;
+  const uint32_t primask = saveAndDisableInterrupts () ;
+    if ((mTransmitQueue.count () == 0)
+     && (FLEXCAN_get_code (FLEXCANb_MBn_CS (FLEXCAN_BASE, dataMailBoxIndex)) == FLEXCAN_MB_CODE_TX_INACTIVE)) {
+      loadDataMailbox (FLEXCAN_BASE, inMessage, dataMailBoxIndex) ;
+      #if ACAN_INSTRUMENTATION
+        mTransmitResidencyHistogram.record (acanCycleCount () - entryCycles) ;
+      #endif
+      sent = true ;
+    }
+  restoreInterrupts (primask) ;
+//--- Contention: queue it
+  if (!sent) {
+    TransmitEntry entry ;
+    entry.mMessage = inMessage ;
+    #if ACAN_INSTRUMENTATION
+      entry.mEntryCycles = entryCycles ;
+    #endif
+    sent = mTransmitQueue.push (entry) ;
+    if (sent && !mPollingMode) {
+      NVIC_SET_PENDING (FlexcanModule <FLEXCAN_BASE>::kMessageIRQ) ;
+    }
+  }
+  return sent ;
+}
+
+//----------------------------------------------------------------------------------------
+// Called from message_isr (single consumer of the transmit queue)
+
+template <uint32_t FLEXCAN_BASE> bool ACAN::loadDataMailboxFromQueue (void) {
+  bool loaded = false ;
+  const uint32_t dataMailBoxIndex = 15 ;
+  if (FLEXCAN_get_code (FLEXCANb_MBn_CS (FLEXCAN_BASE, dataMailBoxIndex)) == FLEXCAN_MB_CODE_TX_INACTIVE) {
+    const TransmitEntry * entry = mTransmitQueue.front () ;
+    if (nullptr != entry) {
+      loadDataMailbox (FLEXCAN_BASE, entry->mMessage, dataMailBoxIndex) ;
+      #if ACAN_INSTRUMENTATION
+        mTransmitResidencyHistogram.record (acanCycleCount () - entry->mEntryCycles) ;
+      #endif
+      mTransmitQueue.pop () ;
+      loaded = true ;
+    }
+  }
+  return loaded ;
+}
+
+//----------------------------------------------------------------------------------------
+//   GATEWAY
+//----------------------------------------------------------------------------------------
+
+#ifdef __MK66FX1M0__
+
+//----------------------------------------------------------------------------------------
+
+uint32_t ACAN::setGatewayRoutes (ACAN * inDestination,
+                                 const ACANGatewayRoute inRoutes [],
+                                 const uint32_t inRouteCount,
+                                 const uint32_t inMaxFramesPerSecond,
+                                 const uint32_t inBurstFrameCount) {
+  uint32_t errorCode = 0 ;
+  if (inDestination == this) {
+    errorCode |= kGatewayDestinationIsSource ;
+  }
+//--- Copy routes
+  ACANGatewayRoute * routes = nullptr ;
+  uint32_t routeCount = 0 ;
+  if ((0 == errorCode) && (nullptr != inDestination) && (inRouteCount > 0)) {
+    routeCount = inRouteCount ;
+    routes = new ACANGatewayRoute [routeCount] ;
+    for (uint32_t i=0 ; i<routeCount ; i++) {
+      routes [i] = inRoutes [i] ;
+    }
+  }
+//--- Latency is measured with the cycle counter
+  ARM_DEMCR |= ARM_DEMCR_TRCENA ;
+  ARM_DWT_CTRL |= ARM_DWT_CTRL_CYCCNTENA ;
+//--- Install new routes
+  const uint32_t burstFrameCount = imin (imax (inBurstFrameCount, (uint32_t) 1), (uint32_t) 4000) ;
+  noInterrupts () ;
+    ACANGatewayRoute * previousRoutes = mGatewayRoutes ;
+    mGatewayRoutes = routes ;
+    mGatewayRouteCount = routeCount ;
+    mGatewayDestination = (routeCount > 0) ? inDestination : nullptr ;
+    mGatewayBucket.mRate = inMaxFramesPerSecond ;
+    mGatewayBucket.mCapacity = burstFrameCount * 1000000 ;
+    mGatewayBucket.mTokens = mGatewayBucket.mCapacity ;
+    mGatewayBucket.mRefillDate = micros () ;
+  interrupts () ;
+  delete [] previousRoutes ;
+  return errorCode ;
+}
+
+//----------------------------------------------------------------------------------------
+
+void ACAN::resetGatewayStatistics (void) {
+  noInterrupts () ;
+    mGatewayForwardedCount = 0 ;
+    mGatewayDroppedCount = 0 ;
+    mGatewayRateLimitedCount = 0 ;
+    mGatewayMaxLatencyCycles = 0 ;
+  interrupts () ;
+}
+
+//----------------------------------------------------------------------------------------
+// Called from message_isr; returns true if the frame matches a route (it should not be
+// stored in the receive buffer). Rate limit is a token bucket: a frame costs 1,000,000
+// tokens, mGatewayBucket.mRate tokens are earned every microsecond.
+// The destination is the other module (setGatewayRoutes rejects this).
+
+template <uint32_t FLEXCAN_BASE> bool ACAN::gatewayForward (CANMessage & ioMessage, const uint32_t inISRStartCycle) {
+  static const uint32_t DESTINATION_BASE = (FLEXCAN_BASE == FLEXCAN0_BASE) ? FLEXCAN1_BASE : FLEXCAN0_BASE ;
+  bool matched = false ;
+  for (uint32_t i=0 ; (i<mGatewayRouteCount) && !matched ; i++) {
+    const ACANGatewayRoute & route = mGatewayRoutes [i] ;
+    matched = (route.mExtended == ioMessage.ext) && ((ioMessage.id & route.mMask) == route.mAcceptance) ;
+    if (matched) {
+      ioMessage.id = (ioMessage.id & ~ route.mRemapMask) | route.mRemapValue ;
+    }
+  }
+  if (matched) {
+  //--- Rate limit
+    bool allowed = true ;
+    if (mGatewayBucket.mRate > 0) {
+      mGatewayBucket.refill (micros ()) ;
+      allowed = mGatewayBucket.mTokens >= 1000000 ;
+      if (allowed) {
+        mGatewayBucket.mTokens -= 1000000 ;
+      }
+    }
+  //--- Hand frame to destination (its interrupt may have a higher priority)
+    if (!allowed) {
+      mGatewayRateLimitedCount += 1 ;
+    }else{
+      const bool sent = mGatewayDestination->sendDataFrame <DESTINATION_BASE> (ioMessage) ;
+      if (sent) {
+        mGatewayForwardedCount += 1 ;
+        const uint32_t latency = ARM_DWT_CYCCNT - inISRStartCycle ;
+        if (mGatewayMaxLatencyCycles < latency) {
+          mGatewayMaxLatencyCycles = latency ;
+        }
+      }else{
+        mGatewayDroppedCount += 1 ;
+      }
+    }
+  }
+  return matched ;
+}
+
+//----------------------------------------------------------------------------------------
+
+#endif
+
+//----------------------------------------------------------------------------------------
+//   MESSAGE INTERRUPT SERVICE ROUTINES
+//----------------------------------------------------------------------------------------
+
+template <uint32_t FLEXCAN_BASE> inline uint32_t ACAN::receivedFilterIndex (void) const {
+  uint32_t filterIndex = FLEXCANb_RXFIR (FLEXCAN_BASE) & 0x1FF ;
+  if (filterIndex >= mMaxPrimaryFilterCount) {
+    filterIndex -= mMaxPrimaryFilterCount - mActualPrimaryFilterCount ;
+  }
+  return filterIndex ;
+}
+
+//----------------------------------------------------------------------------------------
+
+template <uint32_t FLEXCAN_BASE> uint16_t ACAN::readRxRegisters (CANMessage & outMessage) {
+//--- Get identifier, ext, rtr and len
+  const uint32_t dlc = FLEXCANb_MBn_CS (FLEXCAN_BASE, 0) ;
+  outMessage.len = FLEXCAN_get_length (dlc) ;
   if (outMessage.len > 8) {
     outMessage.len = 8 ;
   }
   outMessage.ext = (dlc & FLEXCAN_MB_CS_IDE) != 0 ;
   outMessage.rtr = (dlc & FLEXCAN_MB_CS_RTR) != 0 ;
-  outMessage.id  = FLEXCANb_MBn_ID (mFlexcanBaseAddress, 0) & FLEXCAN_MB_ID_EXT_MASK ;
+  outMessage.id  = FLEXCANb_MBn_ID (FLEXCAN_BASE, 0) & FLEXCAN_MB_ID_EXT_MASK ;
   if (!outMessage.ext) {
     outMessage.id >>= FLEXCAN_MB_ID_STD_BIT_NO ;
   }
 //-- Get data (registers are big endian, values should be swapped)
-  outMessage.data32 [0] = __builtin_bswap32 (FLEXCANb_MBn_WORD0 (mFlexcanBaseAddress, 0)) ;
-  outMessage.data32 [1] = __builtin_bswap32 (FLEXCANb_MBn_WORD1 (mFlexcanBaseAddress, 0)) ;
+  outMessage.data32 [0] = __builtin_bswap32 (FLEXCANb_MBn_WORD0 (FLEXCAN_BASE, 0)) ;
+  outMessage.data32 [1] = __builtin_bswap32 (FLEXCANb_MBn_WORD1 (FLEXCAN_BASE, 0)) ;
 //--- Zero unused data entries
   for (uint32_t i = outMessage.len ; i < 8 ; i++) {
     outMessage.data [i] = 0 ;
   }
 //--- Get filter index
-  outMessage.idx = (uint8_t) FLEXCANb_RXFIR (mFlexcanBaseAddress) ;
-  if (outMessage.idx >= mMaxPrimaryFilterCount) {
-    outMessage.idx -= mMaxPrimaryFilterCount - mActualPrimaryFilterCount ;
-  }
+  outMessage.idx = (uint8_t) receivedFilterIndex <FLEXCAN_BASE> () ;
+//--- Return FlexCAN time stamp
+  return (uint16_t) (dlc & FLEXCAN_MB_CS_TIMESTAMP_MASK) ;
 }
 
 //----------------------------------------------------------------------------------------
 
-void ACAN::message_isr (void) {
-  const uint32_t status = FLEXCANb_IFLAG1 (mFlexcanBaseAddress) ;
-//--- A trame has been received in RxFIFO ?
-  if ((status & (1 << 5)) != 0) {
-    CANMessage message ;
-    readRxRegisters (message) ;
-    if (mReceiveBufferCount == mReceiveBufferSize) { // Overflow! Receive buffer is full
-      mReceiveBufferPeakCount = mReceiveBufferSize + 1 ; // Mark overflow
-    }else{
-      uint32_t receiveBufferWriteIndex = mReceiveBufferReadIndex + mReceiveBufferCount ;
-      if (receiveBufferWriteIndex >= mReceiveBufferSize) {
-        receiveBufferWriteIndex -= mReceiveBufferSize ;
-      }
-      mReceiveBuffer [receiveBufferWriteIndex] = message ;
-      mReceiveBufferCount += 1 ;
-      if (mReceiveBufferCount > mReceiveBufferPeakCount) {
-        mReceiveBufferPeakCount = mReceiveBufferCount ;
+template <uint32_t FLEXCAN_BASE> inline uint32_t ACAN::message_isr (void) {
+  #if ACAN_INSTRUMENTATION
+    const uint32_t isrEntryCycle = acanCycleCount () ;
+  #endif
+  #ifdef __MK66FX1M0__
+    const uint32_t isrStartCycle = ARM_DWT_CYCCNT ;
+  #endif
+  uint32_t status = FLEXCANb_IFLAG1 (FLEXCAN_BASE) ;
+//--- A trame has been received in RxFIFO ? In coalescing and polling modes, RxFIFO is
+//    drained (at most RxFIFO depth, so that execution time is bounded)
+  const uint32_t receivedFrameCountAtEntry = mReceivedFrameCount ;
+  uint32_t events = 0 ;
+  bool frameAvailable = (status & (1 << 5)) != 0 ;
+  while (frameAvailable) {
+    mReceivedFrameCount += 1 ;
+  //--- Read frame directly into the receive buffer, unless it is full
+    CANMessage overflowMessage ;
+    CANMessage * slot = freeReceiveSlot (receivedFilterIndex <FLEXCAN_BASE> ()) ;
+    CANMessage & message = (nullptr != slot) ? *slot : overflowMessage ;
+    const uint16_t flexcanTimeStamp = readRxRegisters <FLEXCAN_BASE> (message) ;
+    updateFilterStatistics (message) ;
+    ACANBusLogger * busLogger = mBusLogger ;
+    if (nullptr != busLogger) {
+      busLogger->appendFromISR (message, flexcanTimeStamp) ;
+    }
+    ACANCyclicSupervisor * supervisor = mCyclicSupervisor ;
+    if (nullptr != supervisor) {
+      supervisor->refresh (message, microsOfTimeStamp <FLEXCAN_BASE> (flexcanTimeStamp)) ;
+    }
+    const bool timeSyncFrame = (kTimeSyncSlave == mTimeSyncRole) && isTimeSyncFrame (message) ;
+    if (timeSyncFrame) { // Consumed
+      handleTimeSyncFrame (message, microsOfTimeStamp <FLEXCAN_BASE> (flexcanTimeStamp)) ;
+    }
+    bool forwarded = false ;
+    #ifdef __MK66FX1M0__
+      if ((nullptr != mGatewayDestination) && !message.rtr && !timeSyncFrame) {
+        forwarded = gatewayForward <FLEXCAN_BASE> (message, isrStartCycle) ;
       }
+    #endif
+    if (!forwarded && !timeSyncFrame && !isUnchangedFrame (message) && enterReceiveBuffer (message)) {
+      events |= kReceiveEvent ;
+    }
+    if (mInterruptCoalescing || mPollingMode) { // Release frame, and continue with next one
+      FLEXCANb_IFLAG1 (FLEXCAN_BASE) = 1 << 5 ;
+      frameAvailable =
+        ((FLEXCANb_IFLAG1 (FLEXCAN_BASE) & (1 << 5)) != 0) &&
+        ((mReceivedFrameCount - receivedFrameCountAtEntry) < RX_FIFO_DEPTH)
+      ;
+      status &= ~ (1 << 5) ; // Frames have already been released
+    }else{
+      frameAvailable = false ;
     }
   }
 //--- RxFIFO warning ? It occurs when the number of messages goes from 4 to 5
@@ -745,38 +1719,512 @@ void ACAN::message_isr (void) {
     mFlexcanRxFIFOFlags |= 2 ;
   }
 //--- Handle Tx MBs
-  if (mTransmitBufferCount > 0) { // There is a frame in the queue to send
-    const uint32_t firstTxMailBoxIndex = 15 ;
-    uint32_t s = (status >> firstTxMailBoxIndex) & 0x3 ;
-    uint32_t mb = firstTxMailBoxIndex ;
-    while (s != 0) {
-      if ((s & 1) != 0) { // Has this mailbox triggered an interrupt?
-        const uint32_t code = FLEXCAN_get_code (FLEXCANb_MBn_CS (mFlexcanBaseAddress, mb));
-        if (code == FLEXCAN_MB_CODE_TX_INACTIVE) {
-          writeTxRegisters (mTransmitBuffer [mTransmitBufferReadIndex], mb);
-          mTransmitBufferReadIndex = (mTransmitBufferReadIndex + 1) % mTransmitBufferSize ;
-          mTransmitBufferCount -= 1 ;
-        }
+  const uint32_t firstTxMailBoxIndex = 15 ;
+  uint32_t s = (status >> firstTxMailBoxIndex) & 0x3 ;
+  uint32_t mb = firstTxMailBoxIndex ;
+  while (s != 0) {
+    if ((s & 1) != 0) { // Has this mailbox triggered an interrupt?
+      const uint32_t cs = FLEXCANb_MBn_CS (FLEXCAN_BASE, mb) ;
+      const uint32_t code = FLEXCAN_get_code (cs) ;
+      if (code == FLEXCAN_MB_CODE_TX_ABORT) { // Aborted by transmit watchdog
+        mTimeSyncInMailbox = false ;
+        handleTransmitTimeout () ;
+        FLEXCANb_MBn_CS (FLEXCAN_BASE, mb) = FLEXCAN_MB_CS_CODE (FLEXCAN_MB_CODE_TX_INACTIVE) ;
+      }else if ((kTimeSyncMaster == mTimeSyncRole) && mTimeSyncInMailbox && (mb == 15)) { // SYNC frame has been sent
+        mTimeSyncInMailbox = false ;
+        sendTimeSyncFollowUp <FLEXCAN_BASE> (cs & FLEXCAN_MB_CS_TIMESTAMP_MASK) ;
       }
-      s >>= 1 ;
-      mb += 1 ;
     }
+    s >>= 1 ;
+    mb += 1 ;
+  }
+//--- Mailbox 15 is inactive after a transmission, an abort, or when the interrupt has been
+//    triggered by sendDataFrame (frame queued under contention): write the next queued frame
+  if (loadDataMailboxFromQueue <FLEXCAN_BASE> ()) {
+    events |= kTransmitSpaceEvent ;
   }
 //--- Writing its value back to itself clears all flags
-  FLEXCANb_IFLAG1 (mFlexcanBaseAddress) = status ;
+  FLEXCANb_IFLAG1 (FLEXCAN_BASE) = status ;
+//--- Event notification
+  const tEventCallBack eventCallBack = mEventCallBack ;
+  if ((events != 0) && (nullptr != eventCallBack)) {
+    eventCallBack (events, mEventUserData) ;
+  }
+  #if ACAN_INSTRUMENTATION
+    mISRDurationHistogram.record (acanCycleCount () - isrEntryCycle) ;
+  #endif
+  return mReceivedFrameCount - receivedFrameCountAtEntry ;
+}
+
+//----------------------------------------------------------------------------------------
+//   EVENT NOTIFICATION
+//----------------------------------------------------------------------------------------
+
+void ACAN::setEventCallBack (const tEventCallBack inCallBack, void * inUserData) {
+  noInterrupts () ; // Call back and user data are changed atomically
+    mEventCallBack = inCallBack ;
+    mEventUserData = inUserData ;
+  interrupts () ;
+}
+
+//----------------------------------------------------------------------------------------
+//   TIME SYNCHRONIZATION
+//----------------------------------------------------------------------------------------
+
+uint32_t ACAN::beginTimeSync (const tTimeSyncRole inRole,
+                              const tFrameFormat inFormat,
+                              const uint32_t inIdentifier) {
+  uint32_t errorCode = 0 ;
+  if (!started ()) {
+    errorCode |= kNotStarted ;
+  }else{
+    noInterrupts () ;
+      mTimeSyncRole = inRole ;
+      mTimeSyncExtended = inFormat == kExtended ;
+      mTimeSyncIdentifier = inIdentifier & defaultMask (inFormat) ;
+      mTimeSyncInMailbox = false ;
+      mTimeSyncReceived = false ;
+      mTimeSynchronized = inRole == kTimeSyncMaster ; // Master time is the global time
+      mGlobalTimeOffsetMicros = 0 ;
+    interrupts () ;
+  }
+  return errorCode ;
+}
+
+//----------------------------------------------------------------------------------------
+
+bool ACAN::isTimeSyncFrame (const CANMessage & inMessage) const {
+  return
+    (inMessage.id == mTimeSyncIdentifier) &&
+    (inMessage.ext == mTimeSyncExtended) &&
+    !inMessage.rtr &&
+    (inMessage.len >= 2)
+  ;
+}
+
+//----------------------------------------------------------------------------------------
+
+bool ACAN::sendTimeSync (void) {
+  bool sent = false ;
+  if (kTimeSyncMaster == mTimeSyncRole) {
+    CANMessage sync ;
+    sync.id = mTimeSyncIdentifier ;
+    sync.ext = mTimeSyncExtended ;
+    sync.len = 2 ;
+    sync.data [0] = kTimeSyncFrameType ;
+    sync.data [1] = mTimeSyncNextSequence ;
+    sent = tryToSend (sync) ;
+    if (sent) {
+      mTimeSyncNextSequence += 1 ;
+    }
+  }
+  return sent ;
+}
+
+//----------------------------------------------------------------------------------------
+// Message interrupt: micros () at a FlexCAN time stamp (the free running timer counts bits,
+// it wraps around after 65,536 bits, much longer than the interrupt latency)
+
+template <uint32_t FLEXCAN_BASE> uint32_t ACAN::microsOfTimeStamp (const uint32_t inFlexcanTimeStamp) const {
+  const uint32_t now = micros () ;
+  const uint32_t elapsedBits = (FLEXCANb_TIMER (FLEXCAN_BASE) - inFlexcanTimeStamp) & 0xFFFF ;
+  return now - ((elapsedBits * mMicrosPerBitQ8) >> 8) ;
+}
+
+//----------------------------------------------------------------------------------------
+// Message interrupt, master: the SYNC frame has been sent, send its time in a follow up frame
+
+template <uint32_t FLEXCAN_BASE> void ACAN::sendTimeSyncFollowUp (const uint32_t inFlexcanTimeStamp) {
+  TransmitEntry entry ;
+  CANMessage & followUp = entry.mMessage ;
+  followUp.id = mTimeSyncIdentifier ;
+  followUp.ext = mTimeSyncExtended ;
+  followUp.len = 8 ;
+  followUp.data [0] = kTimeSyncFollowUpFrameType ;
+  followUp.data [1] = mTimeSyncSequence ;
+  followUp.data32 [1] = microsOfTimeStamp <FLEXCAN_BASE> (inFlexcanTimeStamp) ;
+  #if ACAN_INSTRUMENTATION
+    entry.mEntryCycles = acanCycleCount () ;
+  #endif
+  if (mTransmitQueue.push (entry)) { // Written to mailbox 15 by the caller
+    mTimeSyncCount += 1 ;
+  }
+}
+
+//----------------------------------------------------------------------------------------
+// Message interrupt, slave
+
+void ACAN::handleTimeSyncFrame (const CANMessage & inMessage, const uint32_t inReceiveMicros) {
+  if (inMessage.data [0] == kTimeSyncFrameType) {
+    mTimeSyncSequence = inMessage.data [1] ;
+    mTimeSyncMicros = inReceiveMicros ;
+    mTimeSyncReceived = true ;
+  }else if ((inMessage.data [0] == kTimeSyncFollowUpFrameType) &&
+            (inMessage.len == 8) &&
+            mTimeSyncReceived &&
+            (inMessage.data [1] == mTimeSyncSequence)) {
+    mTimeSyncReceived = false ;
+    mGlobalTimeOffsetMicros = (int32_t) (inMessage.data32 [1] - mTimeSyncMicros) ;
+    mTimeSynchronized = true ;
+    mTimeSyncCount += 1 ;
+  }
+}
+
+//----------------------------------------------------------------------------------------
+//   TIME TRIGGERED TRANSMISSION
+//----------------------------------------------------------------------------------------
+
+uint32_t ACAN::beginTimeTriggeredTransmit (const uint32_t inScheduleSize,
+                                           const uint32_t inResolutionMicros) {
+  endTimeTriggeredTransmit () ;
+  uint32_t errorCode = 0 ;
+  if (!started ()) {
+    errorCode |= kNotStarted ;
+  }else if (inScheduleSize > 0) {
+    mSchedule = new ScheduledFrame [inScheduleSize] ;
+    mScheduleSize = inScheduleSize ;
+    #ifdef __MK66FX1M0__
+      void (* timerISR) (void) = (flexcanBase (mFlexcanBaseAddress) == FLEXCAN0_BASE)
+        ? timeTriggerTimerISR <FLEXCAN0_BASE>
+        : timeTriggerTimerISR <FLEXCAN1_BASE>
+      ;
+    #else
+      void (* timerISR) (void) = timeTriggerTimerISR <FLEXCAN0_BASE> ;
+    #endif
+    mTimeTriggerTimer = new IntervalTimer () ;
+    mTimeTriggerTimer->priority (mMessageIRQPriority) ;
+    if (!mTimeTriggerTimer->begin (timerISR, imax (inResolutionMicros, (uint32_t) 10))) {
+      errorCode |= kNoTimeTriggerTimer ;
+      endTimeTriggeredTransmit () ;
+    }
+  }
+  return errorCode ;
+}
+
+//----------------------------------------------------------------------------------------
+
+void ACAN::endTimeTriggeredTransmit (void) {
+  if (nullptr != mTimeTriggerTimer) {
+    mTimeTriggerTimer->end () ;
+    delete mTimeTriggerTimer ; mTimeTriggerTimer = nullptr ;
+  }
+  delete [] mSchedule ; mSchedule = nullptr ;
+  mScheduleSize = 0 ;
+  mScheduledFrameCount = 0 ;
+  mMaxReleaseLatenessMicros = 0 ;
+}
+
+//----------------------------------------------------------------------------------------
+
+bool ACAN::tryToSendAt (const CANMessage & inMessage, const uint32_t inGlobalMicros) {
+  bool scheduled = false ;
+  if (!inMessage.rtr) {
+    const uint32_t primask = saveAndDisableInterrupts () ; // tryToSendAt may be called from an ISR
+      uint32_t index = mScheduledFrameCount ;
+      scheduled = index < mScheduleSize ;
+      if (scheduled) { // Insert, keeping decreasing release times (same time: first in, first out)
+        while ((index > 0) && ((int32_t) (mSchedule [index - 1].mGlobalMicros - inGlobalMicros) <= 0)) {
+          mSchedule [index] = mSchedule [index - 1] ;
+          index -= 1 ;
+        }
+        mSchedule [index].mMessage = inMessage ;
+        mSchedule [index].mGlobalMicros = inGlobalMicros ;
+        mScheduledFrameCount += 1 ;
+      }
+    restoreInterrupts (primask) ;
+  }
+  return scheduled ;
+}
+
+//----------------------------------------------------------------------------------------
+
+template <uint32_t FLEXCAN_BASE> void ACAN::timeTriggerTimerISR (void) {
+  #ifdef __MK66FX1M0__
+    ACAN & driver = (FLEXCAN_BASE == FLEXCAN0_BASE) ? can0 : can1 ;
+  #else
+    ACAN & driver = can0 ;
+  #endif
+  driver.releaseScheduledFrames <FLEXCAN_BASE> () ;
+}
+
+//----------------------------------------------------------------------------------------
+// Timer interrupt: due frames are written into the transmit buffer (a frame that does not
+// fit is retried on next tick)
+
+template <uint32_t FLEXCAN_BASE> void ACAN::releaseScheduledFrames (void) {
+  const uint32_t primask = saveAndDisableInterrupts () ; // tryToSendAt may be called from a higher priority ISR
+    const uint32_t now = globalMicros () ;
+    bool release = mScheduledFrameCount > 0 ;
+    while (release) {
+      const ScheduledFrame & frame = mSchedule [mScheduledFrameCount - 1] ;
+      const int32_t lateness = (int32_t) (now - frame.mGlobalMicros) ;
+      release = (lateness >= 0) && sendDataFrame <FLEXCAN_BASE> (frame.mMessage) ;
+      if (release) {
+        if ((uint32_t) lateness > mMaxReleaseLatenessMicros) {
+          mMaxReleaseLatenessMicros = (uint32_t) lateness ;
+        }
+        mScheduledFrameCount -= 1 ;
+        release = mScheduledFrameCount > 0 ;
+      }
+    }
+  restoreInterrupts (primask) ;
+}
+
+//----------------------------------------------------------------------------------------
+//   INSTRUMENTATION
+//----------------------------------------------------------------------------------------
+
+#if ACAN_INSTRUMENTATION
+  void ACAN::resetHistograms (void) {
+    noInterrupts () ;
+      mISRDurationHistogram.reset () ;
+      mReceiveResidencyHistogram.reset () ;
+      mTransmitResidencyHistogram.reset () ;
+    interrupts () ;
+  }
+#endif
+
+//----------------------------------------------------------------------------------------
+//   POLLING MODE
+//----------------------------------------------------------------------------------------
+
+uint32_t ACAN::poll (void) {
+  uint32_t frameCount = 0 ;
+  if (mPollingMode) {
+    noInterrupts () ; // tryToSend, receive may be called from other interrupts
+      mPollCount += 1 ;
+      #ifdef __MK66FX1M0__
+        if (flexcanBase (mFlexcanBaseAddress) == FLEXCAN1_BASE) {
+          frameCount = message_isr <FLEXCAN1_BASE> () ;
+        }else{
+          frameCount = message_isr <FLEXCAN0_BASE> () ;
+        }
+      #else
+        frameCount = message_isr <FLEXCAN0_BASE> () ;
+      #endif
+    interrupts () ;
+  }
+  return frameCount ;
+}
+
+//----------------------------------------------------------------------------------------
+
+uint32_t ACAN::poll (CANMessage outMessages [], const uint32_t inMaxCount) {
+  poll () ;
+  uint32_t count = 0 ;
+  while ((count < inMaxCount) && receive (outMessages [count])) {
+    count += 1 ;
+  }
+  return count ;
+}
+
+//----------------------------------------------------------------------------------------
+//   FILTER UPDATE
+//----------------------------------------------------------------------------------------
+
+uint32_t ACAN::updateFilters (const ACANPrimaryFilter inPrimaryFilters [],
+                              const uint32_t inPrimaryFilterCount,
+                              const ACANSecondaryFilter inSecondaryFilters [],
+                              const uint32_t inSecondaryFilterCount) {
+  uint32_t errorCode = 0 ;
+//--- Check filters before touching the controller
+  const uint32_t MAX_PRIMARY_FILTER_COUNT = primaryFilterCountForConfiguration (mConfiguration) ;
+  const uint32_t MAX_SECONDARY_FILTER_COUNT = secondaryFilterCountForConfiguration (mConfiguration) ;
+  if (!started ()) {
+    errorCode |= kNotStarted ;
+  }
+  if (inPrimaryFilterCount > MAX_PRIMARY_FILTER_COUNT) {
+    errorCode |= kTooMuchPrimaryFilters ;
+  }
+  if (inSecondaryFilterCount > MAX_SECONDARY_FILTER_COUNT) {
+    errorCode |= kTooMuchSecondaryFilters ;
+  }
+  for (uint32_t i=0 ; (i<inPrimaryFilterCount) && (0 == errorCode) ; i++) {
+    if ((inPrimaryFilters [i].mAcceptanceFilter & 1) != 0) {
+      errorCode |= kNotConformPrimaryFilter ;
+    }
+  }
+  for (uint32_t i=0 ; (i<inSecondaryFilterCount) && (0 == errorCode) ; i++) {
+    if ((inSecondaryFilters [i].mSingleAcceptanceFilter & 1) != 0) {
+      errorCode |= kNotConformSecondaryFilter ;
+    }
+  }
+  if (0 == errorCode) {
+    const uint32_t base = flexcanBase (mFlexcanBaseAddress) ;
+    const uint32_t freezeStart = micros () ;
+    enterFreezeMode (base) ;
+  //--- Frames in receive buffer refer to former filters
+    noInterrupts () ;
+      for (uint32_t c=0 ; c<ACANSettings::kReceiveClassCount ; c++) {
+        ReceiveQueue & queue = mReceiveQueue [c] ;
+        for (uint32_t i=0 ; i<queue.mCount ; i++) {
+          queue.mBuffer [(queue.mReadIndex + i) % queue.mSize].idx = kFormerFilterIndex ;
+        }
+      }
+    interrupts () ;
+  //--- Replace filter tables and registers
+    freeFilterTables () ;
+    installFilterTables (inPrimaryFilters, inPrimaryFilterCount, inSecondaryFilters, inSecondaryFilterCount) ;
+    writeFilterRegisters (base, mConfiguration,
+                          inPrimaryFilters, inPrimaryFilterCount,
+                          inSecondaryFilters, inSecondaryFilterCount) ;
+    exitFreezeMode (base) ;
+    mLastFilterUpdateFrozenMicros = micros () - freezeStart ;
+  }
+  return errorCode ;
+}
+
+
+//----------------------------------------------------------------------------------------
+// Disable message interrupt, enter freeze mode (current frame is completed). Frames in
+// RxFIFO have been accepted by the current filters: they are handled now.
+
+void ACAN::enterFreezeMode (const uint32_t inFlexcanBase) {
+  NVIC_DISABLE_IRQ (FLEXCAN_MODULE (inFlexcanBase, kMessageIRQ)) ;
+  FLEXCANb_MCR (inFlexcanBase) |= FLEXCAN_MCR_HALT ;
+  while (!(FLEXCANb_MCR (inFlexcanBase) & FLEXCAN_MCR_FRZ_ACK)) {}
+  while ((FLEXCANb_IFLAG1 (inFlexcanBase) & (1 << 5)) != 0) {
+    #ifdef __MK66FX1M0__
+      if (inFlexcanBase == FLEXCAN1_BASE) {
+        message_isr <FLEXCAN1_BASE> () ;
+      }else{
+        message_isr <FLEXCAN0_BASE> () ;
+      }
+    #else
+      message_isr <FLEXCAN0_BASE> () ;
+    #endif
+  }
+}
+
+//----------------------------------------------------------------------------------------
+
+void ACAN::exitFreezeMode (const uint32_t inFlexcanBase) {
+  FLEXCANb_MCR (inFlexcanBase) &= ~FLEXCAN_MCR_HALT ;
+  while (FLEXCANb_MCR (inFlexcanBase) & FLEXCAN_MCR_FRZ_ACK) {}
+  while (FLEXCANb_MCR (inFlexcanBase) & FLEXCAN_MCR_NOT_RDY) {}
+  if (!mPollingMode) {
+    NVIC_ENABLE_IRQ (FLEXCAN_MODULE (inFlexcanBase, kMessageIRQ)) ;
+  }
+}
+
+//----------------------------------------------------------------------------------------
+//   REMOTE FRAME RESPONDERS
+//----------------------------------------------------------------------------------------
+// A mailbox with the TX_RESPONSE code answers a matching remote frame, provided the
+// CTRL2.RRS bit is cleared (otherwise remote frames are stored). Responder mailboxes are
+// allocated from mailbox 14 downwards.
+
+int32_t ACAN::responderMailboxIndex (const uint32_t inFlexcanBase, const CANMessage & inResponse) const {
+  const uint32_t identifier = inResponse.ext
+    ? (inResponse.id & FLEXCAN_MB_ID_EXT_MASK)
+    : FLEXCAN_MB_ID_IDSTD (inResponse.id)
+  ;
+  const uint32_t firstTxMailBoxIndex = 15 ;
+  int32_t result = -1 ;
+  for (uint32_t i=1 ; (i<=mRemoteResponderCount) && (result < 0) ; i++) {
+    const uint32_t index = firstTxMailBoxIndex - i ;
+    const bool extended = (FLEXCANb_MBn_CS (inFlexcanBase, index) & FLEXCAN_MB_CS_IDE) != 0 ;
+    if ((extended == inResponse.ext) && (FLEXCANb_MBn_ID (inFlexcanBase, index) & FLEXCAN_MB_ID_EXT_MASK) == identifier) {
+      result = (int32_t) index ;
+    }
+  }
+  return result ;
+}
+
+//----------------------------------------------------------------------------------------
+
+uint32_t ACAN::addRemoteResponder (const CANMessage & inResponse) {
+  const uint32_t firstTxMailBoxIndex = 15 ;
+  const uint32_t base = flexcanBase (mFlexcanBaseAddress) ;
+  uint32_t errorCode = 0 ;
+  if (!started ()) {
+    errorCode |= kNotStarted ;
+  }else if (updateResponse (inResponse)) {
+    // Already registered, response is updated
+  }else{
+    const uint32_t index = firstTxMailBoxIndex - 1 - mRemoteResponderCount ;
+    bool available = index >= mMaxPrimaryFilterCount ;
+  //--- Claim the mailbox, so that a concurrent remote frame sender does not write it
+    const uint32_t claim = available ? (1U << index) : 0 ;
+    if (available) {
+      available = (__atomic_fetch_or (& mRemoteMailboxClaims, claim, __ATOMIC_ACQUIRE) & claim) == 0 ;
+      if (available) { // Is the mailbox sending a remote frame ?
+        const uint32_t code = FLEXCAN_get_code (FLEXCANb_MBn_CS (base, index)) ;
+        available = code != FLEXCAN_MB_CODE_TX_ONCE ;
+        if (!available) {
+          __atomic_fetch_and (& mRemoteMailboxClaims, ~ claim, __ATOMIC_RELEASE) ;
+        }
+      }
+    }
+    if (!available) {
+      errorCode |= kNoResponderMailbox ;
+    }else{
+      enterFreezeMode (base) ;
+    //--- All identifier bits are compared (individual mask can only be written in freeze mode)
+      FLEXCANb_MB_MASK (base, index) = FLEXCAN_MB_ID_EXT_MASK ;
+      CANMessage response = inResponse ;
+      response.rtr = false ;
+      writeTxRegisters (base, response, index, FLEXCAN_MB_CODE_TX_RESPONSE) ;
+    //--- Remote frames are answered, not stored
+      FLEXCANb_CTRL2 (base) &= ~ (1 << 17) ;
+      mRemoteResponderCount += 1 ;
+    //--- The mailbox is now out of the remote frame sending range
+      __atomic_fetch_and (& mRemoteMailboxClaims, ~ claim, __ATOMIC_RELEASE) ;
+      exitFreezeMode (base) ;
+    }
+  }
+  return errorCode ;
+}
+
+//----------------------------------------------------------------------------------------
+
+void ACAN::removeRemoteResponders (void) {
+  if ((started ()) && (mRemoteResponderCount > 0)) {
+    const uint32_t firstTxMailBoxIndex = 15 ;
+    const uint32_t base = flexcanBase (mFlexcanBaseAddress) ;
+    enterFreezeMode (base) ;
+    for (uint32_t i=1 ; i<=mRemoteResponderCount ; i++) {
+      FLEXCANb_MB_MASK (base, firstTxMailBoxIndex - i) = 0 ;
+      FLEXCANb_MBn_CS (base, firstTxMailBoxIndex - i) = FLEXCAN_MB_CS_CODE (FLEXCAN_MB_CODE_TX_INACTIVE) ;
+    }
+    FLEXCANb_CTRL2 (base) |= 1 << 17 ; // RRS: remote request frames are stored
+    mRemoteResponderCount = 0 ;
+    exitFreezeMode (base) ;
+  }
 }
 
 //----------------------------------------------------------------------------------------
+// The mailbox is deactivated while data is written: a response in progress is completed
+// with the previous data, a remote frame received meanwhile is not answered.
+
+bool ACAN::updateResponse (const CANMessage & inResponse) {
+  const uint32_t base = flexcanBase (mFlexcanBaseAddress) ;
+  const int32_t index = responderMailboxIndex (base, inResponse) ;
+  const bool found = index >= 0 ;
+  if (found) {
+    CANMessage response = inResponse ;
+    response.rtr = false ;
+    noInterrupts () ;
+      writeTxRegisters (base, response, (uint32_t) index, FLEXCAN_MB_CODE_TX_RESPONSE) ;
+    interrupts () ;
+  }
+  return found ;
+}
+//----------------------------------------------------------------------------------------
+
+// Only the interrupt entry points count message interrupts (not poll, not freeze mode)
 
 void can0_message_isr (void) {
-  ACAN::can0.message_isr () ;
+  ACAN::can0.mMessageInterruptCount += 1 ;
+  ACAN::can0.message_isr <FLEXCAN0_BASE> () ;
 }
 
 //----------------------------------------------------------------------------------------
 
 #ifdef __MK66FX1M0__
   void can1_message_isr (void) {
-    ACAN::can1.message_isr () ;
+    ACAN::can1.mMessageInterruptCount += 1 ;
+    ACAN::can1.message_isr <FLEXCAN1_BASE> () ;
   }
 #endif
 
@@ -785,7 +2233,7 @@ void can0_message_isr (void) {
 //----------------------------------------------------------------------------------------
 
 tControllerState ACAN::controllerState (void) const {
-  uint32_t state = (FLEXCANb_ESR1 (mFlexcanBaseAddress) >> 4) & 0x03 ;
+  uint32_t state = (FLEXCANb_ESR1 (flexcanBase (mFlexcanBaseAddress)) >> 4) & 0x03 ;
 //--- Bus-off state is value 2 or value 3
   if (state == 3) {
     state = 2 ;
@@ -796,7 +2244,7 @@ tControllerState ACAN::controllerState (void) const {
 //----------------------------------------------------------------------------------------
 
 uint32_t ACAN::receiveErrorCounter (void) const {
-  return FLEXCANb_ECR (mFlexcanBaseAddress) >> 8 ;
+  return FLEXCANb_ECR (flexcanBase (mFlexcanBaseAddress)) >> 8 ;
 }
 
 //----------------------------------------------------------------------------------------
@@ -804,7 +2252,7 @@ uint32_t ACAN::receiveErrorCounter (void) const {
 uint32_t ACAN::transmitErrorCounter (void) const {
 //--- In bus-off state, TXERRCNT field of CANx_ECR register does not reflect transmit error count: we force 256
   const tControllerState state = controllerState () ;
-  return (state == kBusOff) ? 256 : (FLEXCANb_ECR (mFlexcanBaseAddress) & 0xFF) ;
+  return (state == kBusOff) ? 256 : (FLEXCANb_ECR (flexcanBase (mFlexcanBaseAddress)) & 0xFF) ;
 }
 
 //----------------------------------------------------------------------------------------
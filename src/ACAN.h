@@ -11,55 +11,77 @@
 
 #include <ACANSettings.h>
 #include <ACAN_CANMessage.h>
+#include <ACANFilters.h>
+#include <ACANInstrumentation.h>
+#include <ACANTransmitQueue.h>
+#include <ACANDriverInterface.h>
 
 //----------------------------------------------------------------------------------------
 
-typedef enum {kActive, kPassive, kBusOff} tControllerState ;
+class ACANBusLogger ;
+class ACANCyclicSupervisor ;
 
 //----------------------------------------------------------------------------------------
+// Gateway route (Teensy 3.6): a received data frame whose identifier satisfies
+// (identifier & mMask) == mAcceptance is forwarded to the other CAN module, with
+// identifier (identifier & ~mRemapMask) | mRemapValue. Remote frames are not forwarded.
 
-class ACANPrimaryFilter {
-  public: uint32_t mFilterMask ;
-  public: uint32_t mAcceptanceFilter ;
-  public: ACANCallBackRoutine mCallBackRoutine ;
+class ACANGatewayRoute {
+  public: bool mExtended ;
+  public: uint32_t mMask ;
+  public: uint32_t mAcceptance ;
+  public: uint32_t mRemapMask ;
+  public: uint32_t mRemapValue ;
 
-  public: inline ACANPrimaryFilter (const ACANCallBackRoutine inCallBackRoutine = nullptr) :  // Accept any frame
-  mFilterMask (0),
-  mAcceptanceFilter (0),
-  mCallBackRoutine (inCallBackRoutine) {
+  public: inline ACANGatewayRoute (void) : // Forward any standard frame
+  mExtended (false),
+  mMask (0),
+  mAcceptance (0),
+  mRemapMask (0),
+  mRemapValue (0) {
   }
 
-  public: ACANPrimaryFilter (const tFrameKind inKind,
-                             const tFrameFormat inFormat, // Accept any identifier
-                             const ACANCallBackRoutine inCallBackRoutine = nullptr) ;
+  public: ACANGatewayRoute (const tFrameFormat inFormat, // Forward any identifier
+                            const uint32_t inRemapMask = 0,
+                            const uint32_t inRemapValue = 0) ;
 
-  public: ACANPrimaryFilter (const tFrameKind inKind,
-                             const tFrameFormat inFormat,
-                             const uint32_t inIdentifier,
-                             const ACANCallBackRoutine inCallBackRoutine = nullptr) ;
-
-  public: ACANPrimaryFilter (const tFrameKind inKind,
-                             const tFrameFormat inFormat,
-                             const uint32_t inMask,
-                             const uint32_t inAcceptance,
-                             const ACANCallBackRoutine inCallBackRoutine = nullptr) ;
+  public: ACANGatewayRoute (const tFrameFormat inFormat,
+                            const uint32_t inMask,
+                            const uint32_t inAcceptance,
+                            const uint32_t inRemapMask = 0,
+                            const uint32_t inRemapValue = 0) ;
 } ;
 
 //----------------------------------------------------------------------------------------
+// Transmit rate limit: frames sent by tryToSend whose identifier satisfies
+// (identifier & mMask) == mAcceptance are limited to mFramesPerSecond, with bursts of
+// mBurstFrameCount frames. The first matching limit applies.
+
+class ACANTransmitRateLimit {
+  public: bool mExtended ;
+  public: uint32_t mMask ;
+  public: uint32_t mAcceptance ;
+  public: uint32_t mFramesPerSecond ;
+  public: uint32_t mBurstFrameCount ;
 
-class ACANSecondaryFilter {
-  public: uint32_t mSingleAcceptanceFilter ;
-  public: ACANCallBackRoutine mCallBackRoutine ;
+  public: inline ACANTransmitRateLimit (void) : // No limit
+  mExtended (false),
+  mMask (0),
+  mAcceptance (0),
+  mFramesPerSecond (0),
+  mBurstFrameCount (1) {
+  }
 
-  public: ACANSecondaryFilter (const tFrameKind inKind,
-                               const tFrameFormat inFormat,
-                               const uint32_t inIdentifier,
-                               const ACANCallBackRoutine inCallBackRoutine = nullptr) ;
+  public: ACANTransmitRateLimit (const tFrameFormat inFormat,
+                                 const uint32_t inMask,
+                                 const uint32_t inAcceptance,
+                                 const uint32_t inFramesPerSecond,
+                                 const uint32_t inBurstFrameCount = 1) ;
 } ;
 
 //----------------------------------------------------------------------------------------
 
-class ACAN {
+class ACAN : public ACANDriverInterface <ACAN> {
 //--- Constructor
   private: ACAN (const uint32_t inFlexcanBaseAddress) ;
 
@@ -80,25 +102,203 @@ class ACAN {
                           const ACANSecondaryFilter inSecondaryFilters [] = nullptr,
                           const uint32_t inSecondaryFilterCount = 0) ;
 
+//--- Interrupt coalescing backstop timer cannot be allocated (begin falls back on an
+//    interrupt per frame)
+  public: static const uint32_t kNoCoalescingTimer = 1 << 21 ;
+
 //--- end: stop CAN controller
   public: void end (void) ;
 
-//--- Transmitting messages
+//--- Replace filters while the controller is running: the controller is briefly frozen
+//    (buffers, transmit queue and driver statistics are kept, per filter statistics are
+//    reset). Returns an error code (filters are not changed if it is not 0). Frames already
+//    in the receive buffer were accepted by a former filter: their idx is set to
+//    kFormerFilterIndex, dispatchReceivedMessage does not call any filter call back for them.
+  public: static const uint32_t kNotStarted = 1 << 20 ;
+  public: static const uint8_t kFormerFilterIndex = 0xFF ;
+  public: uint32_t updateFilters (const ACANPrimaryFilter inPrimaryFilters [],
+                                  const uint32_t inPrimaryFilterCount,
+                                  const ACANSecondaryFilter inSecondaryFilters [] = nullptr,
+                                  const uint32_t inSecondaryFilterCount = 0) ;
+//--- Duration of the last filter update, from freeze request to bus activity resumption
+  public: inline uint32_t lastFilterUpdateFrozenMicros (void) const { return mLastFilterUpdateFrozenMicros ; }
+
+//--- Remote frame responders: a spare mailbox (above the RxFIFO filter table) answers
+//    remote frames with the identifier of inResponse in hardware, without interrupt. A remote
+//    frame accepted by a RxFIFO filter is stored instead (use kData filters). Responders
+//    share spare mailboxes with remote frame sending (tryToSend). Adding and removing
+//    responders briefly freezes the controller; registering an identifier again updates
+//    its response.
+  public: static const uint32_t kNoResponderMailbox = 1 << 22 ;
+  public: uint32_t addRemoteResponder (const CANMessage & inResponse) ;
+  public: void removeRemoteResponders (void) ;
+  public: inline uint32_t remoteResponderCount (void) const { return mRemoteResponderCount ; }
+//--- Replace the response data of a responder (identifier and format of inResponse select it);
+//    the response frame is never sent half updated. Returns false if there is no responder.
+  public: bool updateResponse (const CANMessage & inResponse) ;
+
+//--- Transmitting messages: tryToSend can be called from any context (loop, threads,
+//    interrupt service routines) concurrently, without disabling interrupts while data frames
+//    are queued. Data frames are always queued, the message interrupt writes them to mailbox
+//    15 (in polling mode, poll does). The transmit buffer size is rounded up to a power of two.
   public: bool tryToSend (const CANMessage & inMessage) ;
-  public: inline uint32_t transmitBufferSize (void) const { return mTransmitBufferSize ; }
-  public: inline uint32_t transmitBufferCount (void) const { return mTransmitBufferCount ; }
-  public: inline uint32_t transmitBufferPeakCount (void) const { return mTransmitBufferPeakCount ; }
+  public: inline uint32_t transmitBufferSize (void) const { return mTransmitQueue.capacity () ; }
+  public: inline uint32_t transmitBufferCount (void) const { return mTransmitQueue.count () ; }
+  public: inline uint32_t transmitBufferPeakCount (void) const { return mTransmitQueue.peakCount () ; }
+
+//--- Transmit watchdog (see ACANSettings::mTransmitTimeoutMillis): the timeout is checked by
+//    tryToSend and by checkTransmitTimeout (call it from loop if no frame is sent). The call
+//    back is called from the message interrupt service routine with the aborted frame.
+  public: typedef void (*tTransmitTimeoutCallBack) (const CANMessage & inMessage) ;
+  public: inline void setTransmitTimeoutCallBack (const tTransmitTimeoutCallBack inCallBack) { mTransmitTimeoutCallBack = inCallBack ; }
+  public: void checkTransmitTimeout (void) ;
+  public: inline uint32_t transmitTimeoutCount (void) const { return mTransmitTimeoutCount ; }
+  public: inline uint32_t transmitFlushedCount (void) const { return mTransmitFlushedCount ; }
+
+//--- Transmit rate limits and bus share cap: tryToSend returns false for a frame over its
+//    identifier rate limit, or over the bus share (percent of the actual bit rate, computed
+//    from the worst case frame bit length; 0 --> no cap). Limits are copied.
+  public: void setTransmitRateLimits (const ACANTransmitRateLimit inLimits [], const uint32_t inLimitCount) ;
+  public: void setTransmitBusShare (const uint32_t inPercent, const uint32_t inBurstFrameCount = 8) ;
+  public: inline uint32_t transmitRateLimitedCount (void) const { return mTransmitRateLimitedCount ; }
+  public: inline uint32_t transmitBusShareLimitedCount (void) const { return mTransmitBusShareLimitedCount ; }
 
 //--- Receiving messages
   public: inline bool available (void) const { return mReceiveBufferCount > 0 ; }
   public: bool receive (CANMessage & outMessage) ;
   public: typedef void (*tFilterMatchCallBack) (const uint32_t inFilterIndex) ;
   public: bool dispatchReceivedMessage (const tFilterMatchCallBack inFilterMatchCallBack = nullptr) ;
+
+//--- Zero copy reception: peek returns the number of contiguous frames of the highest non
+//    empty receive class (0 if none), outMessages is set to the first one. Frames are read in
+//    place, they remain valid until consume releases them (inCount is at most the value
+//    returned by peek).
+  public: uint32_t peek (const CANMessage * & outMessages) ;
+  public: void consume (const uint32_t inCount) ;
+//--- Batch reception (ACANDriverInterface): peek and consume, so interrupts are disabled
+//    once per run of contiguous frames, not once per frame; cancels a pending peek
+  public: uint32_t receiveBatch (CANMessage outMessages [], const uint32_t inMaxCount) ;
   public: inline uint32_t receiveBufferSize (void) const { return mReceiveBufferSize ; }
   public: inline uint32_t receiveBufferCount (void) const { return mReceiveBufferCount ; }
   public: inline uint32_t receiveBufferPeakCount (void) const { return mReceiveBufferPeakCount ; }
   public: inline uint8_t flexcanRxFIFOFlags (void) const { return mFlexcanRxFIFOFlags ; }
 
+//--- Polling mode (see ACANSettings::mPollingMode): poll reads at most 6 frames (the RxFIFO
+//    depth) into the receive buffers, and refills the transmit mailbox; it returns the number
+//    of read frames. The second form also moves received frames into outMessages (at most
+//    inMaxCount frames), and returns their count.
+  public: uint32_t poll (void) ;
+  public: uint32_t poll (CANMessage outMessages [], const uint32_t inMaxCount) ;
+
+//--- Interrupt statistics (see ACANSettings::mInterruptCoalescing): message interrupts
+//    (poll calls are not counted), and poll calls that did run in polling mode
+  public: inline uint32_t messageInterruptCount (void) const { return mMessageInterruptCount ; }
+  public: inline uint32_t pollCount (void) const { return mPollCount ; }
+  public: inline uint32_t receivedFrameCount (void) const { return mReceivedFrameCount ; }
+
+//--- Instrumentation (see ACANInstrumentation.h), in cycles: message interrupt service
+//    routine duration, time spent by frames in the receive buffers (until receive or
+//    consume), and in the transmit buffer (until written to mailbox 15)
+  #if ACAN_INSTRUMENTATION
+    public: inline const ACANLatencyHistogram & isrDurationHistogram (void) const { return mISRDurationHistogram ; }
+    public: inline const ACANLatencyHistogram & receiveResidencyHistogram (void) const { return mReceiveResidencyHistogram ; }
+    public: inline const ACANLatencyHistogram & transmitResidencyHistogram (void) const { return mTransmitResidencyHistogram ; }
+    public: void resetHistograms (void) ;
+  #endif
+
+//--- Receive classes (see ACANSettings): above methods cumulate all classes
+  public: inline uint32_t receiveBufferSize (const ACANSettings::tReceiveClass inClass) const { return mReceiveQueue [inClass].mSize ; }
+  public: inline uint32_t receiveBufferCount (const ACANSettings::tReceiveClass inClass) const { return mReceiveQueue [inClass].mCount ; }
+  public: inline uint32_t receiveBufferPeakCount (const ACANSettings::tReceiveClass inClass) const { return mReceiveQueue [inClass].mPeakCount ; }
+  public: inline uint32_t receiveBufferDroppedCount (const ACANSettings::tReceiveClass inClass) const { return mReceiveQueue [inClass].mDroppedCount ; }
+
+//--- Receive buffer watermarks and overflow (see ACANSettings); the call back is called from
+//    the message interrupt service routine (high watermark) and from receive (low watermark)
+  public: typedef void (*tReceiveWatermarkCallBack) (const bool inHighWatermarkReached) ;
+  public: inline void setReceiveWatermarkCallBack (const tReceiveWatermarkCallBack inCallBack) { mReceiveWatermarkCallBack = inCallBack ; }
+  public: inline uint32_t receiveBufferDroppedCount (void) const { return mReceiveBufferDroppedCount ; }
+  public: uint32_t filterDroppedCount (const uint32_t inFilterIndex) const ;
+
+//--- Filter statistics, maintained by the message interrupt service routine: frames
+//    accepted by the filter (before on change only suppression and overflow), micros () of
+//    the last one, frames outside the intended identifiers (see
+//    ACANPrimaryFilter::withIntendedIdentifiers). updateFilters resets them.
+  public: uint32_t filterMatchedCount (const uint32_t inFilterIndex) const ;
+  public: uint32_t filterLastSeenMicros (const uint32_t inFilterIndex) const ;
+  public: uint32_t filterFalseAcceptCount (const uint32_t inFilterIndex) const ;
+  public: inline uint32_t falseAcceptCount (void) const { return mFalseAcceptCount ; }
+  public: void resetFilterStatistics (void) ;
+
+//--- Frames discarded by on change only filters (see ACANPrimaryFilter::withOnChangeOnly)
+  public: inline uint32_t suppressedFrameCount (void) const { return mSuppressedFrameCount ; }
+  public: uint32_t filterSuppressedCount (const uint32_t inFilterIndex) const ;
+
+//--- Bus logger: every received frame is appended to the logger by the message interrupt
+//    service routine (nullptr for detaching)
+  public: inline void setBusLogger (ACANBusLogger * inBusLogger) { mBusLogger = inBusLogger ; }
+
+//--- Cyclic frame supervision: the message interrupt service routine refreshes the
+//    supervisor with every received frame and its reception time (micros () time base,
+//    from the FlexCAN time stamp); call its poll method from loop (nullptr for detaching)
+  public: inline void setCyclicSupervisor (ACANCyclicSupervisor * inSupervisor) { mCyclicSupervisor = inSupervisor ; }
+
+//--- Event notification: the call back is called at the end of the message interrupt
+//    service routine when frames have been stored in the receive buffer (kReceiveEvent)
+//    and / or a frame has left the transmit buffer (kTransmitSpaceEvent). Keep it short:
+//    wake a task, set a flag (nullptr for detaching).
+  public: static const uint32_t kReceiveEvent       = 1 << 0 ;
+  public: static const uint32_t kTransmitSpaceEvent = 1 << 1 ;
+  public: typedef void (*tEventCallBack) (const uint32_t inEvents, void * inUserData) ;
+  public: void setEventCallBack (const tEventCallBack inCallBack, void * inUserData = nullptr) ;
+
+//--- Time synchronization: the master sends SYNC frames (sendTimeSync, call it periodically),
+//    then the message interrupt service routine sends a follow up frame carrying the SYNC
+//    send time; slaves compute the offset between their micros () and the master one. Both
+//    frames use inIdentifier (data byte 0 is the frame type), send and receive times come
+//    from FlexCAN time stamps (start of identifier field): precision is a few microseconds.
+//    Slaves consume them: a filter should accept them. Returns kNotStarted if begin has not
+//    been called.
+  public: typedef enum {kTimeSyncOff, kTimeSyncMaster, kTimeSyncSlave} tTimeSyncRole ;
+  public: uint32_t beginTimeSync (const tTimeSyncRole inRole,
+                                  const tFrameFormat inFormat,
+                                  const uint32_t inIdentifier) ;
+  public: bool sendTimeSync (void) ; // Master only
+  public: inline bool timeSynchronized (void) const { return mTimeSynchronized ; }
+  public: inline int32_t globalTimeOffsetMicros (void) const { return mGlobalTimeOffsetMicros ; }
+  public: inline uint32_t globalMicros (void) const { return micros () + (uint32_t) mGlobalTimeOffsetMicros ; }
+  public: inline uint32_t timeSyncCount (void) const { return mTimeSyncCount ; }
+
+//--- Time triggered transmission: tryToSendAt schedules a data frame for a global time
+//    (see globalMicros); a timer interrupt (period inResolutionMicros, at the message
+//    interrupt priority) releases due frames into the transmit buffer. Frames are sent in
+//    release order. Returns kNotStarted, or kNoTimeTriggerTimer if no timer is available.
+  public: static const uint32_t kNoTimeTriggerTimer = 1 << 24 ;
+  public: uint32_t beginTimeTriggeredTransmit (const uint32_t inScheduleSize,
+                                               const uint32_t inResolutionMicros = 50) ;
+  public: void endTimeTriggeredTransmit (void) ;
+  public: bool tryToSendAt (const CANMessage & inMessage, const uint32_t inGlobalMicros) ;
+  public: inline uint32_t scheduledFrameCount (void) const { return mScheduledFrameCount ; }
+  public: inline uint32_t maxReleaseLatenessMicros (void) const { return mMaxReleaseLatenessMicros ; }
+
+//--- Gateway (Teensy 3.6): frames matching a route are written by the message interrupt
+//    service routine into the transmit path of inDestination (nullptr disables gateway).
+//    They are not stored in the receive buffer. inMaxFramesPerSecond limits the forwarding
+//    rate (0 --> no limit), allowing bursts of inBurstFrameCount frames.
+  #ifdef __MK66FX1M0__
+    public: static const uint32_t kGatewayDestinationIsSource = 1 << 19 ;
+    public: uint32_t setGatewayRoutes (ACAN * inDestination,
+                                       const ACANGatewayRoute inRoutes [],
+                                       const uint32_t inRouteCount,
+                                       const uint32_t inMaxFramesPerSecond = 0,
+                                       const uint32_t inBurstFrameCount = 8) ;
+    public: inline uint32_t gatewayForwardedCount (void) const { return mGatewayForwardedCount ; }
+    public: inline uint32_t gatewayDroppedCount (void) const { return mGatewayDroppedCount ; } // Destination buffer full
+    public: inline uint32_t gatewayRateLimitedCount (void) const { return mGatewayRateLimitedCount ; }
+  //--- Maximum duration from interrupt entry to frame handed to destination, in CPU cycles
+    public: inline uint32_t gatewayMaxLatencyCycles (void) const { return mGatewayMaxLatencyCycles ; }
+    public: void resetGatewayStatistics (void) ;
+  #endif
+
 //--- FlexCAN controller state
   public: tControllerState controllerState (void) const ;
   public: uint32_t receiveErrorCounter (void) const ;
@@ -111,29 +311,213 @@ class ACAN {
 //--- Base address
   private: const uint32_t mFlexcanBaseAddress ; // Initialized in constructor
 
-//--- Driver receive buffer
-  private: CANMessage * mReceiveBuffer = nullptr ;
-  private: volatile uint32_t mReceiveBufferSize = 0 ;
-  private: volatile uint32_t mReceiveBufferReadIndex = 0 ;
-  private: volatile uint32_t mReceiveBufferCount = 0 ;
+//--- Driver receive buffers, one per receive class
+  private: class ReceiveQueue {
+    public: CANMessage * mBuffer = nullptr ;
+    public: uint32_t mSize = 0 ;
+    public: volatile uint32_t mReadIndex = 0 ;
+    public: volatile uint32_t mCount = 0 ;
+    public: volatile uint32_t mPeakCount = 0 ; // == mSize + 1 if overflow did occur
+    public: volatile uint32_t mDroppedCount = 0 ;
+    public: volatile uint32_t mPeekedCount = 0 ; // Frames returned by peek, not yet consumed
+    #if ACAN_INSTRUMENTATION
+      public: uint32_t * mEntryCycles = nullptr ; // Cycle count when frame entered mBuffer
+    #endif
+  } ;
+  private: ReceiveQueue mReceiveQueue [ACANSettings::kReceiveClassCount] ;
+  private: uint8_t * mFilterReceiveClassArray = nullptr ; // mCallBackFunctionArraySize entries
+  private: uint32_t mPeekedClass = 0 ;
+  private: CANMessage * freeReceiveSlot (const uint32_t inFilterIndex) ;
+  private: void releaseReceivedFrames (ReceiveQueue & ioQueue, const uint32_t inCount) ;
+  private: volatile uint32_t mReceiveBufferSize = 0 ; // All classes
+  private: volatile uint32_t mReceiveBufferCount = 0 ; // All classes
   private: volatile uint32_t mReceiveBufferPeakCount = 0 ; // == mReceiveBufferSize + 1 if overflow did occur
   private: volatile uint8_t mFlexcanRxFIFOFlags = 0 ;
-  private: void readRxRegisters (CANMessage & outMessage) ;
+  private: bool enterReceiveBuffer (const CANMessage & inMessage) ; // Returns false if frame is dropped
+
+//--- Receive buffer watermarks and overflow
+  private: uint32_t mReceiveBufferHighWatermark = 0 ;
+  private: uint32_t mReceiveBufferLowWatermark = 0 ;
+  private: volatile bool mReceiveBufferAboveHighWatermark = false ;
+  private: ACANSettings::tReceiveOverflowPolicy mReceiveOverflowPolicy = ACANSettings::kDropNewest ;
+  private: tReceiveWatermarkCallBack mReceiveWatermarkCallBack = nullptr ;
+  private: volatile uint32_t mReceiveBufferDroppedCount = 0 ;
+  private: void countDroppedFrame (ReceiveQueue & ioQueue, const CANMessage & inMessage) ;
+  private: bool evictLowestPriorityFrame (ReceiveQueue & ioQueue, const CANMessage & inMessage) ;
+
+//--- Filter statistics
+  private: class FilterStatistics {
+    public: uint32_t mMatchedCount = 0 ;
+    public: uint32_t mDroppedCount = 0 ;
+    public: uint32_t mFalseAcceptCount = 0 ;
+    public: uint32_t mLastSeenMicros = 0 ;
+    public: uint32_t * mIntendedIdentifiers = nullptr ; // Sorted, or nullptr
+    public: uint32_t mIntendedIdentifierCount = 0 ;
+  } ;
+  private: FilterStatistics * mFilterStatisticsArray = nullptr ; // mCallBackFunctionArraySize entries
+  private: volatile uint32_t mFalseAcceptCount = 0 ;
+  private: void updateFilterStatistics (const CANMessage & inMessage) ;
+
+//--- On change only filters
+  private: class ChangeDetector {
+    public: uint64_t mLastData = 0 ;
+    public: uint32_t mLastIdentifier = 0 ; // With bit 31 set for remote frames
+    public: uint32_t mLastAcceptDate = 0 ; // millis ()
+    public: uint32_t mHeartbeatMillis = 0 ;
+    public: uint32_t mSuppressedCount = 0 ;
+    public: uint8_t mLastLength = 0 ;
+    public: bool mEnabled = false ;
+    public: bool mHasLastFrame = false ;
+  } ;
+  private: ChangeDetector * mChangeDetectorArray = nullptr ; // mCallBackFunctionArraySize entries, or nullptr
+  private: volatile uint32_t mSuppressedFrameCount = 0 ;
+  private: bool isUnchangedFrame (const CANMessage & inMessage) ;
+  private: template <uint32_t FLEXCAN_BASE> uint32_t receivedFilterIndex (void) const ;
+  private: template <uint32_t FLEXCAN_BASE> uint16_t readRxRegisters (CANMessage & outMessage) ; // Returns FlexCAN time stamp
+
+//--- Interrupt coalescing
+  private: IntervalTimer * mCoalescingTimer = nullptr ;
+  private: bool mInterruptCoalescing = false ;
+  private: bool mPollingMode = false ;
+  private: volatile uint32_t mMessageInterruptCount = 0 ;
+  private: volatile uint32_t mPollCount = 0 ;
+  private: volatile uint32_t mReceivedFrameCount = 0 ;
+
+//--- Remote frame responders (mailboxes 14, 13, ...)
+  private: uint8_t mRemoteResponderCount = 0 ;
+  private: int32_t responderMailboxIndex (const uint32_t inFlexcanBase, const CANMessage & inResponse) const ;
+
+//--- Instrumentation
+  #if ACAN_INSTRUMENTATION
+    private: ACANLatencyHistogram mISRDurationHistogram ;
+    private: ACANLatencyHistogram mReceiveResidencyHistogram ;
+    private: ACANLatencyHistogram mTransmitResidencyHistogram ;
+  #endif
+
+//--- Bus logger
+  private: ACANBusLogger * volatile mBusLogger = nullptr ;
+
+//--- Cyclic frame supervision
+  private: ACANCyclicSupervisor * volatile mCyclicSupervisor = nullptr ;
+
+//--- Event notification
+  private: tEventCallBack mEventCallBack = nullptr ;
+  private: void * mEventUserData = nullptr ;
+
+//--- Time synchronization
+  private: volatile tTimeSyncRole mTimeSyncRole = kTimeSyncOff ;
+  private: uint32_t mTimeSyncIdentifier = 0 ;
+  private: bool mTimeSyncExtended = false ;
+  private: uint8_t mTimeSyncSequence = 0 ; // Master: SYNC in mailbox 15, slave: last received SYNC
+  private: uint8_t mTimeSyncNextSequence = 0 ; // Master
+  private: bool mTimeSyncInMailbox = false ; // Master: SYNC in mailbox 15
+  private: bool mTimeSyncReceived = false ; // Slave: SYNC received, waiting for its follow up
+  private: uint32_t mTimeSyncMicros = 0 ; // micros () of SYNC
+  private: uint32_t mMicrosPerBitQ8 = 0 ; // 256 * bit duration in µs
+  private: volatile int32_t mGlobalTimeOffsetMicros = 0 ;
+  private: volatile bool mTimeSynchronized = false ;
+  private: volatile uint32_t mTimeSyncCount = 0 ;
+  private: bool isTimeSyncFrame (const CANMessage & inMessage) const ;
+  private: template <uint32_t FLEXCAN_BASE> uint32_t microsOfTimeStamp (const uint32_t inFlexcanTimeStamp) const ;
+  private: template <uint32_t FLEXCAN_BASE> void sendTimeSyncFollowUp (const uint32_t inFlexcanTimeStamp) ;
+  private: void handleTimeSyncFrame (const CANMessage & inMessage, const uint32_t inReceiveMicros) ;
+
+//--- Time triggered transmission: schedule is sorted by decreasing release time
+  private: class ScheduledFrame {
+    public: CANMessage mMessage ;
+    public: uint32_t mGlobalMicros ;
+  } ;
+  private: ScheduledFrame * mSchedule = nullptr ;
+  private: uint32_t mScheduleSize = 0 ;
+  private: volatile uint32_t mScheduledFrameCount = 0 ;
+  private: volatile uint32_t mMaxReleaseLatenessMicros = 0 ;
+  private: IntervalTimer * mTimeTriggerTimer = nullptr ;
+  private: uint8_t mMessageIRQPriority = 64 ;
+  private: template <uint32_t FLEXCAN_BASE> static void timeTriggerTimerISR (void) ;
+  private: template <uint32_t FLEXCAN_BASE> void releaseScheduledFrames (void) ;
 
 //--- Primary filters
   private : uint8_t mActualPrimaryFilterCount = 0 ;
   private : uint8_t mMaxPrimaryFilterCount = 0 ;
+  private : ACANSettings::tConfiguration mConfiguration = ACANSettings::k12_12_Filters ;
+  private: uint32_t mLastFilterUpdateFrozenMicros = 0 ;
+  private: void enterFreezeMode (const uint32_t inFlexcanBase) ;
+  private: void exitFreezeMode (const uint32_t inFlexcanBase) ;
+  private: void freeFilterTables (void) ;
+  private: void installFilterTables (const ACANPrimaryFilter inPrimaryFilters [],
+                                     const uint32_t inPrimaryFilterCount,
+                                     const ACANSecondaryFilter inSecondaryFilters [],
+                                     const uint32_t inSecondaryFilterCount) ;
+  private: uint32_t writeFilterRegisters (const uint32_t inFlexcanBase,
+                                          const ACANSettings::tConfiguration inConfiguration,
+                                          const ACANPrimaryFilter inPrimaryFilters [],
+                                          const uint32_t inPrimaryFilterCount,
+                                          const ACANSecondaryFilter inSecondaryFilters [],
+                                          const uint32_t inSecondaryFilterCount) ;
+
+//--- Driver transmit buffer: multi producer (tryToSend, gateway), single consumer (message
+//    interrupt service routine)
+  private: class TransmitEntry {
+    public: CANMessage mMessage ;
+    #if ACAN_INSTRUMENTATION
+      public: uint32_t mEntryCycles = 0 ;
+    #endif
+  } ;
+  private: ACANMPSCQueue <TransmitEntry> mTransmitQueue ;
+  private: inline bool started (void) const { return mTransmitQueue.capacity () > 0 ; }
+  private: template <uint32_t FLEXCAN_BASE> bool sendDataFrame (const CANMessage & inMessage) ; // Any context
+  private: template <uint32_t FLEXCAN_BASE> bool loadDataMailboxFromQueue (void) ; // Message interrupt, returns true if a frame has been popped
 
-//--- Driver transmit buffer
-  private: CANMessage * mTransmitBuffer = nullptr ;
-  private: volatile uint32_t mTransmitBufferSize = 0 ;
-  private: volatile uint32_t mTransmitBufferReadIndex = 0 ;
-  private: volatile uint32_t mTransmitBufferCount = 0 ;
-  private: volatile uint32_t mTransmitBufferPeakCount = 0 ; // == mTransmitBufferSize + 1 if tentative overflow did occur
-  private: void writeTxRegisters (const CANMessage & inMessage, const uint32_t inMBIndex) ;
+//--- Remote frame sending: a bit is set while a producer writes the mailbox
+  private: volatile uint32_t mRemoteMailboxClaims = 0 ;
 
-//--- Message interrupt service routine
-  private: void message_isr (void) ;
+//--- Transmit rate limits: tokens are earned every microsecond (mRate tokens), a frame
+//    costs 1,000,000 tokens, a bit of the bus share bucket too
+  private: class TokenBucket {
+    public: uint32_t mRate = 0 ; // 0 --> no limit
+    public: uint32_t mCapacity = 0 ;
+    public: uint32_t mTokens = 0 ;
+    public: uint32_t mRefillDate = 0 ;
+    public: void refill (const uint32_t inNow) ;
+    public: void refund (const uint32_t inTokens) ; // Up to capacity
+  } ;
+  private: ACANTransmitRateLimit * mTransmitRateLimits = nullptr ;
+  private: TokenBucket * mTransmitRateBuckets = nullptr ;
+  private: uint32_t mTransmitRateLimitCount = 0 ;
+  private: TokenBucket mBusShareBucket ;
+  private: uint32_t mActualBitRate = 0 ;
+  private: volatile uint32_t mTransmitRateLimitedCount = 0 ;
+  private: volatile uint32_t mTransmitBusShareLimitedCount = 0 ;
+  private: TokenBucket * transmitRateBucket (const CANMessage & inMessage) ;
+  private: bool acceptTransmitRate (const CANMessage & inMessage) ; // Interrupts should be disabled
+  private: void refundTransmitRate (const CANMessage & inMessage) ; // Interrupts should be disabled
+
+//--- Transmit watchdog
+  private: uint32_t mTransmitTimeoutMillis = 0 ;
+  private: bool mFlushTransmitBufferOnTimeout = false ;
+  private: CANMessage mTxMailboxFrame ; // Frame in data mailbox, if watchdog is enabled
+  private: uint32_t mTxMailboxLoadDate = 0 ; // millis ()
+  private: tTransmitTimeoutCallBack mTransmitTimeoutCallBack = nullptr ;
+  private: volatile uint32_t mTransmitTimeoutCount = 0 ;
+  private: volatile uint32_t mTransmitFlushedCount = 0 ;
+  private: void loadDataMailbox (const uint32_t inFlexcanBase, const CANMessage & inMessage, const uint32_t inMBIndex) ;
+  private: void handleTransmitTimeout (void) ;
+
+//--- Gateway
+  #ifdef __MK66FX1M0__
+    private: ACAN * volatile mGatewayDestination = nullptr ;
+    private: ACANGatewayRoute * mGatewayRoutes = nullptr ;
+    private: uint32_t mGatewayRouteCount = 0 ;
+    private: TokenBucket mGatewayBucket ; // Rate: frames per second
+    private: volatile uint32_t mGatewayForwardedCount = 0 ;
+    private: volatile uint32_t mGatewayDroppedCount = 0 ;
+    private: volatile uint32_t mGatewayRateLimitedCount = 0 ;
+    private: volatile uint32_t mGatewayMaxLatencyCycles = 0 ;
+    private: template <uint32_t FLEXCAN_BASE> bool gatewayForward (CANMessage & ioMessage, const uint32_t inISRStartCycle) ;
+  #endif
+
+//--- Message interrupt service routine, specialized for each FlexCAN module
+  private: template <uint32_t FLEXCAN_BASE> uint32_t message_isr (void) ; // Returns the number of read frames
   friend void can0_message_isr (void) ;
   #ifdef __MK66FX1M0__
     friend void can1_message_isr (void) ;
@@ -151,3 +535,7 @@ class ACAN {
 } ;
 
 //----------------------------------------------------------------------------------------
+
+static_assert (ACANIsDriver <ACAN>::value, "ACAN should satisfy the driver interface") ;
+
+//----------------------------------------------------------------------------------------
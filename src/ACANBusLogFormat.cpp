@@ -0,0 +1,150 @@
+//----------------------------------------------------------------------------------------
+// Binary bus log format for the ACAN driver
+// by Pierre Molinaro
+// https://github.com/pierremolinaro/acan
+//
+//----------------------------------------------------------------------------------------
+
+#include "ACANBusLogFormat.h"
+
+//----------------------------------------------------------------------------------------
+//    Block header
+//----------------------------------------------------------------------------------------
+
+void initBusLogBlock (ACANBusLogBlock & outBlock,
+                      const uint32_t inSequence,
+                      const uint32_t inDroppedCount) {
+  outBlock.mHeader.mSyncMarker = kACANBusLogSyncMarker ;
+  outBlock.mHeader.mSequence = inSequence ;
+  outBlock.mHeader.mRecordCount = 0 ;
+  outBlock.mHeader.mFormatVersion = kACANBusLogFormatVersion ;
+  outBlock.mHeader.mDroppedCount = inDroppedCount ;
+  for (uint32_t i=0 ; i<sizeof (outBlock.mPadding) ; i++) {
+    outBlock.mPadding [i] = 0 ;
+  }
+}
+
+//----------------------------------------------------------------------------------------
+
+bool isValidBusLogBlockHeader (const ACANBusLogBlockHeader & inHeader) {
+  return
+    (inHeader.mSyncMarker == kACANBusLogSyncMarker) &&
+    (inHeader.mFormatVersion == kACANBusLogFormatVersion) &&
+    (inHeader.mRecordCount <= kACANBusLogRecordsPerBlock)
+  ;
+}
+
+//----------------------------------------------------------------------------------------
+//    Writer
+//----------------------------------------------------------------------------------------
+
+ACANBusLogWriter::ACANBusLogWriter (const tBlockSink inSink, void * inUserData) :
+mBlock (),
+mSink (inSink),
+mUserData (inUserData) {
+  initBusLogBlock (mBlock, 0, 0) ;
+}
+
+//----------------------------------------------------------------------------------------
+
+bool ACANBusLogWriter::append (const ACANBusLogRecord & inRecord) {
+  mBlock.mRecords [mBlock.mHeader.mRecordCount] = inRecord ;
+  mBlock.mHeader.mRecordCount += 1 ;
+  bool ok = true ;
+  if (mBlock.mHeader.mRecordCount == kACANBusLogRecordsPerBlock) {
+    ok = flush () ;
+  }
+  return ok ;
+}
+
+//----------------------------------------------------------------------------------------
+
+bool ACANBusLogWriter::flush (void) {
+  bool ok = true ;
+  if ((mBlock.mHeader.mRecordCount > 0) || (mDroppedCount > 0)) {
+  //--- Unused records are zeroed, so that captures are reproducible
+    for (uint32_t i = mBlock.mHeader.mRecordCount ; i < kACANBusLogRecordsPerBlock ; i++) {
+      mBlock.mRecords [i] = ACANBusLogRecord () ;
+    }
+    mBlock.mHeader.mDroppedCount = mDroppedCount ;
+    ok = mSink (mBlock, mUserData) ;
+    mSequence += 1 ;
+    mDroppedCount = 0 ;
+    initBusLogBlock (mBlock, mSequence, 0) ;
+  }
+  return ok ;
+}
+
+//----------------------------------------------------------------------------------------
+//    Reader
+//----------------------------------------------------------------------------------------
+
+ACANBusLogReader::ACANBusLogReader (const uint8_t * inData, const size_t inSize) :
+mData (inData),
+mSize (inSize) {
+}
+
+//----------------------------------------------------------------------------------------
+
+void ACANBusLogReader::rewind (void) {
+  mNextBlockOffset = 0 ;
+  mCurrentBlock = nullptr ;
+  mRecordIndex = 0 ;
+  mExpectedSequence = 0 ;
+  mBlockCount = 0 ;
+  mLostBlockCount = 0 ;
+  mDroppedFrameCount = 0 ;
+  mSkippedByteCount = 0 ;
+}
+
+//----------------------------------------------------------------------------------------
+// A valid block is normally found at mNextBlockOffset; otherwise, the capture is scanned
+// (4-byte step, records are word aligned) for the next sync marker.
+
+bool ACANBusLogReader::findNextBlock (void) {
+  mCurrentBlock = nullptr ;
+  while ((nullptr == mCurrentBlock) && ((mNextBlockOffset + kACANBusLogBlockSize) <= mSize)) {
+    const ACANBusLogBlock * block = (const ACANBusLogBlock *) (mData + mNextBlockOffset) ;
+    if (isValidBusLogBlockHeader (block->mHeader)) {
+      mCurrentBlock = block ;
+      mNextBlockOffset += kACANBusLogBlockSize ;
+    }else{
+      mNextBlockOffset += 4 ;
+      mSkippedByteCount += 4 ;
+    }
+  }
+  if (nullptr != mCurrentBlock) {
+    const uint32_t sequence = mCurrentBlock->mHeader.mSequence ;
+    if ((mBlockCount > 0) && (sequence > mExpectedSequence)) { // sequence < mExpectedSequence: logger restart
+      mLostBlockCount += sequence - mExpectedSequence ;
+    }
+    mExpectedSequence = sequence + 1 ;
+    mBlockCount += 1 ;
+    mDroppedFrameCount += mCurrentBlock->mHeader.mDroppedCount ;
+    mRecordIndex = 0 ;
+  }
+  return nullptr != mCurrentBlock ;
+}
+
+//----------------------------------------------------------------------------------------
+
+const ACANBusLogRecord * ACANBusLogReader::next (void) {
+  const ACANBusLogRecord * result = nullptr ;
+  while ((nullptr == result) && ((nullptr != mCurrentBlock) || findNextBlock ())) {
+    if (mRecordIndex < mCurrentBlock->mHeader.mRecordCount) {
+      result = & mCurrentBlock->mRecords [mRecordIndex] ;
+      mRecordIndex += 1 ;
+    }else{
+      mCurrentBlock = nullptr ;
+    }
+  }
+  return result ;
+}
+
+//----------------------------------------------------------------------------------------
+
+const ACANBusLogBlock * ACANBusLogReader::nextBlock (void) {
+  return findNextBlock () ? mCurrentBlock : nullptr ;
+}
+
+//----------------------------------------------------------------------------------------
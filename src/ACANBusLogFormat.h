@@ -0,0 +1,154 @@
+//----------------------------------------------------------------------------------------
+// Binary bus log format for the ACAN driver
+// by Pierre Molinaro
+// https://github.com/pierremolinaro/acan
+//
+// This file does not depend on Arduino: it can be compiled on the host (Linux, macOS)
+// for writing and reading captures produced by ACANBusLogger.
+//
+// A capture is a sequence of 512-byte blocks (an SD card sector):
+//   - a 16-byte header, beginning with a sync marker;
+//   - 24 fixed-width 20-byte records;
+//   - 16 padding bytes.
+// All values are little endian (native byte order of Teensy and x86 / ARM hosts).
+//
+//----------------------------------------------------------------------------------------
+
+#pragma once
+
+//----------------------------------------------------------------------------------------
+
+#include <stdint.h>
+#include <stddef.h>
+
+//----------------------------------------------------------------------------------------
+
+static const uint32_t kACANBusLogSyncMarker      = 0x4E414341 ; // "ACAN" in memory
+static const uint16_t kACANBusLogFormatVersion   = 1 ;
+static const uint32_t kACANBusLogBlockSize       = 512 ;
+static const uint32_t kACANBusLogRecordsPerBlock = 24 ;
+
+//--- Record identifier word: bits 0 ... 28: identifier
+static const uint32_t kACANBusLogIdentifierMask  = 0x1FFFFFFF ;
+static const uint32_t kACANBusLogRemoteFlag      = 1U << 30 ;
+static const uint32_t kACANBusLogExtendedFlag    = 1U << 31 ;
+
+//----------------------------------------------------------------------------------------
+
+class ACANBusLogRecord {
+  public: uint32_t mTimeStamp ; // micros () at reception
+  public: uint32_t mIdentifier ; // Identifier, kACANBusLogRemoteFlag, kACANBusLogExtendedFlag
+  public: uint8_t mData [8] ; // Unused bytes are zero
+  public: uint16_t mFlexcanTimeStamp ; // FlexCAN free running timer (one tick per CAN bit)
+  public: uint8_t mLength ; // 0 ... 8
+  public: uint8_t mFilterIndex ; // CANMessage::idx
+
+  public: inline uint32_t identifier (void) const { return mIdentifier & kACANBusLogIdentifierMask ; }
+  public: inline bool isExtended (void) const { return (mIdentifier & kACANBusLogExtendedFlag) != 0 ; }
+  public: inline bool isRemote (void) const { return (mIdentifier & kACANBusLogRemoteFlag) != 0 ; }
+} ;
+
+//----------------------------------------------------------------------------------------
+
+class ACANBusLogBlockHeader {
+  public: uint32_t mSyncMarker ; // kACANBusLogSyncMarker
+  public: uint32_t mSequence ; // Incremented for each block, a gap denotes lost blocks
+  public: uint16_t mRecordCount ; // 0 ... kACANBusLogRecordsPerBlock
+  public: uint16_t mFormatVersion ; // kACANBusLogFormatVersion
+  public: uint32_t mDroppedCount ; // Frames dropped by the logger since the previous block
+} ;
+
+//----------------------------------------------------------------------------------------
+
+class ACANBusLogBlock {
+  public: ACANBusLogBlockHeader mHeader ;
+  public: ACANBusLogRecord mRecords [kACANBusLogRecordsPerBlock] ;
+  public: uint8_t mPadding [16] ;
+} ;
+
+//----------------------------------------------------------------------------------------
+
+static_assert (sizeof (ACANBusLogRecord) == 20, "ACANBusLogRecord should be 20 bytes") ;
+static_assert (sizeof (ACANBusLogBlockHeader) == 16, "ACANBusLogBlockHeader should be 16 bytes") ;
+static_assert (sizeof (ACANBusLogBlock) == kACANBusLogBlockSize, "ACANBusLogBlock should be 512 bytes") ;
+
+//----------------------------------------------------------------------------------------
+
+void initBusLogBlock (ACANBusLogBlock & outBlock,
+                      const uint32_t inSequence,
+                      const uint32_t inDroppedCount) ;
+
+bool isValidBusLogBlockHeader (const ACANBusLogBlockHeader & inHeader) ;
+
+//----------------------------------------------------------------------------------------
+//   Host side writer: records are accumulated in a block, every complete block is
+//   handed to the sink routine
+//----------------------------------------------------------------------------------------
+
+class ACANBusLogWriter {
+  public: typedef bool (*tBlockSink) (const ACANBusLogBlock & inBlock, void * inUserData) ;
+
+  public: ACANBusLogWriter (const tBlockSink inSink, void * inUserData = nullptr) ;
+
+//--- Returns false if the sink has failed
+  public: bool append (const ACANBusLogRecord & inRecord) ;
+
+//--- Hand the current (partial) block to the sink
+  public: bool flush (void) ;
+
+//--- Account frames that could not be appended (they are reported in the next block header)
+  public: inline void noteDroppedFrames (const uint32_t inCount) { mDroppedCount += inCount ; }
+
+  public: inline uint32_t writtenBlockCount (void) const { return mSequence ; }
+
+  private: ACANBusLogBlock mBlock ;
+  private: const tBlockSink mSink ;
+  private: void * mUserData ;
+  private: uint32_t mSequence = 0 ;
+  private: uint32_t mDroppedCount = 0 ;
+
+//--- No copy
+  private : ACANBusLogWriter (const ACANBusLogWriter &) = delete ;
+  private : ACANBusLogWriter & operator = (const ACANBusLogWriter &) = delete ;
+} ;
+
+//----------------------------------------------------------------------------------------
+//   Reader: iterates records in place (no copy) from a memory area (for example a
+//   memory mapped file). inData should be 4-byte aligned. Corrupted areas are skipped
+//   by searching the next sync marker.
+//----------------------------------------------------------------------------------------
+
+class ACANBusLogReader {
+  public: ACANBusLogReader (const uint8_t * inData, const size_t inSize) ;
+
+//--- Returns nullptr when there is no more record
+  public: const ACANBusLogRecord * next (void) ;
+
+//--- Block iteration: returns the next valid block (nullptr at end), skipping the records
+//    of the current block that have not been read
+  public: const ACANBusLogBlock * nextBlock (void) ;
+
+//--- Restart from the beginning
+  public: void rewind (void) ;
+
+//--- Statistics
+  public: inline uint32_t blockCount (void) const { return mBlockCount ; }
+  public: inline uint32_t lostBlockCount (void) const { return mLostBlockCount ; } // From sequence gaps
+  public: inline uint32_t droppedFrameCount (void) const { return mDroppedFrameCount ; } // From block headers
+  public: inline size_t skippedByteCount (void) const { return mSkippedByteCount ; } // Resynchronization
+
+  private: bool findNextBlock (void) ;
+
+  private: const uint8_t * const mData ;
+  private: const size_t mSize ;
+  private: size_t mNextBlockOffset = 0 ;
+  private: const ACANBusLogBlock * mCurrentBlock = nullptr ;
+  private: uint32_t mRecordIndex = 0 ;
+  private: uint32_t mExpectedSequence = 0 ;
+  private: uint32_t mBlockCount = 0 ;
+  private: uint32_t mLostBlockCount = 0 ;
+  private: uint32_t mDroppedFrameCount = 0 ;
+  private: size_t mSkippedByteCount = 0 ;
+} ;
+
+//----------------------------------------------------------------------------------------
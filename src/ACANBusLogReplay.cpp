@@ -0,0 +1,275 @@
+//----------------------------------------------------------------------------------------
+// Capture analysis and replay for the ACAN binary bus log format
+// by Pierre Molinaro
+// https://github.com/pierremolinaro/acan
+//
+//----------------------------------------------------------------------------------------
+
+#include "ACANBusLogReplay.h"
+
+#include <stdlib.h>
+
+//----------------------------------------------------------------------------------------
+
+#if defined (__unix__) || defined (__APPLE__)
+  #include <fcntl.h>
+  #include <sys/mman.h>
+  #include <sys/stat.h>
+  #include <unistd.h>
+#endif
+
+//----------------------------------------------------------------------------------------
+//    Memory mapped capture file
+//----------------------------------------------------------------------------------------
+
+#if defined (__unix__) || defined (__APPLE__)
+
+//----------------------------------------------------------------------------------------
+
+ACANBusLogMappedFile::ACANBusLogMappedFile (void) :
+mData (nullptr),
+mSize (0) {
+}
+
+//----------------------------------------------------------------------------------------
+
+ACANBusLogMappedFile::~ ACANBusLogMappedFile (void) {
+  close () ;
+}
+
+//----------------------------------------------------------------------------------------
+
+bool ACANBusLogMappedFile::open (const char * inPath) {
+  close () ;
+  const int fd = ::open (inPath, O_RDONLY) ;
+  bool ok = fd >= 0 ;
+  struct stat fileStatus ;
+  if (ok) {
+    ok = (fstat (fd, & fileStatus) == 0) && (fileStatus.st_size > 0) ;
+  }
+  if (ok) {
+    void * p = mmap (nullptr, (size_t) fileStatus.st_size, PROT_READ, MAP_PRIVATE, fd, 0) ;
+    ok = p != MAP_FAILED ;
+    if (ok) {
+    //--- Records are read sequentially
+      madvise (p, (size_t) fileStatus.st_size, MADV_SEQUENTIAL) ;
+      mData = (const uint8_t *) p ;
+      mSize = (size_t) fileStatus.st_size ;
+    }
+  }
+  if (fd >= 0) {
+    ::close (fd) ; // Mapping remains valid
+  }
+  return ok ;
+}
+
+//----------------------------------------------------------------------------------------
+
+void ACANBusLogMappedFile::close (void) {
+  if (nullptr != mData) {
+    munmap ((void *) mData, mSize) ;
+    mData = nullptr ;
+    mSize = 0 ;
+  }
+}
+
+//----------------------------------------------------------------------------------------
+
+#endif
+
+//----------------------------------------------------------------------------------------
+//    Per identifier index
+//----------------------------------------------------------------------------------------
+
+static inline uint32_t keyForRecord (const ACANBusLogRecord & inRecord) {
+  return inRecord.mIdentifier & ~ kACANBusLogRemoteFlag ;
+}
+
+//----------------------------------------------------------------------------------------
+// Sort by key, then by address (that is capture order)
+
+static int compareRecords (const void * inLeft, const void * inRight) {
+  const ACANBusLogRecord * left = * (const ACANBusLogRecord * const *) inLeft ;
+  const ACANBusLogRecord * right = * (const ACANBusLogRecord * const *) inRight ;
+  const uint32_t leftKey = keyForRecord (*left) ;
+  const uint32_t rightKey = keyForRecord (*right) ;
+  int result = 0 ;
+  if (leftKey != rightKey) {
+    result = (leftKey < rightKey) ? -1 : 1 ;
+  }else if (left != right) {
+    result = (left < right) ? -1 : 1 ;
+  }
+  return result ;
+}
+
+//----------------------------------------------------------------------------------------
+
+ACANBusLogIndex::ACANBusLogIndex (void) :
+mRecords (nullptr),
+mKeys (nullptr),
+mFirstRecordIndex (nullptr),
+mRecordCount (0),
+mIdentifierCount (0) {
+}
+
+//----------------------------------------------------------------------------------------
+
+ACANBusLogIndex::~ ACANBusLogIndex (void) {
+  clear () ;
+}
+
+//----------------------------------------------------------------------------------------
+
+void ACANBusLogIndex::clear (void) {
+  delete [] mRecords ; mRecords = nullptr ;
+  delete [] mKeys ; mKeys = nullptr ;
+  delete [] mFirstRecordIndex ; mFirstRecordIndex = nullptr ;
+  mRecordCount = 0 ;
+  mIdentifierCount = 0 ;
+}
+
+//----------------------------------------------------------------------------------------
+
+void ACANBusLogIndex::build (ACANBusLogReader & ioReader) {
+  clear () ;
+//--- Count records
+  ioReader.rewind () ;
+  while (nullptr != ioReader.next ()) {
+    mRecordCount += 1 ;
+  }
+//--- Collect and sort records
+  mRecords = new const ACANBusLogRecord * [mRecordCount] ;
+  ioReader.rewind () ;
+  for (uint32_t i=0 ; i<mRecordCount ; i++) {
+    mRecords [i] = ioReader.next () ;
+  }
+  ioReader.rewind () ;
+  qsort (mRecords, mRecordCount, sizeof (const ACANBusLogRecord *), compareRecords) ;
+//--- Count distinct keys
+  for (uint32_t i=0 ; i<mRecordCount ; i++) {
+    if ((i == 0) || (keyForRecord (*mRecords [i]) != keyForRecord (*mRecords [i-1]))) {
+      mIdentifierCount += 1 ;
+    }
+  }
+//--- Key table
+  mKeys = new uint32_t [mIdentifierCount] ;
+  mFirstRecordIndex = new uint32_t [mIdentifierCount + 1] ;
+  uint32_t keyIndex = 0 ;
+  for (uint32_t i=0 ; i<mRecordCount ; i++) {
+    const uint32_t key = keyForRecord (*mRecords [i]) ;
+    if ((i == 0) || (key != mKeys [keyIndex - 1])) {
+      mKeys [keyIndex] = key ;
+      mFirstRecordIndex [keyIndex] = i ;
+      keyIndex += 1 ;
+    }
+  }
+  mFirstRecordIndex [mIdentifierCount] = mRecordCount ;
+}
+
+//----------------------------------------------------------------------------------------
+
+uint32_t ACANBusLogIndex::keyAtIndex (const uint32_t inIndex) const {
+  return (inIndex < mIdentifierCount) ? mKeys [inIndex] : 0 ;
+}
+
+//----------------------------------------------------------------------------------------
+
+uint32_t ACANBusLogIndex::recordsForIdentifier (const uint32_t inIdentifier,
+                                                const bool inExtended,
+                                                const ACANBusLogRecord * const * & outRecords) const {
+  const uint32_t key = (inIdentifier & kACANBusLogIdentifierMask) | (inExtended ? kACANBusLogExtendedFlag : 0) ;
+  uint32_t count = 0 ;
+  outRecords = nullptr ;
+//--- Binary search
+  uint32_t low = 0 ;
+  uint32_t high = mIdentifierCount ;
+  while (low < high) {
+    const uint32_t middle = low + (high - low) / 2 ;
+    if (mKeys [middle] < key) {
+      low = middle + 1 ;
+    }else{
+      high = middle ;
+    }
+  }
+  if ((low < mIdentifierCount) && (mKeys [low] == key)) {
+    outRecords = & mRecords [mFirstRecordIndex [low]] ;
+    count = mFirstRecordIndex [low + 1] - mFirstRecordIndex [low] ;
+  }
+  return count ;
+}
+
+//----------------------------------------------------------------------------------------
+//    Replay
+//----------------------------------------------------------------------------------------
+
+ACANBusLogReplayer::ACANBusLogReplayer (const tReplaySink inSink, void * inUserData) :
+mSink (inSink),
+mUserData (inUserData) {
+}
+
+//----------------------------------------------------------------------------------------
+
+void ACANBusLogReplayer::setTiming (const uint32_t inSpeedFactor,
+                                    const tClockRoutine inClockRoutine,
+                                    const tWaitUntilRoutine inWaitUntilRoutine) {
+  mSpeedFactor = (nullptr == inClockRoutine) ? 0 : inSpeedFactor ;
+  mClockRoutine = inClockRoutine ;
+  mWaitUntilRoutine = inWaitUntilRoutine ;
+}
+
+//----------------------------------------------------------------------------------------
+
+void ACANBusLogReplayer::handle (const ACANBusLogRecord & inRecord,
+                                 uint64_t & ioTimeStamp,
+                                 uint32_t & ioPreviousTimeStamp) {
+//--- Unwrap time stamp (unsigned arithmetic handles wrap around)
+  ioTimeStamp += (uint32_t) (inRecord.mTimeStamp - ioPreviousTimeStamp) ;
+  ioPreviousTimeStamp = inRecord.mTimeStamp ;
+//--- Wait for release date
+  if (mSpeedFactor > 0) {
+    const uint64_t releaseDate = mClockStart + ioTimeStamp / mSpeedFactor ;
+    if (nullptr != mWaitUntilRoutine) {
+      mWaitUntilRoutine (releaseDate) ;
+    }else{
+      while (mClockRoutine () < releaseDate) {}
+    }
+  }
+  mSink (inRecord, ioTimeStamp, mUserData) ;
+}
+
+//----------------------------------------------------------------------------------------
+
+uint32_t ACANBusLogReplayer::replay (ACANBusLogReader & ioReader) {
+  uint32_t count = 0 ;
+  uint64_t timeStamp = 0 ;
+  uint32_t previousTimeStamp = 0 ;
+  if (mSpeedFactor > 0) {
+    mClockStart = mClockRoutine () ;
+  }
+  const ACANBusLogRecord * record = ioReader.next () ;
+  if (nullptr != record) {
+    previousTimeStamp = record->mTimeStamp ; // First record is replayed at once
+  }
+  while (nullptr != record) {
+    handle (*record, timeStamp, previousTimeStamp) ;
+    count += 1 ;
+    record = ioReader.next () ;
+  }
+  return count ;
+}
+
+//----------------------------------------------------------------------------------------
+
+uint32_t ACANBusLogReplayer::replay (const ACANBusLogRecord * const inRecords [], const uint32_t inCount) {
+  uint64_t timeStamp = 0 ;
+  uint32_t previousTimeStamp = (inCount > 0) ? inRecords [0]->mTimeStamp : 0 ;
+  if (mSpeedFactor > 0) {
+    mClockStart = mClockRoutine () ;
+  }
+  for (uint32_t i=0 ; i<inCount ; i++) {
+    handle (*inRecords [i], timeStamp, previousTimeStamp) ;
+  }
+  return inCount ;
+}
+
+//----------------------------------------------------------------------------------------
@@ -0,0 +1,125 @@
+//----------------------------------------------------------------------------------------
+// Capture analysis and replay for the ACAN binary bus log format
+// by Pierre Molinaro
+// https://github.com/pierremolinaro/acan
+//
+// This file does not depend on Arduino. ACANBusLogMappedFile is only available on
+// POSIX hosts (Linux, macOS).
+//
+//----------------------------------------------------------------------------------------
+
+#pragma once
+
+//----------------------------------------------------------------------------------------
+
+#include "ACANBusLogFormat.h"
+
+//----------------------------------------------------------------------------------------
+//   Memory mapped capture file (read only)
+//----------------------------------------------------------------------------------------
+
+#if defined (__unix__) || defined (__APPLE__)
+
+class ACANBusLogMappedFile {
+  public: ACANBusLogMappedFile (void) ;
+  public: ~ ACANBusLogMappedFile (void) ;
+
+//--- Returns false if the file cannot be opened or mapped
+  public: bool open (const char * inPath) ;
+  public: void close (void) ;
+
+  public: inline const uint8_t * data (void) const { return mData ; }
+  public: inline size_t size (void) const { return mSize ; }
+
+  private: const uint8_t * mData ;
+  private: size_t mSize ;
+
+//--- No copy
+  private : ACANBusLogMappedFile (const ACANBusLogMappedFile &) = delete ;
+  private : ACANBusLogMappedFile & operator = (const ACANBusLogMappedFile &) = delete ;
+} ;
+
+#endif
+
+//----------------------------------------------------------------------------------------
+//   Per identifier index: for each identifier (standard and extended identifiers are
+//   distinct), the records in capture order. Records are not copied, the capture
+//   memory should remain valid while the index is used.
+//----------------------------------------------------------------------------------------
+
+class ACANBusLogIndex {
+  public: ACANBusLogIndex (void) ;
+  public: ~ ACANBusLogIndex (void) ;
+
+//--- Build index (reader is rewound before and after)
+  public: void build (ACANBusLogReader & ioReader) ;
+
+//--- Records of a given identifier; returns the record count (0 if identifier is absent)
+  public: uint32_t recordsForIdentifier (const uint32_t inIdentifier,
+                                         const bool inExtended,
+                                         const ACANBusLogRecord * const * & outRecords) const ;
+
+//--- Distinct identifiers
+  public: inline uint32_t identifierCount (void) const { return mIdentifierCount ; }
+  public: inline uint32_t recordCount (void) const { return mRecordCount ; }
+
+//--- Key of an identifier: ACANBusLogRecord::mIdentifier without remote flag
+  public: uint32_t keyAtIndex (const uint32_t inIndex) const ;
+
+  private: void clear (void) ;
+
+  private: const ACANBusLogRecord * * mRecords ; // Sorted by key, then capture order
+  private: uint32_t * mKeys ; // Distinct keys, sorted
+  private: uint32_t * mFirstRecordIndex ; // For each key, index in mRecords (mIdentifierCount + 1 entries)
+  private: uint32_t mRecordCount ;
+  private: uint32_t mIdentifierCount ;
+
+//--- No copy
+  private : ACANBusLogIndex (const ACANBusLogIndex &) = delete ;
+  private : ACANBusLogIndex & operator = (const ACANBusLogIndex &) = delete ;
+} ;
+
+//----------------------------------------------------------------------------------------
+//   Replay: records are handed to the sink routine, either as fast as possible, or
+//   following the original timing (possibly accelerated).
+//   Time stamps (micros ()) wrap around every 71 minutes; as the interval between two
+//   consecutive frames is always much shorter, the replayer computes 64-bit time stamps.
+//----------------------------------------------------------------------------------------
+
+class ACANBusLogReplayer {
+  public: typedef void (*tReplaySink) (const ACANBusLogRecord & inRecord,
+                                       const uint64_t inReplayTimeStamp, // µs from replay start
+                                       void * inUserData) ;
+
+//--- Host clock (µs) and wait routine, used only if the speed factor is not 0
+  public: typedef uint64_t (*tClockRoutine) (void) ;
+  public: typedef void (*tWaitUntilRoutine) (const uint64_t inClockValue) ;
+
+  public: ACANBusLogReplayer (const tReplaySink inSink, void * inUserData = nullptr) ;
+
+//--- inSpeedFactor: 0 --> as fast as possible, 1 --> original timing, 10 --> ten times faster, ...
+  public: void setTiming (const uint32_t inSpeedFactor,
+                          const tClockRoutine inClockRoutine,
+                          const tWaitUntilRoutine inWaitUntilRoutine = nullptr) ;
+
+//--- Replay all records; returns the number of replayed records
+  public: uint32_t replay (ACANBusLogReader & ioReader) ;
+
+//--- Replay records of one identifier (from an index)
+  public: uint32_t replay (const ACANBusLogRecord * const inRecords [], const uint32_t inCount) ;
+
+  private: void handle (const ACANBusLogRecord & inRecord, uint64_t & ioTimeStamp, uint32_t & ioPreviousTimeStamp) ;
+
+  private: const tReplaySink mSink ;
+  private: void * mUserData ;
+  private: uint32_t mSpeedFactor = 0 ;
+  private: tClockRoutine mClockRoutine = nullptr ;
+  private: tWaitUntilRoutine mWaitUntilRoutine = nullptr ;
+  private: uint64_t mClockStart = 0 ;
+
+//--- No copy
+  private : ACANBusLogReplayer (const ACANBusLogReplayer &) = delete ;
+  private : ACANBusLogReplayer & operator = (const ACANBusLogReplayer &) = delete ;
+} ;
+
+//----------------------------------------------------------------------------------------
@@ -0,0 +1,168 @@
+//----------------------------------------------------------------------------------------
+// High rate binary bus logger for the ACAN driver
+// by Pierre Molinaro
+// https://github.com/pierremolinaro/acan
+//
+//----------------------------------------------------------------------------------------
+
+#include <ACANBusLogger.h>
+
+//----------------------------------------------------------------------------------------
+//    Constructor, destructor
+//----------------------------------------------------------------------------------------
+
+ACANBusLogger::ACANBusLogger (const uint32_t inBlocksPerBuffer) :
+mBlocksPerBuffer ((inBlocksPerBuffer > 0) ? inBlocksPerBuffer : 1) {
+}
+
+//----------------------------------------------------------------------------------------
+
+ACANBusLogger::~ ACANBusLogger (void) {
+  end () ;
+}
+
+//----------------------------------------------------------------------------------------
+//    begin, end
+//----------------------------------------------------------------------------------------
+
+void ACANBusLogger::begin (void) {
+  end () ;
+  ACANBusLogBlock * buffer0 = new ACANBusLogBlock [mBlocksPerBuffer] ;
+  ACANBusLogBlock * buffer1 = new ACANBusLogBlock [mBlocksPerBuffer] ;
+  noInterrupts () ;
+    mFullBlockCount [0] = 0 ;
+    mFullBlockCount [1] = 0 ;
+    mFillBufferIndex = 0 ;
+    mFillBlockIndex = 0 ;
+    mFillRecordIndex = 0 ;
+    mSequence = 0 ;
+    mLoggedFrameCount = 0 ;
+    mDroppedFrameCount = 0 ;
+    mDroppedSinceLastBlock = 0 ;
+    mBuffer [0] = buffer0 ;
+    mBuffer [1] = buffer1 ;
+  interrupts () ;
+  mWrittenBlockCount = 0 ;
+  mSinkErrorCount = 0 ;
+}
+
+//----------------------------------------------------------------------------------------
+
+void ACANBusLogger::end (void) {
+  noInterrupts () ;
+    ACANBusLogBlock * buffer0 = mBuffer [0] ;
+    ACANBusLogBlock * buffer1 = mBuffer [1] ;
+    mBuffer [0] = nullptr ;
+    mBuffer [1] = nullptr ;
+  interrupts () ;
+  delete [] buffer0 ;
+  delete [] buffer1 ;
+}
+
+//----------------------------------------------------------------------------------------
+//    Append (interrupt context)
+//----------------------------------------------------------------------------------------
+
+void ACANBusLogger::appendFromISR (const CANMessage & inMessage, const uint16_t inFlexcanTimeStamp) {
+  const uint32_t bufferIndex = mFillBufferIndex ;
+  if (nullptr == mBuffer [bufferIndex]) { // Not started
+  }else if (mFullBlockCount [bufferIndex] > 0) { // Overflow: both buffers are waiting for the sink
+    mDroppedFrameCount += 1 ;
+    mDroppedSinceLastBlock += 1 ;
+  }else{
+    ACANBusLogBlock & block = mBuffer [bufferIndex] [mFillBlockIndex] ;
+  //--- Start a new block ?
+    if (mFillRecordIndex == 0) {
+      initBusLogBlock (block, mSequence, mDroppedSinceLastBlock) ;
+      mSequence += 1 ;
+      mDroppedSinceLastBlock = 0 ;
+    }
+  //--- Append record
+    ACANBusLogRecord & record = block.mRecords [mFillRecordIndex] ;
+    record.mTimeStamp = micros () ;
+    record.mIdentifier =
+      (inMessage.id & kACANBusLogIdentifierMask) |
+      (inMessage.ext ? kACANBusLogExtendedFlag : 0) |
+      (inMessage.rtr ? kACANBusLogRemoteFlag : 0)
+    ;
+    for (uint32_t i=0 ; i<8 ; i++) {
+      record.mData [i] = inMessage.data [i] ;
+    }
+    record.mFlexcanTimeStamp = inFlexcanTimeStamp ;
+    record.mLength = inMessage.len ;
+    record.mFilterIndex = inMessage.idx ;
+    block.mHeader.mRecordCount += 1 ;
+    mLoggedFrameCount += 1 ;
+  //--- Block full ?
+    mFillRecordIndex += 1 ;
+    if (mFillRecordIndex == kACANBusLogRecordsPerBlock) {
+      mFillRecordIndex = 0 ;
+      mFillBlockIndex += 1 ;
+    //--- Buffer full ? Hand it to flush, and continue with the other one
+      if (mFillBlockIndex == mBlocksPerBuffer) {
+        mFillBlockIndex = 0 ;
+        mFullBlockCount [bufferIndex] = mBlocksPerBuffer ;
+        mFillBufferIndex = 1 - bufferIndex ;
+      }
+    }
+  }
+}
+
+//----------------------------------------------------------------------------------------
+//    Writing to sink (loop context)
+//----------------------------------------------------------------------------------------
+
+uint32_t ACANBusLogger::writeBuffer (Print & inSink, const uint32_t inBufferIndex) {
+  uint32_t writtenByteCount = 0 ;
+  const uint32_t blockCount = mFullBlockCount [inBufferIndex] ;
+  if (blockCount > 0) {
+    const uint32_t size = blockCount * sizeof (ACANBusLogBlock) ;
+    writtenByteCount = inSink.write ((const uint8_t *) mBuffer [inBufferIndex], size) ;
+    if (writtenByteCount != size) {
+      mSinkErrorCount += 1 ;
+    }
+    mWrittenBlockCount += blockCount ;
+  //--- Release buffer
+    mFullBlockCount [inBufferIndex] = 0 ;
+  }
+  return writtenByteCount ;
+}
+
+//----------------------------------------------------------------------------------------
+
+uint32_t ACANBusLogger::flush (Print & inSink) {
+//--- If both buffers are full, the buffer the interrupt tries to fill is the oldest one
+  const uint32_t firstBufferIndex = mFillBufferIndex ;
+  uint32_t writtenByteCount = writeBuffer (inSink, firstBufferIndex) ;
+  writtenByteCount += writeBuffer (inSink, 1 - firstBufferIndex) ;
+  return writtenByteCount ;
+}
+
+//----------------------------------------------------------------------------------------
+
+uint32_t ACANBusLogger::sync (Print & inSink) {
+  noInterrupts () ;
+    const uint32_t bufferIndex = mFillBufferIndex ;
+    const bool hasPartialBuffer =
+      (nullptr != mBuffer [bufferIndex]) &&
+      (mFullBlockCount [bufferIndex] == 0) &&
+      ((mFillBlockIndex > 0) || (mFillRecordIndex > 0))
+    ;
+    if (hasPartialBuffer) {
+      if (mFillRecordIndex > 0) {
+        ACANBusLogBlock & block = mBuffer [bufferIndex] [mFillBlockIndex] ;
+        for (uint32_t i = mFillRecordIndex ; i < kACANBusLogRecordsPerBlock ; i++) {
+          block.mRecords [i] = ACANBusLogRecord () ;
+        }
+        mFillBlockIndex += 1 ;
+      }
+      mFullBlockCount [bufferIndex] = mFillBlockIndex ;
+      mFillBlockIndex = 0 ;
+      mFillRecordIndex = 0 ;
+      mFillBufferIndex = 1 - bufferIndex ;
+    }
+  interrupts () ;
+  return flush (inSink) ;
+}
+
+//----------------------------------------------------------------------------------------
@@ -0,0 +1,74 @@
+//----------------------------------------------------------------------------------------
+// High rate binary bus logger for the ACAN driver
+// by Pierre Molinaro
+// https://github.com/pierremolinaro/acan
+//
+// Received frames are appended by the message interrupt service routine of the driver
+// the logger is attached to (see ACAN::setBusLogger). Records are accumulated in two
+// buffers (ping-pong): while the interrupt fills one buffer, loop () writes the other
+// one to the sink (SD card file, Serial, ...) with a single large write.
+// If both buffers are full, frames are dropped and counted; the count is recorded in the
+// header of the next block.
+//
+//----------------------------------------------------------------------------------------
+
+#pragma once
+
+//----------------------------------------------------------------------------------------
+
+#include <ACANBusLogFormat.h>
+#include <ACAN_CANMessage.h>
+
+//----------------------------------------------------------------------------------------
+
+class ACANBusLogger {
+//--- Constructor: each buffer contains inBlocksPerBuffer blocks of 512 bytes
+  public: explicit ACANBusLogger (const uint32_t inBlocksPerBuffer = 4) ;
+
+//--- Destructor
+  public: ~ ACANBusLogger (void) ;
+
+//--- begin: allocate buffers
+  public: void begin (void) ;
+
+//--- end: free buffers (the logger should be detached from the driver)
+  public: void end (void) ;
+
+//--- Write full buffers to the sink, call it from loop (); returns the number of written bytes
+  public: uint32_t flush (Print & inSink) ;
+
+//--- Close the current buffer, even if it is partially filled, and write it to the sink
+  public: uint32_t sync (Print & inSink) ;
+
+//--- Statistics
+  public: inline uint32_t loggedFrameCount (void) const { return mLoggedFrameCount ; }
+  public: inline uint32_t droppedFrameCount (void) const { return mDroppedFrameCount ; }
+  public: inline uint32_t writtenBlockCount (void) const { return mWrittenBlockCount ; }
+  public: inline uint32_t sinkErrorCount (void) const { return mSinkErrorCount ; }
+
+//--- Called by the message interrupt service routine
+  public: void appendFromISR (const CANMessage & inMessage, const uint16_t inFlexcanTimeStamp) ;
+
+//--- Buffers
+  private: const uint32_t mBlocksPerBuffer ;
+  private: ACANBusLogBlock * mBuffer [2] = {nullptr, nullptr} ;
+  private: volatile uint32_t mFullBlockCount [2] = {0, 0} ; // 0 --> buffer is available for filling
+  private: volatile uint32_t mFillBufferIndex = 0 ;
+  private: volatile uint32_t mFillBlockIndex = 0 ;
+  private: volatile uint32_t mFillRecordIndex = 0 ;
+  private: volatile uint32_t mSequence = 0 ;
+  private: uint32_t writeBuffer (Print & inSink, const uint32_t inBufferIndex) ;
+
+//--- Statistics
+  private: volatile uint32_t mLoggedFrameCount = 0 ;
+  private: volatile uint32_t mDroppedFrameCount = 0 ;
+  private: volatile uint32_t mDroppedSinceLastBlock = 0 ;
+  private: uint32_t mWrittenBlockCount = 0 ;
+  private: uint32_t mSinkErrorCount = 0 ;
+
+//--- No copy
+  private : ACANBusLogger (const ACANBusLogger &) = delete ;
+  private : ACANBusLogger & operator = (const ACANBusLogger &) = delete ;
+} ;
+
+//----------------------------------------------------------------------------------------
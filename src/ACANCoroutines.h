@@ -0,0 +1,217 @@
+//----------------------------------------------------------------------------------------
+// C++20 coroutine layer for the ACAN driver: awaitable receive and send
+// by Pierre Molinaro
+// https://github.com/pierremolinaro/acan
+//
+// A coroutine waits for a frame (co_await async.receive ()) or for transmit buffer space
+// (co_await async.send (frame)) without polling. The driver event call back (see
+// ACAN::setEventCallBack) sets pending event bits in an ACANEventLoop, from the message
+// interrupt service routine; ACANEventLoop::run, called from loop (), retries the waiting
+// coroutines and resumes the satisfied ones: coroutines always run in loop context.
+// The DRIVER template argument only needs receive (CANMessage &), tryToSend (const
+// CANMessage &) and setEventCallBack: a fake driver makes the layer usable on the host.
+// Available only if the compiler supports C++20 coroutines (-std=c++20 or gnu++20);
+// otherwise this file is empty.
+//
+//----------------------------------------------------------------------------------------
+
+#pragma once
+
+//----------------------------------------------------------------------------------------
+
+#if (__cplusplus >= 202002L) && defined (__has_include)
+  #if __has_include (<coroutine>)
+    #define ACAN_COROUTINES 1
+  #endif
+#endif
+
+//----------------------------------------------------------------------------------------
+
+#ifdef ACAN_COROUTINES
+
+//----------------------------------------------------------------------------------------
+
+#include <coroutine>
+#include <exception>
+#include <ACAN_CANMessage.h>
+
+//----------------------------------------------------------------------------------------
+//   Fire and forget coroutine: it starts immediately, its frame is released when it
+//   returns. An exception escaping the coroutine calls std::terminate.
+//----------------------------------------------------------------------------------------
+
+class ACANTask {
+  public: class promise_type {
+    public: inline ACANTask get_return_object (void) { return ACANTask () ; }
+    public: inline std::suspend_never initial_suspend (void) noexcept { return {} ; }
+    public: inline std::suspend_never final_suspend (void) noexcept { return {} ; }
+    public: inline void return_void (void) {}
+    public: inline void unhandled_exception (void) { std::terminate () ; }
+  } ;
+} ;
+
+//----------------------------------------------------------------------------------------
+//   Waiting operation, linked into ACANEventLoop
+//----------------------------------------------------------------------------------------
+
+class ACANAwaiter {
+//--- Returns true if the operation is completed (the coroutine is then resumed)
+  public: virtual bool tryToComplete (void) = 0 ;
+
+  public: std::coroutine_handle <> mCoroutine ;
+  public: ACANAwaiter * mNext = nullptr ;
+
+  protected: ~ ACANAwaiter (void) = default ;
+} ;
+
+//----------------------------------------------------------------------------------------
+//   Single threaded executor
+//----------------------------------------------------------------------------------------
+
+class ACANEventLoop {
+//--- Constructor
+  public: ACANEventLoop (void) {}
+
+//--- Any context (interrupt service routine included)
+  public: inline void notify (const uint32_t inEvents) {
+    __atomic_fetch_or (& mPendingEvents, inEvents, __ATOMIC_RELEASE) ;
+  }
+
+//--- Matches ACAN::tEventCallBack, inUserData is the event loop
+  public: static void eventCallBack (const uint32_t inEvents, void * inUserData) {
+    static_cast <ACANEventLoop *> (inUserData)->notify (inEvents) ;
+  }
+
+//--- Loop context: if an event is pending, retries waiting operations in arrival order,
+//    resumes the completed ones. Returns the number of resumed coroutines.
+  public: uint32_t run (void) ;
+
+  public: inline bool hasPendingEvents (void) const { return __atomic_load_n (& mPendingEvents, __ATOMIC_ACQUIRE) != 0 ; }
+  public: inline bool hasWaiters (void) const { return nullptr != mFirstWaiter ; }
+
+//--- Called by awaiters (loop context)
+  public: void enterWaiter (ACANAwaiter * inAwaiter) ;
+
+//--- Private
+  private: uint32_t mPendingEvents = 0 ;
+  private: ACANAwaiter * mFirstWaiter = nullptr ;
+  private: ACANAwaiter * mLastWaiter = nullptr ;
+
+//--- No copy
+  private : ACANEventLoop (const ACANEventLoop &) = delete ;
+  private : ACANEventLoop & operator = (const ACANEventLoop &) = delete ;
+} ;
+
+//----------------------------------------------------------------------------------------
+
+inline void ACANEventLoop::enterWaiter (ACANAwaiter * inAwaiter) {
+  inAwaiter->mNext = nullptr ;
+  if (nullptr == mLastWaiter) {
+    mFirstWaiter = inAwaiter ;
+  }else{
+    mLastWaiter->mNext = inAwaiter ;
+  }
+  mLastWaiter = inAwaiter ;
+}
+
+//----------------------------------------------------------------------------------------
+
+inline uint32_t ACANEventLoop::run (void) {
+  uint32_t resumedCount = 0 ;
+  if (__atomic_exchange_n (& mPendingEvents, 0, __ATOMIC_ACQUIRE) != 0) {
+  //--- Detach waiting list, and split it: completed operations, still waiting operations
+    ACANAwaiter * waiter = mFirstWaiter ;
+    mFirstWaiter = nullptr ;
+    mLastWaiter = nullptr ;
+    ACANAwaiter * firstCompleted = nullptr ;
+    ACANAwaiter * lastCompleted = nullptr ;
+    while (nullptr != waiter) {
+      ACANAwaiter * next = waiter->mNext ;
+      if (waiter->tryToComplete ()) {
+        waiter->mNext = nullptr ;
+        if (nullptr == lastCompleted) {
+          firstCompleted = waiter ;
+        }else{
+          lastCompleted->mNext = waiter ;
+        }
+        lastCompleted = waiter ;
+      }else{
+        enterWaiter (waiter) ;
+      }
+      waiter = next ;
+    }
+  //--- Resume completed operations: a coroutine may wait again (the awaiter is destroyed
+  //    on resume, so read the link first)
+    while (nullptr != firstCompleted) {
+      ACANAwaiter * next = firstCompleted->mNext ;
+      firstCompleted->mCoroutine.resume () ;
+      resumedCount += 1 ;
+      firstCompleted = next ;
+    }
+  }
+  return resumedCount ;
+}
+
+//----------------------------------------------------------------------------------------
+//   Awaitable operations on a driver
+//----------------------------------------------------------------------------------------
+
+template <typename DRIVER> class ACANAsync {
+//--- Constructor: installs the event loop call back into the driver
+  public: ACANAsync (DRIVER & inDriver, ACANEventLoop & inEventLoop) :
+  mDriver (inDriver),
+  mEventLoop (inEventLoop) {
+    inDriver.setEventCallBack (ACANEventLoop::eventCallBack, & inEventLoop) ;
+  }
+
+//--- co_await receive () returns the received frame
+  public: class ReceiveAwaiter final : public ACANAwaiter {
+    public: inline ReceiveAwaiter (ACANAsync & inAsync) : mAsync (inAsync) {}
+    public: inline bool await_ready (void) { return tryToComplete () ; }
+    public: inline void await_suspend (std::coroutine_handle <> inCoroutine) {
+      mCoroutine = inCoroutine ;
+      mAsync.mEventLoop.enterWaiter (this) ;
+    }
+    public: inline CANMessage await_resume (void) { return mMessage ; }
+    public: virtual bool tryToComplete (void) override { return mAsync.mDriver.receive (mMessage) ; }
+
+    private: ACANAsync & mAsync ;
+    private: CANMessage mMessage ;
+  } ;
+
+  public: inline ReceiveAwaiter receive (void) { return ReceiveAwaiter (*this) ; }
+
+//--- co_await send (frame) completes when the frame is accepted by tryToSend
+  public: class SendAwaiter final : public ACANAwaiter {
+    public: inline SendAwaiter (ACANAsync & inAsync, const CANMessage & inMessage) :
+    mAsync (inAsync),
+    mMessage (inMessage) {
+    }
+    public: inline bool await_ready (void) { return tryToComplete () ; }
+    public: inline void await_suspend (std::coroutine_handle <> inCoroutine) {
+      mCoroutine = inCoroutine ;
+      mAsync.mEventLoop.enterWaiter (this) ;
+    }
+    public: inline void await_resume (void) {}
+    public: virtual bool tryToComplete (void) override { return mAsync.mDriver.tryToSend (mMessage) ; }
+
+    private: ACANAsync & mAsync ;
+    private: const CANMessage mMessage ;
+  } ;
+
+  public: inline SendAwaiter send (const CANMessage & inMessage) { return SendAwaiter (*this, inMessage) ; }
+
+//--- Private
+  private: DRIVER & mDriver ;
+  private: ACANEventLoop & mEventLoop ;
+
+//--- No copy
+  private : ACANAsync (const ACANAsync &) = delete ;
+  private : ACANAsync & operator = (const ACANAsync &) = delete ;
+} ;
+
+//----------------------------------------------------------------------------------------
+
+#endif
+
+//----------------------------------------------------------------------------------------
@@ -0,0 +1,375 @@
+//----------------------------------------------------------------------------------------
+// Deadline supervision of cyclic frames
+// by Pierre Molinaro
+// https://github.com/pierremolinaro/acan
+//
+//----------------------------------------------------------------------------------------
+
+#include "ACANCyclicSupervisor.h"
+
+//----------------------------------------------------------------------------------------
+
+static uint32_t powerOfTwoAbove (const uint32_t inValue) {
+  uint32_t result = 1 ;
+  while ((result < inValue) && (result < (1U << 31))) {
+    result <<= 1 ;
+  }
+  return result ;
+}
+
+//----------------------------------------------------------------------------------------
+//    CONSTRUCTOR, DESTRUCTOR
+//----------------------------------------------------------------------------------------
+
+ACANCyclicSupervisor::ACANCyclicSupervisor (const uint32_t inTickMicros,
+                                            const uint32_t inSlotCount) :
+mSlotMask (powerOfTwoAbove (inSlotCount) - 1),
+mTickMicros ((inTickMicros > 0) ? inTickMicros : 1) {
+}
+
+//----------------------------------------------------------------------------------------
+
+ACANCyclicSupervisor::~ ACANCyclicSupervisor (void) {
+  deallocate () ;
+}
+
+//----------------------------------------------------------------------------------------
+
+void ACANCyclicSupervisor::deallocate (void) {
+  delete [] mEntries ; mEntries = nullptr ;
+  delete [] mHashKeys ; mHashKeys = nullptr ;
+  delete [] mHashEntries ; mHashEntries = nullptr ;
+  delete [] mSlots ; mSlots = nullptr ;
+  mEntryCount = 0 ;
+  mMaxEntryCount = 0 ;
+  mHashMask = 0 ;
+  mStarted = false ;
+}
+
+//----------------------------------------------------------------------------------------
+
+bool ACANCyclicSupervisor::allocate (const uint32_t inMaxEntryCount) {
+  deallocate () ;
+  const bool ok = inMaxEntryCount > 0 ;
+  if (ok) {
+    mEntries = new Entry [inMaxEntryCount] ;
+    mMaxEntryCount = inMaxEntryCount ;
+  //--- Hash table load factor is at most 1/2
+    const uint32_t hashSize = powerOfTwoAbove (2 * inMaxEntryCount) ;
+    mHashKeys = new uint32_t [hashSize] ;
+    mHashEntries = new uint32_t [hashSize] ;
+    for (uint32_t i=0 ; i<hashSize ; i++) {
+      mHashKeys [i] = kNoEntry ;
+    }
+    mHashMask = hashSize - 1 ;
+  //--- Wheel
+    mSlots = new uint32_t [mSlotMask + 1] ;
+    for (uint32_t i=0 ; i<=mSlotMask ; i++) {
+      mSlots [i] = kNoEntry ;
+    }
+    mCurrentSlot = 0 ;
+  }
+  return ok ;
+}
+
+//----------------------------------------------------------------------------------------
+//    HASH TABLE
+//----------------------------------------------------------------------------------------
+
+uint32_t ACANCyclicSupervisor::key (const bool inExtended, const uint32_t inIdentifier) {
+  return inExtended ? ((inIdentifier & 0x1FFFFFFF) | (1U << 31)) : (inIdentifier & 0x7FF) ;
+}
+
+//----------------------------------------------------------------------------------------
+
+static uint32_t hashOfKey (const uint32_t inKey) {
+  uint32_t h = inKey * 0x9E3779B1U ; // Fibonacci hashing, high bits folded down
+  return h ^ (h >> 16) ;
+}
+
+//----------------------------------------------------------------------------------------
+
+uint32_t ACANCyclicSupervisor::findEntry (const uint32_t inKey) const {
+  uint32_t result = kNoEntry ;
+  if (nullptr != mHashKeys) {
+    uint32_t idx = hashOfKey (inKey) & mHashMask ;
+    bool loop = true ;
+    while (loop) {
+      const uint32_t slotKey = __atomic_load_n (& mHashKeys [idx], __ATOMIC_ACQUIRE) ;
+      if (slotKey == inKey) {
+        result = mHashEntries [idx] ;
+        loop = false ;
+      }else if (slotKey == kNoEntry) {
+        loop = false ;
+      }else{
+        idx = (idx + 1) & mHashMask ;
+      }
+    }
+  }
+  return result ;
+}
+
+//----------------------------------------------------------------------------------------
+//    SUPERVISED IDENTIFIERS
+//----------------------------------------------------------------------------------------
+
+uint32_t ACANCyclicSupervisor::supervise (const tFrameFormat inFormat,
+                                          const uint32_t inIdentifier,
+                                          const uint32_t inPeriodMicros,
+                                          const uint32_t inToleranceMicros,
+                                          const uint32_t inNowMicros) {
+  uint32_t errorCode = 0 ;
+  const uint32_t entryKey = key (inFormat == kExtended, inIdentifier) ;
+  if (mEntryCount >= mMaxEntryCount) {
+    errorCode |= kTooManyEntries ;
+  }else if (findEntry (entryKey) != kNoEntry) {
+    errorCode |= kAlreadySupervised ;
+  }
+  if (inPeriodMicros == 0) {
+    errorCode |= kNullPeriod ;
+  }
+  if (errorCode == 0) {
+    if (!mStarted) {
+      mStarted = true ;
+      mNextTickMicros = inNowMicros ;
+    }
+    const uint32_t entryIndex = mEntryCount ;
+    Entry & entry = mEntries [entryIndex] ;
+    entry.mKey = entryKey ;
+    entry.mPeriodMicros = inPeriodMicros ;
+    entry.mToleranceMicros = inToleranceMicros ;
+    entry.mCheckedFrameCount = 0 ;
+    entry.mTimeoutCount = 0 ;
+    entry.mTimedOut = false ;
+    entry.mFrameCount = 0 ;
+    entry.mLastSeenMicros = inNowMicros ;
+    entry.mIntervalCount = 0 ;
+    entry.mMinIntervalMicros = 0xFFFFFFFF ;
+    entry.mMaxIntervalMicros = 0 ;
+    entry.mMaxJitterMicros = 0 ;
+    entry.mTotalJitterMicros = 0 ;
+    schedule (entryIndex, inNowMicros + inPeriodMicros + inToleranceMicros) ;
+    mEntryCount += 1 ;
+  //--- Publish in hash table: entry index first
+    uint32_t idx = hashOfKey (entryKey) & mHashMask ;
+    while (mHashKeys [idx] != kNoEntry) {
+      idx = (idx + 1) & mHashMask ;
+    }
+    mHashEntries [idx] = entryIndex ;
+    __atomic_store_n (& mHashKeys [idx], entryKey, __ATOMIC_RELEASE) ;
+  }
+  return errorCode ;
+}
+
+//----------------------------------------------------------------------------------------
+
+int32_t ACANCyclicSupervisor::entryIndex (const tFrameFormat inFormat, const uint32_t inIdentifier) const {
+  const uint32_t idx = findEntry (key (inFormat == kExtended, inIdentifier)) ;
+  return (idx == kNoEntry) ? -1 : (int32_t) idx ;
+}
+
+//----------------------------------------------------------------------------------------
+
+uint32_t ACANCyclicSupervisor::identifier (const uint32_t inEntryIndex) const {
+  return (inEntryIndex < mEntryCount) ? (mEntries [inEntryIndex].mKey & 0x1FFFFFFF) : 0 ;
+}
+
+//----------------------------------------------------------------------------------------
+
+bool ACANCyclicSupervisor::isExtended (const uint32_t inEntryIndex) const {
+  return (inEntryIndex < mEntryCount) && ((mEntries [inEntryIndex].mKey & (1U << 31)) != 0) ;
+}
+
+//----------------------------------------------------------------------------------------
+
+bool ACANCyclicSupervisor::isTimedOut (const uint32_t inEntryIndex) const {
+  return (inEntryIndex < mEntryCount) && mEntries [inEntryIndex].mTimedOut ;
+}
+
+//----------------------------------------------------------------------------------------
+//    RECEPTION
+//----------------------------------------------------------------------------------------
+
+bool ACANCyclicSupervisor::refresh (const CANMessage & inMessage, const uint32_t inReceiveMicros) {
+  const uint32_t entryIndex = findEntry (key (inMessage.ext, inMessage.id)) ;
+  const bool supervised = entryIndex != kNoEntry ;
+  if (supervised) {
+    Entry & entry = mEntries [entryIndex] ;
+    const uint32_t frameCount = entry.mFrameCount ;
+    if (frameCount > 0) {
+      const uint32_t interval = inReceiveMicros - entry.mLastSeenMicros ;
+      const uint32_t period = entry.mPeriodMicros ;
+      const uint32_t jitter = (interval > period) ? (interval - period) : (period - interval) ;
+      entry.mIntervalCount = entry.mIntervalCount + 1 ;
+      if (entry.mMinIntervalMicros > interval) {
+        entry.mMinIntervalMicros = interval ;
+      }
+      if (entry.mMaxIntervalMicros < interval) {
+        entry.mMaxIntervalMicros = interval ;
+      }
+      if (entry.mMaxJitterMicros < jitter) {
+        entry.mMaxJitterMicros = jitter ;
+      }
+      entry.mTotalJitterMicros = entry.mTotalJitterMicros + jitter ;
+    }
+  //--- Reception time first: poll reads the frame count, then the reception time
+    entry.mLastSeenMicros = inReceiveMicros ;
+    __atomic_store_n (& entry.mFrameCount, frameCount + 1, __ATOMIC_RELEASE) ;
+  }
+  return supervised ;
+}
+
+//----------------------------------------------------------------------------------------
+//    TIMING WHEEL
+//----------------------------------------------------------------------------------------
+
+void ACANCyclicSupervisor::schedule (const uint32_t inEntryIndex, const uint32_t inDeadline) {
+  Entry & entry = mEntries [inEntryIndex] ;
+  entry.mDeadline = inDeadline ;
+//--- The entry is handled by the first tick that starts at or after its deadline. A
+//    deadline more than a wheel turn ahead shares a slot with nearer ones: poll skips it
+//    until it is reached.
+  const int32_t delay = (int32_t) (inDeadline - mNextTickMicros) ;
+  const uint32_t ticks = (delay > 0) ? (((uint32_t) delay + mTickMicros - 1) / mTickMicros) : 0 ;
+  const uint32_t slot = (mCurrentSlot + ticks) & mSlotMask ;
+  entry.mNext = mSlots [slot] ;
+  mSlots [slot] = inEntryIndex ;
+}
+
+//----------------------------------------------------------------------------------------
+
+void ACANCyclicSupervisor::handleDeadline (const uint32_t inEntryIndex,
+                                           const uint32_t inNowMicros,
+                                           uint32_t & ioCallBackCount) {
+  Entry & entry = mEntries [inEntryIndex] ;
+  const uint32_t frameCount = __atomic_load_n (& entry.mFrameCount, __ATOMIC_ACQUIRE) ;
+  const uint32_t lastSeen = entry.mLastSeenMicros ;
+  const bool received = frameCount != entry.mCheckedFrameCount ;
+  entry.mCheckedFrameCount = frameCount ;
+  const uint32_t nextDeadline = lastSeen + entry.mPeriodMicros + entry.mToleranceMicros ;
+  if (entry.mTimedOut) {
+    if (received) { // Frames again: the next one is expected relative to the last one
+      entry.mTimedOut = false ;
+      schedule (inEntryIndex, nextDeadline) ;
+      if (nullptr != mRecoveryCallBack) {
+        mRecoveryCallBack (inEntryIndex) ;
+        ioCallBackCount += 1 ;
+      }
+    }else{ // Still silent, check again a period later
+      schedule (inEntryIndex, inNowMicros + entry.mPeriodMicros) ;
+    }
+  }else if (received && ((int32_t) (nextDeadline - inNowMicros) > 0)) { // Refreshed in time
+    schedule (inEntryIndex, nextDeadline) ;
+  }else{
+    entry.mTimedOut = true ;
+    entry.mTimeoutCount += 1 ;
+    schedule (inEntryIndex, inNowMicros + entry.mPeriodMicros) ;
+    if (nullptr != mTimeoutCallBack) {
+      mTimeoutCallBack (inEntryIndex) ;
+      ioCallBackCount += 1 ;
+    }
+  }
+}
+
+//----------------------------------------------------------------------------------------
+
+uint32_t ACANCyclicSupervisor::poll (const uint32_t inNowMicros) {
+  uint32_t callBackCount = 0 ;
+  uint32_t handledSlotCount = 0 ;
+  while (mStarted
+      && ((int32_t) (inNowMicros - mNextTickMicros) >= 0)
+      && (handledSlotCount <= mSlotMask)) {
+  //--- Detach the slot list, and advance first: an entry scheduled with a passed
+  //    deadline goes to the next slot
+    const uint32_t slot = mCurrentSlot ;
+    uint32_t entryIndex = mSlots [slot] ;
+    mSlots [slot] = kNoEntry ;
+    mCurrentSlot = (mCurrentSlot + 1) & mSlotMask ;
+    mNextTickMicros += mTickMicros ;
+    handledSlotCount += 1 ;
+    while (entryIndex != kNoEntry) {
+      Entry & entry = mEntries [entryIndex] ;
+      const uint32_t next = entry.mNext ;
+      mVisitedEntryCount += 1 ;
+      if ((int32_t) (entry.mDeadline - inNowMicros) > 0) { // Next wheel turn (or later)
+        entry.mNext = mSlots [slot] ;
+        mSlots [slot] = entryIndex ;
+      }else{
+        handleDeadline (entryIndex, inNowMicros, callBackCount) ;
+      }
+      entryIndex = next ;
+    }
+  }
+//--- More than a wheel turn late: every slot has been handled, skip the remaining ticks
+  if (mStarted && ((int32_t) (inNowMicros - mNextTickMicros) >= 0)) {
+    const uint32_t ticks = (inNowMicros - mNextTickMicros) / mTickMicros + 1 ;
+    mNextTickMicros += ticks * mTickMicros ;
+    mCurrentSlot = (mCurrentSlot + ticks) & mSlotMask ;
+  }
+  return callBackCount ;
+}
+
+//----------------------------------------------------------------------------------------
+//    STATISTICS
+//----------------------------------------------------------------------------------------
+
+uint32_t ACANCyclicSupervisor::frameCount (const uint32_t inEntryIndex) const {
+  return (inEntryIndex < mEntryCount) ? mEntries [inEntryIndex].mFrameCount : 0 ;
+}
+
+//----------------------------------------------------------------------------------------
+
+uint32_t ACANCyclicSupervisor::timeoutCount (const uint32_t inEntryIndex) const {
+  return (inEntryIndex < mEntryCount) ? mEntries [inEntryIndex].mTimeoutCount : 0 ;
+}
+
+//----------------------------------------------------------------------------------------
+
+uint32_t ACANCyclicSupervisor::lastSeenMicros (const uint32_t inEntryIndex) const {
+  return (inEntryIndex < mEntryCount) ? mEntries [inEntryIndex].mLastSeenMicros : 0 ;
+}
+
+//----------------------------------------------------------------------------------------
+
+uint32_t ACANCyclicSupervisor::minIntervalMicros (const uint32_t inEntryIndex) const {
+  return (inEntryIndex < mEntryCount) ? mEntries [inEntryIndex].mMinIntervalMicros : 0xFFFFFFFF ;
+}
+
+//----------------------------------------------------------------------------------------
+
+uint32_t ACANCyclicSupervisor::maxIntervalMicros (const uint32_t inEntryIndex) const {
+  return (inEntryIndex < mEntryCount) ? mEntries [inEntryIndex].mMaxIntervalMicros : 0 ;
+}
+
+//----------------------------------------------------------------------------------------
+
+uint32_t ACANCyclicSupervisor::meanJitterMicros (const uint32_t inEntryIndex) const {
+  uint32_t result = 0 ;
+  if ((inEntryIndex < mEntryCount) && (mEntries [inEntryIndex].mIntervalCount > 0)) {
+    result = (uint32_t) (mEntries [inEntryIndex].mTotalJitterMicros / mEntries [inEntryIndex].mIntervalCount) ;
+  }
+  return result ;
+}
+
+//----------------------------------------------------------------------------------------
+
+uint32_t ACANCyclicSupervisor::maxJitterMicros (const uint32_t inEntryIndex) const {
+  return (inEntryIndex < mEntryCount) ? mEntries [inEntryIndex].mMaxJitterMicros : 0 ;
+}
+
+//----------------------------------------------------------------------------------------
+
+void ACANCyclicSupervisor::resetStatistics (void) {
+  for (uint32_t i=0 ; i<mEntryCount ; i++) {
+    Entry & entry = mEntries [i] ;
+    entry.mTimeoutCount = 0 ;
+    entry.mIntervalCount = 0 ;
+    entry.mMinIntervalMicros = 0xFFFFFFFF ;
+    entry.mMaxIntervalMicros = 0 ;
+    entry.mMaxJitterMicros = 0 ;
+    entry.mTotalJitterMicros = 0 ;
+  }
+  mVisitedEntryCount = 0 ;
+}
+
+//----------------------------------------------------------------------------------------
@@ -0,0 +1,134 @@
+//----------------------------------------------------------------------------------------
+// Deadline supervision of cyclic frames
+// by Pierre Molinaro
+// https://github.com/pierremolinaro/acan
+//
+// Every supervised identifier has an expected period and a tolerance. refresh records the
+// reception of a frame in constant time (hash table lookup): it is called by the message
+// interrupt service routine (see ACAN::setCyclicSupervisor). Deadlines are kept in a hashed
+// timing wheel; poll, called from loop, only visits the wheel slots elapsed since its last
+// call: an entry refreshed in time is moved to the slot of its new deadline, an entry
+// whose deadline has passed fires the timeout call back. A timed out entry is checked
+// again every period; the recovery call back is called when frames are received again.
+// Times are given in microseconds by the caller: this file does not depend on Arduino.
+//
+//----------------------------------------------------------------------------------------
+
+#pragma once
+
+//----------------------------------------------------------------------------------------
+
+#include <ACAN_CANMessage.h>
+
+//----------------------------------------------------------------------------------------
+
+class ACANCyclicSupervisor {
+//--- Constructor: wheel slot duration, slot count (rounded up to a power of two)
+  public: ACANCyclicSupervisor (const uint32_t inTickMicros = 1000,
+                                const uint32_t inSlotCount = 256) ;
+  public: ~ ACANCyclicSupervisor (void) ;
+
+//--- Allocates entries and wheel, removes all entries (supervisor detached from the driver);
+//    returns false if inMaxEntryCount is 0
+  public: bool allocate (const uint32_t inMaxEntryCount) ;
+
+//--- Supervise an identifier: the first frame is expected before inNowMicros + period +
+//    tolerance. Entry indexes are given in registration order (the new entry index is
+//    entryCount () - 1). Entries can be added while the supervisor is attached to a
+//    driver, not removed. Returns an error code (0 : ok, other: every bit denotes an error).
+  public: static const uint32_t kTooManyEntries    = 1 << 0 ;
+  public: static const uint32_t kAlreadySupervised = 1 << 1 ;
+  public: static const uint32_t kNullPeriod        = 1 << 2 ;
+  public: uint32_t supervise (const tFrameFormat inFormat,
+                              const uint32_t inIdentifier,
+                              const uint32_t inPeriodMicros,
+                              const uint32_t inToleranceMicros,
+                              const uint32_t inNowMicros) ;
+
+//--- Constant time; returns false if the frame is not supervised. Any context (a single
+//    one at a time, usually the message interrupt service routine).
+  public: bool refresh (const CANMessage & inMessage, const uint32_t inReceiveMicros) ;
+
+//--- Loop context: handles the wheel slots elapsed until inNowMicros, calls the call backs
+//    (with the entry index); returns the number of called call backs
+  public: typedef void (*tSupervisionCallBack) (const uint32_t inEntryIndex) ;
+  public: inline void setTimeoutCallBack (const tSupervisionCallBack inCallBack) { mTimeoutCallBack = inCallBack ; }
+  public: inline void setRecoveryCallBack (const tSupervisionCallBack inCallBack) { mRecoveryCallBack = inCallBack ; }
+  public: uint32_t poll (const uint32_t inNowMicros) ;
+
+//--- Entries
+  public: inline uint32_t entryCount (void) const { return mEntryCount ; }
+  public: int32_t entryIndex (const tFrameFormat inFormat, const uint32_t inIdentifier) const ; // -1 if not supervised
+  public: uint32_t identifier (const uint32_t inEntryIndex) const ;
+  public: bool isExtended (const uint32_t inEntryIndex) const ;
+  public: bool isTimedOut (const uint32_t inEntryIndex) const ;
+
+//--- Per entry statistics, updated by refresh (read or reset them with interrupts disabled
+//    for a consistent snapshot). Jitter is the distance between a reception interval and
+//    the period. frameCount is not reset by resetStatistics.
+  public: uint32_t frameCount (const uint32_t inEntryIndex) const ;
+  public: uint32_t timeoutCount (const uint32_t inEntryIndex) const ;
+  public: uint32_t lastSeenMicros (const uint32_t inEntryIndex) const ;
+  public: uint32_t minIntervalMicros (const uint32_t inEntryIndex) const ; // 0xFFFFFFFF if no interval
+  public: uint32_t maxIntervalMicros (const uint32_t inEntryIndex) const ;
+  public: uint32_t meanJitterMicros (const uint32_t inEntryIndex) const ;
+  public: uint32_t maxJitterMicros (const uint32_t inEntryIndex) const ;
+  public: void resetStatistics (void) ;
+
+//--- Wheel statistics: entries visited by poll (the supervision cost)
+  public: inline uint32_t visitedEntryCount (void) const { return mVisitedEntryCount ; }
+
+//--- Private
+  private: static const uint32_t kNoEntry = 0xFFFFFFFF ; // Also the empty hash key
+  private: class Entry {
+  //--- Loop context
+    public: uint32_t mKey ;
+    public: uint32_t mPeriodMicros ;
+    public: uint32_t mToleranceMicros ;
+    public: uint32_t mDeadline ;
+    public: uint32_t mNext ; // In wheel slot list
+    public: uint32_t mCheckedFrameCount ; // Frame count when mDeadline was checked
+    public: uint32_t mTimeoutCount ;
+    public: bool mTimedOut ;
+  //--- Written by refresh
+    public: volatile uint32_t mFrameCount ;
+    public: volatile uint32_t mLastSeenMicros ;
+    public: volatile uint32_t mIntervalCount ;
+    public: volatile uint32_t mMinIntervalMicros ;
+    public: volatile uint32_t mMaxIntervalMicros ;
+    public: volatile uint32_t mMaxJitterMicros ;
+    public: volatile uint64_t mTotalJitterMicros ;
+  } ;
+  private: static uint32_t key (const bool inExtended, const uint32_t inIdentifier) ;
+  private: uint32_t findEntry (const uint32_t inKey) const ;
+  private: void schedule (const uint32_t inEntryIndex, const uint32_t inDeadline) ;
+  private: void handleDeadline (const uint32_t inEntryIndex, const uint32_t inNowMicros, uint32_t & ioCallBackCount) ;
+  private: void deallocate (void) ;
+
+  private: Entry * mEntries = nullptr ;
+  private: uint32_t mEntryCount = 0 ;
+  private: uint32_t mMaxEntryCount = 0 ;
+//--- Hash table (open addressing, linear probing): key, entry index. A slot entry index is
+//    written before its key, so refresh never reads a partially added entry.
+  private: uint32_t * mHashKeys = nullptr ;
+  private: uint32_t * mHashEntries = nullptr ;
+  private: uint32_t mHashMask = 0 ;
+//--- Wheel: first entry of each slot; the current slot is the one of the tick that
+//    starts at mNextTickMicros
+  private: uint32_t * mSlots = nullptr ;
+  private: const uint32_t mSlotMask ;
+  private: const uint32_t mTickMicros ;
+  private: uint32_t mCurrentSlot = 0 ;
+  private: uint32_t mNextTickMicros = 0 ;
+  private: bool mStarted = false ; // mNextTickMicros is set by the first supervise call
+//--- Call backs, statistics
+  private: tSupervisionCallBack mTimeoutCallBack = nullptr ;
+  private: tSupervisionCallBack mRecoveryCallBack = nullptr ;
+  private: uint32_t mVisitedEntryCount = 0 ;
+
+//--- No copy
+  private : ACANCyclicSupervisor (const ACANCyclicSupervisor &) = delete ;
+  private : ACANCyclicSupervisor & operator = (const ACANCyclicSupervisor &) = delete ;
+} ;
+
+//----------------------------------------------------------------------------------------
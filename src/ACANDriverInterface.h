@@ -0,0 +1,136 @@
+//----------------------------------------------------------------------------------------
+// Common driver interface, resolved at compile time
+// by Pierre Molinaro
+// https://github.com/pierremolinaro/acan
+//
+// Generic layers (gateways, loggers, protocol stacks) are written once as templates on
+// the driver type, and are inlined against it: no virtual call per frame.
+//
+//   template <typename DRIVER> void forward (DRIVER & ioSource, DRIVER & ioDestination) {
+//     static_assert (ACANIsDriver <DRIVER>::value, "DRIVER does not provide the ACAN driver interface") ;
+//     ...
+//   }
+//
+// A driver provides (ACANIsDriver checks names and result types):
+//   bool tryToSend (const CANMessage &), bool receive (CANMessage &), bool available (),
+//   const: transmitBufferSize, transmitBufferCount, transmitBufferPeakCount,
+//   receiveBufferSize, receiveBufferCount, receiveBufferPeakCount, receivedFrameCount,
+//   receiveErrorCounter, transmitErrorCounter (uint32_t), controllerState (tControllerState).
+// Deriving from ACANDriverInterface <DRIVER> (CRTP) adds batch variants and derived state;
+// a driver with a faster implementation declares its own, which hides the default one.
+// ACAN, ACANSimulatedNode and ACANMockDriver are drivers. With C++20 concepts, ACANDriver
+// is the same requirement as a concept. This file does not depend on Arduino.
+//
+//----------------------------------------------------------------------------------------
+
+#pragma once
+
+//----------------------------------------------------------------------------------------
+
+#include <ACAN_CANMessage.h>
+
+//----------------------------------------------------------------------------------------
+
+typedef enum {kActive, kPassive, kBusOff} tControllerState ;
+
+//----------------------------------------------------------------------------------------
+//   CRTP base
+//----------------------------------------------------------------------------------------
+
+template <typename DRIVER> class ACANDriverInterface {
+//--- Sends the frames in order, stops at the first one that is not accepted; returns
+//    the number of accepted frames
+  public: uint32_t tryToSendBatch (const CANMessage inMessages [], const uint32_t inCount) {
+    uint32_t count = 0 ;
+    while ((count < inCount) && driver ().tryToSend (inMessages [count])) {
+      count += 1 ;
+    }
+    return count ;
+  }
+
+//--- Receives at most inMaxCount frames, returns the number of received frames
+  public: uint32_t receiveBatch (CANMessage outMessages [], const uint32_t inMaxCount) {
+    uint32_t count = 0 ;
+    while ((count < inMaxCount) && driver ().receive (outMessages [count])) {
+      count += 1 ;
+    }
+    return count ;
+  }
+
+//--- Derived state
+  public: inline uint32_t transmitBufferFreeCount (void) const {
+    const uint32_t count = driver ().transmitBufferCount () ;
+    const uint32_t size = driver ().transmitBufferSize () ;
+    return (count < size) ? (size - count) : 0 ;
+  }
+
+  public: inline bool isBusOff (void) const { return driver ().controllerState () == kBusOff ; }
+
+//--- Private
+  private: inline DRIVER & driver (void) { return static_cast <DRIVER &> (*this) ; }
+  private: inline const DRIVER & driver (void) const { return static_cast <const DRIVER &> (*this) ; }
+} ;
+
+//----------------------------------------------------------------------------------------
+//   Interface check (C++14: no standard library header is needed)
+//----------------------------------------------------------------------------------------
+
+template <typename T> T & acanDeclaredValue (void) ; // Only used in decltype
+
+template <typename A, typename B> class ACANSameType { public: static const bool value = false ; } ;
+template <typename A> class ACANSameType <A, A> { public: static const bool value = true ; } ;
+
+template <typename ... T> class ACANVoidType { public: typedef void type ; } ;
+
+//----------------------------------------------------------------------------------------
+
+#define ACAN_DRIVER_SEND(D)     decltype (acanDeclaredValue <D> ().tryToSend (acanDeclaredValue <const CANMessage> ()))
+#define ACAN_DRIVER_RECEIVE(D)  decltype (acanDeclaredValue <D> ().receive (acanDeclaredValue <CANMessage> ()))
+#define ACAN_DRIVER_CALL(D, M)  decltype (acanDeclaredValue <D> ().M ())
+
+template <typename DRIVER, typename = void> class ACANIsDriver {
+  public: static const bool value = false ;
+} ;
+
+template <typename DRIVER> class ACANIsDriver <DRIVER, typename ACANVoidType <
+  ACAN_DRIVER_SEND (DRIVER),
+  ACAN_DRIVER_RECEIVE (DRIVER),
+  ACAN_DRIVER_CALL (DRIVER, available),
+  ACAN_DRIVER_CALL (const DRIVER, transmitBufferSize),
+  ACAN_DRIVER_CALL (const DRIVER, transmitBufferCount),
+  ACAN_DRIVER_CALL (const DRIVER, transmitBufferPeakCount),
+  ACAN_DRIVER_CALL (const DRIVER, receiveBufferSize),
+  ACAN_DRIVER_CALL (const DRIVER, receiveBufferCount),
+  ACAN_DRIVER_CALL (const DRIVER, receiveBufferPeakCount),
+  ACAN_DRIVER_CALL (const DRIVER, receivedFrameCount),
+  ACAN_DRIVER_CALL (const DRIVER, receiveErrorCounter),
+  ACAN_DRIVER_CALL (const DRIVER, transmitErrorCounter),
+  ACAN_DRIVER_CALL (const DRIVER, controllerState)
+>::type> {
+  public: static const bool value =
+    ACANSameType <ACAN_DRIVER_SEND (DRIVER), bool>::value &&
+    ACANSameType <ACAN_DRIVER_RECEIVE (DRIVER), bool>::value &&
+    ACANSameType <ACAN_DRIVER_CALL (DRIVER, available), bool>::value &&
+    ACANSameType <ACAN_DRIVER_CALL (const DRIVER, transmitBufferSize), uint32_t>::value &&
+    ACANSameType <ACAN_DRIVER_CALL (const DRIVER, transmitBufferCount), uint32_t>::value &&
+    ACANSameType <ACAN_DRIVER_CALL (const DRIVER, transmitBufferPeakCount), uint32_t>::value &&
+    ACANSameType <ACAN_DRIVER_CALL (const DRIVER, receiveBufferSize), uint32_t>::value &&
+    ACANSameType <ACAN_DRIVER_CALL (const DRIVER, receiveBufferCount), uint32_t>::value &&
+    ACANSameType <ACAN_DRIVER_CALL (const DRIVER, receiveBufferPeakCount), uint32_t>::value &&
+    ACANSameType <ACAN_DRIVER_CALL (const DRIVER, receivedFrameCount), uint32_t>::value &&
+    ACANSameType <ACAN_DRIVER_CALL (const DRIVER, receiveErrorCounter), uint32_t>::value &&
+    ACANSameType <ACAN_DRIVER_CALL (const DRIVER, transmitErrorCounter), uint32_t>::value &&
+    ACANSameType <ACAN_DRIVER_CALL (const DRIVER, controllerState), tControllerState>::value ;
+} ;
+
+#undef ACAN_DRIVER_SEND
+#undef ACAN_DRIVER_RECEIVE
+#undef ACAN_DRIVER_CALL
+
+//----------------------------------------------------------------------------------------
+
+#ifdef __cpp_concepts
+  template <typename DRIVER> concept ACANDriver = ACANIsDriver <DRIVER>::value ;
+#endif
+
+//----------------------------------------------------------------------------------------
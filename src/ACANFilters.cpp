@@ -0,0 +1,97 @@
+//----------------------------------------------------------------------------------------
+// Receive filters of the ACAN driver
+// by Pierre Molinaro
+// https://github.com/pierremolinaro/acan
+//
+//----------------------------------------------------------------------------------------
+
+#include "ACANFilters.h"
+
+//----------------------------------------------------------------------------------------
+//    CAN Filter
+//----------------------------------------------------------------------------------------
+
+static uint32_t defaultMask (const tFrameFormat inFormat) {
+  return (inFormat == kExtended) ? 0x1FFFFFFF : 0x7FF ;
+}
+
+//----------------------------------------------------------------------------------------
+
+static uint32_t computeFilterMask (const tFrameFormat inFormat,
+                                   const uint32_t inMask) {
+  return
+    (1 << 31) | // Test RTR bit
+    (1 << 30) | // Test IDE bit
+    ((inFormat == kStandard) ? (inMask << 19) : (inMask << 1)) // Test identifier
+  ;
+}
+
+//----------------------------------------------------------------------------------------
+
+static uint32_t computeAcceptanceFilter (const tFrameKind inKind,
+                                         const tFrameFormat inFormat,
+                                         const uint32_t inMask,
+                                         const uint32_t inAcceptance) {
+  const uint32_t acceptanceConformanceError = (inFormat == kStandard)
+    ? (inAcceptance > 0x7FF)
+    : (inAcceptance > 0x1FFFFFFF)
+  ;
+  const uint32_t maskConformanceError = (inFormat == kStandard)
+    ? (inMask > 0x7FF)
+    : (inMask > 0x1FFFFFFF)
+  ;
+//--- inMask & inAcceptance sould be equal to inAcceptance
+  const uint32_t maskAndAcceptanceCompabilityError = (inMask & inAcceptance) != inAcceptance ;
+//---
+  return
+    ((inKind == kRemote) ? (1 << 31) : 0) | // Accepts remote or data frames ?
+    ((inFormat == kExtended) ? (1 << 30) : 0) | // Accepts standard or extended frames ?
+    ((inFormat == kStandard) ? (inAcceptance << 19) : (inAcceptance << 1)) |
+    acceptanceConformanceError | // Bit 0 is not used by hardware --> we use it for sting conformance error
+    maskConformanceError | maskAndAcceptanceCompabilityError
+  ;
+}
+
+//----------------------------------------------------------------------------------------
+
+ACANPrimaryFilter::ACANPrimaryFilter (const tFrameKind inKind,
+                                      const tFrameFormat inFormat,
+                                      const ACANCallBackRoutine inCallBackRoutine) :
+mFilterMask (computeFilterMask (inFormat, 0)),
+mAcceptanceFilter (computeAcceptanceFilter (inKind, inFormat, defaultMask (inFormat), 0)),
+mCallBackRoutine (inCallBackRoutine) {
+}
+
+//----------------------------------------------------------------------------------------
+
+ACANPrimaryFilter::ACANPrimaryFilter (const tFrameKind inKind,
+                                      const tFrameFormat inFormat,
+                                      const uint32_t inIdentifier,
+                                      const ACANCallBackRoutine inCallBackRoutine) :
+mFilterMask (computeFilterMask (inFormat, (inFormat == kExtended) ? 0x1FFFFFFF : 0x7FF)),
+mAcceptanceFilter (computeAcceptanceFilter (inKind, inFormat, defaultMask (inFormat), inIdentifier)),
+mCallBackRoutine (inCallBackRoutine) {
+}
+
+//----------------------------------------------------------------------------------------
+
+ACANPrimaryFilter::ACANPrimaryFilter (const tFrameKind inKind,
+                                      const tFrameFormat inFormat,
+                                      const uint32_t inMask,
+                                      const uint32_t inAcceptance,
+                                      const ACANCallBackRoutine inCallBackRoutine) :
+mFilterMask (computeFilterMask (inFormat, inMask)),
+mAcceptanceFilter (computeAcceptanceFilter (inKind, inFormat, inMask, inAcceptance)),
+mCallBackRoutine (inCallBackRoutine) {
+}
+
+//----------------------------------------------------------------------------------------
+
+ACANSecondaryFilter::ACANSecondaryFilter (const tFrameKind inKind,
+                                          const tFrameFormat inFormat,
+                                          const uint32_t inIdentifier,
+                                          const ACANCallBackRoutine inCallBackRoutine) :
+mSingleAcceptanceFilter (computeAcceptanceFilter (inKind, inFormat, defaultMask (inFormat), inIdentifier)),
+mCallBackRoutine (inCallBackRoutine) {
+}
+
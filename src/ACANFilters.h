@@ -0,0 +1,122 @@
+//----------------------------------------------------------------------------------------
+// Receive filters of the ACAN driver
+// by Pierre Molinaro
+// https://github.com/pierremolinaro/acan
+//
+// Filters are stored in the FlexCAN RxFIFO ID table format: bit 31 is RTR, bit 30 is IDE,
+// the identifier is in bits 29-19 (standard) or bits 29-1 (extended); bit 0 flags a non
+// conform filter. This file does not depend on Arduino: it is shared with host backends.
+//
+//----------------------------------------------------------------------------------------
+
+#pragma once
+
+//----------------------------------------------------------------------------------------
+
+#include <ACANSettings.h>
+#include <ACAN_CANMessage.h>
+
+//----------------------------------------------------------------------------------------
+// Frame image in the ID table format, for matching a frame against a filter in software
+
+inline uint32_t acanFilterImage (const CANMessage & inMessage) {
+  return
+    (inMessage.rtr ? (1U << 31) : 0) |
+    (inMessage.ext ? (1U << 30) : 0) |
+    (inMessage.ext ? ((inMessage.id & 0x1FFFFFFF) << 1) : ((inMessage.id & 0x7FF) << 19))
+  ;
+}
+
+//----------------------------------------------------------------------------------------
+
+class ACANPrimaryFilter {
+  public: uint32_t mFilterMask ;
+  public: uint32_t mAcceptanceFilter ;
+  public: ACANCallBackRoutine mCallBackRoutine ;
+  public: ACANSettings::tReceiveClass mReceiveClass = ACANSettings::kReceiveClassNormal ;
+  public: bool mOnChangeOnly = false ;
+  public: uint32_t mHeartbeatMillis = 0 ;
+  public: const uint32_t * mIntendedIdentifiers = nullptr ;
+  public: uint32_t mIntendedIdentifierCount = 0 ;
+
+  public: inline ACANPrimaryFilter (const ACANCallBackRoutine inCallBackRoutine = nullptr) :  // Accept any frame
+  mFilterMask (0),
+  mAcceptanceFilter (0),
+  mCallBackRoutine (inCallBackRoutine) {
+  }
+
+  public: ACANPrimaryFilter (const tFrameKind inKind,
+                             const tFrameFormat inFormat, // Accept any identifier
+                             const ACANCallBackRoutine inCallBackRoutine = nullptr) ;
+
+  public: ACANPrimaryFilter (const tFrameKind inKind,
+                             const tFrameFormat inFormat,
+                             const uint32_t inIdentifier,
+                             const ACANCallBackRoutine inCallBackRoutine = nullptr) ;
+
+  public: ACANPrimaryFilter (const tFrameKind inKind,
+                             const tFrameFormat inFormat,
+                             const uint32_t inMask,
+                             const uint32_t inAcceptance,
+                             const ACANCallBackRoutine inCallBackRoutine = nullptr) ;
+
+  public: inline ACANPrimaryFilter withReceiveClass (const ACANSettings::tReceiveClass inReceiveClass) const {
+    ACANPrimaryFilter result = *this ;
+    result.mReceiveClass = inReceiveClass ;
+    return result ;
+  }
+
+//--- On change only: a received frame is discarded if its identifier, length and data are
+//    the same as the last accepted frame of this filter, unless inHeartbeatMillis (0 -->
+//    no heartbeat) have elapsed since.
+  public: inline ACANPrimaryFilter withOnChangeOnly (const uint32_t inHeartbeatMillis = 0) const {
+    ACANPrimaryFilter result = *this ;
+    result.mOnChangeOnly = true ;
+    result.mHeartbeatMillis = inHeartbeatMillis ;
+    return result ;
+  }
+
+//--- Intended identifiers: the identifiers the mask is meant to accept. A frame accepted by
+//    the filter with another identifier is counted as a false accept (see
+//    ACAN::filterFalseAcceptCount). The array is copied by begin and updateFilters.
+  public: inline ACANPrimaryFilter withIntendedIdentifiers (const uint32_t inIdentifiers [],
+                                                            const uint32_t inIdentifierCount) const {
+    ACANPrimaryFilter result = *this ;
+    result.mIntendedIdentifiers = inIdentifiers ;
+    result.mIntendedIdentifierCount = (nullptr == inIdentifiers) ? 0 : inIdentifierCount ;
+    return result ;
+  }
+} ;
+
+//----------------------------------------------------------------------------------------
+
+class ACANSecondaryFilter {
+  public: uint32_t mSingleAcceptanceFilter ;
+  public: ACANCallBackRoutine mCallBackRoutine ;
+  public: ACANSettings::tReceiveClass mReceiveClass = ACANSettings::kReceiveClassNormal ;
+  public: bool mOnChangeOnly = false ;
+  public: uint32_t mHeartbeatMillis = 0 ;
+
+  public: ACANSecondaryFilter (const tFrameKind inKind,
+                               const tFrameFormat inFormat,
+                               const uint32_t inIdentifier,
+                               const ACANCallBackRoutine inCallBackRoutine = nullptr) ;
+
+  public: inline ACANSecondaryFilter withReceiveClass (const ACANSettings::tReceiveClass inReceiveClass) const {
+    ACANSecondaryFilter result = *this ;
+    result.mReceiveClass = inReceiveClass ;
+    return result ;
+  }
+
+//--- On change only: a received frame is discarded if its identifier, length and data are
+//    the same as the last accepted frame of this filter, unless inHeartbeatMillis (0 -->
+//    no heartbeat) have elapsed since.
+  public: inline ACANSecondaryFilter withOnChangeOnly (const uint32_t inHeartbeatMillis = 0) const {
+    ACANSecondaryFilter result = *this ;
+    result.mOnChangeOnly = true ;
+    result.mHeartbeatMillis = inHeartbeatMillis ;
+    return result ;
+  }
+} ;
+
+//----------------------------------------------------------------------------------------
@@ -0,0 +1,493 @@
+//----------------------------------------------------------------------------------------
+// SLCAN (Lawicel) and GVRET host adapter for the ACAN driver
+// by Pierre Molinaro
+// https://github.com/pierremolinaro/acan
+//
+//----------------------------------------------------------------------------------------
+
+#include <ACANHostAdapter.h>
+
+//----------------------------------------------------------------------------------------
+//    Constants
+//----------------------------------------------------------------------------------------
+
+//--- SLCAN bit rates, S0 ... S8
+static const uint32_t SLCAN_BIT_RATES [9] = {
+  10 * 1000, 20 * 1000, 50 * 1000, 100 * 1000, 125 * 1000,
+  250 * 1000, 500 * 1000, 800 * 1000, 1000 * 1000
+} ;
+
+//--- SLCAN replies
+static const uint8_t SLCAN_OK    = '\r' ;
+static const uint8_t SLCAN_ERROR = 0x07 ; // BEL
+
+//--- Longest streamed frame: SLCAN 'T' + 8 id digits + length + 16 data digits + 4
+//    time stamp digits + CR (31 bytes); GVRET 12 bytes + 8 data bytes
+static const uint32_t MAX_FRAME_TEXT_LENGTH = 32 ;
+
+//--- GVRET
+static const uint8_t GVRET_COMMAND         = 0xF1 ;
+static const uint8_t GVRET_BUILD_CAN_FRAME = 0x00 ;
+static const uint8_t GVRET_TIME_SYNC       = 0x01 ;
+static const uint8_t GVRET_SETUP_CANBUS    = 0x05 ;
+static const uint8_t GVRET_GET_CANBUS_PARAMS = 0x06 ;
+static const uint8_t GVRET_GET_DEVICE_INFO = 0x07 ;
+static const uint8_t GVRET_KEEP_ALIVE      = 0x09 ;
+static const uint8_t GVRET_GET_NUM_BUSES   = 0x0C ;
+
+//----------------------------------------------------------------------------------------
+//    Helpers
+//----------------------------------------------------------------------------------------
+
+static bool parseHex (const uint8_t inText [], const uint32_t inDigitCount, uint32_t & outValue) {
+  bool ok = true ;
+  outValue = 0 ;
+  for (uint32_t i=0 ; (i<inDigitCount) && ok ; i++) {
+    const uint8_t c = inText [i] ;
+    uint32_t digit = 0 ;
+    if ((c >= '0') && (c <= '9')) {
+      digit = c - '0' ;
+    }else if ((c >= 'A') && (c <= 'F')) {
+      digit = c - 'A' + 10 ;
+    }else if ((c >= 'a') && (c <= 'f')) {
+      digit = c - 'a' + 10 ;
+    }else{
+      ok = false ;
+    }
+    outValue = (outValue << 4) | digit ;
+  }
+  return ok ;
+}
+
+//----------------------------------------------------------------------------------------
+
+static uint32_t littleEndianValue (const uint8_t inBytes []) {
+  return
+    ((uint32_t) inBytes [0]) |
+    (((uint32_t) inBytes [1]) << 8) |
+    (((uint32_t) inBytes [2]) << 16) |
+    (((uint32_t) inBytes [3]) << 24)
+  ;
+}
+
+//----------------------------------------------------------------------------------------
+//    Constructor
+//----------------------------------------------------------------------------------------
+
+ACANHostAdapter::ACANHostAdapter (ACAN & inDriver, Stream & inStream) :
+mDriver (inDriver),
+mStream (inStream) {
+}
+
+//----------------------------------------------------------------------------------------
+//    poll
+//----------------------------------------------------------------------------------------
+
+void ACANHostAdapter::poll (void) {
+//--- Host commands; replies are written at once
+  bool commandReceived = false ;
+  int c = mStream.read () ;
+  while (c >= 0) {
+    commandReceived = true ;
+    handleByte ((uint8_t) c) ;
+    c = mStream.read () ;
+  }
+  if (commandReceived) {
+    flushOutput () ;
+  }
+//--- Received frames are formatted in place (zero copy)
+  if (mOpen) {
+    uint32_t streamedCount = 0 ;
+    const CANMessage * messages ;
+    uint32_t n = mDriver.peek (messages) ;
+    while ((n > 0) && (streamedCount < kMaxFramesPerPoll)) {
+      if (n > (kMaxFramesPerPoll - streamedCount)) {
+        n = kMaxFramesPerPoll - streamedCount ;
+      }
+      for (uint32_t i=0 ; i<n ; i++) {
+        streamFrame (messages [i]) ;
+      }
+      mDriver.consume (n) ;
+      streamedCount += n ;
+      n = mDriver.peek (messages) ;
+    }
+  }
+//--- Write buffered frames if they are too old
+  if ((mOutputLength > 0) && ((micros () - mOutputStartDate) >= mMaxLatencyMicros)) {
+    flushOutput () ;
+  }
+}
+
+//----------------------------------------------------------------------------------------
+//    Bus control
+//----------------------------------------------------------------------------------------
+
+bool ACANHostAdapter::open (const bool inListenOnly) {
+  ACANSettings settings (mBitRate) ;
+  settings.mListenOnlyMode = inListenOnly ;
+  mOpen = settings.mBitSettingOk && (0 == mDriver.begin (settings)) ;
+  mListenOnly = inListenOnly ;
+  return mOpen ;
+}
+
+//----------------------------------------------------------------------------------------
+
+void ACANHostAdapter::close (void) {
+  if (mOpen) {
+    mDriver.end () ;
+    mOpen = false ;
+  }
+}
+
+//----------------------------------------------------------------------------------------
+//    Command decoding
+//----------------------------------------------------------------------------------------
+
+void ACANHostAdapter::handleByte (const uint8_t inByte) {
+//--- 0xE7 0xE7 selects GVRET (SavvyCAN sends it when it connects)
+  const bool isE7 = inByte == 0xE7 ;
+  if (isE7 && mPreviousByteIsE7) {
+    mProtocol = kGVRET ;
+    mCommandLength = 0 ;
+    mPreviousByteIsE7 = false ;
+  }else{
+    mPreviousByteIsE7 = isE7 ;
+    if (kGVRET == mProtocol) {
+      handleGVRETByte (inByte) ;
+    }else if (isE7) {
+    }else if (inByte == '\r') {
+      handleSLCANCommand () ;
+      mCommandLength = 0 ;
+    }else if (inByte == '\n') {
+    }else if (mCommandLength < kCommandBufferSize) {
+      mCommand [mCommandLength] = inByte ;
+      mCommandLength += 1 ;
+    }else{ // Too long, rejected when CR is received
+      mCommandLength = kCommandBufferSize + 1 ;
+    }
+  }
+}
+
+//----------------------------------------------------------------------------------------
+//    SLCAN
+//----------------------------------------------------------------------------------------
+
+void ACANHostAdapter::handleSLCANCommand (void) {
+  bool ok = (mCommandLength > 0) && (mCommandLength <= kCommandBufferSize) ;
+  if (ok) {
+    switch (mCommand [0]) {
+    case 'S' : // Bit rate
+      ok = !mOpen && (mCommandLength == 2) && (mCommand [1] >= '0') && (mCommand [1] <= '8') ;
+      if (ok) {
+        mBitRate = SLCAN_BIT_RATES [mCommand [1] - '0'] ;
+      }
+      break ;
+    case 'O' : // Open, normal mode
+      ok = !mOpen && open (false) ;
+      break ;
+    case 'L' : // Open, listen only mode
+      ok = !mOpen && open (true) ;
+      break ;
+    case 'C' : // Close
+      ok = mOpen ;
+      close () ;
+      break ;
+    case 't' : case 'T' : case 'r' : case 'R' :
+      ok = sendSLCANFrame () ;
+      if (ok) {
+        append ((mCommand [0] == 't') || (mCommand [0] == 'r') ? 'z' : 'Z') ;
+      }
+      break ;
+    case 'V' : // Hardware and software versions
+      append ('V') ; append ('1') ; append ('0') ; append ('1') ; append ('3') ;
+      break ;
+    case 'N' : // Serial number
+      append ('N') ; append ('A') ; append ('C') ; append ('A') ; append ('N') ;
+      break ;
+    case 'F' : // Status flags: bit 0 --> RxFIFO warning, bit 1 --> transmit buffer full,
+               // bit 3 --> data overrun, bit 5 --> error passive, bit 7 --> bus off
+      ok = mOpen ;
+      if (ok) {
+        const uint8_t rxFIFOFlags = mDriver.flexcanRxFIFOFlags () ;
+        const tControllerState state = mDriver.controllerState () ;
+        uint32_t flags = 0 ;
+        if ((rxFIFOFlags & 1) != 0) { flags |= 1 << 0 ; }
+        if (mDriver.transmitBufferCount () >= mDriver.transmitBufferSize ()) { flags |= 1 << 1 ; }
+        if ((rxFIFOFlags & 2) != 0) { flags |= 1 << 3 ; }
+        if (kPassive == state) { flags |= 1 << 5 ; }
+        if (kBusOff == state) { flags |= 1 << 7 ; }
+        append ('F') ;
+        appendHex (flags, 2) ;
+      }
+      break ;
+    case 'Z' : // Time stamps off / on
+      ok = (mCommandLength == 2) && ((mCommand [1] == '0') || (mCommand [1] == '1')) ;
+      if (ok) {
+        mSLCANTimeStamps = mCommand [1] == '1' ;
+      }
+      break ;
+    default :
+      ok = false ;
+      break ;
+    }
+  }
+  if (ok) {
+    append (SLCAN_OK) ;
+  }else{
+    mRejectedCommandCount += 1 ;
+    append (SLCAN_ERROR) ;
+  }
+}
+
+//----------------------------------------------------------------------------------------
+// tiiiLdd..., Tiiiiiiiildd..., riiiL, RiiiiiiiiL
+
+bool ACANHostAdapter::sendSLCANFrame (void) {
+  const uint8_t command = mCommand [0] ;
+  const bool extended = (command == 'T') || (command == 'R') ;
+  const bool remote = (command == 'r') || (command == 'R') ;
+  const uint32_t idDigitCount = extended ? 8 : 3 ;
+  bool ok = mOpen && !mListenOnly && (mCommandLength >= (2 + idDigitCount)) ;
+  CANMessage message ;
+  uint32_t value = 0 ;
+  if (ok) {
+    ok = parseHex (& mCommand [1], idDigitCount, value) && (value <= (extended ? 0x1FFFFFFF : 0x7FF)) ;
+    message.id = value ;
+    message.ext = extended ;
+    message.rtr = remote ;
+  }
+  if (ok) {
+    ok = parseHex (& mCommand [1 + idDigitCount], 1, value) && (value <= 8) ;
+    message.len = (uint8_t) value ;
+  }
+  if (ok) {
+    const uint32_t dataDigitCount = remote ? 0 : (2 * message.len) ;
+    ok = mCommandLength == (2 + idDigitCount + dataDigitCount) ;
+    for (uint32_t i=0 ; (i<dataDigitCount / 2) && ok ; i++) {
+      ok = parseHex (& mCommand [2 + idDigitCount + 2 * i], 2, value) ;
+      message.data [i] = (uint8_t) value ;
+    }
+  }
+  if (ok) {
+    ok = mDriver.tryToSend (message) ;
+  }
+  if (ok) {
+    mSentFrameCount += 1 ;
+  }
+  return ok ;
+}
+
+//----------------------------------------------------------------------------------------
+//    GVRET
+//----------------------------------------------------------------------------------------
+
+void ACANHostAdapter::handleGVRETByte (const uint8_t inByte) {
+  if (mCommandLength > 0) {
+    mCommand [mCommandLength] = inByte ;
+    mCommandLength += 1 ;
+    if (mCommandLength >= gvretCommandLength ()) {
+      handleGVRETCommand () ;
+      mCommandLength = 0 ;
+    }
+  }else if (inByte == GVRET_COMMAND) {
+    mCommand [0] = inByte ;
+    mCommandLength = 1 ;
+  }
+}
+
+//----------------------------------------------------------------------------------------
+// Length of the current command, including 0xF1 and the command byte
+
+uint32_t ACANHostAdapter::gvretCommandLength (void) const {
+  uint32_t length = 2 ;
+  if (mCommandLength >= 2) {
+    switch (mCommand [1]) {
+    case GVRET_BUILD_CAN_FRAME : // id (4), bus, length, data, checksum
+      length = 8 ;
+      if (mCommandLength >= 8) {
+        length += (mCommand [7] & 0x0F) + 1 ;
+        if (length > kCommandBufferSize) {
+          length = 8 + 8 + 1 ;
+        }
+      }
+      break ;
+    case GVRET_SETUP_CANBUS : // Two 32-bit values
+      length = 10 ;
+      break ;
+    case 0x04 : case 0x08 : case 0x0A : // Set outputs, set single wire mode, set system type
+      length = 3 ;
+      break ;
+    default :
+      break ;
+    }
+  }
+  return length ;
+}
+
+//----------------------------------------------------------------------------------------
+
+void ACANHostAdapter::handleGVRETCommand (void) {
+  switch (mCommand [1]) {
+  case GVRET_BUILD_CAN_FRAME :
+    { const uint32_t identifier = littleEndianValue (& mCommand [2]) ;
+      CANMessage message ;
+      message.ext = (identifier & (1U << 31)) != 0 ;
+      message.id = identifier & (message.ext ? 0x1FFFFFFF : 0x7FF) ;
+      message.len = mCommand [7] & 0x0F ;
+      if (message.len > 8) {
+        message.len = 8 ;
+      }
+      for (uint32_t i=0 ; i<message.len ; i++) {
+        message.data [i] = mCommand [8 + i] ;
+      }
+      if (mOpen && !mListenOnly && mDriver.tryToSend (message)) {
+        mSentFrameCount += 1 ;
+      }else{
+        mRejectedCommandCount += 1 ;
+      }
+    }
+    break ;
+  case GVRET_TIME_SYNC :
+    append (GVRET_COMMAND) ;
+    append (GVRET_TIME_SYNC) ;
+    appendLittleEndian (micros (), 4) ;
+    break ;
+  case GVRET_SETUP_CANBUS : // Only the first bus is handled
+    { const uint32_t value = littleEndianValue (& mCommand [2]) ;
+      bool enable = value != 0 ;
+      bool listenOnly = false ;
+      uint32_t bitRate = value ;
+      if ((value & (1U << 31)) != 0) { // Flags are present
+        enable = (value & (1U << 30)) != 0 ;
+        listenOnly = (value & (1U << 29)) != 0 ;
+        bitRate = value & 0xFFFFF ;
+      }
+      close () ;
+      if (enable && (bitRate > 0)) {
+        mBitRate = bitRate ;
+        if (!open (listenOnly)) {
+          mRejectedCommandCount += 1 ;
+        }
+      }
+    }
+    break ;
+  case GVRET_GET_CANBUS_PARAMS :
+    append (GVRET_COMMAND) ;
+    append (GVRET_GET_CANBUS_PARAMS) ;
+    append ((mOpen ? 0x01 : 0x00) | (mListenOnly ? 0x10 : 0x00)) ;
+    appendLittleEndian (mBitRate, 4) ;
+    append (0) ; // Second bus: disabled
+    appendLittleEndian (0, 4) ;
+    break ;
+  case GVRET_GET_DEVICE_INFO :
+    append (GVRET_COMMAND) ;
+    append (GVRET_GET_DEVICE_INFO) ;
+    appendLittleEndian (343, 2) ; // Build number
+    append (0x20) ; // EEPROM version
+    append (0) ; // File output type
+    append (0) ; // Auto start logging
+    append (0) ; // Single wire mode
+    break ;
+  case GVRET_KEEP_ALIVE :
+    append (GVRET_COMMAND) ;
+    append (GVRET_KEEP_ALIVE) ;
+    append (0xDE) ;
+    append (0xAD) ;
+    break ;
+  case GVRET_GET_NUM_BUSES :
+    append (GVRET_COMMAND) ;
+    append (GVRET_GET_NUM_BUSES) ;
+    append (1) ;
+    break ;
+  default :
+    mRejectedCommandCount += 1 ;
+    break ;
+  }
+}
+
+//----------------------------------------------------------------------------------------
+//    Streaming received frames
+//    CANMessage has no time stamp: frames are time stamped when they are drained
+//    from the receive buffer (jitter is bounded by the poll period).
+//----------------------------------------------------------------------------------------
+
+void ACANHostAdapter::streamFrame (const CANMessage & inMessage) {
+//--- Write the buffer if the frame may not fit in
+  if ((mOutputLength + MAX_FRAME_TEXT_LENGTH) > kOutputBufferSize) {
+    flushOutput () ;
+  }
+  const uint32_t length = (inMessage.len > 8) ? 8 : inMessage.len ;
+  if (kGVRET == mProtocol) {
+    append (GVRET_COMMAND) ;
+    append (GVRET_BUILD_CAN_FRAME) ;
+    appendLittleEndian (micros (), 4) ;
+    appendLittleEndian (inMessage.id | (inMessage.ext ? (1U << 31) : 0), 4) ;
+    append ((uint8_t) length) ; // Bus 0
+    for (uint32_t i=0 ; i<length ; i++) {
+      append (inMessage.data [i]) ;
+    }
+    append (0) ;
+  }else{
+    if (inMessage.rtr) {
+      append (inMessage.ext ? 'R' : 'r') ;
+    }else{
+      append (inMessage.ext ? 'T' : 't') ;
+    }
+    appendHex (inMessage.id, inMessage.ext ? 8 : 3) ;
+    appendHex (length, 1) ;
+    if (!inMessage.rtr) {
+      for (uint32_t i=0 ; i<length ; i++) {
+        appendHex (inMessage.data [i], 2) ;
+      }
+    }
+    if (mSLCANTimeStamps) {
+      appendHex (millis () % 60000, 4) ;
+    }
+    append ('\r') ;
+  }
+  mStreamedFrameCount += 1 ;
+}
+
+//----------------------------------------------------------------------------------------
+//    Output buffer
+//----------------------------------------------------------------------------------------
+
+void ACANHostAdapter::append (const uint8_t inByte) {
+  if (mOutputLength == kOutputBufferSize) {
+    flushOutput () ;
+  }
+  if (mOutputLength == 0) {
+    mOutputStartDate = micros () ;
+  }
+  mOutput [mOutputLength] = inByte ;
+  mOutputLength += 1 ;
+}
+
+//----------------------------------------------------------------------------------------
+
+void ACANHostAdapter::appendHex (const uint32_t inValue, const uint32_t inDigitCount) {
+  static const char HEX_DIGITS [16] = {'0', '1', '2', '3', '4', '5', '6', '7', '8', '9', 'A', 'B', 'C', 'D', 'E', 'F'} ;
+  for (uint32_t i=inDigitCount ; i>0 ; i--) {
+    append ((uint8_t) HEX_DIGITS [(inValue >> (4 * (i - 1))) & 0x0F]) ;
+  }
+}
+
+//----------------------------------------------------------------------------------------
+
+void ACANHostAdapter::appendLittleEndian (const uint32_t inValue, const uint32_t inByteCount) {
+  for (uint32_t i=0 ; i<inByteCount ; i++) {
+    append ((uint8_t) (inValue >> (8 * i))) ;
+  }
+}
+
+//----------------------------------------------------------------------------------------
+
+void ACANHostAdapter::flushOutput (void) {
+  if (mOutputLength > 0) {
+    mStream.write (mOutput, mOutputLength) ;
+    mOutputLength = 0 ;
+    mWriteCount += 1 ;
+  }
+}
+
+//----------------------------------------------------------------------------------------
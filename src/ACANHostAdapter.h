@@ -0,0 +1,95 @@
+//----------------------------------------------------------------------------------------
+// SLCAN (Lawicel) and GVRET host adapter for the ACAN driver
+// by Pierre Molinaro
+// https://github.com/pierremolinaro/acan
+//
+// The adapter turns a Teensy into a PC bus adapter: commands received from the serial
+// stream (usually USB Serial) are mapped onto ACANSettings, begin, end and tryToSend, and
+// received frames are streamed to the host. Outgoing data is accumulated in a buffer and
+// written with a single large write, instead of one write per frame.
+// The protocol is SLCAN by default; the GVRET binary protocol (SavvyCAN) is selected when
+// the host sends 0xE7 0xE7.
+//
+//----------------------------------------------------------------------------------------
+
+#pragma once
+
+//----------------------------------------------------------------------------------------
+
+#include <ACAN.h>
+
+//----------------------------------------------------------------------------------------
+
+class ACANHostAdapter {
+//--- Constructor
+  public: ACANHostAdapter (ACAN & inDriver, Stream & inStream) ;
+
+//--- Call it from loop (): handles host commands, streams received frames
+  public: void poll (void) ;
+
+//--- Outgoing data is written when the buffer is full, or when it is older than
+//    inMaxLatencyMicros (default 1000 µs)
+  public: inline void setMaxLatencyMicros (const uint32_t inMaxLatencyMicros) { mMaxLatencyMicros = inMaxLatencyMicros ; }
+
+//--- Protocol
+  public: typedef enum {kSLCAN, kGVRET} tProtocol ;
+  public: inline tProtocol protocol (void) const { return mProtocol ; }
+
+//--- Statistics
+  public: inline uint32_t streamedFrameCount (void) const { return mStreamedFrameCount ; }
+  public: inline uint32_t sentFrameCount (void) const { return mSentFrameCount ; }
+  public: inline uint32_t rejectedCommandCount (void) const { return mRejectedCommandCount ; }
+  public: inline uint32_t writeCount (void) const { return mWriteCount ; }
+
+//--- Private methods
+  private: bool open (const bool inListenOnly) ;
+  private: void close (void) ;
+  private: void handleByte (const uint8_t inByte) ;
+  private: void handleSLCANCommand (void) ;
+  private: bool sendSLCANFrame (void) ;
+  private: void handleGVRETByte (const uint8_t inByte) ;
+  private: uint32_t gvretCommandLength (void) const ;
+  private: void handleGVRETCommand (void) ;
+  private: void streamFrame (const CANMessage & inMessage) ;
+  private: void append (const uint8_t inByte) ;
+  private: void appendHex (const uint32_t inValue, const uint32_t inDigitCount) ;
+  private: void appendLittleEndian (const uint32_t inValue, const uint32_t inByteCount) ;
+  private: void flushOutput (void) ;
+
+//--- Driver and stream
+  private: ACAN & mDriver ;
+  private: Stream & mStream ;
+
+//--- Bus settings
+  private: uint32_t mBitRate = 500 * 1000 ;
+  private: bool mListenOnly = false ;
+  private: bool mOpen = false ;
+  private: bool mSLCANTimeStamps = false ;
+
+//--- Command decoding
+  private: tProtocol mProtocol = kSLCAN ;
+  private: static const uint32_t kCommandBufferSize = 32 ;
+  private: uint8_t mCommand [kCommandBufferSize] ;
+  private: uint32_t mCommandLength = 0 ;
+  private: bool mPreviousByteIsE7 = false ;
+
+//--- Output buffer
+  private: static const uint32_t kOutputBufferSize = 1024 ;
+  private: uint8_t mOutput [kOutputBufferSize] ;
+  private: uint32_t mOutputLength = 0 ;
+  private: uint32_t mOutputStartDate = 0 ; // micros () of first byte
+  private: uint32_t mMaxLatencyMicros = 1000 ;
+  private: static const uint32_t kMaxFramesPerPoll = 64 ;
+
+//--- Statistics
+  private: uint32_t mStreamedFrameCount = 0 ;
+  private: uint32_t mSentFrameCount = 0 ;
+  private: uint32_t mRejectedCommandCount = 0 ;
+  private: uint32_t mWriteCount = 0 ;
+
+//--- No copy
+  private : ACANHostAdapter (const ACANHostAdapter &) = delete ;
+  private : ACANHostAdapter & operator = (const ACANHostAdapter &) = delete ;
+} ;
+
+//----------------------------------------------------------------------------------------
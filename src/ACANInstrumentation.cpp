@@ -0,0 +1,80 @@
+//----------------------------------------------------------------------------------------
+// Hot path instrumentation for the ACAN driver
+// by Pierre Molinaro
+// https://github.com/pierremolinaro/acan
+//
+//----------------------------------------------------------------------------------------
+
+#include "ACANInstrumentation.h"
+
+//----------------------------------------------------------------------------------------
+//    Host cycle clock
+//----------------------------------------------------------------------------------------
+
+#if !(defined (__MK20DX256__) || defined (__MK64FX512__) || defined (__MK66FX1M0__))
+
+//----------------------------------------------------------------------------------------
+
+static volatile tACANCycleClock gCycleClock = nullptr ;
+
+//----------------------------------------------------------------------------------------
+
+void setACANCycleClock (const tACANCycleClock inClock) {
+  gCycleClock = inClock ;
+}
+
+//----------------------------------------------------------------------------------------
+
+uint32_t acanCycleCount (void) {
+  const tACANCycleClock clock = gCycleClock ;
+  return (nullptr == clock) ? 0 : clock () ;
+}
+
+//----------------------------------------------------------------------------------------
+
+#endif
+
+//----------------------------------------------------------------------------------------
+//    Histogram
+//----------------------------------------------------------------------------------------
+
+void ACANLatencyHistogram::reset (void) {
+  for (uint32_t i=0 ; i<kBucketCount ; i++) {
+    mBuckets [i] = 0 ;
+  }
+  mCount = 0 ;
+  mMinCycles = 0 ;
+  mMaxCycles = 0 ;
+  mTotalCycles = 0 ;
+}
+
+//----------------------------------------------------------------------------------------
+
+uint32_t ACANLatencyHistogram::meanCycles (void) const {
+  return (mCount == 0) ? 0 : (uint32_t) (mTotalCycles / mCount) ;
+}
+
+//----------------------------------------------------------------------------------------
+
+uint32_t ACANLatencyHistogram::bucketLowerBound (const uint32_t inIndex) {
+  return (inIndex == 0) ? 0 : (1U << (inIndex - 1)) ;
+}
+
+//----------------------------------------------------------------------------------------
+
+uint32_t ACANLatencyHistogram::percentileCycles (const uint32_t inPercent) const {
+  const uint64_t threshold = ((uint64_t) mCount * ((inPercent > 100) ? 100 : inPercent) + 99) / 100 ;
+  uint64_t cumulatedCount = 0 ;
+  uint32_t result = 0 ;
+  bool found = mCount == 0 ;
+  for (uint32_t i=0 ; (i<kBucketCount) && !found ; i++) {
+    cumulatedCount += mBuckets [i] ;
+    if ((cumulatedCount >= threshold) && (mBuckets [i] > 0)) {
+      found = true ;
+      result = (i == 0) ? 0 : ((i == (kBucketCount - 1)) ? mMaxCycles : ((1U << i) - 1)) ;
+    }
+  }
+  return (result > mMaxCycles) ? mMaxCycles : result ;
+}
+
+//----------------------------------------------------------------------------------------
@@ -0,0 +1,92 @@
+//----------------------------------------------------------------------------------------
+// Hot path instrumentation for the ACAN driver
+// by Pierre Molinaro
+// https://github.com/pierremolinaro/acan
+//
+// Instrumentation is enabled by defining ACAN_INSTRUMENTATION to 1 (compiler flag, for
+// example -DACAN_INSTRUMENTATION=1); when it is 0 (default), the driver contains no
+// instrumentation code and no instrumentation data.
+// Events are stamped with a cycle counter: the DWT cycle counter on Teensy, a routine
+// installed by setACANCycleClock on the host (Linux, macOS): this file does not depend
+// on Arduino on the host.
+//
+//----------------------------------------------------------------------------------------
+
+#pragma once
+
+//----------------------------------------------------------------------------------------
+
+#include <stdint.h>
+
+//----------------------------------------------------------------------------------------
+
+#ifndef ACAN_INSTRUMENTATION
+  #define ACAN_INSTRUMENTATION 0
+#endif
+
+//----------------------------------------------------------------------------------------
+//   Cycle counter
+//----------------------------------------------------------------------------------------
+
+#if defined (__MK20DX256__) || defined (__MK64FX512__) || defined (__MK66FX1M0__)
+  #include <Arduino.h>
+
+  static inline uint32_t acanCycleCount (void) { return ARM_DWT_CYCCNT ; }
+#else
+  typedef uint32_t (* tACANCycleClock) (void) ;
+
+//--- nullptr (default) --> acanCycleCount always returns 0
+  void setACANCycleClock (const tACANCycleClock inClock) ;
+  uint32_t acanCycleCount (void) ;
+#endif
+
+//----------------------------------------------------------------------------------------
+//   Log scale histogram of durations (in cycles)
+//   Bucket 0 counts null durations, bucket i (1 ... 31) durations d such that
+//   2^(i-1) <= d < 2^i (bucket 31 also counts longer durations).
+//   Values are updated from interrupt service routines: read them with interrupts disabled
+//   (or after reset) for a consistent snapshot.
+//----------------------------------------------------------------------------------------
+
+class ACANLatencyHistogram {
+  public: static const uint32_t kBucketCount = 32 ;
+
+  public: inline void record (const uint32_t inCycles) {
+    uint32_t bucketIndex = (inCycles == 0) ? 0 : (32 - (uint32_t) __builtin_clz (inCycles)) ;
+    if (bucketIndex >= kBucketCount) {
+      bucketIndex = kBucketCount - 1 ;
+    }
+    mBuckets [bucketIndex] += 1 ;
+    mCount += 1 ;
+    mTotalCycles += inCycles ;
+    if (mMaxCycles < inCycles) {
+      mMaxCycles = inCycles ;
+    }
+    if ((mCount == 1) || (mMinCycles > inCycles)) {
+      mMinCycles = inCycles ;
+    }
+  }
+
+  public: void reset (void) ;
+
+  public: inline uint32_t bucket (const uint32_t inIndex) const { return (inIndex < kBucketCount) ? mBuckets [inIndex] : 0 ; }
+  public: inline uint32_t count (void) const { return mCount ; }
+  public: inline uint32_t minCycles (void) const { return mMinCycles ; }
+  public: inline uint32_t maxCycles (void) const { return mMaxCycles ; }
+  public: inline uint64_t totalCycles (void) const { return mTotalCycles ; }
+  public: uint32_t meanCycles (void) const ;
+
+//--- Upper bound of the bucket that contains the given percentile (0 ... 100)
+  public: uint32_t percentileCycles (const uint32_t inPercent) const ;
+
+//--- Smallest duration of a bucket
+  public: static uint32_t bucketLowerBound (const uint32_t inIndex) ;
+
+  private: volatile uint32_t mBuckets [kBucketCount] = {} ;
+  private: volatile uint32_t mCount = 0 ;
+  private: volatile uint32_t mMinCycles = 0 ;
+  private: volatile uint32_t mMaxCycles = 0 ;
+  private: volatile uint64_t mTotalCycles = 0 ;
+} ;
+
+//----------------------------------------------------------------------------------------
@@ -0,0 +1,112 @@
+//----------------------------------------------------------------------------------------
+// Mock CAN driver (host)
+// by Pierre Molinaro
+// https://github.com/pierremolinaro/acan
+//
+//----------------------------------------------------------------------------------------
+
+#include "ACANMockDriver.h"
+
+//----------------------------------------------------------------------------------------
+
+#ifndef ARDUINO
+
+//----------------------------------------------------------------------------------------
+//    Buffer
+//----------------------------------------------------------------------------------------
+
+ACANMockDriver::Buffer::Buffer (const uint32_t inSize) :
+mMessages (new CANMessage [(inSize > 0) ? inSize : 1]),
+mSize (inSize) {
+}
+
+//----------------------------------------------------------------------------------------
+
+ACANMockDriver::Buffer::~ Buffer (void) {
+  delete [] mMessages ;
+}
+
+//----------------------------------------------------------------------------------------
+
+bool ACANMockDriver::Buffer::push (const CANMessage & inMessage) {
+  const bool ok = mCount < mSize ;
+  if (ok) {
+    mMessages [(mReadIndex + mCount) % mSize] = inMessage ;
+    mCount += 1 ;
+    if (mPeakCount < mCount) {
+      mPeakCount = mCount ;
+    }
+  }else{
+    mPeakCount = mSize + 1 ; // Overflow
+  }
+  return ok ;
+}
+
+//----------------------------------------------------------------------------------------
+
+bool ACANMockDriver::Buffer::pop (CANMessage & outMessage) {
+  const bool ok = mCount > 0 ;
+  if (ok) {
+    outMessage = mMessages [mReadIndex] ;
+    mReadIndex = (mReadIndex + 1) % mSize ;
+    mCount -= 1 ;
+  }
+  return ok ;
+}
+
+//----------------------------------------------------------------------------------------
+//    Mock driver
+//----------------------------------------------------------------------------------------
+
+ACANMockDriver::ACANMockDriver (const uint32_t inReceiveBufferSize,
+                                const uint32_t inTransmitBufferSize) :
+mReceiveBuffer (inReceiveBufferSize),
+mTransmitBuffer (inTransmitBufferSize) {
+}
+
+//----------------------------------------------------------------------------------------
+
+ACANMockDriver::~ ACANMockDriver (void) {
+}
+
+//----------------------------------------------------------------------------------------
+
+bool ACANMockDriver::tryToSend (const CANMessage & inMessage) {
+  const bool ok = (mControllerState != kBusOff) && mTransmitBuffer.push (inMessage) ;
+  if (ok) {
+    mSentFrameCount += 1 ;
+  }else{
+    mRejectedFrameCount += 1 ;
+  }
+  return ok ;
+}
+
+//----------------------------------------------------------------------------------------
+
+bool ACANMockDriver::receive (CANMessage & outMessage) {
+  return mReceiveBuffer.pop (outMessage) ;
+}
+
+//----------------------------------------------------------------------------------------
+
+bool ACANMockDriver::injectReceivedMessage (const CANMessage & inMessage) {
+  const bool ok = mReceiveBuffer.push (inMessage) ;
+  if (ok) {
+    mReceivedFrameCount += 1 ;
+  }else{
+    mDroppedFrameCount += 1 ;
+  }
+  return ok ;
+}
+
+//----------------------------------------------------------------------------------------
+
+bool ACANMockDriver::takeSentMessage (CANMessage & outMessage) {
+  return mTransmitBuffer.pop (outMessage) ;
+}
+
+//----------------------------------------------------------------------------------------
+
+#endif
+
+//----------------------------------------------------------------------------------------
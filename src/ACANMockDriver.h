@@ -0,0 +1,104 @@
+//----------------------------------------------------------------------------------------
+// Mock CAN driver (host), for testing generic layers written on ACANDriverInterface
+// by Pierre Molinaro
+// https://github.com/pierremolinaro/acan
+//
+// ACANMockDriver satisfies ACANIsDriver, without any bus: a test injects the frames to
+// receive, takes the frames passed to tryToSend, and sets the controller state and the
+// error counters. Buffer sizes are exact (no power of two rounding), so tests can fill
+// them. This file does not depend on Arduino; it is empty in an Arduino build.
+//
+//----------------------------------------------------------------------------------------
+
+#pragma once
+
+//----------------------------------------------------------------------------------------
+
+#ifndef ARDUINO
+
+//----------------------------------------------------------------------------------------
+
+#include <ACANDriverInterface.h>
+
+//----------------------------------------------------------------------------------------
+
+class ACANMockDriver : public ACANDriverInterface <ACANMockDriver> {
+  public: ACANMockDriver (const uint32_t inReceiveBufferSize = 32,
+                          const uint32_t inTransmitBufferSize = 16) ;
+  public: ~ ACANMockDriver (void) ;
+
+//--- Driver interface
+  public: bool tryToSend (const CANMessage & inMessage) ;
+  public: inline uint32_t transmitBufferSize (void) const { return mTransmitBuffer.mSize ; }
+  public: inline uint32_t transmitBufferCount (void) const { return mTransmitBuffer.mCount ; }
+  public: inline uint32_t transmitBufferPeakCount (void) const { return mTransmitBuffer.mPeakCount ; } // == size + 1 if overflow did occur
+
+  public: inline bool available (void) const { return mReceiveBuffer.mCount > 0 ; }
+  public: bool receive (CANMessage & outMessage) ;
+  public: inline uint32_t receiveBufferSize (void) const { return mReceiveBuffer.mSize ; }
+  public: inline uint32_t receiveBufferCount (void) const { return mReceiveBuffer.mCount ; }
+  public: inline uint32_t receiveBufferPeakCount (void) const { return mReceiveBuffer.mPeakCount ; } // == size + 1 if overflow did occur
+  public: inline uint32_t receivedFrameCount (void) const { return mReceivedFrameCount ; }
+
+  public: inline tControllerState controllerState (void) const { return mControllerState ; }
+  public: inline uint32_t receiveErrorCounter (void) const { return mReceiveErrorCounter ; }
+  public: inline uint32_t transmitErrorCounter (void) const { return mTransmitErrorCounter ; }
+
+//--- Test side: frame to receive (returns false if the receive buffer is full: the frame
+//    is dropped), frame passed to tryToSend (returns false if none)
+  public: bool injectReceivedMessage (const CANMessage & inMessage) ;
+  public: bool takeSentMessage (CANMessage & outMessage) ;
+
+//--- Test side: state; tryToSend fails in bus off state
+  public: inline void setControllerState (const tControllerState inState) { mControllerState = inState ; }
+  public: inline void setErrorCounters (const uint32_t inReceiveErrorCounter, const uint32_t inTransmitErrorCounter) {
+    mReceiveErrorCounter = inReceiveErrorCounter ;
+    mTransmitErrorCounter = inTransmitErrorCounter ;
+  }
+
+//--- Statistics
+  public: inline uint32_t sentFrameCount (void) const { return mSentFrameCount ; } // Accepted by tryToSend
+  public: inline uint32_t rejectedFrameCount (void) const { return mRejectedFrameCount ; } // tryToSend returned false
+  public: inline uint32_t droppedFrameCount (void) const { return mDroppedFrameCount ; } // Receive buffer overflow
+
+//--- Private
+  private: class Buffer {
+    public: CANMessage * mMessages ;
+    public: uint32_t mSize ;
+    public: uint32_t mReadIndex = 0 ;
+    public: uint32_t mCount = 0 ;
+    public: uint32_t mPeakCount = 0 ;
+
+    public: explicit Buffer (const uint32_t inSize) ;
+    public: ~ Buffer (void) ;
+    public: bool push (const CANMessage & inMessage) ;
+    public: bool pop (CANMessage & outMessage) ;
+
+    private : Buffer (const Buffer &) = delete ;
+    private : Buffer & operator = (const Buffer &) = delete ;
+  } ;
+
+  private: Buffer mReceiveBuffer ;
+  private: Buffer mTransmitBuffer ;
+  private: tControllerState mControllerState = kActive ;
+  private: uint32_t mReceiveErrorCounter = 0 ;
+  private: uint32_t mTransmitErrorCounter = 0 ;
+  private: uint32_t mReceivedFrameCount = 0 ;
+  private: uint32_t mSentFrameCount = 0 ;
+  private: uint32_t mRejectedFrameCount = 0 ;
+  private: uint32_t mDroppedFrameCount = 0 ;
+
+//--- No copy
+  private : ACANMockDriver (const ACANMockDriver &) = delete ;
+  private : ACANMockDriver & operator = (const ACANMockDriver &) = delete ;
+} ;
+
+//----------------------------------------------------------------------------------------
+
+static_assert (ACANIsDriver <ACANMockDriver>::value, "ACANMockDriver should satisfy the driver interface") ;
+
+//----------------------------------------------------------------------------------------
+
+#endif
+
+//----------------------------------------------------------------------------------------
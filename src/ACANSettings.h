@@ -58,12 +58,51 @@ class ACANSettings {
 //--- IRQ priority of message interrupt
   public: uint8_t mMessageIRQPriority = 64 ; // 0 --> highest, 255 --> lowest
 
-//--- Receive buffer size
+//--- Interrupt coalescing: the frame available interrupt is disabled; received frames are
+//    handled in batches when the RxFIFO contains 5 frames (warning interrupt), or at the
+//    latest after mCoalescingMaxLatencyMicros (backstop timer, uses an IntervalTimer)
+  public: bool mInterruptCoalescing = false ;
+  public: uint32_t mCoalescingMaxLatencyMicros = 500 ;
+
+//--- Polling mode: message interrupt is not enabled, ACAN::poll should be called from loop
+//    (interrupt coalescing setting is ignored)
+  public: bool mPollingMode = false ;
+
+//--- Receive buffer size (normal class)
   public: uint16_t mReceiveBufferSize = 32 ;
 
+//--- Receive classes: every filter is assigned to a receive class (normal by default), each
+//    class has its own receive buffer; receive serves the highest non empty class first.
+//    A class whose buffer size is 0 is not used, its frames are stored in the normal class
+//    buffer.
+  public: typedef enum {kReceiveClassHigh, kReceiveClassNormal, kReceiveClassBulk} tReceiveClass ;
+  public: static const uint32_t kReceiveClassCount = 3 ;
+  public: uint16_t mHighReceiveBufferSize = 0 ;
+  public: uint16_t mBulkReceiveBufferSize = 0 ;
+
+//--- Receive buffer watermarks (0 --> no watermark): the receive watermark call back is
+//    called when the receive buffer count (all classes) reaches the high watermark, and when
+//    it falls back to the low watermark
+  public: uint16_t mReceiveBufferHighWatermark = 0 ;
+  public: uint16_t mReceiveBufferLowWatermark = 0 ;
+
+//--- Receive buffer overflow policy
+//    kDropNewest: the received frame is lost
+//    kDropOldest: the oldest frame of the receive class buffer is lost
+//    kEvictLowestPriority: the frame of the receive class buffer with the lowest CAN priority
+//                          (received one included) is lost
+  public: typedef enum {kDropNewest, kDropOldest, kEvictLowestPriority} tReceiveOverflowPolicy ;
+  public: tReceiveOverflowPolicy mReceiveOverflowPolicy = kDropNewest ;
+
 //--- Transmit buffer size
   public: uint16_t mTransmitBufferSize = 16 ;
 
+//--- Transmit watchdog: a data frame not sent after mTransmitTimeoutMillis (for example, no
+//    node acknowledges it) is aborted (0 --> no timeout). If mFlushTransmitBufferOnTimeout
+//    is true, the frames of the transmit buffer are discarded too.
+  public: uint32_t mTransmitTimeoutMillis = 0 ;
+  public: bool mFlushTransmitBufferOnTimeout = false ;
+
 //--- Compute actual bit rate
   public: uint32_t actualBitRate (void) const ;
 
@@ -0,0 +1,716 @@
+//----------------------------------------------------------------------------------------
+// Columnar signal extraction for bus log captures (host)
+// by Pierre Molinaro
+// https://github.com/pierremolinaro/acan
+//
+//----------------------------------------------------------------------------------------
+
+#include "ACANSignalColumns.h"
+
+//----------------------------------------------------------------------------------------
+
+#ifndef ARDUINO
+
+//----------------------------------------------------------------------------------------
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <thread>
+
+#if defined (__x86_64__) || defined (__i386__)
+  #define ACAN_SIGNAL_X86_KERNELS 1
+  #include <immintrin.h>
+#endif
+
+//----------------------------------------------------------------------------------------
+//    Signal
+//----------------------------------------------------------------------------------------
+
+ACANSignal::ACANSignal (const uint32_t inStartBit,
+                        const uint32_t inBitLength,
+                        const tByteOrder inByteOrder,
+                        const bool inSigned,
+                        const double inFactor,
+                        const double inOffset) :
+mStartBit (inStartBit),
+mBitLength (inBitLength),
+mByteOrder (inByteOrder),
+mSigned (inSigned),
+mFactor (inFactor),
+mOffset (inOffset) {
+}
+
+//----------------------------------------------------------------------------------------
+// Big endian signal: position of its most significant bit in the byte swapped payload
+// (data [0] in bits 56-63)
+
+static uint32_t swappedMostSignificantBit (const uint32_t inStartBit) {
+  return (7 - inStartBit / 8) * 8 + (inStartBit % 8) ;
+}
+
+//----------------------------------------------------------------------------------------
+
+bool ACANSignal::isValid (void) const {
+  bool valid = (mBitLength >= 1) && (mBitLength <= 64) && (mStartBit < 64) ;
+  if (valid && (mByteOrder == kLittleEndian)) {
+    valid = (mStartBit + mBitLength) <= 64 ;
+  }else if (valid) {
+    valid = (swappedMostSignificantBit (mStartBit) + 1) >= mBitLength ;
+  }
+  return valid ;
+}
+
+//----------------------------------------------------------------------------------------
+//    Kernels: raw = ((swap ? bswap (payload) : payload) >> shift) & mask, sign extension
+//    by (raw ^ signBit) - signBit, then value * factor + offset. SIMD kernels convert
+//    64-bit integers to double by adding 2^52 + 2^51 to the integer, then subtracting it
+//    as a double: exact for |raw| < 2^51, so longer signals use the scalar kernel.
+//----------------------------------------------------------------------------------------
+
+class SignalPlan {
+  public: bool mSwap ;
+  public: uint32_t mShift ;
+  public: uint64_t mMask ;
+  public: uint64_t mSignBit ; // 0 for an unsigned signal
+  public: double mFactor ;
+  public: double mOffset ;
+  public: bool mWide ; // More than 51 bits
+
+  public: SignalPlan (const ACANSignal & inSignal) :
+  mSwap (inSignal.mByteOrder == ACANSignal::kBigEndian),
+  mShift (mSwap
+    ? (swappedMostSignificantBit (inSignal.mStartBit) + 1 - inSignal.mBitLength)
+    : inSignal.mStartBit),
+  mMask ((inSignal.mBitLength >= 64) ? ~ (uint64_t) 0 : ((((uint64_t) 1) << inSignal.mBitLength) - 1)),
+  mSignBit (inSignal.mSigned ? (((uint64_t) 1) << (inSignal.mBitLength - 1)) : 0),
+  mFactor (inSignal.mFactor),
+  mOffset (inSignal.mOffset),
+  mWide (inSignal.mBitLength > 51) {
+  }
+} ;
+
+//----------------------------------------------------------------------------------------
+
+static const uint64_t kMagicInteger = 0x4338000000000000ULL ; // 2^52 + 2^51 as a double
+static const double kMagicDouble = 6755399441055744.0 ;
+
+//----------------------------------------------------------------------------------------
+
+static void extractScalar (const SignalPlan & inPlan,
+                           const uint64_t inPayloads [],
+                           const size_t inCount,
+                           double outValues []) {
+  for (size_t i=0 ; i<inCount ; i++) {
+    uint64_t raw = inPlan.mSwap ? __builtin_bswap64 (inPayloads [i]) : inPayloads [i] ;
+    raw = (raw >> inPlan.mShift) & inPlan.mMask ;
+    const double value = (inPlan.mSignBit != 0)
+      ? (double) (int64_t) ((raw ^ inPlan.mSignBit) - inPlan.mSignBit)
+      : (double) raw ;
+    outValues [i] = value * inPlan.mFactor + inPlan.mOffset ;
+  }
+}
+
+//----------------------------------------------------------------------------------------
+
+#ifdef ACAN_SIGNAL_X86_KERNELS
+
+__attribute__ ((target ("ssse3")))
+static void extractSSSE3 (const SignalPlan & inPlan,
+                          const uint64_t inPayloads [],
+                          const size_t inCount,
+                          double outValues []) {
+  const __m128i swapMask = _mm_set_epi8 (8, 9, 10, 11, 12, 13, 14, 15, 0, 1, 2, 3, 4, 5, 6, 7) ;
+  const __m128i shift = _mm_cvtsi32_si128 ((int) inPlan.mShift) ;
+  const __m128i mask = _mm_set1_epi64x ((long long) inPlan.mMask) ;
+  const __m128i signBit = _mm_set1_epi64x ((long long) inPlan.mSignBit) ;
+  const __m128i magicInteger = _mm_set1_epi64x ((long long) kMagicInteger) ;
+  const __m128d magicDouble = _mm_set1_pd (kMagicDouble) ;
+  const __m128d factor = _mm_set1_pd (inPlan.mFactor) ;
+  const __m128d offset = _mm_set1_pd (inPlan.mOffset) ;
+  size_t i = 0 ;
+  for ( ; (i + 2) <= inCount ; i += 2) {
+    __m128i raw = _mm_loadu_si128 ((const __m128i *) (inPayloads + i)) ;
+    if (inPlan.mSwap) {
+      raw = _mm_shuffle_epi8 (raw, swapMask) ;
+    }
+    raw = _mm_and_si128 (_mm_srl_epi64 (raw, shift), mask) ;
+    raw = _mm_sub_epi64 (_mm_xor_si128 (raw, signBit), signBit) ;
+    const __m128d value = _mm_sub_pd (_mm_castsi128_pd (_mm_add_epi64 (raw, magicInteger)), magicDouble) ;
+    _mm_storeu_pd (outValues + i, _mm_add_pd (_mm_mul_pd (value, factor), offset)) ;
+  }
+  extractScalar (inPlan, inPayloads + i, inCount - i, outValues + i) ;
+}
+
+#endif
+
+//----------------------------------------------------------------------------------------
+
+#ifdef ACAN_SIGNAL_X86_KERNELS
+
+__attribute__ ((target ("avx2")))
+static void extractAVX2 (const SignalPlan & inPlan,
+                         const uint64_t inPayloads [],
+                         const size_t inCount,
+                         double outValues []) {
+  const __m256i swapMask = _mm256_set_epi8 (8, 9, 10, 11, 12, 13, 14, 15, 0, 1, 2, 3, 4, 5, 6, 7,
+                                            8, 9, 10, 11, 12, 13, 14, 15, 0, 1, 2, 3, 4, 5, 6, 7) ;
+  const __m128i shift = _mm_cvtsi32_si128 ((int) inPlan.mShift) ;
+  const __m256i mask = _mm256_set1_epi64x ((long long) inPlan.mMask) ;
+  const __m256i signBit = _mm256_set1_epi64x ((long long) inPlan.mSignBit) ;
+  const __m256i magicInteger = _mm256_set1_epi64x ((long long) kMagicInteger) ;
+  const __m256d magicDouble = _mm256_set1_pd (kMagicDouble) ;
+  const __m256d factor = _mm256_set1_pd (inPlan.mFactor) ;
+  const __m256d offset = _mm256_set1_pd (inPlan.mOffset) ;
+  size_t i = 0 ;
+  for ( ; (i + 4) <= inCount ; i += 4) {
+    __m256i raw = _mm256_loadu_si256 ((const __m256i *) (inPayloads + i)) ;
+    if (inPlan.mSwap) {
+      raw = _mm256_shuffle_epi8 (raw, swapMask) ;
+    }
+    raw = _mm256_and_si256 (_mm256_srl_epi64 (raw, shift), mask) ;
+    raw = _mm256_sub_epi64 (_mm256_xor_si256 (raw, signBit), signBit) ;
+    const __m256d value = _mm256_sub_pd (_mm256_castsi256_pd (_mm256_add_epi64 (raw, magicInteger)), magicDouble) ;
+    _mm256_storeu_pd (outValues + i, _mm256_add_pd (_mm256_mul_pd (value, factor), offset)) ;
+  }
+  extractScalar (inPlan, inPayloads + i, inCount - i, outValues + i) ;
+}
+
+#endif
+
+//----------------------------------------------------------------------------------------
+//    Kernel selection
+//----------------------------------------------------------------------------------------
+
+static bool kernelIsSupported (const tACANSignalKernel inKernel) {
+  bool supported = inKernel == kACANSignalKernelScalar ;
+  #ifdef ACAN_SIGNAL_X86_KERNELS
+    if (inKernel == kACANSignalKernelSSSE3) {
+      supported = __builtin_cpu_supports ("ssse3") ;
+    }else if (inKernel == kACANSignalKernelAVX2) {
+      supported = __builtin_cpu_supports ("avx2") ;
+    }
+  #endif
+  return supported ;
+}
+
+//----------------------------------------------------------------------------------------
+
+static tACANSignalKernel bestKernel (void) {
+  tACANSignalKernel kernel = kACANSignalKernelScalar ;
+  if (kernelIsSupported (kACANSignalKernelAVX2)) {
+    kernel = kACANSignalKernelAVX2 ;
+  }else if (kernelIsSupported (kACANSignalKernelSSSE3)) {
+    kernel = kACANSignalKernelSSSE3 ;
+  }
+  return kernel ;
+}
+
+//----------------------------------------------------------------------------------------
+
+static tACANSignalKernel gSignalKernel = bestKernel () ;
+
+//----------------------------------------------------------------------------------------
+
+bool setACANSignalKernel (const tACANSignalKernel inKernel) {
+  const bool supported = kernelIsSupported (inKernel) ;
+  if (supported) {
+    gSignalKernel = inKernel ;
+  }
+  return supported ;
+}
+
+//----------------------------------------------------------------------------------------
+
+tACANSignalKernel acanSignalKernel (void) {
+  return gSignalKernel ;
+}
+
+//----------------------------------------------------------------------------------------
+
+void acanExtractSignal (const ACANSignal & inSignal,
+                        const uint64_t inPayloads [],
+                        const size_t inCount,
+                        double outValues []) {
+  if (!inSignal.isValid ()) {
+    for (size_t i=0 ; i<inCount ; i++) {
+      outValues [i] = NAN ;
+    }
+  }else{
+    const SignalPlan plan (inSignal) ;
+    #ifdef ACAN_SIGNAL_X86_KERNELS
+      if (!plan.mWide && (gSignalKernel == kACANSignalKernelAVX2)) {
+        extractAVX2 (plan, inPayloads, inCount, outValues) ;
+      }else if (!plan.mWide && (gSignalKernel == kACANSignalKernelSSSE3)) {
+        extractSSSE3 (plan, inPayloads, inCount, outValues) ;
+      }else{
+        extractScalar (plan, inPayloads, inCount, outValues) ;
+      }
+    #else
+      extractScalar (plan, inPayloads, inCount, outValues) ;
+    #endif
+  }
+}
+
+//----------------------------------------------------------------------------------------
+//    Threads
+//----------------------------------------------------------------------------------------
+
+static uint32_t effectiveThreadCount (const uint32_t inThreadCount) {
+  uint32_t threadCount = inThreadCount ;
+  if (threadCount == 0) {
+    threadCount = std::thread::hardware_concurrency () ;
+  }
+  return (threadCount > 0) ? threadCount : 1 ;
+}
+
+//----------------------------------------------------------------------------------------
+// Calls inRoutine (0), ..., inRoutine (inCount - 1), the calling thread included
+
+template <typename ROUTINE> static void runInThreads (const uint32_t inCount, const ROUTINE & inRoutine) {
+  std::thread * threads = new std::thread [(inCount > 1) ? (inCount - 1) : 1] ;
+  for (uint32_t i=1 ; i<inCount ; i++) {
+    threads [i-1] = std::thread (inRoutine, i) ;
+  }
+  inRoutine (0) ;
+  for (uint32_t i=1 ; i<inCount ; i++) {
+    threads [i-1].join () ;
+  }
+  delete [] threads ;
+}
+
+//----------------------------------------------------------------------------------------
+//    Record key count table (open addressing, grows when half full)
+//----------------------------------------------------------------------------------------
+
+static const uint32_t kNoKey = 0xFFFFFFFF ; // Bit 29 is never set in a key
+
+static uint32_t recordKey (const ACANBusLogRecord & inRecord) {
+  return inRecord.mIdentifier & (kACANBusLogIdentifierMask | kACANBusLogExtendedFlag) ;
+}
+
+static uint32_t hashOfKey (const uint32_t inKey) {
+  const uint32_t h = inKey * 0x9E3779B1U ;
+  return h ^ (h >> 16) ;
+}
+
+//----------------------------------------------------------------------------------------
+
+class KeyCountTable {
+  public: uint32_t * mKeys = nullptr ;
+  public: uint64_t * mCounts = nullptr ;
+  public: uint32_t mMask = 0 ;
+  public: uint32_t mUsed = 0 ;
+
+  public: KeyCountTable (void) { resize (256) ; }
+  public: ~ KeyCountTable (void) { delete [] mKeys ; delete [] mCounts ; }
+
+  public: void increment (const uint32_t inKey) {
+    uint32_t idx = hashOfKey (inKey) & mMask ;
+    while ((mKeys [idx] != inKey) && (mKeys [idx] != kNoKey)) {
+      idx = (idx + 1) & mMask ;
+    }
+    if (mKeys [idx] == kNoKey) {
+      mKeys [idx] = inKey ;
+      mUsed += 1 ;
+    }
+    mCounts [idx] += 1 ;
+    if ((2 * mUsed) > mMask) {
+      resize (2 * (mMask + 1)) ;
+    }
+  }
+
+  private: void resize (const uint32_t inSize) {
+    uint32_t * oldKeys = mKeys ;
+    uint64_t * oldCounts = mCounts ;
+    const uint32_t oldSize = (nullptr == oldKeys) ? 0 : (mMask + 1) ;
+    mKeys = new uint32_t [inSize] ;
+    mCounts = new uint64_t [inSize] ;
+    mMask = inSize - 1 ;
+    for (uint32_t i=0 ; i<inSize ; i++) {
+      mKeys [i] = kNoKey ;
+      mCounts [i] = 0 ;
+    }
+    for (uint32_t i=0 ; i<oldSize ; i++) {
+      if (oldKeys [i] != kNoKey) {
+        uint32_t idx = hashOfKey (oldKeys [i]) & mMask ;
+        while (mKeys [idx] != kNoKey) {
+          idx = (idx + 1) & mMask ;
+        }
+        mKeys [idx] = oldKeys [i] ;
+        mCounts [idx] = oldCounts [i] ;
+      }
+    }
+    delete [] oldKeys ;
+    delete [] oldCounts ;
+  }
+
+  private : KeyCountTable (const KeyCountTable &) = delete ;
+  private : KeyCountTable & operator = (const KeyCountTable &) = delete ;
+} ;
+
+//----------------------------------------------------------------------------------------
+//    Capture columns
+//----------------------------------------------------------------------------------------
+
+class ACANCaptureColumns::Chunk {
+  public: uint32_t mFirstBlock = 0 ;
+  public: uint32_t mBlockEnd = 0 ;
+//--- Counting pass
+  public: KeyCountTable mKeyCounts ;
+  public: uint64_t mRecordCount = 0 ; // Remote frames included
+  public: uint64_t mRemoteFrameCount = 0 ;
+  public: uint32_t mFirstTimeStamp = 0 ;
+  public: uint32_t mLastTimeStamp = 0 ;
+  public: uint64_t mDuration = 0 ; // Unwrapped, from first to last record
+//--- Filling pass
+  public: uint64_t mBaseTimeStamp = 0 ; // Of first record
+  public: uint64_t * mCursors = nullptr ; // Next row of every column
+} ;
+
+//----------------------------------------------------------------------------------------
+
+ACANCaptureColumns::ACANCaptureColumns (void) {
+}
+
+//----------------------------------------------------------------------------------------
+
+ACANCaptureColumns::~ ACANCaptureColumns (void) {
+  clear () ;
+}
+
+//----------------------------------------------------------------------------------------
+
+void ACANCaptureColumns::clear (void) {
+  delete [] mKeys ; mKeys = nullptr ;
+  delete [] mFirstRow ; mFirstRow = nullptr ;
+  delete [] mTimeStamps ; mTimeStamps = nullptr ;
+  delete [] mPayloads ; mPayloads = nullptr ;
+  delete [] mLengths ; mLengths = nullptr ;
+  delete [] mKeyHashKeys ; mKeyHashKeys = nullptr ;
+  delete [] mKeyHashColumns ; mKeyHashColumns = nullptr ;
+  delete [] mBlocks ; mBlocks = nullptr ;
+  mColumnCount = 0 ;
+  mKeyHashMask = 0 ;
+  mBlockCount = 0 ;
+  mRecordCount = 0 ;
+  mRemoteFrameCount = 0 ;
+}
+
+//----------------------------------------------------------------------------------------
+
+static int compareKeys (const void * inLeft, const void * inRight) {
+  const uint32_t left = *(const uint32_t *) inLeft ;
+  const uint32_t right = *(const uint32_t *) inRight ;
+  return (left < right) ? -1 : ((left > right) ? 1 : 0) ;
+}
+
+//----------------------------------------------------------------------------------------
+
+uint32_t ACANCaptureColumns::keySlot (const uint32_t inKey) const {
+  uint32_t idx = hashOfKey (inKey) & mKeyHashMask ;
+  while ((mKeyHashKeys [idx] != inKey) && (mKeyHashKeys [idx] != kNoKey)) {
+    idx = (idx + 1) & mKeyHashMask ;
+  }
+  return idx ;
+}
+
+//----------------------------------------------------------------------------------------
+
+void ACANCaptureColumns::countChunk (Chunk & ioChunk) const {
+  uint64_t duration = 0 ;
+  uint32_t previousTimeStamp = 0 ;
+  for (uint32_t b=ioChunk.mFirstBlock ; b<ioChunk.mBlockEnd ; b++) {
+    const ACANBusLogBlock & block = *mBlocks [b] ;
+    for (uint32_t r=0 ; r<block.mHeader.mRecordCount ; r++) {
+      const ACANBusLogRecord & record = block.mRecords [r] ;
+      if (ioChunk.mRecordCount == 0) {
+        ioChunk.mFirstTimeStamp = record.mTimeStamp ;
+      }else{
+        duration += (uint32_t) (record.mTimeStamp - previousTimeStamp) ;
+      }
+      previousTimeStamp = record.mTimeStamp ;
+      ioChunk.mRecordCount += 1 ;
+      if (record.isRemote ()) {
+        ioChunk.mRemoteFrameCount += 1 ;
+      }else{
+        ioChunk.mKeyCounts.increment (recordKey (record)) ;
+      }
+    }
+  }
+  ioChunk.mLastTimeStamp = previousTimeStamp ;
+  ioChunk.mDuration = duration ;
+}
+
+//----------------------------------------------------------------------------------------
+
+void ACANCaptureColumns::fillChunk (Chunk & ioChunk) {
+  uint64_t timeStamp = ioChunk.mBaseTimeStamp ;
+  uint32_t previousTimeStamp = ioChunk.mFirstTimeStamp ;
+  for (uint32_t b=ioChunk.mFirstBlock ; b<ioChunk.mBlockEnd ; b++) {
+    const ACANBusLogBlock & block = *mBlocks [b] ;
+    for (uint32_t r=0 ; r<block.mHeader.mRecordCount ; r++) {
+      const ACANBusLogRecord & record = block.mRecords [r] ;
+      timeStamp += (uint32_t) (record.mTimeStamp - previousTimeStamp) ;
+      previousTimeStamp = record.mTimeStamp ;
+      if (!record.isRemote ()) {
+        const uint32_t column = mKeyHashColumns [keySlot (recordKey (record))] ;
+        const uint64_t row = ioChunk.mCursors [column] ;
+        ioChunk.mCursors [column] = row + 1 ;
+        mTimeStamps [row] = timeStamp ;
+        #if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+          memcpy (& mPayloads [row], record.mData, 8) ;
+        #else
+          uint64_t payload = 0 ;
+          for (uint32_t i=0 ; i<8 ; i++) {
+            payload |= ((uint64_t) record.mData [i]) << (8 * i) ;
+          }
+          mPayloads [row] = payload ;
+        #endif
+        mLengths [row] = record.mLength ;
+      }
+    }
+  }
+}
+
+//----------------------------------------------------------------------------------------
+
+uint64_t ACANCaptureColumns::build (const uint8_t * inData, const size_t inSize, const uint32_t inThreadCount) {
+  clear () ;
+//--- Valid blocks (sequential: resynchronization needs the previous block)
+  ACANBusLogReader reader (inData, inSize) ;
+  while (nullptr != reader.nextBlock ()) {
+    mBlockCount += 1 ;
+  }
+  mBlocks = new const ACANBusLogBlock * [(mBlockCount > 0) ? mBlockCount : 1] ;
+  reader.rewind () ;
+  for (uint32_t i=0 ; i<mBlockCount ; i++) {
+    mBlocks [i] = reader.nextBlock () ;
+  }
+//--- Chunks: block ranges
+  uint32_t chunkCount = effectiveThreadCount (inThreadCount) ;
+  if (chunkCount > mBlockCount) {
+    chunkCount = (mBlockCount > 0) ? mBlockCount : 1 ;
+  }
+  Chunk * chunks = new Chunk [chunkCount] ;
+  for (uint32_t i=0 ; i<chunkCount ; i++) {
+    chunks [i].mFirstBlock = (uint32_t) (((uint64_t) mBlockCount * i) / chunkCount) ;
+    chunks [i].mBlockEnd = (uint32_t) (((uint64_t) mBlockCount * (i + 1)) / chunkCount) ;
+  }
+//--- Counting pass
+  runInThreads (chunkCount, [this, chunks] (const uint32_t inChunk) { countChunk (chunks [inChunk]) ; }) ;
+//--- Merge keys: key hash table, sorted key array
+  uint32_t keyCapacity = 0 ;
+  for (uint32_t i=0 ; i<chunkCount ; i++) {
+    keyCapacity += chunks [i].mKeyCounts.mUsed ;
+  }
+  uint32_t hashSize = 256 ;
+  while (hashSize < (2 * keyCapacity)) {
+    hashSize <<= 1 ;
+  }
+  mKeyHashKeys = new uint32_t [hashSize] ;
+  mKeyHashColumns = new uint32_t [hashSize] ;
+  mKeyHashMask = hashSize - 1 ;
+  for (uint32_t i=0 ; i<hashSize ; i++) {
+    mKeyHashKeys [i] = kNoKey ;
+  }
+  mKeys = new uint32_t [(keyCapacity > 0) ? keyCapacity : 1] ;
+  for (uint32_t i=0 ; i<chunkCount ; i++) {
+    const KeyCountTable & table = chunks [i].mKeyCounts ;
+    for (uint32_t j=0 ; j<=table.mMask ; j++) {
+      if (table.mKeys [j] != kNoKey) {
+        const uint32_t slot = keySlot (table.mKeys [j]) ;
+        if (mKeyHashKeys [slot] == kNoKey) {
+          mKeyHashKeys [slot] = table.mKeys [j] ;
+          mKeys [mColumnCount] = table.mKeys [j] ;
+          mColumnCount += 1 ;
+        }
+      }
+    }
+  }
+  qsort (mKeys, mColumnCount, sizeof (uint32_t), compareKeys) ;
+  for (uint32_t c=0 ; c<mColumnCount ; c++) {
+    mKeyHashColumns [keySlot (mKeys [c])] = c ;
+  }
+//--- Column rows: column c, chunk k rows start after the rows of chunks 0 ... k-1
+  uint64_t * columnRowCounts = new uint64_t [mColumnCount + 1] ;
+  for (uint32_t c=0 ; c<=mColumnCount ; c++) {
+    columnRowCounts [c] = 0 ;
+  }
+  for (uint32_t i=0 ; i<chunkCount ; i++) {
+    const KeyCountTable & table = chunks [i].mKeyCounts ;
+    for (uint32_t j=0 ; j<=table.mMask ; j++) {
+      if (table.mKeys [j] != kNoKey) {
+        columnRowCounts [mKeyHashColumns [keySlot (table.mKeys [j])]] += table.mCounts [j] ;
+      }
+    }
+    mRecordCount += chunks [i].mRecordCount - chunks [i].mRemoteFrameCount ;
+    mRemoteFrameCount += chunks [i].mRemoteFrameCount ;
+  }
+  mFirstRow = new uint64_t [mColumnCount + 1] ;
+  uint64_t row = 0 ;
+  for (uint32_t c=0 ; c<=mColumnCount ; c++) {
+    mFirstRow [c] = row ;
+    row += columnRowCounts [c] ;
+  }
+  for (uint32_t c=0 ; c<mColumnCount ; c++) {
+    columnRowCounts [c] = mFirstRow [c] ; // Now: next row
+  }
+  for (uint32_t i=0 ; i<chunkCount ; i++) {
+    chunks [i].mCursors = new uint64_t [(mColumnCount > 0) ? mColumnCount : 1] ;
+    memcpy (chunks [i].mCursors, columnRowCounts, mColumnCount * sizeof (uint64_t)) ;
+    const KeyCountTable & table = chunks [i].mKeyCounts ;
+    for (uint32_t j=0 ; j<=table.mMask ; j++) {
+      if (table.mKeys [j] != kNoKey) {
+        columnRowCounts [mKeyHashColumns [keySlot (table.mKeys [j])]] += table.mCounts [j] ;
+      }
+    }
+  }
+  delete [] columnRowCounts ;
+//--- Time stamp of the first record of every chunk (sequential unwrapping, per chunk)
+  bool first = true ;
+  uint64_t lastTimeStamp = 0 ;
+  uint32_t lastRawTimeStamp = 0 ;
+  for (uint32_t i=0 ; i<chunkCount ; i++) {
+    if (chunks [i].mRecordCount > 0) {
+      chunks [i].mBaseTimeStamp = first ? 0 : (lastTimeStamp + (uint32_t) (chunks [i].mFirstTimeStamp - lastRawTimeStamp)) ;
+      lastTimeStamp = chunks [i].mBaseTimeStamp + chunks [i].mDuration ;
+      lastRawTimeStamp = chunks [i].mLastTimeStamp ;
+      first = false ;
+    }
+  }
+//--- Filling pass
+  mTimeStamps = new uint64_t [(mRecordCount > 0) ? mRecordCount : 1] ;
+  mPayloads = new uint64_t [(mRecordCount > 0) ? mRecordCount : 1] ;
+  mLengths = new uint8_t [(mRecordCount > 0) ? mRecordCount : 1] ;
+  runInThreads (chunkCount, [this, chunks] (const uint32_t inChunk) { fillChunk (chunks [inChunk]) ; }) ;
+  for (uint32_t i=0 ; i<chunkCount ; i++) {
+    delete [] chunks [i].mCursors ;
+  }
+  delete [] chunks ;
+  return mRecordCount ;
+}
+
+//----------------------------------------------------------------------------------------
+
+int32_t ACANCaptureColumns::columnIndex (const uint32_t inIdentifier, const bool inExtended) const {
+  int32_t result = -1 ;
+  if (mColumnCount > 0) {
+    const uint32_t key = (inIdentifier & kACANBusLogIdentifierMask) | (inExtended ? kACANBusLogExtendedFlag : 0) ;
+    const uint32_t slot = keySlot (key) ;
+    if (mKeyHashKeys [slot] == key) {
+      result = (int32_t) mKeyHashColumns [slot] ;
+    }
+  }
+  return result ;
+}
+
+//----------------------------------------------------------------------------------------
+
+uint64_t ACANCaptureColumns::rowCount (const uint32_t inColumn) const {
+  return (inColumn < mColumnCount) ? (mFirstRow [inColumn + 1] - mFirstRow [inColumn]) : 0 ;
+}
+
+//----------------------------------------------------------------------------------------
+
+const uint64_t * ACANCaptureColumns::timeStamps (const uint32_t inColumn) const {
+  return (inColumn < mColumnCount) ? (mTimeStamps + mFirstRow [inColumn]) : nullptr ;
+}
+
+//----------------------------------------------------------------------------------------
+
+const uint64_t * ACANCaptureColumns::payloads (const uint32_t inColumn) const {
+  return (inColumn < mColumnCount) ? (mPayloads + mFirstRow [inColumn]) : nullptr ;
+}
+
+//----------------------------------------------------------------------------------------
+
+const uint8_t * ACANCaptureColumns::lengths (const uint32_t inColumn) const {
+  return (inColumn < mColumnCount) ? (mLengths + mFirstRow [inColumn]) : nullptr ;
+}
+
+//----------------------------------------------------------------------------------------
+//    Signal extraction
+//----------------------------------------------------------------------------------------
+
+bool ACANCaptureColumns::extractSignal (const uint32_t inIdentifier,
+                                        const bool inExtended,
+                                        const ACANSignal & inSignal,
+                                        double outValues []) const {
+  const int32_t column = columnIndex (inIdentifier, inExtended) ;
+  if (column >= 0) {
+    acanExtractSignal (inSignal, payloads ((uint32_t) column), rowCount ((uint32_t) column), outValues) ;
+  }
+  return column >= 0 ;
+}
+
+//----------------------------------------------------------------------------------------
+
+static int compareColumnRequests (const void * inLeft, const void * inRight) {
+  const uint64_t left = *(const uint64_t *) inLeft ;
+  const uint64_t right = *(const uint64_t *) inRight ;
+  return (left < right) ? -1 : ((left > right) ? 1 : 0) ;
+}
+
+//----------------------------------------------------------------------------------------
+// Requests are grouped by identifier (column): a thread takes a whole group, and extracts
+// its signals by tiles of rows, so that the payload tile stays in cache for all signals
+
+static const uint64_t kExtractionTileRows = 4096 ;
+
+bool ACANCaptureColumns::extractSignals (const ACANSignalRequest inRequests [],
+                                         const uint32_t inRequestCount,
+                                         const uint32_t inThreadCount) const {
+//--- (column, request index) pairs, sorted
+  uint64_t * columnRequests = new uint64_t [(inRequestCount > 0) ? inRequestCount : 1] ;
+  bool ok = true ;
+  for (uint32_t i=0 ; (i<inRequestCount) && ok ; i++) {
+    const int32_t column = columnIndex (inRequests [i].mIdentifier, inRequests [i].mExtended) ;
+    ok = column >= 0 ;
+    columnRequests [i] = (((uint64_t) (uint32_t) column) << 32) | i ;
+  }
+  if (ok && (inRequestCount > 0)) {
+    qsort (columnRequests, inRequestCount, sizeof (uint64_t), compareColumnRequests) ;
+  //--- Groups: first request index of every column
+    uint32_t * groupStarts = new uint32_t [inRequestCount + 1] ;
+    uint32_t groupCount = 0 ;
+    for (uint32_t i=0 ; i<inRequestCount ; i++) {
+      if ((i == 0) || ((columnRequests [i] >> 32) != (columnRequests [i-1] >> 32))) {
+        groupStarts [groupCount] = i ;
+        groupCount += 1 ;
+      }
+    }
+    groupStarts [groupCount] = inRequestCount ;
+  //--- Threads take groups in turn
+    uint32_t nextGroup = 0 ;
+    uint32_t threadCount = effectiveThreadCount (inThreadCount) ;
+    if (threadCount > groupCount) {
+      threadCount = groupCount ;
+    }
+    runInThreads (threadCount, [&] (const uint32_t /* inThread */) {
+      uint32_t group = __atomic_fetch_add (& nextGroup, 1, __ATOMIC_RELAXED) ;
+      while (group < groupCount) {
+        const uint32_t column = (uint32_t) (columnRequests [groupStarts [group]] >> 32) ;
+        const uint64_t * columnPayloads = payloads (column) ;
+        const uint64_t rows = rowCount (column) ;
+        for (uint64_t tile=0 ; tile<rows ; tile += kExtractionTileRows) {
+          const uint64_t tileRows = ((rows - tile) < kExtractionTileRows) ? (rows - tile) : kExtractionTileRows ;
+          for (uint32_t r=groupStarts [group] ; r<groupStarts [group + 1] ; r++) {
+            const ACANSignalRequest & request = inRequests [(uint32_t) columnRequests [r]] ;
+            acanExtractSignal (request.mSignal, columnPayloads + tile, tileRows, request.mValues + tile) ;
+          }
+        }
+        group = __atomic_fetch_add (& nextGroup, 1, __ATOMIC_RELAXED) ;
+      }
+    }) ;
+    delete [] groupStarts ;
+  }
+  delete [] columnRequests ;
+  return ok ;
+}
+
+//----------------------------------------------------------------------------------------
+
+#endif
+
+//----------------------------------------------------------------------------------------
@@ -0,0 +1,168 @@
+//----------------------------------------------------------------------------------------
+// Columnar signal extraction for bus log captures (host)
+// by Pierre Molinaro
+// https://github.com/pierremolinaro/acan
+//
+// ACANCaptureColumns converts a capture (see ACANBusLogFormat.h) into per identifier
+// columns: 64-bit time stamps, raw 64-bit payloads (data [0] in bits 0-7, whatever the
+// host byte order) and lengths. Signals are then extracted from whole payload columns by
+// SIMD kernels (AVX2, SSSE3, scalar fallback, selected at run time): byte swap, shift,
+// mask, sign extension and scaling, with results identical to the scalar kernel.
+// Conversion is split into block ranges, extraction into identifier partitions, both
+// handled by several threads.
+// This file does not depend on Arduino; it is empty in an Arduino build.
+//
+//----------------------------------------------------------------------------------------
+
+#pragma once
+
+//----------------------------------------------------------------------------------------
+
+#ifndef ARDUINO
+
+//----------------------------------------------------------------------------------------
+
+#include <ACANBusLogFormat.h>
+
+//----------------------------------------------------------------------------------------
+//   Signal description (DBC conventions)
+//   Little endian (Intel): inStartBit is the least significant bit, bit i of the payload
+//   is bit (i % 8) of data [i / 8].
+//   Big endian (Motorola): inStartBit is the most significant bit, with the same bit
+//   numbering; the signal continues in the next byte.
+//   Physical value = raw value * factor + offset.
+//----------------------------------------------------------------------------------------
+
+class ACANSignal {
+  public: typedef enum {kLittleEndian, kBigEndian} tByteOrder ;
+
+  public: ACANSignal (const uint32_t inStartBit,
+                      const uint32_t inBitLength, // 1 ... 64
+                      const tByteOrder inByteOrder = kLittleEndian,
+                      const bool inSigned = false,
+                      const double inFactor = 1.0,
+                      const double inOffset = 0.0) ;
+
+  public: uint32_t mStartBit ;
+  public: uint32_t mBitLength ;
+  public: tByteOrder mByteOrder ;
+  public: bool mSigned ;
+  public: double mFactor ;
+  public: double mOffset ;
+
+//--- Signal does not fit in the payload
+  public: bool isValid (void) const ;
+} ;
+
+//----------------------------------------------------------------------------------------
+//   Kernels
+//----------------------------------------------------------------------------------------
+
+typedef enum {kACANSignalKernelScalar, kACANSignalKernelSSSE3, kACANSignalKernelAVX2} tACANSignalKernel ;
+
+//--- Kernel used by extraction: the best one supported by the processor, unless forced;
+//    returns false (kernel unchanged) if inKernel is not supported
+bool setACANSignalKernel (const tACANSignalKernel inKernel) ;
+tACANSignalKernel acanSignalKernel (void) ;
+
+//--- Extracts a signal from inCount payloads. Signals longer than 51 bits use the scalar
+//    kernel. An invalid signal gives NaN values.
+void acanExtractSignal (const ACANSignal & inSignal,
+                        const uint64_t inPayloads [],
+                        const size_t inCount,
+                        double outValues []) ;
+
+//----------------------------------------------------------------------------------------
+//   Signal extraction request, for ACANCaptureColumns::extractSignals
+//----------------------------------------------------------------------------------------
+
+class ACANSignalRequest {
+  public: uint32_t mIdentifier ;
+  public: bool mExtended ;
+  public: ACANSignal mSignal ;
+  public: double * mValues ; // rowCount (column) values, allocated by the caller
+
+  public: ACANSignalRequest (const uint32_t inIdentifier,
+                             const bool inExtended,
+                             const ACANSignal & inSignal,
+                             double * outValues) :
+  mIdentifier (inIdentifier),
+  mExtended (inExtended),
+  mSignal (inSignal),
+  mValues (outValues) {
+  }
+} ;
+
+//----------------------------------------------------------------------------------------
+//   Capture columns
+//----------------------------------------------------------------------------------------
+
+class ACANCaptureColumns {
+  public: ACANCaptureColumns (void) ;
+  public: ~ ACANCaptureColumns (void) ;
+
+//--- Builds columns from a capture (inData should be 4-byte aligned); remote frames are
+//    not stored. Time stamps are in µs from the first record (wrap around handled, as
+//    ACANBusLogReplayer does). inThreadCount == 0 --> one thread per hardware thread.
+//    Returns the number of stored records.
+  public: uint64_t build (const uint8_t * inData, const size_t inSize, const uint32_t inThreadCount = 0) ;
+
+//--- Columns: one per identifier (standard and extended identifiers are distinct), sorted
+//    by key (identifier, kACANBusLogExtendedFlag); rows in capture order
+  public: inline uint32_t columnCount (void) const { return mColumnCount ; }
+  public: inline uint32_t keyAtIndex (const uint32_t inColumn) const { return (inColumn < mColumnCount) ? mKeys [inColumn] : 0 ; }
+  public: int32_t columnIndex (const uint32_t inIdentifier, const bool inExtended) const ; // -1 if absent
+  public: uint64_t rowCount (const uint32_t inColumn) const ;
+  public: const uint64_t * timeStamps (const uint32_t inColumn) const ;
+  public: const uint64_t * payloads (const uint32_t inColumn) const ;
+  public: const uint8_t * lengths (const uint32_t inColumn) const ;
+
+//--- Capture statistics
+  public: inline uint64_t recordCount (void) const { return mRecordCount ; }
+  public: inline uint64_t remoteFrameCount (void) const { return mRemoteFrameCount ; }
+  public: inline uint32_t blockCount (void) const { return mBlockCount ; }
+
+//--- Signal extraction: a column, or several requests handled in parallel, a thread
+//    handling all requests of an identifier; returns false (no value written) if the
+//    identifier of a request is absent
+  public: bool extractSignal (const uint32_t inIdentifier,
+                              const bool inExtended,
+                              const ACANSignal & inSignal,
+                              double outValues []) const ;
+  public: bool extractSignals (const ACANSignalRequest inRequests [],
+                               const uint32_t inRequestCount,
+                               const uint32_t inThreadCount = 0) const ;
+
+//--- Private
+  private: class Chunk ;
+  private: void clear (void) ;
+  private: void countChunk (Chunk & ioChunk) const ;
+  private: void fillChunk (Chunk & ioChunk) ;
+  private: uint32_t keySlot (const uint32_t inKey) const ; // In mKeyHash
+
+  private: uint32_t * mKeys = nullptr ; // Sorted
+  private: uint64_t * mFirstRow = nullptr ; // mColumnCount + 1 entries
+  private: uint32_t mColumnCount = 0 ;
+  private: uint64_t * mTimeStamps = nullptr ;
+  private: uint64_t * mPayloads = nullptr ;
+  private: uint8_t * mLengths = nullptr ;
+//--- Key hash table (open addressing): key, column index
+  private: uint32_t * mKeyHashKeys = nullptr ;
+  private: uint32_t * mKeyHashColumns = nullptr ;
+  private: uint32_t mKeyHashMask = 0 ;
+//--- Capture
+  private: const ACANBusLogBlock * * mBlocks = nullptr ;
+  private: uint32_t mBlockCount = 0 ;
+  private: uint64_t mRecordCount = 0 ;
+  private: uint64_t mRemoteFrameCount = 0 ;
+
+//--- No copy
+  private : ACANCaptureColumns (const ACANCaptureColumns &) = delete ;
+  private : ACANCaptureColumns & operator = (const ACANCaptureColumns &) = delete ;
+} ;
+
+//----------------------------------------------------------------------------------------
+
+#endif
+
+//----------------------------------------------------------------------------------------
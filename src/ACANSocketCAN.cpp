@@ -0,0 +1,430 @@
+//----------------------------------------------------------------------------------------
+// Linux SocketCAN backend with the ACAN driver API
+// by Pierre Molinaro
+// https://github.com/pierremolinaro/acan
+//
+//----------------------------------------------------------------------------------------
+
+#include "ACANSocketCAN.h"
+
+//----------------------------------------------------------------------------------------
+
+#ifdef __linux__
+
+//----------------------------------------------------------------------------------------
+
+#include <errno.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <net/if.h>
+#include <sys/socket.h>
+#include <linux/can.h>
+#include <linux/can/raw.h>
+
+//----------------------------------------------------------------------------------------
+//    System call buffers: a recvmmsg or sendmmsg call handles at most kBatchSize frames
+//----------------------------------------------------------------------------------------
+
+static const uint32_t kBatchSize = 32 ;
+
+//----------------------------------------------------------------------------------------
+
+class ACANSocketCAN::Batch {
+  public: struct can_frame mFrames [kBatchSize] ;
+  public: struct iovec mIOVectors [kBatchSize] ;
+  public: struct mmsghdr mMessages [kBatchSize] ;
+  public: static const size_t kControlSize = CMSG_SPACE (sizeof (struct timespec)) + CMSG_SPACE (sizeof (uint32_t)) ;
+  public: uint64_t mControl [kBatchSize][(kControlSize + 7) / 8] ; // Aligned for cmsghdr
+
+  public: Batch (const bool inReceive) {
+    memset (mFrames, 0, sizeof (mFrames)) ;
+    memset (mMessages, 0, sizeof (mMessages)) ;
+    for (uint32_t i=0 ; i<kBatchSize ; i++) {
+      mIOVectors [i].iov_base = & mFrames [i] ;
+      mIOVectors [i].iov_len = sizeof (struct can_frame) ;
+      mMessages [i].msg_hdr.msg_iov = & mIOVectors [i] ;
+      mMessages [i].msg_hdr.msg_iovlen = 1 ;
+      if (inReceive) {
+        mMessages [i].msg_hdr.msg_control = mControl [i] ;
+      }
+    }
+  }
+} ;
+
+//----------------------------------------------------------------------------------------
+//    Frame conversions
+//----------------------------------------------------------------------------------------
+
+static void frameFromMessage (const CANMessage & inMessage, struct can_frame & outFrame) {
+  outFrame.can_id = inMessage.ext
+    ? ((inMessage.id & CAN_EFF_MASK) | CAN_EFF_FLAG)
+    : (inMessage.id & CAN_SFF_MASK)
+  ;
+  if (inMessage.rtr) {
+    outFrame.can_id |= CAN_RTR_FLAG ;
+  }
+  outFrame.can_dlc = (inMessage.len > 8) ? 8 : inMessage.len ;
+  memcpy (outFrame.data, inMessage.data, 8) ;
+}
+
+//----------------------------------------------------------------------------------------
+
+static void messageFromFrame (const struct can_frame & inFrame, CANMessage & outMessage) {
+  outMessage.ext = (inFrame.can_id & CAN_EFF_FLAG) != 0 ;
+  outMessage.rtr = (inFrame.can_id & CAN_RTR_FLAG) != 0 ;
+  outMessage.id = inFrame.can_id & (outMessage.ext ? CAN_EFF_MASK : CAN_SFF_MASK) ;
+  outMessage.len = (inFrame.can_dlc > 8) ? 8 : inFrame.can_dlc ;
+  outMessage.data64 = 0 ;
+  memcpy (outMessage.data, inFrame.data, outMessage.len) ;
+}
+
+//----------------------------------------------------------------------------------------
+// ID table format (see ACANFilters.h) to kernel filter: the kernel accepts a frame if
+// (frame can_id & can_mask) == (can_id & can_mask)
+
+static struct can_filter kernelFilter (const uint32_t inMask, const uint32_t inAcceptance) {
+  const bool extended = (inAcceptance & (1U << 30)) != 0 ;
+  struct can_filter result ;
+  result.can_id = extended
+    ? (((inAcceptance >> 1) & CAN_EFF_MASK) | CAN_EFF_FLAG)
+    : ((inAcceptance >> 19) & CAN_SFF_MASK)
+  ;
+  result.can_mask = extended ? ((inMask >> 1) & CAN_EFF_MASK) : ((inMask >> 19) & CAN_SFF_MASK) ;
+  if ((inAcceptance & (1U << 31)) != 0) {
+    result.can_id |= CAN_RTR_FLAG ;
+  }
+  if ((inMask & (1U << 31)) != 0) { // Test RTR bit
+    result.can_mask |= CAN_RTR_FLAG ;
+  }
+  if ((inMask & (1U << 30)) != 0) { // Test IDE bit
+    result.can_mask |= CAN_EFF_FLAG ;
+  }
+  return result ;
+}
+
+//----------------------------------------------------------------------------------------
+//    Constructor, destructor
+//----------------------------------------------------------------------------------------
+
+ACANSocketCAN::ACANSocketCAN (const char * inInterfaceName) {
+  strncpy (mInterfaceName, inInterfaceName, sizeof (mInterfaceName) - 1) ;
+  mInterfaceName [sizeof (mInterfaceName) - 1] = '\0' ;
+}
+
+//----------------------------------------------------------------------------------------
+
+ACANSocketCAN::~ ACANSocketCAN (void) {
+  end () ;
+}
+
+//----------------------------------------------------------------------------------------
+//    begin, end
+//----------------------------------------------------------------------------------------
+
+uint32_t ACANSocketCAN::begin (const ACANSettings & inSettings,
+                               const ACANPrimaryFilter inPrimaryFilters [],
+                               const uint32_t inPrimaryFilterCount,
+                               const ACANSecondaryFilter inSecondaryFilters [],
+                               const uint32_t inSecondaryFilterCount) {
+  end () ;
+//---------- Check filters (same limits as the FlexCAN RxFIFO)
+  uint32_t errorCode = 0 ;
+  const uint32_t MAX_PRIMARY_FILTER_COUNT = 8 + 2 * (uint32_t) inSettings.mConfiguration ;
+  const uint32_t MAX_SECONDARY_FILTER_COUNT = 6 * (uint32_t) inSettings.mConfiguration ;
+  if (inPrimaryFilterCount > MAX_PRIMARY_FILTER_COUNT) {
+    errorCode |= kTooMuchPrimaryFilters ;
+  }
+  if (inSecondaryFilterCount > MAX_SECONDARY_FILTER_COUNT) {
+    errorCode |= kTooMuchSecondaryFilters ;
+  }
+  for (uint32_t i=0 ; i<inPrimaryFilterCount ; i++) {
+    if ((inPrimaryFilters [i].mAcceptanceFilter & 1) != 0) { // Bit 0 is the error flag
+      errorCode |= kNotConformPrimaryFilter ;
+    }
+  }
+  for (uint32_t i=0 ; i<inSecondaryFilterCount ; i++) {
+    if ((inSecondaryFilters [i].mSingleAcceptanceFilter & 1) != 0) {
+      errorCode |= kNotConformSecondaryFilter ;
+    }
+  }
+//---------- Open socket
+  if (0 == errorCode) {
+    mSocket = socket (PF_CAN, SOCK_RAW, CAN_RAW) ;
+    bool ok = mSocket >= 0 ;
+  //--- Kernel filters (default: accept any frame)
+    const uint32_t filterCount = inPrimaryFilterCount + inSecondaryFilterCount ;
+    if (ok && (filterCount > 0)) {
+      struct can_filter * filters = new struct can_filter [filterCount] ;
+      for (uint32_t i=0 ; i<inPrimaryFilterCount ; i++) {
+        filters [i] = kernelFilter (inPrimaryFilters [i].mFilterMask, inPrimaryFilters [i].mAcceptanceFilter) ;
+      }
+      for (uint32_t i=0 ; i<inSecondaryFilterCount ; i++) {
+        filters [inPrimaryFilterCount + i] = kernelFilter (~ 1U, inSecondaryFilters [i].mSingleAcceptanceFilter) ;
+      }
+      ok = setsockopt (mSocket, SOL_CAN_RAW, CAN_RAW_FILTER, filters, filterCount * sizeof (struct can_filter)) == 0 ;
+      delete [] filters ;
+    }
+  //--- Sent frames are received (self reception, loop back)
+    const int receiveOwnMessages = (inSettings.mSelfReceptionMode || inSettings.mLoopBackMode) ? 1 : 0 ;
+    if (ok) {
+      ok = setsockopt (mSocket, SOL_CAN_RAW, CAN_RAW_RECV_OWN_MSGS, & receiveOwnMessages, sizeof (receiveOwnMessages)) == 0 ;
+    }
+  //--- Kernel receive time stamps, socket receive queue drop count
+    const int enable = 1 ;
+    if (ok) {
+      ok = setsockopt (mSocket, SOL_SOCKET, SO_TIMESTAMPNS, & enable, sizeof (enable)) == 0 ;
+    }
+    if (ok) {
+      ok = setsockopt (mSocket, SOL_SOCKET, SO_RXQ_OVFL, & enable, sizeof (enable)) == 0 ;
+    }
+  //--- Bind to interface
+    if (ok) {
+      struct sockaddr_can address ;
+      memset (& address, 0, sizeof (address)) ;
+      address.can_family = AF_CAN ;
+      address.can_ifindex = (int) if_nametoindex (mInterfaceName) ;
+      ok = (address.can_ifindex != 0) && (bind (mSocket, (struct sockaddr *) & address, sizeof (address)) == 0) ;
+    }
+    if (!ok) {
+      errorCode |= kSocketError ;
+      if (mSocket >= 0) {
+        const int savedErrno = errno ;
+        close (mSocket) ;
+        errno = savedErrno ;
+        mSocket = -1 ;
+      }
+    }
+  }
+//---------- Filters, buffers
+  if (0 == errorCode) {
+    mPollingMode = inSettings.mPollingMode ;
+    mListenOnlyMode = inSettings.mListenOnlyMode ;
+    mFilterCount = inPrimaryFilterCount + inSecondaryFilterCount ;
+    if (mFilterCount > 0) {
+      mFilterMaskArray = new uint32_t [mFilterCount] ;
+      mFilterAcceptanceArray = new uint32_t [mFilterCount] ;
+      mCallBackFunctionArray = new ACANCallBackRoutine [mFilterCount] ;
+      for (uint32_t i=0 ; i<inPrimaryFilterCount ; i++) {
+        mFilterMaskArray [i] = inPrimaryFilters [i].mFilterMask ;
+        mFilterAcceptanceArray [i] = inPrimaryFilters [i].mAcceptanceFilter ;
+        mCallBackFunctionArray [i] = inPrimaryFilters [i].mCallBackRoutine ;
+      }
+      for (uint32_t i=0 ; i<inSecondaryFilterCount ; i++) {
+        mFilterMaskArray [inPrimaryFilterCount + i] = ~ 1U ;
+        mFilterAcceptanceArray [inPrimaryFilterCount + i] = inSecondaryFilters [i].mSingleAcceptanceFilter ;
+        mCallBackFunctionArray [inPrimaryFilterCount + i] = inSecondaryFilters [i].mCallBackRoutine ;
+      }
+    }
+    mReceiveBufferSize = inSettings.mHighReceiveBufferSize + inSettings.mReceiveBufferSize + inSettings.mBulkReceiveBufferSize ;
+    mReceiveBuffer = new CANMessage [mReceiveBufferSize] ;
+    mReceiveTimeStamps = new uint64_t [mReceiveBufferSize] ;
+    mTransmitQueue.allocate (inSettings.mTransmitBufferSize) ;
+    mReceiveBatch = new Batch (true) ;
+    mTransmitBatch = new Batch (false) ;
+  }
+  return errorCode ;
+}
+
+//----------------------------------------------------------------------------------------
+
+void ACANSocketCAN::end (void) {
+  if (mSocket >= 0) {
+    close (mSocket) ;
+    mSocket = -1 ;
+  }
+  delete [] mFilterMaskArray ; mFilterMaskArray = nullptr ;
+  delete [] mFilterAcceptanceArray ; mFilterAcceptanceArray = nullptr ;
+  delete [] mCallBackFunctionArray ; mCallBackFunctionArray = nullptr ;
+  mFilterCount = 0 ;
+  delete [] mReceiveBuffer ; mReceiveBuffer = nullptr ;
+  delete [] mReceiveTimeStamps ; mReceiveTimeStamps = nullptr ;
+  mReceiveBufferSize = 0 ;
+  mReceiveBufferReadIndex = 0 ;
+  mReceiveBufferCount = 0 ;
+  mReceiveBufferPeakCount = 0 ;
+  mTransmitQueue.deallocate () ;
+  delete mReceiveBatch ; mReceiveBatch = nullptr ;
+  delete mTransmitBatch ; mTransmitBatch = nullptr ;
+}
+
+//----------------------------------------------------------------------------------------
+//   EMISSION
+//----------------------------------------------------------------------------------------
+
+bool ACANSocketCAN::tryToSend (const CANMessage & inMessage) {
+  const bool ok = (mSocket >= 0) && !mListenOnlyMode && mTransmitQueue.push (inMessage) ;
+  if (ok && !mPollingMode) {
+    writeSocket () ;
+  }
+  return ok ;
+}
+
+//----------------------------------------------------------------------------------------
+// A single thread writes the socket (the transmit queue has a single consumer); a thread
+// that finds it busy returns, the writing thread sends its frame.
+
+void ACANSocketCAN::writeSocket (void) {
+  bool write = !__atomic_test_and_set (& mWritingSocket, __ATOMIC_ACQUIRE) ;
+  while (write) {
+    uint32_t frameCount = 0 ;
+    const CANMessage * message = mTransmitQueue.front (0) ;
+    while ((nullptr != message) && (frameCount < kBatchSize)) {
+      frameFromMessage (*message, mTransmitBatch->mFrames [frameCount]) ;
+      frameCount += 1 ;
+      message = mTransmitQueue.front (frameCount) ;
+    }
+    bool blocked = false ;
+    if (frameCount > 0) {
+      const int sentCount = sendmmsg (mSocket, mTransmitBatch->mMessages, frameCount, MSG_DONTWAIT) ;
+      __atomic_fetch_add (& mSystemCallCount, 1, __ATOMIC_RELAXED) ; // Sender and receiver threads
+      if (sentCount > 0) {
+        mTransmitQueue.pop ((uint32_t) sentCount) ;
+      }else if ((errno == EAGAIN) || (errno == EWOULDBLOCK) || (errno == ENOBUFS) || (errno == EINTR)) {
+        blocked = true ; // Interface queue is full: retry later
+      }else{ // Frame rejected (interface down, ...): drop it
+        mTransmitQueue.pop () ;
+        __atomic_fetch_add (& mTransmitErrorCount, 1, __ATOMIC_RELAXED) ;
+      }
+    }
+    if ((frameCount == 0) || blocked) {
+      __atomic_clear (& mWritingSocket, __ATOMIC_RELEASE) ;
+    //--- A frame may have been pushed by a thread that found the socket busy
+      write = !blocked
+        && (nullptr != mTransmitQueue.front ())
+        && !__atomic_test_and_set (& mWritingSocket, __ATOMIC_ACQUIRE)
+      ;
+    }
+  }
+}
+
+//----------------------------------------------------------------------------------------
+//   RECEPTION
+//----------------------------------------------------------------------------------------
+
+// The kernel does not tell which filter has accepted a frame: match it again, in the
+// FlexCAN RxFIFO order (primary filters, then secondary filters)
+
+uint32_t ACANSocketCAN::filterIndex (const CANMessage & inMessage) const {
+  uint32_t result = 0 ; // No filter
+  if (mFilterCount > 0) {
+    const uint32_t image = acanFilterImage (inMessage) ;
+    result = mFilterCount ; // No call back
+    for (uint32_t i=mFilterCount ; i>0 ; i--) {
+      if (((image ^ mFilterAcceptanceArray [i-1]) & mFilterMaskArray [i-1]) == 0) {
+        result = i - 1 ;
+      }
+    }
+  }
+  return result ;
+}
+
+//----------------------------------------------------------------------------------------
+
+uint32_t ACANSocketCAN::readSocket (void) {
+  uint32_t readCount = 0 ;
+  bool readAgain = mSocket >= 0 ;
+  while (readAgain && (mReceiveBufferCount < mReceiveBufferSize)) {
+    const uint32_t freeCount = mReceiveBufferSize - mReceiveBufferCount ;
+    const uint32_t requestedCount = (freeCount < kBatchSize) ? freeCount : kBatchSize ;
+    for (uint32_t i=0 ; i<requestedCount ; i++) { // recvmmsg updates these fields
+      mReceiveBatch->mMessages [i].msg_hdr.msg_controllen = Batch::kControlSize ;
+      mReceiveBatch->mMessages [i].msg_hdr.msg_flags = 0 ;
+    }
+    const int receivedCount = recvmmsg (mSocket, mReceiveBatch->mMessages, requestedCount, MSG_DONTWAIT, nullptr) ;
+    __atomic_fetch_add (& mSystemCallCount, 1, __ATOMIC_RELAXED) ; // Sender and receiver threads
+    readAgain = receivedCount == (int) requestedCount ;
+    for (int i=0 ; i<receivedCount ; i++) {
+      struct msghdr & header = mReceiveBatch->mMessages [i].msg_hdr ;
+      if (mReceiveBatch->mMessages [i].msg_len == sizeof (struct can_frame)) {
+        uint32_t writeIndex = mReceiveBufferReadIndex + mReceiveBufferCount ;
+        if (writeIndex >= mReceiveBufferSize) {
+          writeIndex -= mReceiveBufferSize ;
+        }
+        CANMessage & message = mReceiveBuffer [writeIndex] ;
+        messageFromFrame (mReceiveBatch->mFrames [i], message) ;
+        message.idx = (uint8_t) filterIndex (message) ;
+        mReceiveTimeStamps [writeIndex] = 0 ;
+        for (struct cmsghdr * c = CMSG_FIRSTHDR (& header) ; nullptr != c ; c = CMSG_NXTHDR (& header, c)) {
+          if ((c->cmsg_level == SOL_SOCKET) && (c->cmsg_type == SCM_TIMESTAMPNS)) {
+            struct timespec timeStamp ;
+            memcpy (& timeStamp, CMSG_DATA (c), sizeof (timeStamp)) ;
+            mReceiveTimeStamps [writeIndex] = (uint64_t) timeStamp.tv_sec * 1000000000ULL + (uint64_t) timeStamp.tv_nsec ;
+          }else if ((c->cmsg_level == SOL_SOCKET) && (c->cmsg_type == SO_RXQ_OVFL)) {
+            memcpy (& mKernelDroppedFrameCount, CMSG_DATA (c), sizeof (uint32_t)) ; // Cumulated by kernel
+          }
+        }
+        mReceiveBufferCount += 1 ;
+        readCount += 1 ;
+      }
+    }
+  }
+  if (mReceiveBufferCount > mReceiveBufferPeakCount) {
+    mReceiveBufferPeakCount = mReceiveBufferCount ;
+  }
+  mReceivedFrameCount += readCount ;
+  return readCount ;
+}
+
+//----------------------------------------------------------------------------------------
+
+bool ACANSocketCAN::available (void) {
+  if ((mReceiveBufferCount == 0) && !mPollingMode) {
+    poll () ;
+  }
+  return mReceiveBufferCount > 0 ;
+}
+
+//----------------------------------------------------------------------------------------
+
+bool ACANSocketCAN::receive (CANMessage & outMessage) {
+  const bool hasReceived = available () ;
+  if (hasReceived) {
+    outMessage = mReceiveBuffer [mReceiveBufferReadIndex] ;
+    mLastReceivedTimeStampNanos = mReceiveTimeStamps [mReceiveBufferReadIndex] ;
+    mReceiveBufferReadIndex += 1 ;
+    if (mReceiveBufferReadIndex == mReceiveBufferSize) {
+      mReceiveBufferReadIndex = 0 ;
+    }
+    mReceiveBufferCount -= 1 ;
+  }
+  return hasReceived ;
+}
+
+//----------------------------------------------------------------------------------------
+
+bool ACANSocketCAN::dispatchReceivedMessage (const tFilterMatchCallBack inFilterMatchCallBack) {
+  CANMessage receivedMessage ;
+  const bool hasReceived = receive (receivedMessage) ;
+  if (hasReceived) {
+    const uint32_t filterIndex = receivedMessage.idx ;
+    if (nullptr != inFilterMatchCallBack) {
+      inFilterMatchCallBack (filterIndex) ;
+    }
+    if (filterIndex < mFilterCount) {
+      ACANCallBackRoutine callBackFunction = mCallBackFunctionArray [filterIndex] ;
+      if (nullptr != callBackFunction) {
+        callBackFunction (receivedMessage) ;
+      }
+    }
+  }
+  return hasReceived ;
+}
+
+//----------------------------------------------------------------------------------------
+//   POLLING
+//----------------------------------------------------------------------------------------
+
+uint32_t ACANSocketCAN::poll (void) {
+  const uint32_t readCount = readSocket () ;
+  if ((mSocket >= 0) && (nullptr != mTransmitQueue.front ())) {
+    writeSocket () ;
+  }
+  return readCount ;
+}
+
+//----------------------------------------------------------------------------------------
+
+#endif
+
+//----------------------------------------------------------------------------------------
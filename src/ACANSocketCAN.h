@@ -0,0 +1,140 @@
+//----------------------------------------------------------------------------------------
+// Linux SocketCAN backend with the ACAN driver API
+// by Pierre Molinaro
+// https://github.com/pierremolinaro/acan
+//
+// Application code written against ACAN (begin with filters, tryToSend, receive,
+// dispatchReceivedMessage) runs on Linux over a CAN network interface (can0, or a vcan
+// interface without hardware). Primary and secondary filters become kernel can_filter
+// entries, frames are read with recvmmsg and written with sendmmsg, and every received
+// frame carries its kernel receive time stamp.
+// The bit rate is the one of the interface (ip link set can0 type can bitrate ...).
+// This file does not depend on Arduino; it is empty if the target is not Linux.
+//
+//----------------------------------------------------------------------------------------
+
+#pragma once
+
+//----------------------------------------------------------------------------------------
+
+#ifdef __linux__
+
+//----------------------------------------------------------------------------------------
+
+#include <ACANSettings.h>
+#include <ACAN_CANMessage.h>
+#include <ACANFilters.h>
+#include <ACANTransmitQueue.h>
+
+//----------------------------------------------------------------------------------------
+
+class ACANSocketCAN {
+//--- Constructor: inInterfaceName is the network interface name ("can0", "vcan0", ...)
+  public: explicit ACANSocketCAN (const char * inInterfaceName) ;
+  public: ~ ACANSocketCAN (void) ;
+
+//--- begin; returns a result code (0 : Ok, other: every bit denotes an error). Filter
+//    counts are checked against mConfiguration, as ACAN::begin does. Settings used:
+//    listen only mode, self reception and loop back modes (frames sent are also received),
+//    receive buffer sizes (all classes in a single buffer), transmit buffer size, polling
+//    mode. Bit timing settings are ignored.
+  public: static const uint32_t kTooMuchPrimaryFilters     = 1 << 12 ;
+  public: static const uint32_t kNotConformPrimaryFilter   = 1 << 13 ;
+  public: static const uint32_t kTooMuchSecondaryFilters   = 1 << 14 ;
+  public: static const uint32_t kNotConformSecondaryFilter = 1 << 15 ;
+  public: static const uint32_t kSocketError               = 1 << 23 ; // See errno
+
+  public: uint32_t begin (const ACANSettings & inSettings,
+                          const ACANPrimaryFilter inPrimaryFilters [] = nullptr ,
+                          const uint32_t inPrimaryFilterCount = 0,
+                          const ACANSecondaryFilter inSecondaryFilters [] = nullptr,
+                          const uint32_t inSecondaryFilterCount = 0) ;
+
+//--- end: close the socket
+  public: void end (void) ;
+
+//--- Socket file descriptor (-1 if not started), for select, poll or epoll
+  public: inline int fileDescriptor (void) const { return mSocket ; }
+
+//--- Transmitting messages: tryToSend can be called from several threads. In polling
+//    mode, frames are only written by poll; otherwise tryToSend writes them at once.
+  public: bool tryToSend (const CANMessage & inMessage) ;
+  public: inline uint32_t transmitBufferSize (void) const { return mTransmitQueue.capacity () ; }
+  public: inline uint32_t transmitBufferCount (void) const { return mTransmitQueue.count () ; }
+  public: inline uint32_t transmitBufferPeakCount (void) const { return mTransmitQueue.peakCount () ; }
+
+//--- Receiving messages (a single thread). Except in polling mode, available, receive and
+//    dispatchReceivedMessage read the socket when the receive buffer is empty.
+  public: bool available (void) ;
+  public: bool receive (CANMessage & outMessage) ;
+  public: typedef void (*tFilterMatchCallBack) (const uint32_t inFilterIndex) ;
+  public: bool dispatchReceivedMessage (const tFilterMatchCallBack inFilterMatchCallBack = nullptr) ;
+//--- Kernel receive time stamp (CLOCK_REALTIME, in ns) of the frame returned by the last
+//    receive or dispatchReceivedMessage call
+  public: inline uint64_t lastReceivedTimeStampNanos (void) const { return mLastReceivedTimeStampNanos ; }
+  public: inline uint32_t receiveBufferSize (void) const { return mReceiveBufferSize ; }
+  public: inline uint32_t receiveBufferCount (void) const { return mReceiveBufferCount ; }
+  public: inline uint32_t receiveBufferPeakCount (void) const { return mReceiveBufferPeakCount ; }
+
+//--- Reads frames into the receive buffer (a recvmmsg call per batch, while the buffer is
+//    not full), writes the transmit buffer (a sendmmsg call per batch); returns the number
+//    of read frames. Never blocks.
+  public: uint32_t poll (void) ;
+
+//--- Statistics
+  public: inline uint32_t receivedFrameCount (void) const { return mReceivedFrameCount ; }
+  public: inline uint32_t kernelDroppedFrameCount (void) const { return mKernelDroppedFrameCount ; } // Socket receive queue overflow
+  public: inline uint32_t transmitErrorCount (void) const { return __atomic_load_n (& mTransmitErrorCount, __ATOMIC_RELAXED) ; } // Frames rejected by the kernel
+  public: inline uint32_t systemCallCount (void) const { return __atomic_load_n (& mSystemCallCount, __ATOMIC_RELAXED) ; } // recvmmsg and sendmmsg calls
+
+//--- Private methods
+  private: uint32_t readSocket (void) ;
+  private: void writeSocket (void) ;
+  private: uint32_t filterIndex (const CANMessage & inMessage) const ;
+
+//--- Interface and socket
+  private: char mInterfaceName [16] ;
+  private: int mSocket = -1 ;
+  private: bool mPollingMode = false ;
+  private: bool mListenOnlyMode = false ;
+
+//--- Filters (ID table format, see ACANFilters.h), primary filters first
+  private: uint32_t * mFilterMaskArray = nullptr ;
+  private: uint32_t * mFilterAcceptanceArray = nullptr ;
+  private: ACANCallBackRoutine * mCallBackFunctionArray = nullptr ;
+  private: uint32_t mFilterCount = 0 ;
+
+//--- Receive buffer
+  private: CANMessage * mReceiveBuffer = nullptr ;
+  private: uint64_t * mReceiveTimeStamps = nullptr ;
+  private: uint32_t mReceiveBufferSize = 0 ;
+  private: uint32_t mReceiveBufferReadIndex = 0 ;
+  private: uint32_t mReceiveBufferCount = 0 ;
+  private: uint32_t mReceiveBufferPeakCount = 0 ;
+  private: uint64_t mLastReceivedTimeStampNanos = 0 ;
+
+//--- Transmit buffer
+  private: ACANMPSCQueue <CANMessage> mTransmitQueue ;
+  private: bool mWritingSocket = false ; // A thread is running writeSocket
+
+//--- System call buffers (defined in ACANSocketCAN.cpp)
+  private: class Batch ;
+  private: Batch * mReceiveBatch = nullptr ;
+  private: Batch * mTransmitBatch = nullptr ;
+
+//--- Statistics
+  private: uint32_t mReceivedFrameCount = 0 ;
+  private: uint32_t mKernelDroppedFrameCount = 0 ;
+  private: uint32_t mTransmitErrorCount = 0 ; // Atomic access
+  private: uint32_t mSystemCallCount = 0 ; // Atomic access: written by sender and receiver threads
+
+//--- No copy
+  private : ACANSocketCAN (const ACANSocketCAN &) = delete ;
+  private : ACANSocketCAN & operator = (const ACANSocketCAN &) = delete ;
+} ;
+
+//----------------------------------------------------------------------------------------
+
+#endif
+
+//----------------------------------------------------------------------------------------
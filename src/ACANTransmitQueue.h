@@ -0,0 +1,166 @@
+//----------------------------------------------------------------------------------------
+// Lock-free multi producer, single consumer queue for the ACAN driver transmit path
+// by Pierre Molinaro
+// https://github.com/pierremolinaro/acan
+//
+// Any context (loop, threads, interrupt service routines of any priority) can push
+// without disabling interrupts; a single context (the message interrupt service routine)
+// pops. Bounded queue with a sequence number per cell (D. Vyukov's algorithm): a producer
+// reserves a cell by advancing the enqueue position with a compare and swap, writes the
+// value, then publishes it by writing the cell sequence number.
+// GCC atomic builtins are used: on Cortex-M4 they compile to LDREX / STREX (an exception
+// clears the exclusive monitor, so a preempted producer retries); on the host (Linux,
+// macOS) they are the std::atomic primitives. This file does not depend on Arduino.
+//
+//----------------------------------------------------------------------------------------
+
+#pragma once
+
+//----------------------------------------------------------------------------------------
+
+#include <stdint.h>
+
+//----------------------------------------------------------------------------------------
+
+template <typename T> class ACANMPSCQueue {
+//--- Constructor, destructor
+  public: ACANMPSCQueue (void) {}
+  public: ~ ACANMPSCQueue (void) { deallocate () ; }
+
+//--- Capacity is rounded up to a power of two, at least 1. Not thread safe.
+  public: void allocate (const uint32_t inMinimumCapacity) ;
+  public: void deallocate (void) ;
+
+//--- Any context; returns false if the queue is full
+  public: bool push (const T & inValue) ;
+
+//--- Consumer only: first published value (nullptr if none), then pop it
+  public: inline T * front (void) { return front (0) ; }
+  public: inline void pop (void) { pop (1) ; }
+
+//--- Consumer only, for batches: value at inOffset from the first one (nullptr if it, or a
+//    value before it, is not published yet), then pop inCount values (all published)
+  public: T * front (const uint32_t inOffset) ;
+  public: void pop (const uint32_t inCount) ;
+
+//--- Statistics (approximate while producers are running)
+  public: inline uint32_t capacity (void) const { return mCapacity ; }
+  public: inline uint32_t count (void) const {
+    const uint32_t dequeuePosition = __atomic_load_n (& mDequeuePosition, __ATOMIC_ACQUIRE) ; // Read first: never ahead of enqueue position
+    return __atomic_load_n (& mEnqueuePosition, __ATOMIC_RELAXED) - dequeuePosition ;
+  }
+  public: inline uint32_t peakCount (void) const { return __atomic_load_n (& mPeakCount, __ATOMIC_RELAXED) ; } // == capacity + 1 if overflow did occur
+
+//--- Private
+  private: class Cell {
+    public: uint32_t mSequence ;
+    public: T mValue ;
+  } ;
+  private: void updatePeakCount (const uint32_t inCount) ;
+
+  private: Cell * mCells = nullptr ;
+  private: uint32_t mCapacity = 0 ;
+  private: uint32_t mMask = 0 ;
+  private: uint32_t mEnqueuePosition = 0 ; // Producers
+  private: uint32_t mDequeuePosition = 0 ; // Consumer
+  private: uint32_t mPeakCount = 0 ;
+
+//--- No copy
+  private : ACANMPSCQueue (const ACANMPSCQueue &) = delete ;
+  private : ACANMPSCQueue & operator = (const ACANMPSCQueue &) = delete ;
+} ;
+
+//----------------------------------------------------------------------------------------
+
+template <typename T> void ACANMPSCQueue <T>::allocate (const uint32_t inMinimumCapacity) {
+  deallocate () ;
+  uint32_t capacity = 1 ;
+  while ((capacity < inMinimumCapacity) && (capacity < (1U << 31))) {
+    capacity <<= 1 ;
+  }
+  mCells = new Cell [capacity] ;
+  for (uint32_t i=0 ; i<capacity ; i++) {
+    mCells [i].mSequence = i ;
+  }
+  mCapacity = capacity ;
+  mMask = capacity - 1 ;
+  mEnqueuePosition = 0 ;
+  mDequeuePosition = 0 ;
+  mPeakCount = 0 ;
+}
+
+//----------------------------------------------------------------------------------------
+
+template <typename T> void ACANMPSCQueue <T>::deallocate (void) {
+  delete [] mCells ; mCells = nullptr ;
+  mCapacity = 0 ;
+  mMask = 0 ;
+  mEnqueuePosition = 0 ;
+  mDequeuePosition = 0 ;
+  mPeakCount = 0 ;
+}
+
+//----------------------------------------------------------------------------------------
+
+template <typename T> bool ACANMPSCQueue <T>::push (const T & inValue) {
+  Cell * cell = nullptr ;
+  bool full = mCapacity == 0 ;
+  uint32_t position = __atomic_load_n (& mEnqueuePosition, __ATOMIC_RELAXED) ;
+  while ((nullptr == cell) && !full) {
+    Cell & candidate = mCells [position & mMask] ;
+    const int32_t difference = (int32_t) (__atomic_load_n (& candidate.mSequence, __ATOMIC_ACQUIRE) - position) ;
+    if (difference == 0) { // Cell is free: reserve it (on failure, position is reloaded)
+      if (__atomic_compare_exchange_n (& mEnqueuePosition, & position, position + 1, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+        cell = & candidate ;
+      }
+    }else if (difference < 0) { // Cell has not been popped yet
+      full = true ;
+    }else{ // Another producer has reserved it
+      position = __atomic_load_n (& mEnqueuePosition, __ATOMIC_RELAXED) ;
+    }
+  }
+  if (full) {
+    updatePeakCount (mCapacity + 1) ;
+  }else{
+    cell->mValue = inValue ;
+    __atomic_store_n (& cell->mSequence, position + 1, __ATOMIC_RELEASE) ; // Publish
+    updatePeakCount (count ()) ;
+  }
+  return !full ;
+}
+
+//----------------------------------------------------------------------------------------
+
+template <typename T> T * ACANMPSCQueue <T>::front (const uint32_t inOffset) {
+  T * result = nullptr ;
+  bool published = inOffset < mCapacity ;
+  for (uint32_t i=0 ; (i<=inOffset) && published ; i++) {
+    const uint32_t position = mDequeuePosition + i ;
+    Cell & cell = mCells [position & mMask] ;
+    published = __atomic_load_n (& cell.mSequence, __ATOMIC_ACQUIRE) == (position + 1) ;
+    if (published && (i == inOffset)) {
+      result = & cell.mValue ;
+    }
+  }
+  return result ;
+}
+
+//----------------------------------------------------------------------------------------
+
+template <typename T> void ACANMPSCQueue <T>::pop (const uint32_t inCount) {
+  for (uint32_t i=0 ; i<inCount ; i++) {
+    Cell & cell = mCells [mDequeuePosition & mMask] ;
+    __atomic_store_n (& cell.mSequence, mDequeuePosition + mCapacity, __ATOMIC_RELEASE) ; // Free for next lap
+    __atomic_store_n (& mDequeuePosition, mDequeuePosition + 1, __ATOMIC_RELEASE) ;
+  }
+}
+
+//----------------------------------------------------------------------------------------
+
+template <typename T> void ACANMPSCQueue <T>::updatePeakCount (const uint32_t inCount) {
+  uint32_t peak = __atomic_load_n (& mPeakCount, __ATOMIC_RELAXED) ;
+  while ((peak < inCount) && !__atomic_compare_exchange_n (& mPeakCount, & peak, inCount, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+  }
+}
+
+//----------------------------------------------------------------------------------------
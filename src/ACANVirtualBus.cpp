@@ -0,0 +1,771 @@
+//----------------------------------------------------------------------------------------
+// Virtual CAN bus simulator (host)
+// by Pierre Molinaro
+// https://github.com/pierremolinaro/acan
+//
+//----------------------------------------------------------------------------------------
+
+#include "ACANVirtualBus.h"
+
+//----------------------------------------------------------------------------------------
+
+#ifndef ARDUINO
+
+//----------------------------------------------------------------------------------------
+//    Bit level frame image
+//----------------------------------------------------------------------------------------
+
+static const uint32_t kIntermissionBits = 3 ;
+static const uint32_t kSuspendTransmissionBits = 8 ;
+static const uint32_t kErrorFrameBits = 20 ; // Error flag (6 bits, up to 6 echo bits), delimiter (8 bits)
+static const uint32_t kBusOffRecoveryBits = 128 * 11 ;
+
+//----------------------------------------------------------------------------------------
+
+static void appendBits (uint8_t ioBits [], uint32_t & ioCount, const uint32_t inValue, const uint32_t inBitCount) {
+  for (uint32_t i=inBitCount ; i>0 ; i--) { // Most significant bit first
+    ioBits [ioCount] = (uint8_t) ((inValue >> (i - 1)) & 1) ;
+    ioCount += 1 ;
+  }
+}
+
+//----------------------------------------------------------------------------------------
+
+uint32_t ACANVirtualBus::frameBitCount (const CANMessage & inMessage, uint32_t * outAckSlotIndex) {
+  uint8_t bits [128] ;
+  uint32_t count = 0 ;
+  const uint32_t length = (inMessage.len > 8) ? 8 : inMessage.len ;
+//--- Start of frame, arbitration and control fields
+  appendBits (bits, count, 0, 1) ; // SOF
+  if (inMessage.ext) {
+    appendBits (bits, count, (inMessage.id >> 18) & 0x7FF, 11) ;
+    appendBits (bits, count, 3, 2) ; // SRR, IDE
+    appendBits (bits, count, inMessage.id & 0x3FFFF, 18) ;
+    appendBits (bits, count, inMessage.rtr ? 1 : 0, 1) ;
+    appendBits (bits, count, 0, 2) ; // r1, r0
+  }else{
+    appendBits (bits, count, inMessage.id & 0x7FF, 11) ;
+    appendBits (bits, count, inMessage.rtr ? 1 : 0, 1) ;
+    appendBits (bits, count, 0, 2) ; // IDE, r0
+  }
+  appendBits (bits, count, length, 4) ;
+//--- Data field
+  if (!inMessage.rtr) {
+    for (uint32_t i=0 ; i<length ; i++) {
+      appendBits (bits, count, inMessage.data [i], 8) ;
+    }
+  }
+//--- CRC field
+  uint32_t crc = 0 ;
+  for (uint32_t i=0 ; i<count ; i++) {
+    const uint32_t crcNext = bits [i] ^ ((crc >> 14) & 1) ;
+    crc = (crc << 1) & 0x7FFF ;
+    if (crcNext != 0) {
+      crc ^= 0x4599 ;
+    }
+  }
+  appendBits (bits, count, crc, 15) ;
+//--- Stuff bits: after 5 equal bits, a complement bit is inserted (it starts a new run)
+  uint32_t stuffedCount = 0 ;
+  uint32_t runLength = 0 ;
+  uint8_t runValue = 2 ;
+  for (uint32_t i=0 ; i<count ; i++) {
+    if (bits [i] == runValue) {
+      runLength += 1 ;
+    }else{
+      runValue = bits [i] ;
+      runLength = 1 ;
+    }
+    stuffedCount += 1 ;
+    if (runLength == 5) {
+      stuffedCount += 1 ;
+      runValue = 1 - runValue ;
+      runLength = 1 ;
+    }
+  }
+//--- CRC delimiter, ACK slot, ACK delimiter, end of frame (not stuffed)
+  if (nullptr != outAckSlotIndex) {
+    *outAckSlotIndex = stuffedCount + 1 ;
+  }
+  return stuffedCount + 3 + 7 ;
+}
+
+//----------------------------------------------------------------------------------------
+
+uint32_t ACANVirtualBus::arbitrationKey (const CANMessage & inMessage) {
+  uint32_t result ;
+  if (inMessage.ext) { // Base identifier, SRR, IDE, identifier extension, RTR
+    result =
+      (((inMessage.id >> 18) & 0x7FF) << 21) | (3U << 19) | ((inMessage.id & 0x3FFFF) << 1) | (inMessage.rtr ? 1 : 0) ;
+  }else{ // Identifier, RTR, IDE (a standard frame wins over an extended one at IDE)
+    result = ((inMessage.id & 0x7FF) << 21) | (inMessage.rtr ? (1U << 20) : 0) ;
+  }
+  return result ;
+}
+
+//----------------------------------------------------------------------------------------
+//    Scenario events
+//----------------------------------------------------------------------------------------
+
+class ACANVirtualBus::Event {
+  public: uint64_t mNanos ;
+  public: Event * mNext = nullptr ;
+//--- Action
+  public: tScenarioAction mAction = nullptr ;
+  public: void * mUserData = nullptr ;
+//--- Periodic frame
+  public: ACANSimulatedNode * mNode = nullptr ;
+  public: CANMessage mMessage ;
+  public: uint64_t mPeriodNanos = 0 ;
+  public: uint32_t mRemainingCount = 0 ; // 0 --> forever
+
+  public: Event (const uint64_t inNanos) : mNanos (inNanos) {}
+} ;
+
+//----------------------------------------------------------------------------------------
+
+void ACANVirtualBus::enterEvent (Event * inEvent) {
+  Event ** eventPtr = & mFirstEvent ;
+  while ((nullptr != *eventPtr) && ((*eventPtr)->mNanos <= inEvent->mNanos)) { // Same time: in order
+    eventPtr = & (*eventPtr)->mNext ;
+  }
+  inEvent->mNext = *eventPtr ;
+  *eventPtr = inEvent ;
+}
+
+//----------------------------------------------------------------------------------------
+
+void ACANVirtualBus::at (const uint64_t inNanos, const tScenarioAction inAction, void * inUserData) {
+  Event * event = new Event (inNanos) ;
+  event->mAction = inAction ;
+  event->mUserData = inUserData ;
+  enterEvent (event) ;
+}
+
+//----------------------------------------------------------------------------------------
+
+void ACANVirtualBus::sendPeriodically (ACANSimulatedNode & inNode,
+                                       const CANMessage & inMessage,
+                                       const uint32_t inPeriodMicros,
+                                       const uint32_t inStartMicros,
+                                       const uint32_t inCount) {
+  Event * event = new Event ((uint64_t) inStartMicros * 1000) ;
+  event->mNode = & inNode ;
+  event->mMessage = inMessage ;
+  event->mPeriodNanos = ((inPeriodMicros > 0) ? inPeriodMicros : 1) * (uint64_t) 1000 ;
+  event->mRemainingCount = inCount ;
+  enterEvent (event) ;
+}
+
+//----------------------------------------------------------------------------------------
+
+void ACANVirtualBus::injectBitErrors (const uint32_t inFrameCount, const uint32_t inBitIndex) {
+  mPendingBitErrorCount = inFrameCount ;
+  mBitErrorIndex = (inBitIndex > 0) ? inBitIndex : 1 ; // Start of frame cannot be destroyed
+}
+
+//----------------------------------------------------------------------------------------
+//    Constructor, destructor, nodes
+//----------------------------------------------------------------------------------------
+
+ACANVirtualBus::ACANVirtualBus (const uint32_t inBitRate) :
+mBitRate (inBitRate) {
+  mSharedSegment.mBitNanos = (inBitRate > 0) ? ((1000ULL * 1000 * 1000 + inBitRate / 2) / inBitRate) : 0 ;
+}
+
+//----------------------------------------------------------------------------------------
+
+ACANVirtualBus::~ ACANVirtualBus (void) {
+  while (nullptr != mFirstEvent) {
+    Event * event = mFirstEvent ;
+    mFirstEvent = event->mNext ;
+    delete event ;
+  }
+  while (nullptr != mFirstNode) { // Nodes outlive the bus (static sketch nodes)
+    ACANSimulatedNode * node = mFirstNode ;
+    mFirstNode = node->mNextNode ;
+    node->mNextNode = nullptr ;
+  }
+}
+
+//----------------------------------------------------------------------------------------
+
+void ACANVirtualBus::attach (ACANSimulatedNode * inNode) {
+  inNode->mNextNode = mFirstNode ;
+  mFirstNode = inNode ;
+}
+
+//----------------------------------------------------------------------------------------
+
+void ACANVirtualBus::detach (ACANSimulatedNode * inNode) {
+  ACANSimulatedNode ** nodePtr = & mFirstNode ;
+  while ((nullptr != *nodePtr) && (*nodePtr != inNode)) {
+    nodePtr = & (*nodePtr)->mNextNode ;
+  }
+  if (nullptr != *nodePtr) {
+    *nodePtr = inNode->mNextNode ;
+    inNode->mNextNode = nullptr ;
+  }
+  if (mSharedSegment.mTransmitter == inNode) { // Frame in progress is lost
+    mSharedSegment.mTransmitter = nullptr ;
+  }
+}
+
+//----------------------------------------------------------------------------------------
+
+bool ACANVirtualBus::joinSharedSegment (const uint32_t inBitRate) {
+  if (mBitRate == 0) {
+    mBitRate = inBitRate ;
+    mSharedSegment.mBitNanos = (1000ULL * 1000 * 1000 + inBitRate / 2) / inBitRate ;
+  }
+  return mBitRate == inBitRate ;
+}
+
+//----------------------------------------------------------------------------------------
+
+ACANBusSegment & ACANVirtualBus::segmentOf (ACANSimulatedNode * inNode) {
+  return inNode->mLoopBackMode ? inNode->mLoopBackSegment : mSharedSegment ;
+}
+
+//----------------------------------------------------------------------------------------
+
+uint32_t ACANVirtualBus::busLoadPerMille (void) const {
+  return (mNowNanos == 0) ? 0 : (uint32_t) ((mSharedSegment.mBusyNanos * 1000) / mNowNanos) ;
+}
+
+//----------------------------------------------------------------------------------------
+//    Simulation
+//----------------------------------------------------------------------------------------
+
+bool ACANVirtualBus::nextTransition (ACANBusSegment & inSegment, uint64_t & outNanos) {
+  bool found = nullptr != inSegment.mTransmitter ;
+  if (found) { // End of the frame in progress
+    outNanos = inSegment.mEndNanos ;
+  }else{ // Start of frame: bus idle, and a node ready to send
+    for (ACANSimulatedNode * node = mFirstNode ; nullptr != node ; node = node->mNextNode) {
+      uint64_t readyNanos ;
+      if ((& segmentOf (node) == & inSegment) && node->readyToSend (readyNanos)) {
+        if (readyNanos < inSegment.mIdleFromNanos) {
+          readyNanos = inSegment.mIdleFromNanos ;
+        }
+        if (!found || (outNanos > readyNanos)) {
+          outNanos = readyNanos ;
+        }
+        found = true ;
+      }
+    }
+  }
+  return found ;
+}
+
+//----------------------------------------------------------------------------------------
+
+void ACANVirtualBus::startFrame (ACANBusSegment & inSegment) {
+//--- Arbitration between the nodes ready at start of frame
+  ACANSimulatedNode * winner = nullptr ;
+  uint32_t winnerKey = 0 ;
+  for (ACANSimulatedNode * node = mFirstNode ; nullptr != node ; node = node->mNextNode) {
+    uint64_t readyNanos ;
+    if ((& segmentOf (node) == & inSegment) && node->readyToSend (readyNanos) && (readyNanos <= mNowNanos)) {
+      const uint32_t key = arbitrationKey (node->mMailboxMessage) ;
+      if ((nullptr == winner) || (key < winnerKey)) {
+        if (nullptr != winner) {
+          winner->mLostArbitrationCount += 1 ;
+        }
+        winner = node ;
+        winnerKey = key ;
+      }else{
+        node->mLostArbitrationCount += 1 ;
+      }
+    }
+  }
+//--- Acknowledge: another started node, not in listen only mode; in loop back mode, the
+//    transmitter itself
+  bool acknowledged = (nullptr != winner) && winner->mLoopBackMode ;
+  for (ACANSimulatedNode * node = mFirstNode ; (nullptr != node) && !acknowledged ; node = node->mNextNode) {
+    acknowledged = (node != winner) && (& segmentOf (node) == & inSegment)
+      && node->mStarted && !node->mListenOnlyMode && !node->mBusOff ;
+  }
+//--- Frame duration, errors
+  if (nullptr != winner) {
+    uint32_t ackSlotIndex ;
+    uint32_t bitCount = frameBitCount (winner->mMailboxMessage, & ackSlotIndex) ;
+    inSegment.mTransmitter = winner ;
+    inSegment.mErrorBitIndex = 0 ;
+    if ((& inSegment == & mSharedSegment) && (mPendingBitErrorCount > 0)) {
+      mPendingBitErrorCount -= 1 ;
+      inSegment.mErrorBitIndex = (mBitErrorIndex < ackSlotIndex + 1) ? mBitErrorIndex : (ackSlotIndex + 1) ;
+    }else if (!acknowledged) { // ACK error
+      inSegment.mErrorBitIndex = ackSlotIndex ;
+    }
+    if (inSegment.mErrorBitIndex > 0) {
+      bitCount = inSegment.mErrorBitIndex + 1 + kErrorFrameBits ;
+    }
+    const uint64_t duration = bitCount * inSegment.mBitNanos ;
+    inSegment.mEndNanos = mNowNanos + duration ;
+    inSegment.mBusyNanos += duration ;
+  }
+}
+
+//----------------------------------------------------------------------------------------
+
+void ACANVirtualBus::endFrame (ACANBusSegment & inSegment) {
+  ACANSimulatedNode * transmitter = inSegment.mTransmitter ;
+  inSegment.mTransmitter = nullptr ;
+  inSegment.mIdleFromNanos = mNowNanos + kIntermissionBits * inSegment.mBitNanos ;
+  const bool shared = & inSegment == & mSharedSegment ;
+  if (inSegment.mErrorBitIndex > 0) { // Error frame: the frame stays in the transmit mailbox
+    uint32_t ackSlotIndex ;
+    frameBitCount (transmitter->mMailboxMessage, & ackSlotIndex) ;
+    const bool ackError = inSegment.mErrorBitIndex == ackSlotIndex ;
+    if (shared) {
+      mErrorFrameCount += 1 ;
+    }
+    transmitter->transmitError (ackError, mNowNanos, inSegment.mBitNanos) ;
+    for (ACANSimulatedNode * node = mFirstNode ; nullptr != node ; node = node->mNextNode) {
+      if ((node != transmitter) && (& segmentOf (node) == & inSegment) && node->mStarted && !node->mBusOff) {
+        node->receiveError () ;
+      }
+    }
+  }else{
+    if (shared) {
+      mFrameCount += 1 ;
+    }
+    const CANMessage message = transmitter->mMailboxMessage ;
+    transmitter->frameSent (mNowNanos, inSegment.mBitNanos) ;
+    for (ACANSimulatedNode * node = mFirstNode ; nullptr != node ; node = node->mNextNode) {
+      if ((& segmentOf (node) == & inSegment) && node->mStarted && !node->mBusOff) {
+        if (node != transmitter) {
+          node->frameAcknowledged () ;
+          node->frameReceived (message) ;
+        }else if (node->mSelfReceptionMode || node->mLoopBackMode) {
+          node->frameReceived (message) ;
+        }
+      }
+    }
+  }
+}
+
+//----------------------------------------------------------------------------------------
+
+void ACANVirtualBus::runUntil (const uint64_t inNanos) {
+  bool loop = true ;
+  while (loop) {
+  //--- Nearest segment transition
+    ACANBusSegment * segment = nullptr ;
+    uint64_t transitionNanos = 0 ;
+    uint64_t nanos ;
+    if (nextTransition (mSharedSegment, nanos)) {
+      segment = & mSharedSegment ;
+      transitionNanos = nanos ;
+    }
+    for (ACANSimulatedNode * node = mFirstNode ; nullptr != node ; node = node->mNextNode) {
+      if (node->mLoopBackMode && nextTransition (node->mLoopBackSegment, nanos)
+       && ((nullptr == segment) || (transitionNanos > nanos))) {
+        segment = & node->mLoopBackSegment ;
+        transitionNanos = nanos ;
+      }
+    }
+  //--- Scenario event first at same time: it may send a frame that takes part in arbitration
+    if ((nullptr != mFirstEvent) && (mFirstEvent->mNanos <= inNanos)
+     && ((nullptr == segment) || (mFirstEvent->mNanos <= transitionNanos))) {
+      Event * event = mFirstEvent ;
+      mFirstEvent = event->mNext ;
+      if (mNowNanos < event->mNanos) {
+        mNowNanos = event->mNanos ;
+      }
+      if (nullptr != event->mAction) {
+        event->mAction (*this, event->mUserData) ;
+      }
+      if (nullptr != event->mNode) {
+        event->mNode->tryToSend (event->mMessage) ;
+        if (event->mRemainingCount != 1) { // 0: forever
+          event->mRemainingCount -= (event->mRemainingCount > 0) ? 1 : 0 ;
+          event->mNanos += event->mPeriodNanos ;
+          enterEvent (event) ;
+          event = nullptr ;
+        }
+      }
+      delete event ;
+    }else if ((nullptr != segment) && (transitionNanos <= inNanos)) {
+      if (mNowNanos < transitionNanos) {
+        mNowNanos = transitionNanos ;
+      }
+      if (nullptr != segment->mTransmitter) {
+        endFrame (*segment) ;
+      }else{
+        startFrame (*segment) ;
+      }
+    }else{
+      loop = false ;
+    }
+  }
+  if (mNowNanos < inNanos) {
+    mNowNanos = inNanos ;
+  }
+  for (ACANSimulatedNode * node = mFirstNode ; nullptr != node ; node = node->mNextNode) {
+    node->updateBusOffState (mNowNanos) ;
+  }
+}
+
+//----------------------------------------------------------------------------------------
+//    Simulated node
+//----------------------------------------------------------------------------------------
+
+ACANSimulatedNode::ACANSimulatedNode (ACANVirtualBus & inBus, const char * inName) :
+mBus (inBus),
+mName (inName) {
+  inBus.attach (this) ;
+}
+
+//----------------------------------------------------------------------------------------
+
+ACANSimulatedNode::~ ACANSimulatedNode (void) {
+  end () ;
+  mBus.detach (this) ;
+}
+
+//----------------------------------------------------------------------------------------
+
+uint32_t ACANSimulatedNode::begin (const ACANSettings & inSettings,
+                                   const ACANPrimaryFilter inPrimaryFilters [],
+                                   const uint32_t inPrimaryFilterCount,
+                                   const ACANSecondaryFilter inSecondaryFilters [],
+                                   const uint32_t inSecondaryFilterCount) {
+  end () ;
+//---------- Check filters (same limits as the FlexCAN RxFIFO), bit rate
+  uint32_t errorCode = 0 ;
+  const uint32_t MAX_PRIMARY_FILTER_COUNT = 8 + 2 * (uint32_t) inSettings.mConfiguration ;
+  const uint32_t MAX_SECONDARY_FILTER_COUNT = 6 * (uint32_t) inSettings.mConfiguration ;
+  if (inPrimaryFilterCount > MAX_PRIMARY_FILTER_COUNT) {
+    errorCode |= kTooMuchPrimaryFilters ;
+  }
+  if (inSecondaryFilterCount > MAX_SECONDARY_FILTER_COUNT) {
+    errorCode |= kTooMuchSecondaryFilters ;
+  }
+  for (uint32_t i=0 ; i<inPrimaryFilterCount ; i++) {
+    if ((inPrimaryFilters [i].mAcceptanceFilter & 1) != 0) { // Bit 0 is the error flag
+      errorCode |= kNotConformPrimaryFilter ;
+    }
+  }
+  for (uint32_t i=0 ; i<inSecondaryFilterCount ; i++) {
+    if ((inSecondaryFilters [i].mSingleAcceptanceFilter & 1) != 0) {
+      errorCode |= kNotConformSecondaryFilter ;
+    }
+  }
+  const uint32_t bitRate = inSettings.actualBitRate () ;
+  if (!inSettings.mBitSettingOk || (bitRate == 0)) {
+    errorCode |= kCANBitConfiguration ;
+  }else if (inSettings.mLoopBackMode) {
+    mLoopBackSegment = ACANBusSegment () ;
+    mLoopBackSegment.mBitNanos = (1000ULL * 1000 * 1000 + bitRate / 2) / bitRate ;
+    mLoopBackSegment.mIdleFromNanos = mBus.nowNanos () ;
+  }else if ((0 == errorCode) && !mBus.joinSharedSegment (bitRate)) {
+    errorCode |= kBitRateMismatch ;
+  }
+//---------- Filters, buffers
+  if (0 == errorCode) {
+    mListenOnlyMode = inSettings.mListenOnlyMode ;
+    mSelfReceptionMode = inSettings.mSelfReceptionMode ;
+    mLoopBackMode = inSettings.mLoopBackMode ;
+    mFilterCount = inPrimaryFilterCount + inSecondaryFilterCount ;
+    if (mFilterCount > 0) {
+      mFilterMaskArray = new uint32_t [mFilterCount] ;
+      mFilterAcceptanceArray = new uint32_t [mFilterCount] ;
+      mCallBackFunctionArray = new ACANCallBackRoutine [mFilterCount] ;
+      for (uint32_t i=0 ; i<inPrimaryFilterCount ; i++) {
+        mFilterMaskArray [i] = inPrimaryFilters [i].mFilterMask ;
+        mFilterAcceptanceArray [i] = inPrimaryFilters [i].mAcceptanceFilter ;
+        mCallBackFunctionArray [i] = inPrimaryFilters [i].mCallBackRoutine ;
+      }
+      for (uint32_t i=0 ; i<inSecondaryFilterCount ; i++) {
+        mFilterMaskArray [inPrimaryFilterCount + i] = ~ 1U ;
+        mFilterAcceptanceArray [inPrimaryFilterCount + i] = inSecondaryFilters [i].mSingleAcceptanceFilter ;
+        mCallBackFunctionArray [inPrimaryFilterCount + i] = inSecondaryFilters [i].mCallBackRoutine ;
+      }
+    }
+    mReceiveBufferSize = inSettings.mHighReceiveBufferSize + inSettings.mReceiveBufferSize + inSettings.mBulkReceiveBufferSize ;
+    mReceiveBuffer = new CANMessage [(mReceiveBufferSize > 0) ? mReceiveBufferSize : 1] ;
+    mReceiveOverflowPolicy = inSettings.mReceiveOverflowPolicy ;
+  //--- Transmit buffer capacity is rounded up to a power of two, as the driver does
+    mTransmitBufferSize = 1 ;
+    while (mTransmitBufferSize < inSettings.mTransmitBufferSize) {
+      mTransmitBufferSize <<= 1 ;
+    }
+    mTransmitBuffer = new CANMessage [mTransmitBufferSize] ;
+    mTransmitBufferNanos = new uint64_t [mTransmitBufferSize] ;
+    mStarted = true ;
+  }
+  return errorCode ;
+}
+
+//----------------------------------------------------------------------------------------
+
+void ACANSimulatedNode::releaseBuffers (void) {
+  delete [] mFilterMaskArray ; mFilterMaskArray = nullptr ;
+  delete [] mFilterAcceptanceArray ; mFilterAcceptanceArray = nullptr ;
+  delete [] mCallBackFunctionArray ; mCallBackFunctionArray = nullptr ;
+  delete [] mReceiveBuffer ; mReceiveBuffer = nullptr ;
+  delete [] mTransmitBuffer ; mTransmitBuffer = nullptr ;
+  delete [] mTransmitBufferNanos ; mTransmitBufferNanos = nullptr ;
+}
+
+//----------------------------------------------------------------------------------------
+
+void ACANSimulatedNode::end (void) {
+  releaseBuffers () ;
+  mStarted = false ;
+  mLoopBackMode = false ;
+  mFilterCount = 0 ;
+  mReceiveBufferSize = 0 ;
+  mReceiveBufferReadIndex = 0 ;
+  mReceiveBufferCount = 0 ;
+  mMailboxFull = false ;
+  mTransmitBufferSize = 0 ;
+  mTransmitBufferReadIndex = 0 ;
+  mTransmitBufferCount = 0 ;
+  mTransmitErrorCounter = 0 ;
+  mReceiveErrorCounter = 0 ;
+  mBusOff = false ;
+  mSuspendUntilNanos = 0 ;
+}
+
+//----------------------------------------------------------------------------------------
+//    Transmission
+//----------------------------------------------------------------------------------------
+
+bool ACANSimulatedNode::tryToSend (const CANMessage & inMessage) {
+  bool ok = mStarted && !mListenOnlyMode ;
+  if (ok && !mMailboxFull) {
+    mMailboxMessage = inMessage ;
+    mMailboxNanos = mBus.nowNanos () ;
+    mMailboxFull = true ;
+  }else if (ok && (mTransmitBufferCount < mTransmitBufferSize)) {
+    const uint32_t writeIndex = (mTransmitBufferReadIndex + mTransmitBufferCount) % mTransmitBufferSize ;
+    mTransmitBuffer [writeIndex] = inMessage ;
+    mTransmitBufferNanos [writeIndex] = mBus.nowNanos () ;
+    mTransmitBufferCount += 1 ;
+    if (mTransmitBufferPeakCount < mTransmitBufferCount) {
+      mTransmitBufferPeakCount = mTransmitBufferCount ;
+    }
+  }else{
+    if (ok) {
+      mTransmitBufferPeakCount = mTransmitBufferSize + 1 ;
+    }
+    mRejectedFrameCount += 1 ;
+    ok = false ;
+  }
+  return ok ;
+}
+
+//----------------------------------------------------------------------------------------
+
+bool ACANSimulatedNode::readyToSend (uint64_t & outReadyNanos) {
+  const bool ready = mStarted && !mListenOnlyMode && mMailboxFull ;
+  if (ready) {
+    outReadyNanos = (mMailboxNanos > mSuspendUntilNanos) ? mMailboxNanos : mSuspendUntilNanos ;
+    updateBusOffState (mBus.nowNanos ()) ;
+    if (mBusOff && (outReadyNanos < mBusOffEndNanos)) {
+      outReadyNanos = mBusOffEndNanos ;
+    }
+  }
+  return ready ;
+}
+
+//----------------------------------------------------------------------------------------
+
+void ACANSimulatedNode::updateBusOffState (const uint64_t inNanos) {
+  if (mBusOff && (mBusOffEndNanos <= inNanos)) { // Recovered
+    mBusOff = false ;
+    mTransmitErrorCounter = 0 ;
+    mReceiveErrorCounter = 0 ;
+  }
+}
+
+//----------------------------------------------------------------------------------------
+
+void ACANSimulatedNode::frameSent (const uint64_t inNanos, const uint64_t inBitNanos) {
+  mSentFrameCount += 1 ;
+  const uint64_t latencyMicros = (inNanos - mMailboxNanos) / 1000 ;
+  mTransmitLatencyHistogram.record ((latencyMicros > 0xFFFFFFFF) ? 0xFFFFFFFF : (uint32_t) latencyMicros) ;
+  if (mTransmitErrorCounter > 0) {
+    mTransmitErrorCounter -= 1 ;
+  }
+  if (controllerState () == kPassive) {
+    mSuspendUntilNanos = inNanos + (kIntermissionBits + kSuspendTransmissionBits) * inBitNanos ;
+  }
+//--- Next frame of the transmit buffer
+  mMailboxFull = mTransmitBufferCount > 0 ;
+  if (mMailboxFull) {
+    mMailboxMessage = mTransmitBuffer [mTransmitBufferReadIndex] ;
+    mMailboxNanos = mTransmitBufferNanos [mTransmitBufferReadIndex] ;
+    mTransmitBufferReadIndex = (mTransmitBufferReadIndex + 1) % mTransmitBufferSize ;
+    mTransmitBufferCount -= 1 ;
+  }
+}
+
+//----------------------------------------------------------------------------------------
+
+void ACANSimulatedNode::transmitError (const bool inAckError, const uint64_t inNanos, const uint64_t inBitNanos) {
+//--- An error passive transmitter does not count ACK errors (no other node on the bus)
+  if (!inAckError || (controllerState () != kPassive)) {
+    mTransmitErrorCounter += 8 ;
+  }
+  if (mTransmitErrorCounter > 255) {
+    mBusOff = true ;
+    mBusOffEndNanos = inNanos + kBusOffRecoveryBits * inBitNanos ;
+    mBusOffCount += 1 ;
+  }else if (controllerState () == kPassive) {
+    mSuspendUntilNanos = inNanos + (kIntermissionBits + kSuspendTransmissionBits) * inBitNanos ;
+  }
+}
+
+//----------------------------------------------------------------------------------------
+
+tControllerState ACANSimulatedNode::controllerState (void) const {
+  tControllerState result = kActive ;
+  if (mBusOff) {
+    result = kBusOff ;
+  }else if ((mTransmitErrorCounter > 127) || (mReceiveErrorCounter > 127)) {
+    result = kPassive ;
+  }
+  return result ;
+}
+
+//----------------------------------------------------------------------------------------
+//    Reception
+//----------------------------------------------------------------------------------------
+
+void ACANSimulatedNode::receiveError (void) {
+  if (mReceiveErrorCounter < 255) {
+    mReceiveErrorCounter += 1 ;
+  }
+}
+
+//----------------------------------------------------------------------------------------
+
+void ACANSimulatedNode::frameAcknowledged (void) {
+  if (mReceiveErrorCounter > 127) {
+    mReceiveErrorCounter = 120 ; // Back to error active: a value between 119 and 127
+  }else if (mReceiveErrorCounter > 0) {
+    mReceiveErrorCounter -= 1 ;
+  }
+}
+
+//----------------------------------------------------------------------------------------
+
+uint32_t ACANSimulatedNode::filterIndex (const CANMessage & inMessage) const {
+  uint32_t result = 0 ; // No filter: any frame is accepted
+  if (mFilterCount > 0) {
+    const uint32_t image = acanFilterImage (inMessage) ;
+    result = kNoFilter ;
+    for (uint32_t i=mFilterCount ; i>0 ; i--) {
+      if (((image ^ mFilterAcceptanceArray [i-1]) & mFilterMaskArray [i-1]) == 0) {
+        result = i - 1 ;
+      }
+    }
+  }
+  return result ;
+}
+
+//----------------------------------------------------------------------------------------
+
+void ACANSimulatedNode::frameReceived (const CANMessage & inMessage) {
+  const uint32_t idx = filterIndex (inMessage) ;
+  if (idx != kNoFilter) {
+    CANMessage message = inMessage ;
+    message.idx = (uint8_t) idx ;
+    bool store = mReceiveBufferCount < mReceiveBufferSize ;
+    if (!store) {
+      mDroppedFrameCount += 1 ;
+      mReceiveBufferPeakCount = mReceiveBufferSize + 1 ;
+      if ((mReceiveOverflowPolicy == ACANSettings::kDropOldest) && (mReceiveBufferSize > 0)) {
+        mReceiveBufferReadIndex = (mReceiveBufferReadIndex + 1) % mReceiveBufferSize ;
+        mReceiveBufferCount -= 1 ;
+        store = true ;
+      }else if ((mReceiveOverflowPolicy == ACANSettings::kEvictLowestPriority) && (mReceiveBufferSize > 0)) {
+        uint32_t lowest = mReceiveBufferSize ; // Received frame
+        uint32_t lowestKey = ACANVirtualBus::arbitrationKey (message) ;
+        for (uint32_t i=0 ; i<mReceiveBufferCount ; i++) {
+          const uint32_t key = ACANVirtualBus::arbitrationKey (mReceiveBuffer [(mReceiveBufferReadIndex + i) % mReceiveBufferSize]) ;
+          if (key > lowestKey) {
+            lowest = i ;
+            lowestKey = key ;
+          }
+        }
+        if (lowest < mReceiveBufferSize) { // Remove it, keeping arrival order
+          for (uint32_t i=lowest + 1 ; i<mReceiveBufferCount ; i++) {
+            mReceiveBuffer [(mReceiveBufferReadIndex + i - 1) % mReceiveBufferSize] =
+              mReceiveBuffer [(mReceiveBufferReadIndex + i) % mReceiveBufferSize] ;
+          }
+          mReceiveBufferCount -= 1 ;
+          store = true ;
+        }
+      }
+    }
+    if (store) {
+      mReceiveBuffer [(mReceiveBufferReadIndex + mReceiveBufferCount) % mReceiveBufferSize] = message ;
+      mReceiveBufferCount += 1 ;
+      mReceivedFrameCount += 1 ;
+      if (mReceiveBufferPeakCount < mReceiveBufferCount) {
+        mReceiveBufferPeakCount = mReceiveBufferCount ;
+      }
+    }
+  }
+}
+
+//----------------------------------------------------------------------------------------
+
+bool ACANSimulatedNode::receive (CANMessage & outMessage) {
+  const bool hasReceived = mReceiveBufferCount > 0 ;
+  if (hasReceived) {
+    outMessage = mReceiveBuffer [mReceiveBufferReadIndex] ;
+    mReceiveBufferReadIndex = (mReceiveBufferReadIndex + 1) % mReceiveBufferSize ;
+    mReceiveBufferCount -= 1 ;
+  }
+  return hasReceived ;
+}
+
+//----------------------------------------------------------------------------------------
+
+uint32_t ACANSimulatedNode::peek (const CANMessage * & outMessages) {
+  outMessages = mReceiveBuffer + mReceiveBufferReadIndex ;
+  const uint32_t untilEnd = mReceiveBufferSize - mReceiveBufferReadIndex ;
+  return (mReceiveBufferCount < untilEnd) ? mReceiveBufferCount : untilEnd ;
+}
+
+//----------------------------------------------------------------------------------------
+
+void ACANSimulatedNode::consume (const uint32_t inCount) {
+  const uint32_t n = (inCount < mReceiveBufferCount) ? inCount : mReceiveBufferCount ;
+  if (n > 0) {
+    mReceiveBufferReadIndex = (mReceiveBufferReadIndex + n) % mReceiveBufferSize ;
+    mReceiveBufferCount -= n ;
+  }
+}
+
+//----------------------------------------------------------------------------------------
+
+bool ACANSimulatedNode::dispatchReceivedMessage (const tFilterMatchCallBack inFilterMatchCallBack) {
+  CANMessage receivedMessage ;
+  const bool hasReceived = receive (receivedMessage) ;
+  if (hasReceived) {
+    const uint32_t filterIndex = receivedMessage.idx ;
+    if (nullptr != inFilterMatchCallBack) {
+      inFilterMatchCallBack (filterIndex) ;
+    }
+    if (filterIndex < mFilterCount) {
+      ACANCallBackRoutine callBackFunction = mCallBackFunctionArray [filterIndex] ;
+      if (nullptr != callBackFunction) {
+        callBackFunction (receivedMessage) ;
+      }
+    }
+  }
+  return hasReceived ;
+}
+
+//----------------------------------------------------------------------------------------
+
+#endif
+
+//----------------------------------------------------------------------------------------
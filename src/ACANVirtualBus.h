@@ -0,0 +1,262 @@
+//----------------------------------------------------------------------------------------
+// Virtual CAN bus simulator (host)
+// by Pierre Molinaro
+// https://github.com/pierremolinaro/acan
+//
+// Several ACANSimulatedNode instances (ACAN driver API: begin with filters, tryToSend,
+// receive, dispatchReceivedMessage) share an ACANVirtualBus, in simulated time. The bus
+// models identifier arbitration, frame duration with stuff bits (the CRC is computed, so
+// stuffing is exact) at the ACANSettings bit rate, intermission, acknowledge, injected bit
+// errors, error counters, error passive and bus off states. Scenarios schedule actions and
+// periodic frames; nodes report transmit latency distributions, lost arbitrations and
+// buffer high-water marks, for sizing buffers before deployment.
+// extras/simulator runs unchanged sketches on the bus (see README).
+// This file does not depend on Arduino; it is empty in an Arduino build.
+//
+//----------------------------------------------------------------------------------------
+
+#pragma once
+
+//----------------------------------------------------------------------------------------
+
+#ifndef ARDUINO
+
+//----------------------------------------------------------------------------------------
+
+#include <ACANSettings.h>
+#include <ACAN_CANMessage.h>
+#include <ACANFilters.h>
+#include <ACANInstrumentation.h>
+#include <ACANDriverInterface.h>
+
+//----------------------------------------------------------------------------------------
+
+class ACANSimulatedNode ;
+
+//----------------------------------------------------------------------------------------
+//   Bus segment: the shared bus, or the internal bus of a node in loop back mode
+//----------------------------------------------------------------------------------------
+
+class ACANBusSegment {
+  public: uint64_t mBitNanos = 0 ;
+  public: uint64_t mIdleFromNanos = 0 ; // After intermission
+  public: ACANSimulatedNode * mTransmitter = nullptr ; // Frame in progress
+  public: uint64_t mEndNanos = 0 ;
+  public: uint32_t mErrorBitIndex = 0 ; // 0 --> no error
+  public: uint64_t mBusyNanos = 0 ;
+} ;
+
+//----------------------------------------------------------------------------------------
+//   Virtual bus
+//----------------------------------------------------------------------------------------
+
+class ACANVirtualBus {
+//--- Constructor: inBitRate == 0 --> bit rate of the first started node
+  public: explicit ACANVirtualBus (const uint32_t inBitRate = 0) ;
+  public: ~ ACANVirtualBus (void) ;
+
+//--- Simulated time (starts at 0)
+  public: inline uint64_t nowNanos (void) const { return mNowNanos ; }
+  public: inline uint32_t nowMicros (void) const { return (uint32_t) (mNowNanos / 1000) ; }
+  public: inline uint32_t bitRate (void) const { return mBitRate ; }
+
+//--- Advances simulated time: transmits frames and runs scenario actions in time order
+  public: void runUntil (const uint64_t inNanos) ;
+  public: inline void runFor (const uint64_t inNanos) { runUntil (mNowNanos + inNanos) ; }
+
+//--- Scenario: an action is called at a given time (from runUntil)
+  public: typedef void (*tScenarioAction) (ACANVirtualBus & inBus, void * inUserData) ;
+  public: void at (const uint64_t inNanos, const tScenarioAction inAction, void * inUserData = nullptr) ;
+//--- Scenario: inNode sends inMessage every inPeriodMicros from inStartMicros, inCount
+//    times (0 --> forever); a frame rejected by tryToSend is counted by the node
+  public: void sendPeriodically (ACANSimulatedNode & inNode,
+                                 const CANMessage & inMessage,
+                                 const uint32_t inPeriodMicros,
+                                 const uint32_t inStartMicros = 0,
+                                 const uint32_t inCount = 0) ;
+
+//--- Error injection: the next inFrameCount frames of the shared bus are destroyed by a
+//    bit error at bit inBitIndex from start of frame (clamped to the ACK delimiter)
+  public: void injectBitErrors (const uint32_t inFrameCount, const uint32_t inBitIndex = 20) ;
+
+//--- Frame length in bits, from start of frame to end of frame (intermission excluded),
+//    stuff bits included; outAckSlotIndex (if not nullptr) is the ACK slot bit index
+  public: static uint32_t frameBitCount (const CANMessage & inMessage,
+                                         uint32_t * outAckSlotIndex = nullptr) ;
+//--- Arbitration field image: the frame with the lowest value wins arbitration
+  public: static uint32_t arbitrationKey (const CANMessage & inMessage) ;
+
+//--- Statistics (shared bus)
+  public: inline uint32_t frameCount (void) const { return mFrameCount ; }
+  public: inline uint32_t errorFrameCount (void) const { return mErrorFrameCount ; }
+  public: uint32_t busLoadPerMille (void) const ; // Busy time / elapsed time
+
+//--- Called by nodes
+  public: void attach (ACANSimulatedNode * inNode) ;
+  public: void detach (ACANSimulatedNode * inNode) ;
+  public: bool joinSharedSegment (const uint32_t inBitRate) ; // false if bit rates differ
+
+//--- Private
+  private: class Event ;
+  private: void enterEvent (Event * inEvent) ;
+  private: ACANBusSegment & segmentOf (ACANSimulatedNode * inNode) ;
+  private: bool nextTransition (ACANBusSegment & inSegment, uint64_t & outNanos) ;
+  private: void startFrame (ACANBusSegment & inSegment) ;
+  private: void endFrame (ACANBusSegment & inSegment) ;
+
+  private: uint64_t mNowNanos = 0 ;
+  private: uint32_t mBitRate ;
+  private: ACANBusSegment mSharedSegment ;
+  private: ACANSimulatedNode * mFirstNode = nullptr ;
+  private: Event * mFirstEvent = nullptr ; // Sorted by time
+  private: uint32_t mPendingBitErrorCount = 0 ;
+  private: uint32_t mBitErrorIndex = 0 ;
+  private: uint32_t mFrameCount = 0 ;
+  private: uint32_t mErrorFrameCount = 0 ;
+
+//--- No copy
+  private : ACANVirtualBus (const ACANVirtualBus &) = delete ;
+  private : ACANVirtualBus & operator = (const ACANVirtualBus &) = delete ;
+} ;
+
+//----------------------------------------------------------------------------------------
+//   Simulated node
+//----------------------------------------------------------------------------------------
+
+class ACANSimulatedNode : public ACANDriverInterface <ACANSimulatedNode> {
+//--- Constructor: the node is attached to inBus, but does not take part before begin
+  public: ACANSimulatedNode (ACANVirtualBus & inBus, const char * inName) ;
+  public: virtual ~ ACANSimulatedNode (void) ;
+
+//--- begin; returns a result code (0 : Ok, other: every bit denotes an error). Settings
+//    used: bit rate (must be the bus one, except in loop back mode), listen only, self
+//    reception and loop back modes, receive buffer sizes (all classes in a single buffer),
+//    receive overflow policy, transmit buffer size.
+  public: static const uint32_t kTooMuchPrimaryFilters     = 1 << 12 ;
+  public: static const uint32_t kNotConformPrimaryFilter   = 1 << 13 ;
+  public: static const uint32_t kTooMuchSecondaryFilters   = 1 << 14 ;
+  public: static const uint32_t kNotConformSecondaryFilter = 1 << 15 ;
+  public: static const uint32_t kCANBitConfiguration       = 1 << 18 ;
+  public: static const uint32_t kBitRateMismatch           = 1 << 25 ;
+
+  public: uint32_t begin (const ACANSettings & inSettings,
+                          const ACANPrimaryFilter inPrimaryFilters [] = nullptr,
+                          const uint32_t inPrimaryFilterCount = 0,
+                          const ACANSecondaryFilter inSecondaryFilters [] = nullptr,
+                          const uint32_t inSecondaryFilterCount = 0) ;
+  public: void end (void) ;
+  public: inline bool isStarted (void) const { return mStarted ; }
+  public: inline const char * name (void) const { return mName ; }
+
+//--- Transmitting messages: the transmit mailbox, then the transmit buffer
+  public: bool tryToSend (const CANMessage & inMessage) ;
+  public: inline uint32_t transmitBufferSize (void) const { return mTransmitBufferSize ; }
+  public: inline uint32_t transmitBufferCount (void) const { return mTransmitBufferCount ; }
+  public: inline uint32_t transmitBufferPeakCount (void) const { return mTransmitBufferPeakCount ; } // == size + 1 if overflow did occur
+
+//--- Receiving messages
+  public: inline bool available (void) const { return mReceiveBufferCount > 0 ; }
+  public: bool receive (CANMessage & outMessage) ;
+//--- Zero copy reception, as ACAN: peek returns the number of contiguous frames at the head
+//    of the receive buffer, consume releases inCount of them. Frames are stored by the bus
+//    (runUntil): they remain valid until consume if the bus is not run in between.
+  public: uint32_t peek (const CANMessage * & outMessages) ;
+  public: void consume (const uint32_t inCount) ;
+  public: typedef void (*tFilterMatchCallBack) (const uint32_t inFilterIndex) ;
+  public: bool dispatchReceivedMessage (const tFilterMatchCallBack inFilterMatchCallBack = nullptr) ;
+  public: inline uint32_t receiveBufferSize (void) const { return mReceiveBufferSize ; }
+  public: inline uint32_t receiveBufferCount (void) const { return mReceiveBufferCount ; }
+  public: inline uint32_t receiveBufferPeakCount (void) const { return mReceiveBufferPeakCount ; }
+
+//--- Controller state
+  public: tControllerState controllerState (void) const ;
+  public: inline uint32_t receiveErrorCounter (void) const { return mReceiveErrorCounter ; }
+  public: inline uint32_t transmitErrorCounter (void) const { return mTransmitErrorCounter ; }
+
+//--- Statistics
+  public: inline uint32_t sentFrameCount (void) const { return mSentFrameCount ; }
+  public: inline uint32_t receivedFrameCount (void) const { return mReceivedFrameCount ; } // Stored in receive buffer
+  public: inline uint32_t droppedFrameCount (void) const { return mDroppedFrameCount ; } // Receive buffer overflow
+  public: inline uint32_t rejectedFrameCount (void) const { return mRejectedFrameCount ; } // tryToSend returned false
+  public: inline uint32_t lostArbitrationCount (void) const { return mLostArbitrationCount ; }
+  public: inline uint32_t busOffCount (void) const { return mBusOffCount ; }
+//--- Transmit latency (in µs): from tryToSend to end of successful frame
+  public: inline const ACANLatencyHistogram & transmitLatencyHistogram (void) const { return mTransmitLatencyHistogram ; }
+
+//--- Private, used by ACANVirtualBus
+  private: friend class ACANVirtualBus ;
+  private: bool readyToSend (uint64_t & outReadyNanos) ;
+  private: void updateBusOffState (const uint64_t inNanos) ;
+  private: void frameSent (const uint64_t inNanos, const uint64_t inBitNanos) ;
+  private: void frameReceived (const CANMessage & inMessage) ;
+  private: void transmitError (const bool inAckError, const uint64_t inNanos, const uint64_t inBitNanos) ;
+  private: void receiveError (void) ;
+  private: void frameAcknowledged (void) ;
+  private: uint32_t filterIndex (const CANMessage & inMessage) const ; // kNoFilter if rejected
+  private: void releaseBuffers (void) ;
+
+  private: ACANVirtualBus & mBus ;
+  private: const char * mName ;
+  private: ACANSimulatedNode * mNextNode = nullptr ;
+  private: bool mStarted = false ;
+  private: bool mListenOnlyMode = false ;
+  private: bool mSelfReceptionMode = false ;
+  private: bool mLoopBackMode = false ;
+  private: ACANBusSegment mLoopBackSegment ;
+
+//--- Filters (ID table format, see ACANFilters.h), primary filters first
+  private: static const uint32_t kNoFilter = 0xFFFFFFFF ;
+  private: uint32_t * mFilterMaskArray = nullptr ;
+  private: uint32_t * mFilterAcceptanceArray = nullptr ;
+  private: ACANCallBackRoutine * mCallBackFunctionArray = nullptr ;
+  private: uint32_t mFilterCount = 0 ;
+
+//--- Receive buffer
+  private: CANMessage * mReceiveBuffer = nullptr ;
+  private: uint32_t mReceiveBufferSize = 0 ;
+  private: uint32_t mReceiveBufferReadIndex = 0 ;
+  private: uint32_t mReceiveBufferCount = 0 ;
+  private: uint32_t mReceiveBufferPeakCount = 0 ;
+  private: ACANSettings::tReceiveOverflowPolicy mReceiveOverflowPolicy = ACANSettings::kDropNewest ;
+
+//--- Transmit mailbox and buffer, with tryToSend times
+  private: CANMessage mMailboxMessage ;
+  private: uint64_t mMailboxNanos = 0 ;
+  private: bool mMailboxFull = false ;
+  private: CANMessage * mTransmitBuffer = nullptr ;
+  private: uint64_t * mTransmitBufferNanos = nullptr ;
+  private: uint32_t mTransmitBufferSize = 0 ;
+  private: uint32_t mTransmitBufferReadIndex = 0 ;
+  private: uint32_t mTransmitBufferCount = 0 ;
+  private: uint32_t mTransmitBufferPeakCount = 0 ;
+
+//--- Error confinement
+  private: uint32_t mTransmitErrorCounter = 0 ;
+  private: uint32_t mReceiveErrorCounter = 0 ;
+  private: bool mBusOff = false ;
+  private: uint64_t mBusOffEndNanos = 0 ; // Recovery: 128 x 11 recessive bits
+  private: uint64_t mSuspendUntilNanos = 0 ; // Error passive transmitter: suspend transmission
+
+//--- Statistics
+  private: uint32_t mSentFrameCount = 0 ;
+  private: uint32_t mReceivedFrameCount = 0 ;
+  private: uint32_t mDroppedFrameCount = 0 ;
+  private: uint32_t mRejectedFrameCount = 0 ;
+  private: uint32_t mLostArbitrationCount = 0 ;
+  private: uint32_t mBusOffCount = 0 ;
+  private: ACANLatencyHistogram mTransmitLatencyHistogram ;
+
+//--- No copy
+  private : ACANSimulatedNode (const ACANSimulatedNode &) = delete ;
+  private : ACANSimulatedNode & operator = (const ACANSimulatedNode &) = delete ;
+} ;
+
+//----------------------------------------------------------------------------------------
+
+static_assert (ACANIsDriver <ACANSimulatedNode>::value, "ACANSimulatedNode should satisfy the driver interface") ;
+
+//----------------------------------------------------------------------------------------
+
+#endif
+
+//----------------------------------------------------------------------------------------
@@ -15,7 +15,11 @@
 
 //----------------------------------------------------------------------------------------
 
-#include <Arduino.h>
+#ifdef ARDUINO
+  #include <Arduino.h>
+#else
+  #include <stdint.h> // Host build (Linux, macOS)
+#endif
 
 //----------------------------------------------------------------------------------------
 